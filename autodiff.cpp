@@ -0,0 +1,441 @@
+#include "lib.h"
+
+// Автоматическое дифференцирование: grad("выражение", "x, y" [, "forward" | "reverse"]).
+//
+// Выражение переводится в ОПЗ (небольшие функции пользователя подставляются, как и
+// при обычном вычислении) и компилируется в короткую программу над числами.
+// Переменные из списка дифференцирования берутся со своими текущими значениями,
+// остальные переменные - константы.
+//
+// Прямой режим считает программу на дуальных числах v + d*e (e^2 = 0): один проход
+// дает производную по одной переменной, градиент по n переменным - n проходов.
+// Обратный режим за один проход записывает ленту (для каждой операции - номера
+// аргументов и частные производные), затем один обратный проход по ленте
+// накапливает производные по всем переменным сразу, то есть градиент стоит
+// несколько вычислений выражения независимо от n. По умолчанию для одной
+// переменной выбирается прямой режим, для нескольких - обратный.
+//
+// В точках излома берется одна из односторонних производных: abs'(0) = 0,
+// max и min при равенстве аргументов дифференцируются по первому.
+
+#define AD_MAX_VARS 64
+
+typedef enum {
+    AD_CONST,
+    AD_VAR,
+    AD_ADD,
+    AD_SUB,
+    AD_MUL,
+    AD_DIV,
+    AD_NEG,
+    AD_SIN,
+    AD_COS,
+    AD_LOG,
+    AD_ABS,
+    AD_POW,
+    AD_MAX,
+    AD_MIN
+} AdOp;
+
+typedef struct {
+    AdOp op;
+    double value;       // AD_CONST
+    int var;            // AD_VAR: номер переменной дифференцирования
+} AdInstr;
+
+typedef struct {
+    AdInstr *code;
+    int count;
+    int depth;          // Наибольшая глубина стека
+    int vars;
+    double point[AD_MAX_VARS];      // Значения переменных
+} AdProgram;
+
+typedef struct {
+    const char *name;
+    int arg_count;
+    AdOp op;
+} AdFunction;
+
+static const AdFunction ad_functions[] = {
+    {"sin", 1, AD_SIN},
+    {"cos", 1, AD_COS},
+    {"log", 1, AD_LOG},
+    {"abs", 1, AD_ABS},
+    {"pow", 2, AD_POW},
+    {"max", 2, AD_MAX},
+    {"min", 2, AD_MIN},
+    {NULL,  0, AD_CONST}
+};
+
+static int op_arity(AdOp op) {
+    switch (op) {
+        case AD_CONST:
+        case AD_VAR:
+            return 0;
+        case AD_NEG:
+        case AD_SIN:
+        case AD_COS:
+        case AD_LOG:
+        case AD_ABS:
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+// Значение pow тем же ядром, что и в pow_func
+static double ad_pow(double x, double y) {
+    double r;
+    kernels->binary[EW_POW - EW_POW](&x, 0, &y, 0, &r, 1);
+    return r;
+}
+
+
+// Компиляция
+
+// Список имен "x, y z" в массив; возвращает число имен или -1
+static int parse_vars(const char *list, char names[][64], int max) {
+    int count = 0;
+    const char *p = list;
+    while (*p) {
+        while (*p == ' ' || *p == ',') p++;
+        if (!*p) break;
+        if (!isalpha((unsigned char)*p) && *p != '_') return -1;
+        int len = 0;
+        while (isalnum((unsigned char)p[len]) || p[len] == '_') len++;
+        if (count >= max || len >= 64) return -1;
+        memcpy(names[count], p, len);
+        names[count][len] = 0;
+        for (int i = 0; i < count; i++) {
+            if (strcmp(names[i], names[count]) == 0) return -1;
+        }
+        count++;
+        p += len;
+    }
+    return count;
+}
+
+static int compile_token(const Token *t, char names[][64], int vars, AdInstr *in) {
+    memset(in, 0, sizeof(*in));
+    switch (t->type) {
+        case TOK_NUMBER:
+            if (!container_is_scalar(t->container)) break;
+            in->op = AD_CONST;
+            in->value = container_to_double(t->container);
+            return 1;
+
+        case TOK_IDENT: {
+            for (int i = 0; i < vars; i++) {
+                if (strcmp(t->value, names[i]) == 0) {
+                    in->op = AD_VAR;
+                    in->var = i;
+                    return 1;
+                }
+            }
+            Ident *ident = find_ident(FirstIdent, t->value);
+            if (!ident) {
+                print_log("grad: переменная %s не существует\n", t->value);
+                return 0;
+            }
+            if (!container_is_scalar(ident->value->container)) {
+                print_log("grad: переменная %s должна быть числом\n", t->value);
+                return 0;
+            }
+            in->op = AD_CONST;
+            in->value = container_to_double(ident->value->container);
+            return 1;
+        }
+
+        case TOK_PLUS:     in->op = AD_ADD; return 1;
+        case TOK_MINUS:    in->op = AD_SUB; return 1;
+        case TOK_MULTIPLY: in->op = AD_MUL; return 1;
+        case TOK_DIVIDE:   in->op = AD_DIV; return 1;
+        case TOK_UMINUS:   in->op = AD_NEG; return 1;
+
+        case TOK_FUNCTION:
+            for (const AdFunction *f = ad_functions; f->name; f++) {
+                if (strcmp(f->name, t->value) == 0 && f->arg_count == t->arg_count) {
+                    in->op = f->op;
+                    return 1;
+                }
+            }
+            print_log("grad: функция %s не дифференцируется\n", t->value);
+            return 0;
+
+        default:
+            break;
+    }
+    print_log("grad: в выражении допустимы только числа, переменные, + - * / и sin, cos, log, abs, pow, max, min\n");
+    return 0;
+}
+
+static int ad_compile(const char *expr, char names[][64], int vars, AdProgram *prog) {
+    Token *tokens = lex(expr);
+    if (!tokens) return 0;
+    Token *rpn = shuntingYard(tokens);
+    free_tokens(tokens);
+    if (!rpn) {
+        print_log("grad: ошибка разбора выражения\n");
+        return 0;
+    }
+    // Все вызовы функций пользователя раскрываются, сколько бы раз ни встречался параметр
+    rpn = user_expand(rpn);
+
+    int length = 0;
+    for (Token *t = rpn; t; t = t->next) length++;
+    prog->code = (AdInstr*)malloc((size_t)(length > 0 ? length : 1) * sizeof(AdInstr));
+    prog->count = 0;
+    prog->depth = 0;
+    prog->vars = vars;
+
+    int top = 0, ok = prog->code != NULL;
+    for (Token *t = rpn; ok && t; t = t->next) {
+        AdInstr *in = &prog->code[prog->count];
+        ok = compile_token(t, names, vars, in);
+        if (!ok) break;
+        int arity = op_arity(in->op);
+        if (top < arity) {
+            print_log("grad: недостаточно операндов\n");
+            ok = 0;
+            break;
+        }
+        top += 1 - arity;
+        if (top > prog->depth) prog->depth = top;
+        prog->count++;
+    }
+    if (ok && top != 1) {
+        print_log("grad: выражение должно давать одно значение\n");
+        ok = 0;
+    }
+
+    free_tokens(rpn);
+    if (!ok) {
+        free(prog->code);
+        prog->code = NULL;
+    }
+    return ok;
+}
+
+// Проверка области определения; сообщение как у обычных функций
+static int ad_domain(AdOp op, double a, double b) {
+    if (op == AD_DIV && b == 0.0) {
+        print_log("grad: деление на ноль\n");
+        return 0;
+    }
+    if (op == AD_LOG && !(a > 0)) {
+        print_log("grad: аргумент log должен быть положительным\n");
+        return 0;
+    }
+    if (op == AD_POW && a == 0.0 && b < 0.0) {
+        print_log("grad: ноль в отрицательной степени\n");
+        return 0;
+    }
+    return 1;
+}
+
+
+// Прямой режим: дуальные числа
+
+typedef struct {
+    double v;
+    double d;
+} Dual;
+
+static const Dual DUAL_ZERO = {0, 0};
+
+static int forward_pass(const AdProgram *prog, int seed, Dual *stack, double *result) {
+    int top = 0;
+    for (int k = 0; k < prog->count; k++) {
+        const AdInstr *in = &prog->code[k];
+        int arity = op_arity(in->op);
+        Dual a = arity >= 1 ? stack[top - arity] : DUAL_ZERO;
+        Dual b = arity == 2 ? stack[top - 1] : DUAL_ZERO;
+        if (arity > 0 && !ad_domain(in->op, a.v, b.v)) return 0;
+        Dual r;
+
+        switch (in->op) {
+            case AD_CONST: r.v = in->value; r.d = 0; break;
+            case AD_VAR:   r.v = prog->point[in->var]; r.d = in->var == seed; break;
+            case AD_ADD:   r.v = a.v + b.v; r.d = a.d + b.d; break;
+            case AD_SUB:   r.v = a.v - b.v; r.d = a.d - b.d; break;
+            case AD_MUL:   r.v = a.v * b.v; r.d = a.d * b.v + a.v * b.d; break;
+            case AD_DIV:   r.v = a.v / b.v; r.d = (a.d - r.v * b.d) / b.v; break;
+            case AD_NEG:   r.v = -a.v; r.d = -a.d; break;
+            case AD_SIN:   r.v = sin(a.v); r.d = cos(a.v) * a.d; break;
+            case AD_COS:   r.v = cos(a.v); r.d = -sin(a.v) * a.d; break;
+            case AD_LOG:   r.v = log(a.v); r.d = a.d / a.v; break;
+            case AD_ABS:   r.v = fabs(a.v); r.d = a.v < 0 ? -a.d : a.v > 0 ? a.d : 0; break;
+            case AD_POW:
+                r.v = ad_pow(a.v, b.v);
+                r.d = a.d != 0 ? b.v * ad_pow(a.v, b.v - 1) * a.d : 0;
+                // Показатель зависит от переменных: d(a^b)/db = a^b * ln(a)
+                if (b.d != 0) r.d += r.v * log(a.v) * b.d;
+                break;
+            case AD_MAX:   r = a.v >= b.v ? a : b; break;
+            default:       r = a.v <= b.v ? a : b; break;
+        }
+        top -= arity;
+        stack[top++] = r;
+    }
+    *result = stack[0].d;
+    return 1;
+}
+
+static int gradient_forward(const AdProgram *prog, double *grad) {
+    Dual *stack = (Dual*)malloc((size_t)prog->depth * sizeof(Dual));
+    if (!stack) return 0;
+    int ok = 1;
+    for (int v = 0; ok && v < prog->vars; v++) ok = forward_pass(prog, v, stack, &grad[v]);
+    free(stack);
+    return ok;
+}
+
+
+// Обратный режим: лента
+
+// Узел ленты: значение не нужно, для обратного прохода хватает частных производных
+typedef struct {
+    int a, b;           // Номера узлов-аргументов (-1 - нет)
+    double da, db;      // Частные производные по ним
+} TapeNode;
+
+static int gradient_reverse(const AdProgram *prog, double *grad) {
+    TapeNode *tape = (TapeNode*)malloc((size_t)prog->count * sizeof(TapeNode));
+    double *value = (double*)malloc((size_t)prog->depth * sizeof(double));
+    int *node = (int*)malloc((size_t)prog->depth * sizeof(int));
+    char *active = (char*)malloc((size_t)prog->depth);      // Значение зависит от переменных
+    double *adjoint = (double*)calloc((size_t)prog->count, sizeof(double));
+    int *var_node = (int*)malloc((size_t)prog->count * sizeof(int));
+    int ok = tape && value && node && active && adjoint && var_node;
+
+    // Прямой проход: значения на стеке, производные операций - на ленту
+    int top = 0;
+    for (int k = 0; ok && k < prog->count; k++) {
+        const AdInstr *in = &prog->code[k];
+        int arity = op_arity(in->op);
+        double a = arity >= 1 ? value[top - arity] : 0;
+        double b = arity == 2 ? value[top - 1] : 0;
+        if (arity > 0 && !ad_domain(in->op, a, b)) {
+            ok = 0;
+            break;
+        }
+        TapeNode *t = &tape[k];
+        t->a = arity >= 1 ? node[top - arity] : -1;
+        t->b = arity == 2 ? node[top - 1] : -1;
+        t->da = t->db = 0;
+        var_node[k] = in->op == AD_VAR ? in->var : -1;
+        double r;
+
+        switch (in->op) {
+            case AD_CONST: r = in->value; break;
+            case AD_VAR:   r = prog->point[in->var]; break;
+            case AD_ADD:   r = a + b; t->da = 1; t->db = 1; break;
+            case AD_SUB:   r = a - b; t->da = 1; t->db = -1; break;
+            case AD_MUL:   r = a * b; t->da = b; t->db = a; break;
+            case AD_DIV:   r = a / b; t->da = 1 / b; t->db = -r / b; break;
+            case AD_NEG:   r = -a; t->da = -1; break;
+            case AD_SIN:   r = sin(a); t->da = cos(a); break;
+            case AD_COS:   r = cos(a); t->da = -sin(a); break;
+            case AD_LOG:   r = log(a); t->da = 1 / a; break;
+            case AD_ABS:   r = fabs(a); t->da = a < 0 ? -1 : a > 0 ? 1 : 0; break;
+            case AD_POW:
+                r = ad_pow(a, b);
+                t->da = b * ad_pow(a, b - 1);
+                // Производная по показателю нужна, только если он зависит от переменных
+                if (active[top - 1]) t->db = a > 0 ? r * log(a) : NAN;
+                break;
+            case AD_MAX:   r = a >= b ? a : b; t->da = a >= b; t->db = a < b; break;
+            default:       r = a <= b ? a : b; t->da = a <= b; t->db = a > b; break;
+        }
+        int depends = in->op == AD_VAR;
+        for (int i = 1; i <= arity; i++) depends = depends || active[top - i];
+        top -= arity;
+        value[top] = r;
+        node[top] = k;
+        active[top] = (char)depends;
+        top++;
+    }
+
+    // Обратный проход: производная результата по каждому узлу
+    if (ok) {
+        for (int v = 0; v < prog->vars; v++) grad[v] = 0;
+        adjoint[prog->count - 1] = 1;
+        for (int k = prog->count - 1; k >= 0; k--) {
+            double w = adjoint[k];
+            if (w == 0) continue;
+            const TapeNode *t = &tape[k];
+            if (var_node[k] >= 0) grad[var_node[k]] += w;
+            if (t->a >= 0) adjoint[t->a] += w * t->da;
+            if (t->b >= 0) adjoint[t->b] += w * t->db;
+        }
+    }
+
+    free(tape);
+    free(value);
+    free(node);
+    free(active);
+    free(adjoint);
+    free(var_node);
+    return ok;
+}
+
+
+// grad("выражение", "x, y" [, "forward" | "reverse"]): число для одной переменной,
+// столбец производных для нескольких
+Container* grad_func(Container** args, int arg_count) {
+    if (arg_count < 2 || arg_count > 3) {
+        print_log("grad: ожидается grad(\"выражение\", \"x, y\" [, \"forward\" | \"reverse\"])\n");
+        return NULL;
+    }
+    for (int i = 0; i < arg_count; i++) {
+        if (!args[i] || args[i]->type != CT_STRING) {
+            print_log("grad: аргументы должны быть строками в кавычках\n");
+            return NULL;
+        }
+    }
+    const char *expr = ((StringContainer*)args[0]->data)->value;
+    const char *list = ((StringContainer*)args[1]->data)->value;
+
+    char names[AD_MAX_VARS][64];
+    int vars = parse_vars(list, names, AD_MAX_VARS);
+    if (vars <= 0) {
+        print_log("grad: список переменных должен содержать от 1 до %d разных имен\n", AD_MAX_VARS);
+        return NULL;
+    }
+
+    int reverse = vars > 1;
+    if (arg_count == 3) {
+        const char *mode = ((StringContainer*)args[2]->data)->value;
+        if (strcmp(mode, "forward") == 0) {
+            reverse = 0;
+        } else if (strcmp(mode, "reverse") == 0) {
+            reverse = 1;
+        } else {
+            print_log("grad: неизвестный режим %s (forward или reverse)\n", mode);
+            return NULL;
+        }
+    }
+
+    AdProgram prog;
+    for (int i = 0; i < vars; i++) {
+        Ident *ident = find_ident(FirstIdent, names[i]);
+        if (!ident || !container_is_scalar(ident->value->container)) {
+            print_log("grad: переменная %s должна существовать и быть числом\n", names[i]);
+            return NULL;
+        }
+        prog.point[i] = container_to_double(ident->value->container);
+    }
+    if (!ad_compile(expr, names, vars, &prog)) return NULL;
+
+    double grad[AD_MAX_VARS];
+    int ok = reverse ? gradient_reverse(&prog, grad) : gradient_forward(&prog, grad);
+    free(prog.code);
+    if (!ok) return NULL;
+
+    if (vars == 1) return create_float_container(grad[0]);
+    Container *result = create_matrix_container(vars, 1);
+    if (!result) return NULL;
+    memcpy(((MatrixContainer*)result->data)->data, grad, (size_t)vars * sizeof(double));
+    return result;
+}
@@ -0,0 +1,198 @@
+#include "lib.h"
+
+// Замеры времени: "timeit выражение" и "bench файл [n]".
+//
+// timeit разбирает выражение один раз и вычисляет готовую ОПЗ много раз.
+// Один замер - серия из batch вычислений: batch подбирается так, чтобы серия
+// шла не меньше TIMEIT_SAMPLE_MIN, иначе короткие выражения тонут в точности
+// таймера. Замеров не больше TIMEIT_SAMPLES и не дольше TIMEIT_BUDGET в сумме.
+// Кэш memo на время замера выключается: иначе со второго раза меряется попадание.
+// Выделения - учтенные блоки mem.cpp (токены, контейнеры, элементы, разложения).
+//
+// Во время замера print_log молчит; перед ним выражение вычисляется один раз
+// с выводом ошибок, чтобы ошибка не пряталась за нулевым временем.
+
+#define TIMEIT_SAMPLE_MIN   1e-4    // Не короче 100 мкс на замер
+#define TIMEIT_BUDGET       1.0     // Секунд на все замеры
+#define TIMEIT_SAMPLES      1000
+#define TIMEIT_MIN_SAMPLES  3       // Даже если одно вычисление дольше бюджета
+#define TIMEIT_MAX_BATCH    (1 << 20)
+#define BENCH_RUNS          10
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Время в удобных единицах
+static const char* format_time(double seconds, char *buf, size_t size) {
+    if (seconds < 1e-6) snprintf(buf, size, "%.1f нс", seconds * 1e9);
+    else if (seconds < 1e-3) snprintf(buf, size, "%.2f мкс", seconds * 1e6);
+    else if (seconds < 1.0) snprintf(buf, size, "%.2f мс", seconds * 1e3);
+    else snprintf(buf, size, "%.3f с", seconds);
+    return buf;
+}
+
+// Перцентиль отсортированного массива (p от 0 до 1)
+static double percentile(const double *sorted, int n, double p) {
+    int i = (int)(p * n + 0.999999) - 1;
+    if (i < 0) i = 0;
+    if (i >= n) i = n - 1;
+    return sorted[i];
+}
+
+// Серия из batch вычислений; 0 - выражение вернуло ошибку
+static int run_batch(Token *rpn, int batch, double *seconds) {
+    double start = wall_time();
+    for (int i = 0; i < batch; i++) {
+        Container *result = countRPN(rpn);
+        if (!result) return 0;
+        free_container(result);
+    }
+    *seconds = wall_time() - start;
+    return 1;
+}
+
+// Команда "timeit выражение"
+void timeit_command(const char *expr) {
+    while (expr != NULL && *expr == ' ') expr++;
+    if (expr == NULL || *expr == 0) {
+        print_log("timeit: введите выражение через пробел\n");
+        return;
+    }
+
+    Token *tokens = lex(expr);
+    if (tokens == NULL) {
+        print_log("Ошибка лексического анализа\n");
+        return;
+    }
+    Token *rpn = shuntingYard(tokens);
+    free_tokens(tokens);
+    if (rpn == NULL) {
+        print_log("Ошибка синтаксического анализа\n");
+        return;
+    }
+    rpn = user_inline(rpn);
+
+    int saved_memo = memo_enabled;
+    memo_enabled = 0;
+
+    // Проверка с выводом ошибок; заодно прогрев кэшей и отложенных переменных
+    double first;
+    if (!run_batch(rpn, 1, &first)) {
+        memo_enabled = saved_memo;
+        free_tokens(rpn);
+        return;
+    }
+
+    int muted = log_mute(1);
+
+    // Подбор числа вычислений в замере
+    int batch = 1;
+    double elapsed = first;
+    int ok = 1;
+    while (ok && first < TIMEIT_SAMPLE_MIN && batch < TIMEIT_MAX_BATCH) {
+        int grow = first > 0 ? (int)(TIMEIT_SAMPLE_MIN / first * 1.2) + 1 : 16;
+        if (grow < 2) grow = 2;
+        if (grow > 16) grow = 16;
+        batch = batch * grow < TIMEIT_MAX_BATCH ? batch * grow : TIMEIT_MAX_BATCH;
+        ok = run_batch(rpn, batch, &first);
+        elapsed += first;
+    }
+
+    double *samples = (double*)malloc(TIMEIT_SAMPLES * sizeof(double));
+    int count = 0;
+    unsigned long long allocs_before, bytes_before, allocs_after, bytes_after;
+    mem_counters(&allocs_before, &bytes_before);
+    double budget_start = wall_time();
+    while (ok && samples && count < TIMEIT_SAMPLES) {
+        if (count >= TIMEIT_MIN_SAMPLES && wall_time() - budget_start >= TIMEIT_BUDGET) break;
+        double seconds;
+        ok = run_batch(rpn, batch, &seconds);
+        if (ok) samples[count++] = seconds / batch;
+    }
+    mem_counters(&allocs_after, &bytes_after);
+
+    log_mute(muted);
+    memo_enabled = saved_memo;
+    free_tokens(rpn);
+
+    if (!samples) {
+        print_log("Ошибка: не удалось выделить память для замеров\n");
+        return;
+    }
+    if (!ok) {
+        // Выражение со случайностью или лимитом памяти может упасть не сразу
+        print_log("timeit: ошибка во время замера после %d замеров\n", count);
+        free(samples);
+        return;
+    }
+
+    qsort(samples, count, sizeof(double), compare_double);
+    double evaluations = (double)count * batch;
+    char t_min[32], t_med[32], t_p99[32];
+    print_log("%d замеров по %d вычислений (%.2f с)\n", count, batch, wall_time() - budget_start + elapsed);
+    print_log("  мин %s, медиана %s, p99 %s\n",
+              format_time(samples[0], t_min, sizeof(t_min)),
+              format_time(percentile(samples, count, 0.5), t_med, sizeof(t_med)),
+              format_time(percentile(samples, count, 0.99), t_p99, sizeof(t_p99)));
+    print_log("  выделений %.1f (%.1f КБ) на вычисление\n",
+              (allocs_after - allocs_before) / evaluations,
+              (bytes_after - bytes_before) / evaluations / 1024.0);
+    free(samples);
+}
+
+// Команда "bench файл [n]": выполнить сценарий n раз без вывода
+void bench_command(const char *arg) {
+    while (arg != NULL && *arg == ' ') arg++;
+    if (arg == NULL || *arg == 0) {
+        print_log("bench: введите имя файла через пробел\n");
+        print_log("Пример: bench program.txt 10\n");
+        return;
+    }
+
+    // Последнее слово - число повторов, если это число
+    char filename[256];
+    snprintf(filename, sizeof(filename), "%s", arg);
+    int runs = BENCH_RUNS;
+    char *space = strrchr(filename, ' ');
+    if (space != NULL && atoi(space + 1) > 0) {
+        runs = atoi(space + 1);
+        *space = 0;
+    }
+
+    double *times = (double*)malloc(runs * sizeof(double));
+    if (!times) {
+        print_log("Ошибка: не удалось выделить память для замеров\n");
+        return;
+    }
+
+    // Переменные сценария остаются между повторами, как при повторном open
+    long long lines = 0;
+    for (int r = 0; r < runs; r++) {
+        int muted = log_mute(1);
+        double start = wall_time();
+        int count = execute_script(filename, 0);
+        times[r] = wall_time() - start;
+        log_mute(muted);
+
+        if (count < 0) {
+            print_log("Ошибка: не удалось открыть файл скрипта '%s'\n", filename);
+            free(times);
+            return;
+        }
+        lines += count;
+    }
+
+    double total = 0;
+    for (int i = 0; i < runs; i++) total += times[i];
+    qsort(times, runs, sizeof(double), compare_double);
+
+    char t_min[32], t_med[32];
+    print_log("%s: %d повторов по %lld строк за %.3f с\n", filename, runs, lines / runs, total);
+    print_log("  %.0f строк/с, повтор: мин %s, медиана %s\n",
+              total > 0 ? lines / total : 0.0,
+              format_time(times[0], t_min, sizeof(t_min)),
+              format_time(percentile(times, runs, 0.5), t_med, sizeof(t_med)));
+    free(times);
+}
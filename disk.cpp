@@ -0,0 +1,510 @@
+#include "lib.h"
+
+// Матрицы на диске, которые не помещаются в память. Файл: заголовок размером
+// DISK_HEADER, затем тайлы DISK_TILE x DISK_TILE по строкам тайлов; каждый тайл
+// лежит в файле подряд (по строкам), крайние тайлы дополнены нулями. В память
+// отображаются только тайлы, с которыми идет работа.
+
+#define DISK_MAGIC "MCDISK1"
+#define TILE_BYTES ((size_t)DISK_TILE * DISK_TILE * sizeof(double))
+
+typedef struct {
+    char magic[8];
+    int rows;
+    int cols;
+    int tile;
+} DiskHeader;
+
+// Отображенный в память тайл матрицы
+typedef struct {
+    int row;
+    int col;
+    double *data;
+} TileRef;
+
+// Счетчики планировщика умножения
+typedef struct {
+    long long loads;    // Отображено тайлов A и B
+    long long reused;   // Тайл уже был отображен на предыдущем шаге
+} DiskStats;
+
+// Описание диапазона памяти для PrefetchVirtualMemory (WIN32_MEMORY_RANGE_ENTRY)
+typedef struct {
+    void *address;
+    size_t size;
+} PrefetchRange;
+
+typedef BOOL (WINAPI *PrefetchFunc)(HANDLE process, ULONG_PTR count, PrefetchRange *ranges, ULONG flags);
+
+
+// Файлы
+
+static DiskFile* disk_file_open(const char *path, int create, long long size) {
+    if (strlen(path) >= MAX_PATH) {
+        print_log("Ошибка: слишком длинное имя файла %s\n", path);
+        return NULL;
+    }
+
+    HANDLE file = CreateFileA(path, create ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                              FILE_SHARE_READ, NULL, create ? CREATE_ALWAYS : OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        print_log("Ошибка: не удалось открыть файл %s\n", path);
+        return NULL;
+    }
+
+    // Отображение нового файла заданного размера сразу увеличивает файл
+    HANDLE mapping = CreateFileMappingA(file, NULL, create ? PAGE_READWRITE : PAGE_READONLY,
+                                        create ? (DWORD)(size >> 32) : 0,
+                                        create ? (DWORD)(size & 0xFFFFFFFF) : 0, NULL);
+    if (!mapping) {
+        print_log("Ошибка: не удалось отобразить файл %s в память\n", path);
+        CloseHandle(file);
+        return NULL;
+    }
+
+    DiskFile *df = (DiskFile*)malloc(sizeof(DiskFile));
+    df->refs = 1;
+    df->file = file;
+    df->mapping = mapping;
+    strcpy(df->path, path);
+    return df;
+}
+
+static void disk_file_release(DiskFile *df) {
+    if (!df || --df->refs > 0) return;
+
+    CloseHandle(df->mapping);
+    CloseHandle(df->file);
+    free(df);
+}
+
+static long long disk_file_size(int rows, int cols) {
+    long long tiles = (long long)((rows + DISK_TILE - 1) / DISK_TILE) * ((cols + DISK_TILE - 1) / DISK_TILE);
+    return DISK_HEADER + tiles * (long long)TILE_BYTES;
+}
+
+
+// Контейнер
+
+static Container* create_disk_container(DiskFile *df, int rows, int cols) {
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
+    DiskContainer *disk = (DiskContainer*)malloc(sizeof(DiskContainer));
+
+    disk->rows = rows;
+    disk->cols = cols;
+    disk->tile_rows = (rows + DISK_TILE - 1) / DISK_TILE;
+    disk->tile_cols = (cols + DISK_TILE - 1) / DISK_TILE;
+    disk->file = df;
+    container->type = CT_DISK;
+    container->data = disk;
+    container->free_func = free_disk_container;
+    container->print_func = print_disk_container;
+
+    return container;
+}
+
+void free_disk_container(void *data) {
+    DiskContainer *disk = (DiskContainer*)data;
+    if (disk) {
+        disk_file_release(disk->file);
+        free(disk);
+    }
+}
+
+void print_disk_container(void *data) {
+    DiskContainer *disk = (DiskContainer*)data;
+    if (!disk) return;
+    print_log("disk(\"%s\") (%dx%d)", disk->file->path, disk->rows, disk->cols);
+}
+
+// Копия значения - еще одна ссылка на тот же файл
+Container* disk_copy(DiskContainer *d) {
+    d->file->refs++;
+    return create_disk_container(d->file, d->rows, d->cols);
+}
+
+// Новый файл матрицы rows x cols, заполненный нулями
+static Container* disk_create(const char *path, int rows, int cols) {
+    DiskFile *df = disk_file_open(path, 1, disk_file_size(rows, cols));
+    if (!df) return NULL;
+
+    DiskHeader *header = (DiskHeader*)MapViewOfFile(df->mapping, FILE_MAP_WRITE, 0, 0, DISK_HEADER);
+    if (!header) {
+        print_log("Ошибка: не удалось записать заголовок %s\n", path);
+        disk_file_release(df);
+        return NULL;
+    }
+    memcpy(header->magic, DISK_MAGIC, sizeof(header->magic));
+    header->rows = rows;
+    header->cols = cols;
+    header->tile = DISK_TILE;
+    UnmapViewOfFile(header);
+
+    return create_disk_container(df, rows, cols);
+}
+
+// Открытие существующего файла матрицы
+static Container* disk_open(const char *path) {
+    DiskFile *df = disk_file_open(path, 0, 0);
+    if (!df) return NULL;
+
+    LARGE_INTEGER size;
+    DiskHeader *header = NULL;
+    if (GetFileSizeEx(df->file, &size) && size.QuadPart >= DISK_HEADER) {
+        header = (DiskHeader*)MapViewOfFile(df->mapping, FILE_MAP_READ, 0, 0, DISK_HEADER);
+    }
+    int valid = header && memcmp(header->magic, DISK_MAGIC, sizeof(header->magic)) == 0 &&
+                header->tile == DISK_TILE && header->rows > 0 && header->cols > 0 &&
+                size.QuadPart >= disk_file_size(header->rows, header->cols);
+    int rows = valid ? header->rows : 0;
+    int cols = valid ? header->cols : 0;
+    if (header) UnmapViewOfFile(header);
+
+    if (!valid) {
+        print_log("Ошибка: %s не является файлом матрицы\n", path);
+        disk_file_release(df);
+        return NULL;
+    }
+    return create_disk_container(df, rows, cols);
+}
+
+
+// Тайлы
+
+// Размер тайла с номером t по измерению длины total
+static int tile_extent(int total, int t) {
+    int rest = total - t * DISK_TILE;
+    return rest < DISK_TILE ? rest : DISK_TILE;
+}
+
+static double* disk_map_tile(DiskContainer *d, int row, int col, int write) {
+    long long offset = DISK_HEADER + ((long long)row * d->tile_cols + col) * (long long)TILE_BYTES;
+    double *data = (double*)MapViewOfFile(d->file->mapping, write ? FILE_MAP_WRITE : FILE_MAP_READ,
+                                          (DWORD)(offset >> 32), (DWORD)(offset & 0xFFFFFFFF), TILE_BYTES);
+    if (!data) print_log("Ошибка: не удалось отобразить тайл (%d, %d) файла %s\n", row, col, d->file->path);
+    return data;
+}
+
+// Асинхронная подкачка страниц с диска. PrefetchVirtualMemory есть начиная с Windows 8;
+// в более старых системах страницы читаются при первом обращении
+static void disk_prefetch(void *data, size_t size) {
+    static PrefetchFunc prefetch = NULL;
+    static int resolved = 0;
+
+    if (!resolved) {
+        prefetch = (PrefetchFunc)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+        resolved = 1;
+    }
+    if (prefetch) {
+        PrefetchRange range = {data, size};
+        prefetch(GetCurrentProcess(), 1, &range, 0);
+    }
+}
+
+// Тайл (row, col) с подкачкой; если он уже отображен на текущем шаге, берется он же
+static TileRef tile_acquire(DiskContainer *d, int row, int col, const TileRef *current, DiskStats *stats) {
+    TileRef ref = {row, col, NULL};
+
+    stats->loads++;
+    if (current->data && current->row == row && current->col == col) {
+        stats->reused++;
+        ref.data = current->data;
+        return ref;
+    }
+    ref.data = disk_map_tile(d, row, col, 0);
+    if (ref.data) disk_prefetch(ref.data, TILE_BYTES);
+    return ref;
+}
+
+static void tile_release(TileRef *ref, const TileRef *next) {
+    if (ref->data && ref->data != next->data) UnmapViewOfFile(ref->data);
+    ref->data = NULL;
+}
+
+// Запись тайла C; FlushViewOfFile начинает запись на диск, не дожидаясь ее окончания
+static int tile_store(DiskContainer *d, int row, int col, const double *data) {
+    double *view = disk_map_tile(d, row, col, 1);
+    if (!view) return 0;
+    memcpy(view, data, TILE_BYTES);
+    FlushViewOfFile(view, 0);
+    UnmapViewOfFile(view);
+    return 1;
+}
+
+
+// Умножение
+
+// Шаг s планировщика: C(i, j) += A(i, p) * B(p, j). Тайлы C обходятся змейкой по j,
+// а p внутри каждого тайла C - попеременно вперед и назад. Тогда последний тайл A
+// (в пределах строки) или B (при переходе на следующую строку) нужен и следующему шагу
+static void disk_step(long long s, int nt, int kt, int *i, int *j, int *p) {
+    long long t = s / kt;
+
+    *i = (int)(t / nt);
+    *j = (int)(t % nt);
+    *p = (int)(s % kt);
+    if (*i & 1) *j = nt - 1 - *j;
+    if (t & 1) *p = kt - 1 - *p;
+}
+
+// C = A*B по тайлам. Пока считается текущий шаг, тайлы следующего уже подкачиваются
+static int disk_gemm(DiskContainer *a, DiskContainer *b, DiskContainer *c, DiskStats *stats) {
+    int mt = a->tile_rows;
+    int nt = b->tile_cols;
+    int kt = a->tile_cols;
+    long long steps = (long long)mt * nt * kt;
+
+    double *acc = (double*)mem_alloc(MEM_SCRATCH, TILE_BYTES);
+    if (!acc) {
+        print_log("Ошибка: недостаточно памяти для тайла %dx%d\n", DISK_TILE, DISK_TILE);
+        return 0;
+    }
+
+    TileRef none = {-1, -1, NULL};
+    TileRef ta, tb;
+    int i, j, p;
+    disk_step(0, nt, kt, &i, &j, &p);
+    ta = tile_acquire(a, i, p, &none, stats);
+    tb = tile_acquire(b, p, j, &none, stats);
+
+    int ok = ta.data && tb.data;
+    for (long long s = 0; s < steps && ok; s++) {
+        disk_step(s, nt, kt, &i, &j, &p);
+
+        TileRef na = none, nb = none;
+        if (s + 1 < steps) {
+            int i2, j2, p2;
+            disk_step(s + 1, nt, kt, &i2, &j2, &p2);
+            na = tile_acquire(a, i2, p2, &ta, stats);
+            nb = tile_acquire(b, p2, j2, &tb, stats);
+            ok = na.data && nb.data;
+        }
+
+        if (s % kt == 0) memset(acc, 0, TILE_BYTES);
+        gemm(tile_extent(a->rows, i), tile_extent(b->cols, j), tile_extent(a->cols, p),
+             1.0, ta.data, DISK_TILE, tb.data, DISK_TILE, 1.0, acc, DISK_TILE);
+        if (s % kt == kt - 1 && !tile_store(c, i, j, acc)) ok = 0;
+
+        tile_release(&ta, &na);
+        tile_release(&tb, &nb);
+        ta = na;
+        tb = nb;
+    }
+
+    tile_release(&ta, &none);
+    tile_release(&tb, &none);
+    mem_free(MEM_SCRATCH, acc);
+    return ok;
+}
+
+// Произведение двух матриц на диске в новый файл path
+static Container* disk_multiply(DiskContainer *a, DiskContainer *b, const char *path, DiskStats *stats) {
+    if (a->cols != b->rows) {
+        print_log("Ошибка: несогласованные размеры %dx%d и %dx%d\n", a->rows, a->cols, b->rows, b->cols);
+        return NULL;
+    }
+    if (strcmp(path, a->file->path) == 0 || strcmp(path, b->file->path) == 0) {
+        print_log("Ошибка: результат нельзя записать в файл множителя %s\n", path);
+        return NULL;
+    }
+
+    Container *result = disk_create(path, a->rows, b->cols);
+    if (!result) return NULL;
+
+    stats->loads = 0;
+    stats->reused = 0;
+    if (!disk_gemm(a, b, (DiskContainer*)result->data, stats)) {
+        free_container(result);
+        return NULL;
+    }
+    return result;
+}
+
+
+// Преобразования
+
+// Матрица на диске целиком в память
+Container* disk_to_matrix(DiskContainer *d) {
+    Container *result = create_matrix_container(d->rows, d->cols);
+    if (!result) return NULL;
+    double *out = ((MatrixContainer*)result->data)->data;
+
+    for (int ti = 0; ti < d->tile_rows; ti++) {
+        for (int tj = 0; tj < d->tile_cols; tj++) {
+            double *tile = disk_map_tile(d, ti, tj, 0);
+            if (!tile) {
+                free_container(result);
+                return NULL;
+            }
+            int mb = tile_extent(d->rows, ti);
+            int nb = tile_extent(d->cols, tj);
+            for (int r = 0; r < mb; r++) {
+                memcpy(out + (size_t)(ti * DISK_TILE + r) * d->cols + (size_t)tj * DISK_TILE,
+                       tile + (size_t)r * DISK_TILE, nb * sizeof(double));
+            }
+            UnmapViewOfFile(tile);
+        }
+    }
+    return result;
+}
+
+// Заполнение тайлов нового файла: из матрицы m или случайными числами (m = NULL)
+static int disk_fill(DiskContainer *d, const MatrixContainer *m) {
+    for (int ti = 0; ti < d->tile_rows; ti++) {
+        for (int tj = 0; tj < d->tile_cols; tj++) {
+            double *tile = disk_map_tile(d, ti, tj, 1);
+            if (!tile) return 0;
+            int mb = tile_extent(d->rows, ti);
+            int nb = tile_extent(d->cols, tj);
+            for (int r = 0; r < mb; r++) {
+                double *dst = tile + (size_t)r * DISK_TILE;
+                if (m) {
+                    memcpy(dst, m->data + (size_t)(ti * DISK_TILE + r) * m->cols + (size_t)tj * DISK_TILE,
+                           nb * sizeof(double));
+                } else {
+                    for (int c = 0; c < nb; c++) dst[c] = rand_uniform();
+                }
+            }
+            UnmapViewOfFile(tile);
+        }
+    }
+    return 1;
+}
+
+static const char* arg_to_path(Container *arg, const char *func_name) {
+    if (!arg || arg->type != CT_STRING) {
+        print_log("%s: имя файла должно быть строкой\n", func_name);
+        return NULL;
+    }
+    return ((StringContainer*)arg->data)->value;
+}
+
+// Функции калькулятора
+
+// disk("файл") - открыть матрицу на диске, disk("файл", A) - записать A в файл
+Container* disk_func(Container** args, int arg_count) {
+    if (arg_count != 1 && arg_count != 2) {
+        print_log("disk: ожидается 1 или 2 аргумента\n");
+        return NULL;
+    }
+    const char *path = arg_to_path(args[0], "disk");
+    if (!path) return NULL;
+    if (arg_count == 1) return disk_open(path);
+
+    Container *dense = args[1] ? container_to_matrix(args[1]) : NULL;
+    if (!dense) {
+        print_log("disk: второй аргумент должен быть матрицей\n");
+        return NULL;
+    }
+    MatrixContainer *m = (MatrixContainer*)dense->data;
+    Container *result = disk_create(path, m->rows, m->cols);
+    if (result && !disk_fill((DiskContainer*)result->data, m)) {
+        free_container(result);
+        result = NULL;
+    }
+    free_container(dense);
+    return result;
+}
+
+// diskrand("файл", m, n) - случайная матрица на диске, заполняется по тайлам
+Container* diskrand_func(Container** args, int arg_count) {
+    if (arg_count != 3) {
+        print_log("diskrand: ожидается 3 аргумента\n");
+        return NULL;
+    }
+    const char *path = arg_to_path(args[0], "diskrand");
+    int rows, cols;
+    if (!path || !arg_to_size(args[1], "diskrand", &rows) || !arg_to_size(args[2], "diskrand", &cols)) return NULL;
+
+    Container *result = disk_create(path, rows, cols);
+    if (result && !disk_fill((DiskContainer*)result->data, NULL)) {
+        free_container(result);
+        result = NULL;
+    }
+    return result;
+}
+
+// diskmul(A, B, "файл") - произведение матриц на диске, результат пишется в файл
+Container* diskmul_func(Container** args, int arg_count) {
+    if (arg_count != 3) {
+        print_log("diskmul: ожидается 3 аргумента\n");
+        return NULL;
+    }
+    if (!args[0] || args[0]->type != CT_DISK || !args[1] || args[1]->type != CT_DISK) {
+        print_log("diskmul: множители должны быть матрицами на диске (disk, diskrand)\n");
+        return NULL;
+    }
+    const char *path = arg_to_path(args[2], "diskmul");
+    if (!path) return NULL;
+
+    DiskStats stats;
+    return disk_multiply((DiskContainer*)args[0]->data, (DiskContainer*)args[1]->data, path, &stats);
+}
+
+
+// Тест "diskbench [n]": умножение двух случайных матриц n x n через файлы в текущей папке.
+// Выборочные элементы произведения сверяются со скалярными произведениями строк и столбцов
+void disk_benchmark(int n) {
+    static const char *names[3] = {"diskbench_a.bin", "diskbench_b.bin", "diskbench_c.bin"};
+    const int samples = 8;
+    double gib = (double)disk_file_size(n, n) / (1024.0 * 1024.0 * 1024.0);
+
+    print_log("Умножение %dx%d на диске: тайлы %dx%d, файлы по %.2f ГиБ\n", n, n, DISK_TILE, DISK_TILE, gib);
+
+    double t0 = wall_time();
+    Container *a = disk_create(names[0], n, n);
+    Container *b = a ? disk_create(names[1], n, n) : NULL;
+    int ok = b && disk_fill((DiskContainer*)a->data, NULL) && disk_fill((DiskContainer*)b->data, NULL);
+    double t_fill = wall_time() - t0;
+
+    DiskStats stats = {0, 0};
+    Container *c = NULL;
+    double t_mul = 0.0;
+    if (ok) {
+        t0 = wall_time();
+        c = disk_multiply((DiskContainer*)a->data, (DiskContainer*)b->data, names[2], &stats);
+        t_mul = wall_time() - t0;
+    }
+
+    if (c) {
+        DiskContainer *da = (DiskContainer*)a->data;
+        DiskContainer *db = (DiskContainer*)b->data;
+        DiskContainer *dc = (DiskContainer*)c->data;
+        double max_diff = 0.0;
+
+        for (int s = 0; s < samples && ok; s++) {
+            int i = (int)(rand_next() % n);
+            int j = (int)(rand_next() % n);
+            int ti = i / DISK_TILE, tj = j / DISK_TILE;
+            double expected = 0.0;
+
+            for (int p = 0; p < da->tile_cols && ok; p++) {
+                double *ta = disk_map_tile(da, ti, p, 0);
+                double *tb = disk_map_tile(db, p, tj, 0);
+                ok = ta && tb;
+                for (int k = 0; ok && k < tile_extent(n, p); k++) {
+                    expected += ta[(size_t)(i % DISK_TILE) * DISK_TILE + k] * tb[(size_t)k * DISK_TILE + j % DISK_TILE];
+                }
+                if (ta) UnmapViewOfFile(ta);
+                if (tb) UnmapViewOfFile(tb);
+            }
+            double *tc = ok ? disk_map_tile(dc, ti, tj, 0) : NULL;
+            if (tc) {
+                double diff = fabs(tc[(size_t)(i % DISK_TILE) * DISK_TILE + j % DISK_TILE] - expected);
+                if (diff > max_diff) max_diff = diff;
+                UnmapViewOfFile(tc);
+            }
+        }
+
+        print_log("заполнение %.2f с, умножение %.2f с, %.2f ГФлоп/с\n",
+                  t_fill, t_mul, 2.0 * n * (double)n * n / t_mul * 1e-9);
+        print_log("тайлов A и B: %lld, из них без повторного отображения: %lld%s\n",
+                  stats.loads, stats.reused, max_diff > 1e-9 * n ? "  (РАСХОЖДЕНИЕ)" : "");
+    }
+
+    free_container(a);
+    free_container(b);
+    free_container(c);
+    for (int f = 0; f < 3; f++) DeleteFileA(names[f]);
+}
@@ -0,0 +1,219 @@
+#include "lib.h"
+
+// Выбор вычислительных ядер под набор инструкций процессора.
+//
+// При запуске dispatch_init определяет старший доступный уровень (SSE2, AVX2,
+// AVX-512) и заполняет указатель kernels таблицей соответствующих функций.
+// Уровень можно понизить переменной окружения MC_ISA=sse2|avx2|avx512 или
+// командой isa. Поэлементные ядра дают одинаковый результат на всех уровнях,
+// у сумм и скалярного произведения от ширины регистра зависит порядок
+// суммирования (при фиксированном уровне результат воспроизводим).
+
+static const char *isa_names[ISA_COUNT] = { "sse2", "avx2", "avx512" };
+
+static KernelTable tables[ISA_COUNT];
+static IsaLevel max_level = ISA_SSE2;
+
+const KernelTable *kernels = &tables[ISA_SSE2];
+
+
+// y += a*x
+static FORCE_INLINE void axpy_body(double a, const double *x, double *y, int n) {
+    #pragma omp simd
+    for (int i = 0; i < n; i++) y[i] += a * x[i];
+}
+
+// x *= a
+static FORCE_INLINE void scal_body(double a, double *x, int n) {
+    #pragma omp simd
+    for (int i = 0; i < n; i++) x[i] *= a;
+}
+
+// x /= a - когда 1/a неточно, умножение на него дает другое округление
+static FORCE_INLINE void scal_div_body(double a, double *x, int n) {
+    #pragma omp simd
+    for (int i = 0; i < n; i++) x[i] /= a;
+}
+
+// y += a*x в одинарной точности
+static FORCE_INLINE void saxpy_body(float a, const float *x, float *y, int n) {
+    #pragma omp simd
+    for (int i = 0; i < n; i++) y[i] += a * x[i];
+}
+
+// Скалярное произведение float с накоплением в double
+static FORCE_INLINE float sdot_body(const float *x, const float *y, int n) {
+    double sum = 0.0;
+    #pragma omp simd reduction(+:sum)
+    for (int i = 0; i < n; i++) sum += (double)x[i] * y[i];
+    return (float)sum;
+}
+
+static FORCE_INLINE double dot_body(const double *x, const double *y, int n) {
+    double sum = 0.0;
+    #pragma omp simd reduction(+:sum)
+    for (int i = 0; i < n; i++) sum += x[i] * y[i];
+    return sum;
+}
+
+static FORCE_INLINE double sum_body(const double *x, int n) {
+    double sum = 0.0;
+    #pragma omp simd reduction(+:sum)
+    for (int i = 0; i < n; i++) sum += x[i];
+    return sum;
+}
+
+// Суммирование Кэхэна в KAHAN_LANES независимых дорожках, чтобы цикл
+// векторизовался; дорожки и хвост складываются по Ноймайеру
+#define KAHAN_LANES 8
+
+// Компенсированное сложение Ноймайера: sum + comp - точная сумма слагаемых
+void neumaier_add(double *sum, double *comp, double x) {
+    double t = *sum + x;
+    if (fabs(*sum) >= fabs(x)) *comp += (*sum - t) + x;
+    else *comp += (x - t) + *sum;
+    *sum = t;
+}
+
+static FORCE_INLINE double kahan_finish(const double *s, const double *c, const double *tail, int tail_n) {
+    double sum = 0.0, comp = 0.0;
+    for (int l = 0; l < KAHAN_LANES; l++) {
+        neumaier_add(&sum, &comp, s[l]);
+        neumaier_add(&sum, &comp, -c[l]);
+    }
+    for (int i = 0; i < tail_n; i++) neumaier_add(&sum, &comp, tail[i]);
+    return sum + comp;
+}
+
+static FORCE_INLINE double sum_kahan_body(const double *x, int n) {
+    double s[KAHAN_LANES] = {0}, c[KAHAN_LANES] = {0};
+    int i = 0;
+    for (; i + KAHAN_LANES <= n; i += KAHAN_LANES) {
+        for (int l = 0; l < KAHAN_LANES; l++) {
+            double y = x[i + l] - c[l];
+            double t = s[l] + y;
+            c[l] = (t - s[l]) - y;
+            s[l] = t;
+        }
+    }
+    return kahan_finish(s, c, x + i, n - i);
+}
+
+// Компенсируется ошибка сложения; ошибка округления произведений остается
+static FORCE_INLINE double dot_kahan_body(const double *x, const double *y, int n) {
+    double s[KAHAN_LANES] = {0}, c[KAHAN_LANES] = {0};
+    double tail[KAHAN_LANES];
+    int i = 0;
+    for (; i + KAHAN_LANES <= n; i += KAHAN_LANES) {
+        for (int l = 0; l < KAHAN_LANES; l++) {
+            double v = x[i + l] * y[i + l] - c[l];
+            double t = s[l] + v;
+            c[l] = (t - s[l]) - v;
+            s[l] = t;
+        }
+    }
+    for (int k = 0; i + k < n; k++) tail[k] = x[i + k] * y[i + k];
+    return kahan_finish(s, c, tail, n - i);
+}
+
+static FORCE_INLINE double minval_body(const double *x, int n) {
+    double m = x[0];
+    #pragma omp simd reduction(min:m)
+    for (int i = 1; i < n; i++) m = x[i] < m ? x[i] : m;
+    return m;
+}
+
+static FORCE_INLINE double maxval_body(const double *x, int n) {
+    double m = x[0];
+    #pragma omp simd reduction(max:m)
+    for (int i = 1; i < n; i++) m = x[i] > m ? x[i] : m;
+    return m;
+}
+
+KERNEL_VARIANTS(void, axpy, (double a, const double *x, double *y, int n), (a, x, y, n))
+KERNEL_VARIANTS(void, scal, (double a, double *x, int n), (a, x, n))
+KERNEL_VARIANTS(void, scal_div, (double a, double *x, int n), (a, x, n))
+KERNEL_VARIANTS(void, saxpy, (float a, const float *x, float *y, int n), (a, x, y, n))
+KERNEL_VARIANTS(float, sdot, (const float *x, const float *y, int n), (x, y, n))
+KERNEL_VARIANTS(double, dot, (const double *x, const double *y, int n), (x, y, n))
+KERNEL_VARIANTS(double, dot_kahan, (const double *x, const double *y, int n), (x, y, n))
+KERNEL_VARIANTS(double, sum, (const double *x, int n), (x, n))
+KERNEL_VARIANTS(double, sum_kahan, (const double *x, int n), (x, n))
+KERNEL_VARIANTS(double, minval, (const double *x, int n), (x, n))
+KERNEL_VARIANTS(double, maxval, (const double *x, int n), (x, n))
+
+
+static IsaLevel detect_level() {
+#ifdef ISA_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return ISA_AVX512;
+    if (__builtin_cpu_supports("avx2")) return ISA_AVX2;
+#endif
+    return ISA_SSE2;
+}
+
+const char* isa_name(IsaLevel level) {
+    return isa_names[level];
+}
+
+static int isa_parse(const char *name, IsaLevel *level) {
+    for (int l = 0; l < ISA_COUNT; l++) {
+        if (strcmp(name, isa_names[l]) == 0) {
+            *level = (IsaLevel)l;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Переключение на заданный уровень, если процессор его поддерживает
+static int isa_select(const char *name, const char *source) {
+    IsaLevel level;
+    if (!isa_parse(name, &level)) {
+        print_log("%s: неизвестный набор инструкций '%s' (sse2, avx2, avx512)\n", source, name);
+        return 0;
+    }
+    if (level > max_level) {
+        print_log("%s: процессор не поддерживает %s\n", source, isa_name(level));
+        return 0;
+    }
+    kernels = &tables[level];
+    return 1;
+}
+
+void dispatch_init() {
+    max_level = detect_level();
+
+    for (int l = 0; l < ISA_COUNT; l++) {
+        KernelTable *t = &tables[l];
+        t->level = (IsaLevel)l;
+        t->axpy = KERNEL_PICK(axpy, t->level);
+        t->scal = KERNEL_PICK(scal, t->level);
+        t->scal_div = KERNEL_PICK(scal_div, t->level);
+        t->dot  = KERNEL_PICK(dot, t->level);
+        t->dot_kahan = KERNEL_PICK(dot_kahan, t->level);
+        t->sum       = KERNEL_PICK(sum, t->level);
+        t->sum_kahan = KERNEL_PICK(sum_kahan, t->level);
+        t->minval    = KERNEL_PICK(minval, t->level);
+        t->maxval    = KERNEL_PICK(maxval, t->level);
+        t->saxpy     = KERNEL_PICK(saxpy, t->level);
+        t->sdot      = KERNEL_PICK(sdot, t->level);
+        vmath_register(t);
+    }
+    kernels = &tables[max_level];
+
+    const char *env = getenv("MC_ISA");
+    if (env != NULL && *env != 0) isa_select(env, "MC_ISA");
+}
+
+// Команда "isa [уровень]": без аргумента показывает текущий уровень
+void isa_command(const char *arg) {
+    while (arg != NULL && *arg == ' ') arg++;
+    if (arg != NULL && *arg != 0) {
+        // Отложенные выражения считаются ядрами, выбранными на момент присваивания
+        lazy_force_all();
+        if (!isa_select(arg, "isa")) return;
+    }
+    print_log("Набор инструкций: %s (максимальный для процессора: %s)\n",
+              isa_name(kernels->level), isa_name(max_level));
+}
@@ -0,0 +1,929 @@
+#include "lib.h"
+#include <float.h>
+
+// Размер трехдиагональной задачи, начиная с которого "разделяй и властвуй" переходит на QL-итерации
+#define DC_MIN_SIZE 32
+
+// Предел итераций QL/QR на одно собственное (сингулярное) значение
+#define EIG_MAX_ITER 75
+
+// Ширина полосы столбцов A в произведении A^T * X
+#define TN_BLOCK 64
+
+// Запас по размерности и число степенных итераций рандомизированного svds
+#define SVDS_OVERSAMPLE  10
+#define SVDS_POWER_ITERS 2
+
+typedef struct {
+    double value;
+    int index;
+} SortKey;
+
+static int sort_key_cmp(const void *a, const void *b) {
+    double x = ((const SortKey*)a)->value, y = ((const SortKey*)b)->value;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+
+// Отражение Хаусхолдера для x (len элементов с шагом stride): x[0] заменяется на beta,
+// остальные элементы - на вектор v (v_0 = 1 не хранится); возвращает tau
+static double house(double *x, int len, size_t stride) {
+    double alpha = x[0];
+    double sigma = 0.0;
+    for (int i = 1; i < len; i++) sigma += x[i * stride] * x[i * stride];
+    if (sigma == 0.0) return 0.0;
+
+    double beta = -copysign(sqrt(alpha * alpha + sigma), alpha);
+    double scale = 1.0 / (alpha - beta);
+    for (int i = 1; i < len; i++) x[i * stride] *= scale;
+    x[0] = beta;
+    return (beta - alpha) / beta;
+}
+
+// B = (I - tau*v*v^T) * B для блока rows x cols; w - рабочий массив длины cols
+static void house_left(double *b, size_t ldb, int rows, int cols, const double *v, double tau, double *w) {
+    if (tau == 0.0 || cols <= 0) return;
+
+    // w = B^T * v: каждый поток накапливает свою полосу столбцов
+    double work = (double)rows * cols;
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+    for (int c0 = 0; c0 < cols; c0 += TN_BLOCK) {
+        int c1 = c0 + TN_BLOCK < cols ? c0 + TN_BLOCK : cols;
+        for (int c = c0; c < c1; c++) w[c] = 0.0;
+        for (int i = 0; i < rows; i++) {
+            const double *bi = b + i * ldb;
+            double vi = v[i];
+            for (int c = c0; c < c1; c++) w[c] += vi * bi[c];
+        }
+    }
+
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+    for (int i = 0; i < rows; i++) {
+        double *bi = b + i * ldb;
+        double tv = tau * v[i];
+        for (int c = 0; c < cols; c++) bi[c] -= tv * w[c];
+    }
+}
+
+// B = B * (I - tau*v*v^T) для блока rows x cols
+static void house_right(double *b, size_t ldb, int rows, int cols, const double *v, double tau) {
+    if (tau == 0.0 || rows <= 0) return;
+
+    double work = (double)rows * cols;
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+    for (int i = 0; i < rows; i++) {
+        double *bi = b + i * ldb;
+        double sum = 0.0;
+        for (int c = 0; c < cols; c++) sum += bi[c] * v[c];
+        double ts = tau * sum;
+        for (int c = 0; c < cols; c++) bi[c] -= ts * v[c];
+    }
+}
+
+// Y = A^T * X (A: m x n, X: m x c) без транспонирования A: каждый поток ведет свою полосу столбцов A
+static void gemm_tn(int m, int n, int c, const double *A, const double *X, double *Y) {
+    double work = (double)m * n * c;
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+    for (int j0 = 0; j0 < n; j0 += TN_BLOCK) {
+        int j1 = j0 + TN_BLOCK < n ? j0 + TN_BLOCK : n;
+        for (size_t p = (size_t)j0 * c; p < (size_t)j1 * c; p++) Y[p] = 0.0;
+
+        for (int i = 0; i < m; i++) {
+            const double *ai = A + (size_t)i * n;
+            const double *xi = X + (size_t)i * c;
+            for (int j = j0; j < j1; j++) {
+                double aij = ai[j];
+                if (aij == 0.0) continue;
+                double *yj = Y + (size_t)j * c;
+                for (int t = 0; t < c; t++) yj[t] += aij * xi[t];
+            }
+        }
+    }
+}
+
+
+// Приведение симметричной матрицы a (n x n) к трехдиагональной T = Q^T * A * Q:
+// диагональ в d, поддиагональ в e (n - 1 элементов), ортогональная матрица в q
+static void tridiagonalize(double *a, int n, double *d, double *e, double *q) {
+    double *v = (double*)malloc((size_t)n * sizeof(double));
+    double *p = (double*)malloc((size_t)n * sizeof(double));
+    double *tau = (double*)calloc((size_t)n, sizeof(double));
+
+    for (int k = 0; k + 2 < n; k++) {
+        int m = n - k - 1;
+        double *col = a + (size_t)(k + 1) * n + k;
+        tau[k] = house(col, m, n);
+        e[k] = col[0];
+        if (tau[k] == 0.0) continue;
+
+        v[0] = 1.0;
+        for (int i = 1; i < m; i++) v[i] = col[(size_t)i * n];
+
+        // Двустороннее отражение A22 - v*w^T - w*v^T, где w = p - (tau/2)*(p, v)*v, p = tau*A22*v
+        double *a22 = a + (size_t)(k + 1) * n + k + 1;
+        double work = (double)m * m;
+        #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < m; i++) {
+            const double *row = a22 + (size_t)i * n;
+            double sum = 0.0;
+            for (int j = 0; j < m; j++) sum += row[j] * v[j];
+            p[i] = tau[k] * sum;
+        }
+
+        double pv = 0.0;
+        for (int i = 0; i < m; i++) pv += p[i] * v[i];
+        double half = 0.5 * tau[k] * pv;
+        for (int i = 0; i < m; i++) p[i] -= half * v[i];
+
+        #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < m; i++) {
+            double *row = a22 + (size_t)i * n;
+            for (int j = 0; j < m; j++) row[j] -= v[i] * p[j] + p[i] * v[j];
+        }
+    }
+
+    for (int i = 0; i < n; i++) d[i] = a[(size_t)i * n + i];
+    if (n >= 2) e[n - 2] = a[(size_t)(n - 1) * n + n - 2];
+
+    // Q = H_0 * ... * H_{n-3}, отражения применяются в обратном порядке к правому нижнему блоку
+    memset(q, 0, (size_t)n * n * sizeof(double));
+    for (int i = 0; i < n; i++) q[(size_t)i * n + i] = 1.0;
+    for (int k = n - 3; k >= 0; k--) {
+        if (tau[k] == 0.0) continue;
+        int m = n - k - 1;
+        v[0] = 1.0;
+        for (int i = 1; i < m; i++) v[i] = a[(size_t)(k + 1 + i) * n + k];
+        house_left(q + (size_t)(k + 1) * n + k + 1, n, m, m, v, tau[k], p);
+    }
+
+    free(v);
+    free(p);
+    free(tau);
+}
+
+// Неявные QL-итерации со сдвигом для трехдиагональной матрицы (d, e; e[n-1] = 0),
+// вращения накапливаются в столбцах q
+static int tridiag_ql(int n, double *d, double *e, double *q, size_t ldq) {
+    for (int l = 0; l < n; l++) {
+        int iter = 0;
+        int m;
+        do {
+            for (m = l; m < n - 1; m++) {
+                double dd = fabs(d[m]) + fabs(d[m + 1]);
+                if (fabs(e[m]) <= DBL_EPSILON * dd) break;
+            }
+            if (m == l) break;
+            if (iter++ == EIG_MAX_ITER) return 0;
+
+            double g = (d[l + 1] - d[l]) / (2.0 * e[l]);
+            double r = hypot(g, 1.0);
+            g = d[m] - d[l] + e[l] / (g + copysign(r, g));
+            double s = 1.0, c = 1.0, p = 0.0;
+            int i;
+            for (i = m - 1; i >= l; i--) {
+                double f = s * e[i];
+                double b = c * e[i];
+                r = hypot(f, g);
+                e[i + 1] = r;
+                if (r == 0.0) {
+                    d[i + 1] -= p;
+                    e[m] = 0.0;
+                    break;
+                }
+                s = f / r;
+                c = g / r;
+                g = d[i + 1] - p;
+                r = (d[i] - g) * s + 2.0 * c * b;
+                p = s * r;
+                d[i + 1] = g + p;
+                g = c * r - b;
+
+                for (int k = 0; k < n; k++) {
+                    double *qk = q + k * ldq;
+                    double t = qk[i + 1];
+                    qk[i + 1] = s * qk[i] + c * t;
+                    qk[i] = c * qk[i] - s * t;
+                }
+            }
+            if (r == 0.0 && i >= l) continue;
+            d[l] -= p;
+            e[l] = g;
+            e[m] = 0.0;
+        } while (m != l);
+    }
+    return 1;
+}
+
+// Упорядочивание собственных значений по возрастанию вместе со столбцами q
+static void eigen_sort(int n, double *d, double *q, size_t ldq) {
+    for (int i = 0; i < n - 1; i++) {
+        int best = i;
+        for (int j = i + 1; j < n; j++) {
+            if (d[j] < d[best]) best = j;
+        }
+        if (best == i) continue;
+
+        double t = d[i];
+        d[i] = d[best];
+        d[best] = t;
+        for (int r = 0; r < n; r++) {
+            double *qr = q + r * ldq;
+            t = qr[i];
+            qr[i] = qr[best];
+            qr[best] = t;
+        }
+    }
+}
+
+// Значение и производная секулярной функции 1 + rho * sum(z_j^2 / (d_j - lambda))
+// в точке lambda = d[o] + t; разности считаются от полюса d[o] без потери точности
+static double secular_value(int k, const double *d, const double *z, double rho, int o, double t, double *df) {
+    double f = 0.0, g = 0.0;
+    for (int j = 0; j < k; j++) {
+        double delta = (d[j] - d[o]) - t;
+        double w = z[j] / delta;
+        f += z[j] * w;
+        g += w * w;
+    }
+    if (df) *df = rho * g;
+    return 1.0 + rho * f;
+}
+
+// Корни секулярного уравнения при rho > 0 и строго возрастающих d: корень i лежит
+// в (d_i, d_{i+1}) и хранится как сдвиг tau[i] от ближайшего полюса d[org[i]]
+static void secular_solve(int k, const double *d, const double *z, double rho, int *org, double *tau) {
+    double zz = 0.0;
+    for (int j = 0; j < k; j++) zz += z[j] * z[j];
+
+    #pragma omp parallel for if((double)k * k > PARALLEL_MIN_WORK) schedule(dynamic, 16)
+    for (int i = 0; i < k; i++) {
+        int o = i;
+        double lo, hi;
+        if (i < k - 1) {
+            double half = (d[i + 1] - d[i]) / 2;
+            if (secular_value(k, d, z, rho, i, half, NULL) >= 0.0) {
+                lo = 0.0;
+                hi = half;
+            } else {
+                o = i + 1;
+                lo = -half;
+                hi = 0.0;
+            }
+        } else {
+            lo = 0.0;
+            hi = rho * zz;
+        }
+
+        // Ньютон, защищенный бисекцией: функция возрастает на интервале
+        double t = (lo + hi) / 2;
+        for (int it = 0; it < 200; it++) {
+            double df;
+            double f = secular_value(k, d, z, rho, o, t, &df);
+            if (f == 0.0) break;
+            if (f > 0.0) hi = t;
+            else lo = t;
+
+            double tn = t - f / df;
+            if (!(tn > lo && tn < hi)) tn = (lo + hi) / 2;
+            int done = fabs(tn - t) <= 2 * DBL_EPSILON * fabs(tn);
+            t = tn;
+            if (done) break;
+        }
+        org[i] = o;
+        tau[i] = t;
+    }
+}
+
+// Слияние двух решенных половин: собственная задача для diag(D1, D2) + rho*z*z^T
+static int dc_merge(int n, int m, double *d, double rho, double *q, size_t ldq) {
+    double *z = (double*)malloc((size_t)n * sizeof(double));
+    SortKey *keys = (SortKey*)malloc((size_t)n * sizeof(SortKey));
+    double *ds = (double*)malloc((size_t)n * sizeof(double));
+    double *zs = (double*)malloc((size_t)n * sizeof(double));
+    double *qs = (double*)malloc((size_t)n * n * sizeof(double));
+    int *kept = (int*)malloc((size_t)n * sizeof(int));
+
+    // z = Q^T * (e_m + e_{m+1}) имеет норму sqrt(2), приводим к единичной
+    for (int j = 0; j < n; j++) {
+        z[j] = (q[(size_t)(m - 1) * ldq + j] + q[(size_t)m * ldq + j]) / sqrt(2.0);
+    }
+    rho *= 2.0;
+
+    // При rho < 0 решается задача для -D + |rho|*z*z^T, собственные значения меняют знак
+    double sign = rho < 0.0 ? -1.0 : 1.0;
+    rho = fabs(rho);
+
+    for (int j = 0; j < n; j++) {
+        keys[j].value = sign * d[j];
+        keys[j].index = j;
+    }
+    qsort(keys, n, sizeof(SortKey), sort_key_cmp);
+    double dmax = 0.0;
+    for (int c = 0; c < n; c++) {
+        int j = keys[c].index;
+        ds[c] = keys[c].value;
+        zs[c] = z[j];
+        for (int i = 0; i < n; i++) qs[(size_t)i * n + c] = q[(size_t)i * ldq + j];
+        if (fabs(ds[c]) > dmax) dmax = fabs(ds[c]);
+    }
+
+    // Дефляция: малые компоненты z и близкие значения d (вращением Гивенса) отделяются сразу
+    double tol = 8.0 * DBL_EPSILON * (dmax > rho ? dmax : rho);
+    int k = 0, last = -1;
+    for (int c = 0; c < n; c++) {
+        if (rho * fabs(zs[c]) <= tol) continue;
+
+        if (last >= 0) {
+            double r = hypot(zs[last], zs[c]);
+            double cs = zs[c] / r, sn = zs[last] / r;
+            if (fabs((ds[c] - ds[last]) * cs * sn) <= tol) {
+                for (int i = 0; i < n; i++) {
+                    double *row = qs + (size_t)i * n;
+                    double a = row[last], b = row[c];
+                    row[last] = cs * a - sn * b;
+                    row[c] = sn * a + cs * b;
+                }
+                double dl = ds[last], dc = ds[c];
+                ds[last] = cs * cs * dl + sn * sn * dc;
+                ds[c] = sn * sn * dl + cs * cs * dc;
+                zs[last] = 0.0;
+                zs[c] = r;
+                kept[k - 1] = c;
+                last = c;
+                continue;
+            }
+        }
+        kept[k++] = c;
+        last = c;
+    }
+
+    if (k > 0) {
+        double *dk = (double*)malloc((size_t)k * sizeof(double));
+        double *zk = (double*)malloc((size_t)k * sizeof(double));
+        double *tau = (double*)malloc((size_t)k * sizeof(double));
+        int *org = (int*)malloc((size_t)k * sizeof(int));
+        double *U = (double*)malloc((size_t)k * k * sizeof(double));
+        double *Qk = (double*)malloc((size_t)n * k * sizeof(double));
+        double *R = (double*)malloc((size_t)n * k * sizeof(double));
+
+        for (int c = 0; c < k; c++) {
+            dk[c] = ds[kept[c]];
+            zk[c] = zs[kept[c]];
+        }
+        secular_solve(k, dk, zk, rho, org, tau);
+
+        // Пересчет z по найденным корням (Гу-Айзенштат) сохраняет ортогональность векторов
+        for (int j = 0; j < k; j++) {
+            double prod = -((dk[j] - dk[org[k - 1]]) - tau[k - 1]) / rho;
+            for (int i = 0; i < k - 1; i++) {
+                double li = -((dk[j] - dk[org[i]]) - tau[i]);
+                prod *= li / (i < j ? dk[i] - dk[j] : dk[i + 1] - dk[j]);
+            }
+            zk[j] = copysign(sqrt(fabs(prod)), zk[j]);
+        }
+
+        #pragma omp parallel for if((double)k * k > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < k; i++) {
+            double norm = 0.0;
+            for (int j = 0; j < k; j++) {
+                double u = zk[j] / ((dk[j] - dk[org[i]]) - tau[i]);
+                U[(size_t)j * k + i] = u;
+                norm += u * u;
+            }
+            norm = 1.0 / sqrt(norm);
+            for (int j = 0; j < k; j++) U[(size_t)j * k + i] *= norm;
+        }
+
+        for (int i = 0; i < n; i++) {
+            for (int c = 0; c < k; c++) Qk[(size_t)i * k + c] = qs[(size_t)i * n + kept[c]];
+        }
+        gemm(n, k, k, 1.0, Qk, k, U, k, 0.0, R, k);
+        for (int i = 0; i < n; i++) {
+            for (int c = 0; c < k; c++) qs[(size_t)i * n + kept[c]] = R[(size_t)i * k + c];
+        }
+        for (int c = 0; c < k; c++) ds[kept[c]] = dk[org[c]] + tau[c];
+
+        free(dk);
+        free(zk);
+        free(tau);
+        free(org);
+        free(U);
+        free(Qk);
+        free(R);
+    }
+
+    for (int c = 0; c < n; c++) {
+        keys[c].value = sign * ds[c];
+        keys[c].index = c;
+    }
+    qsort(keys, n, sizeof(SortKey), sort_key_cmp);
+    for (int c = 0; c < n; c++) {
+        d[c] = keys[c].value;
+        for (int i = 0; i < n; i++) q[(size_t)i * ldq + c] = qs[(size_t)i * n + keys[c].index];
+    }
+
+    free(z);
+    free(keys);
+    free(ds);
+    free(zs);
+    free(qs);
+    free(kept);
+    return 1;
+}
+
+// "Разделяй и властвуй" для трехдиагональной матрицы (d, e): T = diag(T1, T2) + rho*v*v^T,
+// собственные векторы пишутся в блок q (n x n с шагом ldq), значения по возрастанию в d
+static int tridiag_dc(int n, double *d, const double *e, double *q, size_t ldq) {
+    if (n <= DC_MIN_SIZE) {
+        double *ew = (double*)malloc((size_t)n * sizeof(double));
+        for (int i = 0; i < n - 1; i++) ew[i] = e[i];
+        ew[n - 1] = 0.0;
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) q[i * ldq + j] = i == j ? 1.0 : 0.0;
+        }
+        int ok = tridiag_ql(n, d, ew, q, ldq);
+        free(ew);
+        if (ok) eigen_sort(n, d, q, ldq);
+        return ok;
+    }
+
+    int m = n / 2;
+    double rho = e[m - 1];
+    d[m - 1] -= rho;
+    d[m] -= rho;
+    if (!tridiag_dc(m, d, e, q, ldq)) return 0;
+    if (!tridiag_dc(n - m, d + m, e + m, q + (size_t)m * ldq + m, ldq)) return 0;
+
+    for (int i = 0; i < n; i++) {
+        double *row = q + i * ldq;
+        int j0 = i < m ? m : 0;
+        int j1 = i < m ? n : m;
+        for (int j = j0; j < j1; j++) row[j] = 0.0;
+    }
+    return dc_merge(n, m, d, rho, q, ldq);
+}
+
+// Собственные значения (по возрастанию) и векторы симметричной матрицы; a разрушается
+static int symmetric_eigen(double *a, int n, double *w, double *v) {
+    double *e = (double*)calloc((size_t)n, sizeof(double));
+    double *q = (double*)malloc((size_t)n * n * sizeof(double));
+    double *z = (double*)malloc((size_t)n * n * sizeof(double));
+
+    tridiagonalize(a, n, w, e, q);
+    int ok = tridiag_dc(n, w, e, z, n);
+    if (ok) gemm(n, n, n, 1.0, q, n, z, n, 0.0, v, n);
+
+    free(e);
+    free(q);
+    free(z);
+    return ok;
+}
+
+
+// Перестановка строк i и j матрицы с длиной строки len
+static void swap_rows(double *a, int len, int i, int j) {
+    double *ri = a + (size_t)i * len, *rj = a + (size_t)j * len;
+    for (int c = 0; c < len; c++) {
+        double t = ri[c];
+        ri[c] = rj[c];
+        rj[c] = t;
+    }
+}
+
+// Вращение строк i и j: (ri, rj) <- (ri*c + rj*s, rj*c - ri*s)
+static void rotate_rows(double *a, int len, int i, int j, double c, double s) {
+    double *ri = a + (size_t)i * len, *rj = a + (size_t)j * len;
+    for (int k = 0; k < len; k++) {
+        double x = ri[k], y = rj[k];
+        ri[k] = x * c + y * s;
+        rj[k] = y * c - x * s;
+    }
+}
+
+// QR-итерации Голуба-Кахана для верхней двухдиагональной матрицы (s - диагональ,
+// f[i] - элемент над s[i], f[0] = 0). Вращения накапливаются в транспонированных
+// U^T (n x m) и V^T (n x n), чтобы каждое затрагивало две непрерывные строки
+static int bidiag_qr(int m, int n, double *s, double *f, double *ut, double *vt) {
+    double anorm = 0.0;
+    for (int i = 0; i < n; i++) {
+        double t = fabs(s[i]) + fabs(f[i]);
+        if (t > anorm) anorm = t;
+    }
+    double eps = DBL_EPSILON * anorm;
+
+    for (int k = n - 1; k >= 0; k--) {
+        for (int its = 0; ; its++) {
+            // Поиск точки расщепления: нулевой f[l] или нулевой s[l - 1]
+            int l, split = 1;
+            for (l = k; l >= 0; l--) {
+                if (l == 0 || fabs(f[l]) <= eps) {
+                    split = 0;
+                    break;
+                }
+                if (fabs(s[l - 1]) <= eps) break;
+            }
+
+            // Нулевой s[l - 1]: f[l] обнуляется вращениями слева
+            if (split) {
+                double c = 0.0, sn = 1.0;
+                for (int i = l; i <= k; i++) {
+                    double g = sn * f[i];
+                    f[i] = c * f[i];
+                    if (fabs(g) <= eps) break;
+                    double h = hypot(g, s[i]);
+                    c = s[i] / h;
+                    sn = -g / h;
+                    s[i] = h;
+                    rotate_rows(ut, m, l - 1, i, c, sn);
+                }
+            }
+
+            double z = s[k];
+            if (l == k) {
+                if (z < 0.0) {
+                    s[k] = -z;
+                    for (int j = 0; j < n; j++) vt[(size_t)k * n + j] = -vt[(size_t)k * n + j];
+                }
+                break;
+            }
+            if (its == EIG_MAX_ITER) return 0;
+
+            // Сдвиг по нижнему угловому блоку 2x2
+            double x = s[l];
+            double y = s[k - 1];
+            double g = f[k - 1];
+            double h = f[k];
+            double ff = ((y - z) * (y + z) + (g - h) * (g + h)) / (2.0 * h * y);
+            g = hypot(ff, 1.0);
+            ff = ((x - z) * (x + z) + h * ((y / (ff + copysign(g, ff))) - h)) / x;
+
+            double c = 1.0, sn = 1.0;
+            for (int j = l; j < k; j++) {
+                int i = j + 1;
+                g = f[i];
+                y = s[i];
+                h = sn * g;
+                g = c * g;
+                z = hypot(ff, h);
+                f[j] = z;
+                c = ff / z;
+                sn = h / z;
+                ff = x * c + g * sn;
+                g = g * c - x * sn;
+                h = y * sn;
+                y *= c;
+                rotate_rows(vt, n, j, i, c, sn);
+
+                z = hypot(ff, h);
+                s[j] = z;
+                if (z != 0.0) {
+                    c = ff / z;
+                    sn = h / z;
+                }
+                ff = c * g + sn * y;
+                x = c * y - sn * g;
+                rotate_rows(ut, m, j, i, c, sn);
+            }
+            f[l] = 0.0;
+            f[k] = ff;
+            s[k] = x;
+        }
+    }
+    return 1;
+}
+
+// Сингулярное разложение a = U * diag(s) * V^T для m >= n через бидиагонализацию
+// Хаусхолдера; a разрушается, U: m x n, V: n x n, s по убыванию
+static int svd_tall(double *a, int m, int n, double *s, double *u, double *v) {
+    double *f = (double*)calloc((size_t)n, sizeof(double));
+    double *tl = (double*)calloc((size_t)n, sizeof(double));
+    double *tr = (double*)calloc((size_t)n, sizeof(double));
+    double *vb = (double*)malloc((size_t)m * sizeof(double));
+    double *w = (double*)malloc((size_t)n * sizeof(double));
+
+    // A = U_B * B * V_B^T: отражения чередуются по столбцам (слева) и строкам (справа)
+    for (int k = 0; k < n; k++) {
+        double *col = a + (size_t)k * n + k;
+        tl[k] = house(col, m - k, n);
+        s[k] = col[0];
+        if (tl[k] != 0.0) {
+            vb[0] = 1.0;
+            for (int i = 1; i < m - k; i++) vb[i] = col[(size_t)i * n];
+            house_left(col + 1, n, m - k, n - k - 1, vb, tl[k], w);
+        }
+
+        if (k < n - 1) {
+            double *row = col + 1;
+            tr[k] = house(row, n - k - 1, 1);
+            f[k + 1] = row[0];
+            if (tr[k] != 0.0) {
+                vb[0] = 1.0;
+                for (int j = 1; j < n - k - 1; j++) vb[j] = row[j];
+                house_right(row + n, n, m - k - 1, n - k - 1, vb, tr[k]);
+            }
+        }
+    }
+
+    memset(u, 0, (size_t)m * n * sizeof(double));
+    for (int i = 0; i < n; i++) u[(size_t)i * n + i] = 1.0;
+    for (int k = n - 1; k >= 0; k--) {
+        if (tl[k] == 0.0) continue;
+        vb[0] = 1.0;
+        for (int i = 1; i < m - k; i++) vb[i] = a[(size_t)(k + i) * n + k];
+        house_left(u + (size_t)k * n + k, n, m - k, n - k, vb, tl[k], w);
+    }
+
+    memset(v, 0, (size_t)n * n * sizeof(double));
+    for (int i = 0; i < n; i++) v[(size_t)i * n + i] = 1.0;
+    for (int k = n - 2; k >= 0; k--) {
+        if (tr[k] == 0.0) continue;
+        vb[0] = 1.0;
+        for (int j = 1; j < n - k - 1; j++) vb[j] = a[(size_t)k * n + k + 1 + j];
+        house_left(v + (size_t)(k + 1) * n + k + 1, n, n - k - 1, n - k - 1, vb, tr[k], w);
+    }
+
+    double *ut = (double*)malloc((size_t)n * m * sizeof(double));
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) ut[(size_t)j * m + i] = u[(size_t)i * n + j];
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            double t = v[(size_t)i * n + j];
+            v[(size_t)i * n + j] = v[(size_t)j * n + i];
+            v[(size_t)j * n + i] = t;
+        }
+    }
+
+    int ok = bidiag_qr(m, n, s, f, ut, v);
+
+    // Упорядочивание по убыванию вместе с векторами
+    for (int i = 0; ok && i < n - 1; i++) {
+        int best = i;
+        for (int j = i + 1; j < n; j++) {
+            if (s[j] > s[best]) best = j;
+        }
+        if (best == i) continue;
+
+        double t = s[i];
+        s[i] = s[best];
+        s[best] = t;
+        swap_rows(ut, m, i, best);
+        swap_rows(v, n, i, best);
+    }
+
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) u[(size_t)i * n + j] = ut[(size_t)j * m + i];
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            double t = v[(size_t)i * n + j];
+            v[(size_t)i * n + j] = v[(size_t)j * n + i];
+            v[(size_t)j * n + i] = t;
+        }
+    }
+    free(ut);
+
+    free(f);
+    free(tl);
+    free(tr);
+    free(vb);
+    free(w);
+    return ok;
+}
+
+
+// Собственные значения и векторы симметричной матрицы: eig(A) -> (значения по возрастанию, векторы по столбцам)
+Container* eig_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("eig: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (!args[0]) return NULL;
+
+    Container *temp;
+    MatrixContainer *mc = dense_view(args[0], &temp);
+    if (!mc) {
+        print_log("eig: ожидается матрица\n");
+        return NULL;
+    }
+
+    int n = mc->rows;
+    if (mc->rows != mc->cols) {
+        print_log("eig: матрица %dx%d не квадратная\n", mc->rows, mc->cols);
+        free_container(temp);
+        return NULL;
+    }
+
+    // Проверка симметрии с относительным допуском, затем симметризация рабочей копии
+    double amax = 0.0, asym = 0.0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            double x = mc->data[(size_t)i * n + j];
+            if (fabs(x) > amax) amax = fabs(x);
+            double dx = fabs(x - mc->data[(size_t)j * n + i]);
+            if (dx > asym) asym = dx;
+        }
+    }
+    if (asym > 1e-10 * amax) {
+        print_log("eig: поддерживаются только симметричные матрицы\n");
+        free_container(temp);
+        return NULL;
+    }
+
+    double *a = (double*)malloc((size_t)n * n * sizeof(double));
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            a[(size_t)i * n + j] = 0.5 * (mc->data[(size_t)i * n + j] + mc->data[(size_t)j * n + i]);
+        }
+    }
+    free_container(temp);
+
+    Container *items[2];
+    items[0] = create_matrix_container(n, 1);
+    items[1] = create_matrix_container(n, n);
+    int ok = symmetric_eigen(a, n, ((MatrixContainer*)items[0]->data)->data,
+                             ((MatrixContainer*)items[1]->data)->data);
+    free(a);
+    if (!ok) {
+        print_log("eig: итерации не сошлись\n");
+        free_container(items[0]);
+        free_container(items[1]);
+        return NULL;
+    }
+    return create_list_container(2, items);
+}
+
+// Сингулярное разложение: svd(A) -> (U, s, V), A = U * diag(s) * V^T, s по убыванию
+Container* svd_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("svd: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (!args[0]) return NULL;
+
+    Container *temp;
+    MatrixContainer *mc = dense_view(args[0], &temp);
+    if (!mc) {
+        print_log("svd: ожидается матрица\n");
+        return NULL;
+    }
+
+    // Для широкой матрицы раскладывается A^T, после чего U и V меняются местами
+    int m = mc->rows, n = mc->cols;
+    int wide = m < n;
+    int rows = wide ? n : m, cols = wide ? m : n;
+    double *a = (double*)malloc((size_t)m * n * sizeof(double));
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            double x = mc->data[(size_t)i * n + j];
+            if (wide) a[(size_t)j * m + i] = x;
+            else a[(size_t)i * n + j] = x;
+        }
+    }
+    free_container(temp);
+
+    Container *items[3];
+    items[0] = create_matrix_container(rows, cols);
+    items[1] = create_matrix_container(cols, 1);
+    items[2] = create_matrix_container(cols, cols);
+    int ok = svd_tall(a, rows, cols, ((MatrixContainer*)items[1]->data)->data,
+                      ((MatrixContainer*)items[0]->data)->data, ((MatrixContainer*)items[2]->data)->data);
+    free(a);
+    if (!ok) {
+        print_log("svd: итерации не сошлись\n");
+        for (int i = 0; i < 3; i++) free_container(items[i]);
+        return NULL;
+    }
+
+    if (wide) {
+        Container *t = items[0];
+        items[0] = items[2];
+        items[2] = t;
+    }
+    return create_list_container(3, items);
+}
+
+// Линейный оператор для svds: плотная матрица или пара CSR-матриц A и A^T
+typedef struct {
+    int rows, cols;
+    const double *dense;
+    SparseContainer *csr, *csr_t;
+} LinearMap;
+
+// Y = A * X (X: cols x c)
+static void map_apply(const LinearMap *a, const double *X, int c, double *Y) {
+    if (a->csr) sparse_spmm(a->csr, X, c, Y);
+    else gemm(a->rows, c, a->cols, 1.0, a->dense, a->cols, X, c, 0.0, Y, c);
+}
+
+// Y = A^T * X (X: rows x c)
+static void map_apply_t(const LinearMap *a, const double *X, int c, double *Y) {
+    if (a->csr_t) sparse_spmm(a->csr_t, X, c, Y);
+    else gemm_tn(a->rows, a->cols, c, a->dense, X, Y);
+}
+
+// Замена столбцов Y (m x c) ортонормированным базисом их линейной оболочки
+static void orthonormalize(double *Y, int m, int c) {
+    QRFactor *f = qr_factor(Y, m, c);
+    qr_form_q(f, Y, c);
+    qr_free(f);
+}
+
+// Рандомизированное усеченное SVD: svds(A, k) -> (U, s, V) для k старших сингулярных значений.
+// Образ A приближается по A*Omega со случайной Omega и уточняется степенными итерациями
+Container* svds_func(Container** args, int arg_count) {
+    if (arg_count != 2) {
+        print_log("svds: ожидается 2 аргумента\n");
+        return NULL;
+    }
+    if (!args[0] || !args[1]) return NULL;
+
+    LinearMap a;
+    a.dense = NULL;
+    a.csr = NULL;
+    a.csr_t = NULL;
+    if (args[0]->type == CT_MATRIX) {
+        MatrixContainer *mc = (MatrixContainer*)args[0]->data;
+        a.rows = mc->rows;
+        a.cols = mc->cols;
+        a.dense = mc->data;
+    } else if (args[0]->type == CT_SPARSE) {
+        // Обе ориентации в CSR, чтобы и A*X, и A^T*X шли параллельно по строкам
+        SparseContainer *sp = (SparseContainer*)args[0]->data;
+        SparseContainer tview = *sp;
+        tview.format = sp->format == SP_CSR ? SP_CSC : SP_CSR;
+        tview.rows = sp->cols;
+        tview.cols = sp->rows;
+        tview.cache = NULL;
+        a.rows = sp->rows;
+        a.cols = sp->cols;
+        a.csr = sparse_convert(sp, SP_CSR);
+        a.csr_t = sparse_convert(&tview, SP_CSR);
+    } else {
+        print_log("svds: первый аргумент должен быть матрицей\n");
+        return NULL;
+    }
+
+    int m = a.rows, n = a.cols;
+    int kmax = m < n ? m : n;
+    int k = container_is_scalar(args[1]) ? (int)container_to_double(args[1]) : 0;
+    if (k < 1 || k > kmax) {
+        print_log("svds: k должно быть от 1 до %d\n", kmax);
+        sparse_free(a.csr);
+        sparse_free(a.csr_t);
+        return NULL;
+    }
+
+    int l = k + SVDS_OVERSAMPLE < kmax ? k + SVDS_OVERSAMPLE : kmax;
+    double *omega = (double*)malloc((size_t)n * l * sizeof(double));
+    double *Y = (double*)malloc((size_t)m * l * sizeof(double));
+    double *Z = (double*)malloc((size_t)n * l * sizeof(double));
+    for (size_t p = 0; p < (size_t)n * l; p++) omega[p] = 2.0 * rand_uniform() - 1.0;
+
+    map_apply(&a, omega, l, Y);
+    orthonormalize(Y, m, l);
+    for (int it = 0; it < SVDS_POWER_ITERS; it++) {
+        map_apply_t(&a, Y, l, Z);
+        orthonormalize(Z, n, l);
+        map_apply(&a, Z, l, Y);
+        orthonormalize(Y, m, l);
+    }
+
+    // B^T = A^T * Y (n x l) = Ub * S * Vb^T, тогда A ~ (Y * Vb) * S * Ub^T
+    map_apply_t(&a, Y, l, Z);
+    double *s = (double*)malloc((size_t)l * sizeof(double));
+    double *ub = (double*)malloc((size_t)n * l * sizeof(double));
+    double *vb = (double*)malloc((size_t)l * l * sizeof(double));
+    int ok = svd_tall(Z, n, l, s, ub, vb);
+
+    Container *result = NULL;
+    if (ok) {
+        double *uy = (double*)malloc((size_t)m * l * sizeof(double));
+        gemm(m, l, l, 1.0, Y, l, vb, l, 0.0, uy, l);
+
+        Container *items[3];
+        items[0] = create_matrix_container(m, k);
+        items[1] = create_matrix_container(k, 1);
+        items[2] = create_matrix_container(n, k);
+        double *U = ((MatrixContainer*)items[0]->data)->data;
+        double *S = ((MatrixContainer*)items[1]->data)->data;
+        double *V = ((MatrixContainer*)items[2]->data)->data;
+        for (int i = 0; i < m; i++) memcpy(U + (size_t)i * k, uy + (size_t)i * l, (size_t)k * sizeof(double));
+        for (int i = 0; i < n; i++) memcpy(V + (size_t)i * k, ub + (size_t)i * l, (size_t)k * sizeof(double));
+        memcpy(S, s, (size_t)k * sizeof(double));
+        free(uy);
+        result = create_list_container(3, items);
+    } else {
+        print_log("svds: итерации не сошлись\n");
+    }
+
+    free(omega);
+    free(Y);
+    free(Z);
+    free(s);
+    free(ub);
+    free(vb);
+    sparse_free(a.csr);
+    sparse_free(a.csr_t);
+    return result;
+}
@@ -0,0 +1,991 @@
+#include "lib.h"
+
+// Быстрое преобразование Фурье и свертка.
+//
+// Длина n раскладывается на множители 4, 2, 3, 5 и остальные простые; каждый
+// множитель - проход Stockham со своей бабочкой (результат сразу в естественном
+// порядке, без перестановки битов). Длины с простым множителем больше FFT_MAX_RADIX
+// считаются алгоритмом Блюстейна через БПФ длины 2^k. Разложение, поворачивающие
+// множители и ядро Блюстейна (план) строятся один раз на длину и хранятся в кэше
+// последних FFT_PLAN_CACHE длин.
+//
+// Вектор преобразуется целиком, у матрицы fft/ifft/rfft преобразуют каждый столбец,
+// fft2/ifft2 - строки и столбцы. Для столбцов матрица транспонируется блоками, чтобы
+// каждое преобразование шло по непрерывной памяти.
+
+#define FFT_MAX_RADIX  31
+#define FFT_MAX_STAGES 32
+#define FFT_PLAN_CACHE 16
+#define TRANSPOSE_BLOCK 32
+
+// Оценки стоимости для conv в единицах одного умножения-сложения прямой свертки
+// (подобраны замером обоих путей): БПФ длины n стоит FFT_COST * n * log2(n),
+// каждый вызов axpy по строке ядра - еще CONV_ROW_COST
+#define FFT_COST      22.0
+#define CONV_ROW_COST 75.0
+
+typedef struct FftPlan FftPlan;
+
+struct FftPlan {
+    int n;
+    int stages;
+    int radix[FFT_MAX_STAGES];
+    int tw_offset[FFT_MAX_STAGES];      // Начало множителей прохода в twiddle
+    int root_offset[FFT_MAX_STAGES];    // Корни степени radix для общей бабочки (-1 - своя бабочка)
+    Complex *twiddle;
+    Complex *roots;
+    int work;                           // Размер рабочего буфера в комплексных числах
+
+    // Алгоритм Блюстейна: x[k] * chirp[k], свертка с сопряженным chirp через БПФ длины m
+    int m;
+    Complex *chirp;
+    Complex *kernel;                    // БПФ ядра свертки длины m
+    FftPlan *sub;
+};
+
+static FftPlan *plan_cache[FFT_PLAN_CACHE];
+static unsigned long plan_used[FFT_PLAN_CACHE];
+static unsigned long plan_clock = 0;
+
+static inline Complex c_mul(Complex a, Complex b) {
+    Complex r = {a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re};
+    return r;
+}
+
+static inline Complex c_expi(double angle) {
+    Complex r = {cos(angle), sin(angle)};
+    return r;
+}
+
+
+// План
+
+static void plan_free(FftPlan *p) {
+    if (!p) return;
+    free(p->twiddle);
+    free(p->roots);
+    free(p->chirp);
+    free(p->kernel);
+    plan_free(p->sub);
+    free(p);
+}
+
+static void fft_exec(const FftPlan *p, Complex *x, Complex *work, int inverse);
+
+static FftPlan* plan_create(int n) {
+    FftPlan *p = (FftPlan*)calloc(1, sizeof(FftPlan));
+    p->n = n;
+
+    // Множители: сначала 4 и 2, затем 3, 5 и остальные простые
+    int rest = n;
+    int big = 0;
+    while (rest % 4 == 0) { p->radix[p->stages++] = 4; rest /= 4; }
+    while (rest % 2 == 0) { p->radix[p->stages++] = 2; rest /= 2; }
+    for (int f = 3; f * f <= rest; f += 2) {
+        while (rest % f == 0) { p->radix[p->stages++] = f; rest /= f; }
+    }
+    if (rest > 1) p->radix[p->stages++] = rest;
+    for (int s = 0; s < p->stages; s++) {
+        if (p->radix[s] > FFT_MAX_RADIX) big = 1;
+    }
+
+    if (big) {
+        // Блюстейн: chirp[k] = exp(-i*pi*k^2/n), k^2 берется по модулю 2n для точности
+        p->stages = 0;
+        p->m = 1;
+        while (p->m < 2 * n - 1) p->m *= 2;
+        p->sub = plan_create(p->m);
+        p->work = 2 * p->m + p->sub->work;
+        p->chirp = (Complex*)malloc((size_t)n * sizeof(Complex));
+        p->kernel = (Complex*)calloc((size_t)p->m, sizeof(Complex));
+        for (int k = 0; k < n; k++) {
+            long long k2 = (long long)k * k % (2LL * n);
+            p->chirp[k] = c_expi(-M_PI * (double)k2 / n);
+            Complex conj = {p->chirp[k].re, -p->chirp[k].im};
+            p->kernel[k] = conj;
+            if (k > 0) p->kernel[p->m - k] = conj;
+        }
+        Complex *tmp = (Complex*)malloc((size_t)p->sub->work * sizeof(Complex));
+        fft_exec(p->sub, p->kernel, tmp, 0);
+        free(tmp);
+        return p;
+    }
+
+    int tw_count = 0, root_count = 0, ns = 1;
+    for (int s = 0; s < p->stages; s++) {
+        int r = p->radix[s];
+        p->tw_offset[s] = tw_count;
+        tw_count += ns * (r - 1);
+        p->root_offset[s] = -1;
+        if (r > 5) {
+            p->root_offset[s] = root_count;
+            root_count += r;
+        }
+        ns *= r;
+    }
+    p->twiddle = (Complex*)malloc((size_t)(tw_count > 0 ? tw_count : 1) * sizeof(Complex));
+    p->roots = (Complex*)malloc((size_t)(root_count > 0 ? root_count : 1) * sizeof(Complex));
+    p->work = n;
+
+    // Множители прохода s: exp(-2*pi*i * k*r / (ns*radix)) для k < ns, 1 <= r < radix
+    ns = 1;
+    for (int s = 0; s < p->stages; s++) {
+        int r = p->radix[s];
+        long long len = (long long)ns * r;
+        Complex *tw = p->twiddle + p->tw_offset[s];
+        for (int k = 0; k < ns; k++) {
+            for (int q = 1; q < r; q++) {
+                tw[k * (r - 1) + q - 1] = c_expi(-2.0 * M_PI * (double)((long long)k * q % len) / len);
+            }
+        }
+        if (p->root_offset[s] >= 0) {
+            for (int q = 0; q < r; q++) p->roots[p->root_offset[s] + q] = c_expi(-2.0 * M_PI * q / r);
+        }
+        ns *= r;
+    }
+    return p;
+}
+
+// План из кэша; при промахе вытесняется дольше всех не использовавшийся.
+// Вызывается только вне параллельных областей
+static FftPlan* fft_plan(int n) {
+    int slot = 0;
+    plan_clock++;
+    for (int i = 0; i < FFT_PLAN_CACHE; i++) {
+        if (plan_cache[i] && plan_cache[i]->n == n) {
+            plan_used[i] = plan_clock;
+            return plan_cache[i];
+        }
+        if (!plan_cache[i] || plan_used[i] < plan_used[slot]) slot = i;
+        if (!plan_cache[i]) break;
+    }
+    plan_free(plan_cache[slot]);
+    plan_cache[slot] = plan_create(n);
+    plan_used[slot] = plan_clock;
+    return plan_cache[slot];
+}
+
+
+// Бабочки (прямое преобразование)
+
+static inline void butterfly2(Complex *v) {
+    Complex a = v[0], b = v[1];
+    v[0].re = a.re + b.re; v[0].im = a.im + b.im;
+    v[1].re = a.re - b.re; v[1].im = a.im - b.im;
+}
+
+static inline void butterfly3(Complex *v) {
+    const double c = -0.5, s = -0.86602540378443864676;
+    Complex t = {v[1].re + v[2].re, v[1].im + v[2].im};
+    Complex m = {v[0].re + c * t.re, v[0].im + c * t.im};
+    Complex d = {-s * (v[1].im - v[2].im), s * (v[1].re - v[2].re)};   // i*s*(v1 - v2)
+    v[0].re += t.re; v[0].im += t.im;
+    v[1].re = m.re + d.re; v[1].im = m.im + d.im;
+    v[2].re = m.re - d.re; v[2].im = m.im - d.im;
+}
+
+static inline void butterfly4(Complex *v) {
+    Complex t0 = {v[0].re + v[2].re, v[0].im + v[2].im};
+    Complex t1 = {v[0].re - v[2].re, v[0].im - v[2].im};
+    Complex t2 = {v[1].re + v[3].re, v[1].im + v[3].im};
+    Complex t3 = {v[1].im - v[3].im, v[3].re - v[1].re};                // -i*(v1 - v3)
+    v[0].re = t0.re + t2.re; v[0].im = t0.im + t2.im;
+    v[1].re = t1.re + t3.re; v[1].im = t1.im + t3.im;
+    v[2].re = t0.re - t2.re; v[2].im = t0.im - t2.im;
+    v[3].re = t1.re - t3.re; v[3].im = t1.im - t3.im;
+}
+
+static inline void butterfly5(Complex *v) {
+    const double c1 = 0.30901699437494742410, c2 = -0.80901699437494742410;
+    const double s1 = -0.95105651629515357212, s2 = -0.58778525229247312917;
+    Complex t1 = {v[1].re + v[4].re, v[1].im + v[4].im};
+    Complex t2 = {v[2].re + v[3].re, v[2].im + v[3].im};
+    Complex d1 = {v[1].re - v[4].re, v[1].im - v[4].im};
+    Complex d2 = {v[2].re - v[3].re, v[2].im - v[3].im};
+    Complex a1 = {v[0].re + c1 * t1.re + c2 * t2.re, v[0].im + c1 * t1.im + c2 * t2.im};
+    Complex a2 = {v[0].re + c2 * t1.re + c1 * t2.re, v[0].im + c2 * t1.im + c1 * t2.im};
+    Complex b1 = {-(s1 * d1.im + s2 * d2.im), s1 * d1.re + s2 * d2.re};   // i*(s1*d1 + s2*d2)
+    Complex b2 = {-(s2 * d1.im - s1 * d2.im), s2 * d1.re - s1 * d2.re};   // i*(s2*d1 - s1*d2)
+    v[0].re += t1.re + t2.re; v[0].im += t1.im + t2.im;
+    v[1].re = a1.re + b1.re; v[1].im = a1.im + b1.im;
+    v[4].re = a1.re - b1.re; v[4].im = a1.im - b1.im;
+    v[2].re = a2.re + b2.re; v[2].im = a2.im + b2.im;
+    v[3].re = a2.re - b2.re; v[3].im = a2.im - b2.im;
+}
+
+// Простой множитель до FFT_MAX_RADIX: прямое ДПФ по таблице корней
+static inline void butterfly_generic(Complex *v, int r, const Complex *roots) {
+    Complex out[FFT_MAX_RADIX];
+    for (int q = 0; q < r; q++) {
+        Complex sum = v[0];
+        int idx = 0;
+        for (int t = 1; t < r; t++) {
+            idx += q;
+            if (idx >= r) idx -= r;
+            Complex w = c_mul(v[t], roots[idx]);
+            sum.re += w.re;
+            sum.im += w.im;
+        }
+        out[q] = sum;
+    }
+    for (int q = 0; q < r; q++) v[q] = out[q];
+}
+
+
+// Преобразование
+
+// Проходы Stockham: на проходе с множителем r уже готовы преобразования длины ns;
+// элемент j = g*ns + k берет r входов с шагом n/r и пишет r выходов с шагом ns
+static void stockham(const FftPlan *p, Complex *x, Complex *work) {
+    int n = p->n;
+    Complex *src = x, *dst = work;
+    int ns = 1;
+
+    for (int s = 0; s < p->stages; s++) {
+        int r = p->radix[s];
+        int q = n / r;
+        const Complex *tw = p->twiddle + p->tw_offset[s];
+        const Complex *roots = p->root_offset[s] >= 0 ? p->roots + p->root_offset[s] : NULL;
+        Complex v[FFT_MAX_RADIX];
+
+        for (int g = 0; g < q / ns; g++) {
+            for (int k = 0; k < ns; k++) {
+                int j = g * ns + k;
+                for (int t = 0; t < r; t++) v[t] = src[j + t * q];
+                if (ns > 1) {
+                    const Complex *w = tw + k * (r - 1);
+                    for (int t = 1; t < r; t++) v[t] = c_mul(v[t], w[t - 1]);
+                }
+                switch (r) {
+                    case 2: butterfly2(v); break;
+                    case 3: butterfly3(v); break;
+                    case 4: butterfly4(v); break;
+                    case 5: butterfly5(v); break;
+                    default: butterfly_generic(v, r, roots); break;
+                }
+                Complex *out = dst + g * ns * r + k;
+                for (int t = 0; t < r; t++) out[t * ns] = v[t];
+            }
+        }
+
+        Complex *tmp = src;
+        src = dst;
+        dst = tmp;
+        ns *= r;
+    }
+    if (src != x) memcpy(x, src, (size_t)n * sizeof(Complex));
+}
+
+// Блюстейн: X[k] = chirp[k] * sum_j (x[j]*chirp[j]) * conj(chirp[k-j])
+static void bluestein(const FftPlan *p, Complex *x, Complex *work) {
+    int n = p->n, m = p->m;
+    Complex *a = work;
+    Complex *sub_work = work + m;
+
+    for (int k = 0; k < n; k++) a[k] = c_mul(x[k], p->chirp[k]);
+    for (int k = n; k < m; k++) a[k].re = a[k].im = 0.0;
+    fft_exec(p->sub, a, sub_work, 0);
+    for (int k = 0; k < m; k++) a[k] = c_mul(a[k], p->kernel[k]);
+    fft_exec(p->sub, a, sub_work, 1);
+    for (int k = 0; k < n; k++) x[k] = c_mul(a[k], p->chirp[k]);
+}
+
+// Преобразование на месте; обратное - через сопряжение и деление на n
+static void fft_exec(const FftPlan *p, Complex *x, Complex *work, int inverse) {
+    int n = p->n;
+    if (inverse) {
+        for (int k = 0; k < n; k++) x[k].im = -x[k].im;
+    }
+
+    if (p->m) bluestein(p, x, work);
+    else stockham(p, x, work);
+
+    if (inverse) {
+        double scale = 1.0 / n;
+        for (int k = 0; k < n; k++) {
+            x[k].re *= scale;
+            x[k].im = -x[k].im * scale;
+        }
+    }
+}
+
+// Преобразование каждой из rows строк длины n (строки подряд)
+static void fft_rows(Complex *data, int rows, int n, int inverse) {
+    if (n <= 1 || rows == 0) return;
+    FftPlan *p = fft_plan(n);
+    double work = (double)rows * n * log2((double)n);
+
+    #pragma omp parallel if(rows > 1 && work > PARALLEL_MIN_WORK)
+    {
+        Complex *buf = (Complex*)malloc((size_t)p->work * sizeof(Complex));
+        #pragma omp for schedule(static)
+        for (int r = 0; r < rows; r++) {
+            fft_exec(p, data + (size_t)r * n, buf, inverse);
+        }
+        free(buf);
+    }
+}
+
+// Транспонирование блоками rows x cols -> cols x rows
+static void transpose_complex(const Complex *src, Complex *dst, int rows, int cols) {
+    #pragma omp parallel for if((double)rows * cols > PARALLEL_MIN_WORK) schedule(static)
+    for (int i0 = 0; i0 < rows; i0 += TRANSPOSE_BLOCK) {
+        int i1 = i0 + TRANSPOSE_BLOCK < rows ? i0 + TRANSPOSE_BLOCK : rows;
+        for (int j0 = 0; j0 < cols; j0 += TRANSPOSE_BLOCK) {
+            int j1 = j0 + TRANSPOSE_BLOCK < cols ? j0 + TRANSPOSE_BLOCK : cols;
+            for (int i = i0; i < i1; i++) {
+                for (int j = j0; j < j1; j++) {
+                    dst[(size_t)j * rows + i] = src[(size_t)i * cols + j];
+                }
+            }
+        }
+    }
+}
+
+// Преобразование каждого столбца; 0 - не хватило памяти
+static int fft_columns(Complex *data, int rows, int cols, int inverse) {
+    if (rows <= 1) return 1;
+    if (cols == 1) {
+        fft_rows(data, 1, rows, inverse);
+        return 1;
+    }
+
+    Complex *t = (Complex*)malloc((size_t)rows * cols * sizeof(Complex));
+    if (!t) return 0;
+    transpose_complex(data, t, rows, cols);
+    fft_rows(t, cols, rows, inverse);
+    transpose_complex(t, data, cols, rows);
+    free(t);
+    return 1;
+}
+
+// Наименьшая длина >= n вида 2^a * 3^b * 5^c
+static int fft_fast_size(int n) {
+    for (int m = n > 1 ? n : 1; ; m++) {
+        int r = m;
+        while (r % 2 == 0) r /= 2;
+        while (r % 3 == 0) r /= 3;
+        while (r % 5 == 0) r /= 5;
+        if (r == 1) return m;
+    }
+}
+
+
+// Комплексный контейнер
+
+Container* create_complex_container(int rows, int cols) {
+    size_t count = (size_t)rows * cols;
+    Complex *values = (Complex*)mem_calloc(MEM_CONTAINERS, count > 0 ? count : 1, sizeof(Complex));
+    if (!values) {
+        print_log("Ошибка: недостаточно памяти для комплексной матрицы %dx%d\n", rows, cols);
+        return NULL;
+    }
+
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
+    ComplexContainer *data = (ComplexContainer*)malloc(sizeof(ComplexContainer));
+    data->rows = rows;
+    data->cols = cols;
+    data->data = values;
+    container->type = CT_COMPLEX;
+    container->data = data;
+    container->free_func = free_complex_container;
+    container->print_func = print_complex_container;
+
+    return container;
+}
+
+void free_complex_container(void *data) {
+    ComplexContainer *z = (ComplexContainer*)data;
+    if (z) {
+        mem_free(MEM_CONTAINERS, z->data);
+        free(z);
+    }
+}
+
+// Вывод a+bi; части меньше eps (шум округления БПФ) выводятся нулем
+static void print_complex(Complex z, double eps) {
+    double re = fabs(z.re) < eps ? 0.0 : z.re;
+    double im = fabs(z.im) < eps ? 0.0 : z.im;
+
+    if (im == 0.0) {
+        print_smart_double(re);
+        return;
+    }
+    if (re != 0.0) {
+        print_smart_double(re);
+        if (im > 0) print_log("+");
+    }
+    if (im == -1.0) print_log("-");
+    else if (im != 1.0) print_smart_double(im);
+    print_log("i");
+}
+
+static void print_complex_row(const Complex *row, int cols, double eps) {
+    print_log("[");
+    for (int j = 0; j < cols; j++) {
+        if (cols > 10 && j == 4) {
+            print_log("..., ");
+            j = cols - 4;
+        }
+        print_complex(row[j], eps);
+        if (j + 1 < cols) print_log(", ");
+    }
+    print_log("]");
+}
+
+// Вывод как у плотной матрицы: 1 x 1 - число, столбец - список
+void print_complex_container(void *data) {
+    if (!data) return;
+    ComplexContainer *z = (ComplexContainer*)data;
+    size_t count = (size_t)z->rows * z->cols;
+
+    double scale = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double a = fabs(z->data[i].re) > fabs(z->data[i].im) ? fabs(z->data[i].re) : fabs(z->data[i].im);
+        if (a > scale) scale = a;
+    }
+    double eps = scale * 1e-13;
+
+    if (count == 1) {
+        print_complex(z->data[0], eps);
+        return;
+    }
+    if (z->cols == 1) {
+        print_complex_row(z->data, z->rows, eps);
+        return;
+    }
+
+    print_log("[");
+    for (int i = 0; i < z->rows; i++) {
+        if (z->rows > 10 && i == 4) {
+            print_log("..., ");
+            i = z->rows - 4;
+        }
+        print_complex_row(z->data + (size_t)i * z->cols, z->cols, eps);
+        if (i + 1 < z->rows) print_log(", ");
+    }
+    print_log("]");
+
+    if (z->rows > 10 || z->cols > 10) {
+        print_log(" (%dx%d)", z->rows, z->cols);
+    }
+}
+
+Container* complex_copy(ComplexContainer *z) {
+    Container *copy = create_complex_container(z->rows, z->cols);
+    if (copy) memcpy(((ComplexContainer*)copy->data)->data, z->data, (size_t)z->rows * z->cols * sizeof(Complex));
+    return copy;
+}
+
+int complex_compare(ComplexContainer *a, ComplexContainer *b) {
+    if (a->rows != b->rows || a->cols != b->cols) return 0;
+
+    size_t count = (size_t)a->rows * a->cols;
+    for (size_t i = 0; i < count; i++) {
+        if (fabs(a->data[i].re - b->data[i].re) >= 1e-10 || fabs(a->data[i].im - b->data[i].im) >= 1e-10) return 0;
+    }
+    return 1;
+}
+
+// Новая комплексная копия числа, вектора, матрицы или комплексного значения
+static Container* to_complex(Container *c) {
+    if (!c) return NULL;
+    if (c->type == CT_COMPLEX) return complex_copy((ComplexContainer*)c->data);
+
+    Container *dense = container_to_matrix(c);
+    if (!dense) return NULL;
+    MatrixContainer *m = (MatrixContainer*)dense->data;
+    Container *result = create_complex_container(m->rows, m->cols);
+    if (result) {
+        Complex *z = ((ComplexContainer*)result->data)->data;
+        size_t count = (size_t)m->rows * m->cols;
+        for (size_t i = 0; i < count; i++) {
+            z[i].re = m->data[i];
+            z[i].im = 0.0;
+        }
+    }
+    free_container(dense);
+    return result;
+}
+
+static int is_scalar_type(Container *c) {
+    return c->type == CT_INT || c->type == CT_FLOAT;
+}
+
+// Сумма и разность с числом, вещественной или комплексной матрицей того же размера
+Container* complex_add(Container *a, Container *b, double sign) {
+    Container *za = to_complex(a);
+    Container *zb = to_complex(b);
+    Container *result = NULL;
+
+    if (za && zb) {
+        ComplexContainer *ca = (ComplexContainer*)za->data;
+        ComplexContainer *cb = (ComplexContainer*)zb->data;
+        int a_scalar = ca->rows * ca->cols == 1 && is_scalar_type(a);
+        int b_scalar = cb->rows * cb->cols == 1 && is_scalar_type(b);
+
+        if (!a_scalar && !b_scalar && (ca->rows != cb->rows || ca->cols != cb->cols)) {
+            print_log("Ошибка: несогласованные размеры %dx%d и %dx%d\n", ca->rows, ca->cols, cb->rows, cb->cols);
+        } else {
+            ComplexContainer *shape = a_scalar ? cb : ca;
+            result = create_complex_container(shape->rows, shape->cols);
+            if (result) {
+                Complex *out = ((ComplexContainer*)result->data)->data;
+                size_t count = (size_t)shape->rows * shape->cols;
+                for (size_t i = 0; i < count; i++) {
+                    Complex x = ca->data[a_scalar ? 0 : i];
+                    Complex y = cb->data[b_scalar ? 0 : i];
+                    out[i].re = x.re + sign * y.re;
+                    out[i].im = x.im + sign * y.im;
+                }
+            }
+        }
+    }
+    free_container(za);
+    free_container(zb);
+    return result;
+}
+
+// Умножение и деление на вещественное число
+Container* complex_scale(Container *a, double scalar) {
+    Container *result = complex_copy((ComplexContainer*)a->data);
+    if (!result) return NULL;
+    ComplexContainer *z = (ComplexContainer*)result->data;
+    size_t count = (size_t)z->rows * z->cols;
+    for (size_t i = 0; i < count; i++) {
+        z->data[i].re *= scalar;
+        z->data[i].im *= scalar;
+    }
+    return result;
+}
+
+Container* complex_divide(Container *a, double divisor) {
+    if (reciprocal_exact(divisor)) return complex_scale(a, 1.0 / divisor);
+    Container *result = complex_copy((ComplexContainer*)a->data);
+    if (!result) return NULL;
+    ComplexContainer *z = (ComplexContainer*)result->data;
+    size_t count = (size_t)z->rows * z->cols;
+    for (size_t i = 0; i < count; i++) {
+        z->data[i].re /= divisor;
+        z->data[i].im /= divisor;
+    }
+    return result;
+}
+
+Container* complex_mul(Container *a, Container *b) {
+    if (a->type == CT_COMPLEX && is_scalar_type(b)) return complex_scale(a, container_to_double(b));
+    if (b->type == CT_COMPLEX && is_scalar_type(a)) return complex_scale(b, container_to_double(a));
+    print_log("Ошибка: комплексный массив умножается только на число\n");
+    return NULL;
+}
+
+// Модули элементов
+Container* complex_abs(Container *a) {
+    ComplexContainer *z = (ComplexContainer*)a->data;
+    Container *result = create_matrix_container(z->rows, z->cols);
+    if (!result) return NULL;
+    double *out = ((MatrixContainer*)result->data)->data;
+    size_t count = (size_t)z->rows * z->cols;
+    for (size_t i = 0; i < count; i++) out[i] = hypot(z->data[i].re, z->data[i].im);
+    return result;
+}
+
+
+// Функции калькулятора
+
+static Container* complex_arg(Container** args, int arg_count, const char *name) {
+    if (arg_count != 1) {
+        print_log("%s: ожидается 1 аргумент\n", name);
+        return NULL;
+    }
+    Container *z = args[0] && args[0]->type != CT_STRING ? to_complex(args[0]) : NULL;
+    if (!z) print_log("%s: аргумент должен быть вектором или матрицей\n", name);
+    return z;
+}
+
+// Вещественная часть, мнимая часть или аргумент элементов (part: 0, 1, 2)
+static Container* complex_part(Container** args, int arg_count, const char *name, int part) {
+    Container *z = complex_arg(args, arg_count, name);
+    if (!z) return NULL;
+    ComplexContainer *cz = (ComplexContainer*)z->data;
+
+    Container *result = create_matrix_container(cz->rows, cz->cols);
+    if (result) {
+        double *out = ((MatrixContainer*)result->data)->data;
+        size_t count = (size_t)cz->rows * cz->cols;
+        for (size_t i = 0; i < count; i++) {
+            Complex c = cz->data[i];
+            out[i] = part == 0 ? c.re : part == 1 ? c.im : atan2(c.im, c.re);
+        }
+    }
+    free_container(z);
+    return result;
+}
+
+Container* real_func(Container** args, int arg_count)  { return complex_part(args, arg_count, "real", 0); }
+Container* imag_func(Container** args, int arg_count)  { return complex_part(args, arg_count, "imag", 1); }
+Container* angle_func(Container** args, int arg_count) { return complex_part(args, arg_count, "angle", 2); }
+
+Container* conj_func(Container** args, int arg_count) {
+    Container *z = complex_arg(args, arg_count, "conj");
+    if (!z) return NULL;
+    ComplexContainer *cz = (ComplexContainer*)z->data;
+    size_t count = (size_t)cz->rows * cz->cols;
+    for (size_t i = 0; i < count; i++) cz->data[i].im = -cz->data[i].im;
+    return z;
+}
+
+// complex(re, im): комплексный массив из вещественной и мнимой частей одного размера
+Container* complex_func(Container** args, int arg_count) {
+    if (arg_count != 1 && arg_count != 2) {
+        print_log("complex: ожидается 1 или 2 аргумента\n");
+        return NULL;
+    }
+    if (arg_count == 1) return complex_arg(args, arg_count, "complex");
+
+    Container *re = args[0] ? container_to_matrix(args[0]) : NULL;
+    Container *im = args[1] ? container_to_matrix(args[1]) : NULL;
+    Container *result = NULL;
+    if (!re || !im) {
+        print_log("complex: аргументы должны быть числами, векторами или матрицами\n");
+    } else {
+        MatrixContainer *mr = (MatrixContainer*)re->data;
+        MatrixContainer *mi = (MatrixContainer*)im->data;
+        if (mr->rows != mi->rows || mr->cols != mi->cols) {
+            print_log("complex: размеры частей %dx%d и %dx%d не совпадают\n", mr->rows, mr->cols, mi->rows, mi->cols);
+        } else {
+            result = create_complex_container(mr->rows, mr->cols);
+            if (result) {
+                Complex *z = ((ComplexContainer*)result->data)->data;
+                size_t count = (size_t)mr->rows * mr->cols;
+                for (size_t i = 0; i < count; i++) {
+                    z[i].re = mr->data[i];
+                    z[i].im = mi->data[i];
+                }
+            }
+        }
+    }
+    free_container(re);
+    free_container(im);
+    return result;
+}
+
+// Преобразование вектора целиком или каждого столбца матрицы
+static Container* fft_apply(Container** args, int arg_count, const char *name, int inverse, int two_dim) {
+    Container *z = complex_arg(args, arg_count, name);
+    if (!z) return NULL;
+    ComplexContainer *cz = (ComplexContainer*)z->data;
+
+    int ok = 1;
+    if (two_dim) {
+        fft_rows(cz->data, cz->rows, cz->cols, inverse);
+        ok = fft_columns(cz->data, cz->rows, cz->cols, inverse);
+    } else if (cz->rows == 1) {
+        fft_rows(cz->data, 1, cz->cols, inverse);
+    } else {
+        ok = fft_columns(cz->data, cz->rows, cz->cols, inverse);
+    }
+    if (!ok) {
+        print_log("%s: недостаточно памяти\n", name);
+        free_container(z);
+        return NULL;
+    }
+    return z;
+}
+
+Container* fft_func(Container** args, int arg_count)   { return fft_apply(args, arg_count, "fft", 0, 0); }
+Container* ifft_func(Container** args, int arg_count)  { return fft_apply(args, arg_count, "ifft", 1, 0); }
+Container* fft2_func(Container** args, int arg_count)  { return fft_apply(args, arg_count, "fft2", 0, 1); }
+Container* ifft2_func(Container** args, int arg_count) { return fft_apply(args, arg_count, "ifft2", 1, 1); }
+
+// БПФ вещественной последовательности длины n = 2h через комплексное БПФ длины h:
+// z[k] = x[2k] + i*x[2k+1], X[k] = (Z[k] + conj Z[h-k])/2 - i/2 * w^k * (Z[k] - conj Z[h-k]).
+// out получает n/2 + 1 значений
+static void rfft_line(const double *x, int n, Complex *out, Complex *z, Complex *work, const FftPlan *half) {
+    if (n % 2) {
+        for (int k = 0; k < n; k++) {
+            z[k].re = x[k];
+            z[k].im = 0.0;
+        }
+        fft_exec(half, z, work, 0);
+        memcpy(out, z, (size_t)(n / 2 + 1) * sizeof(Complex));
+        return;
+    }
+
+    int h = n / 2;
+    for (int k = 0; k < h; k++) {
+        z[k].re = x[2 * k];
+        z[k].im = x[2 * k + 1];
+    }
+    fft_exec(half, z, work, 0);
+
+    for (int k = 0; k <= h; k++) {
+        Complex a = z[k % h];
+        Complex b = {z[(h - k) % h].re, -z[(h - k) % h].im};
+        Complex even = {0.5 * (a.re + b.re), 0.5 * (a.im + b.im)};
+        Complex odd = {0.5 * (a.im - b.im), -0.5 * (a.re - b.re)};     // (a - b) / (2i)
+        Complex w = c_expi(-2.0 * M_PI * k / n);
+        Complex t = c_mul(w, odd);
+        out[k].re = even.re + t.re;
+        out[k].im = even.im + t.im;
+    }
+}
+
+// rfft(x): n/2 + 1 коэффициентов БПФ вещественного вектора или каждого столбца матрицы
+Container* rfft_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("rfft: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (!args[0] || args[0]->type == CT_COMPLEX || args[0]->type == CT_STRING) {
+        print_log("rfft: аргумент должен быть вещественным вектором или матрицей\n");
+        return NULL;
+    }
+    Container *dense = container_to_matrix(args[0]);
+    if (!dense) {
+        print_log("rfft: аргумент должен быть вещественным вектором или матрицей\n");
+        return NULL;
+    }
+    MatrixContainer *m = (MatrixContainer*)dense->data;
+
+    // Строка преобразуется вдоль строки, иначе - по столбцам (столбцы переписываются в строки)
+    int row = m->rows == 1;
+    int n = row ? m->cols : m->rows;
+    int lines = row ? 1 : m->cols;
+    int out_n = n / 2 + 1;
+
+    Container *result = row ? create_complex_container(1, out_n) : create_complex_container(out_n, m->cols);
+    double *x = (double*)malloc((size_t)n * lines * sizeof(double));
+    Complex *spec = (Complex*)malloc((size_t)out_n * lines * sizeof(Complex));
+    if (!result || !x || !spec) {
+        free_container(result);
+        free_container(dense);
+        free(x);
+        free(spec);
+        return NULL;
+    }
+    for (int l = 0; l < lines; l++) {
+        for (int k = 0; k < n; k++) x[(size_t)l * n + k] = row ? m->data[k] : m->data[(size_t)k * m->cols + l];
+    }
+
+    const FftPlan *half = fft_plan(n % 2 ? n : (n / 2 > 0 ? n / 2 : 1));
+    double work = (double)lines * n * log2((double)n + 1);
+
+    #pragma omp parallel if(lines > 1 && work > PARALLEL_MIN_WORK)
+    {
+        Complex *z = (Complex*)malloc((size_t)(n + half->work) * sizeof(Complex));
+        #pragma omp for schedule(static)
+        for (int l = 0; l < lines; l++) {
+            if (n == 1) {
+                spec[l].re = x[l];
+                spec[l].im = 0.0;
+            } else {
+                rfft_line(x + (size_t)l * n, n, spec + (size_t)l * out_n, z, z + n, half);
+            }
+        }
+        free(z);
+    }
+
+    Complex *out = ((ComplexContainer*)result->data)->data;
+    if (row) memcpy(out, spec, (size_t)out_n * sizeof(Complex));
+    else transpose_complex(spec, out, lines, out_n);
+
+    free(x);
+    free(spec);
+    free_container(dense);
+    return result;
+}
+
+
+// Свертка
+
+// Полная свертка напрямую: out (m1+m2-1) x (n1+n2-1) += a (*) b
+static void conv_direct_real(const MatrixContainer *a, const MatrixContainer *b, double *out, int out_cols) {
+    int rows = a->rows + b->rows - 1;
+    double work = (double)a->rows * a->cols * b->rows * b->cols;
+
+    // Каждая строка результата собирается одним потоком
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(dynamic)
+    for (int r = 0; r < rows; r++) {
+        int i0 = r - b->rows + 1 > 0 ? r - b->rows + 1 : 0;
+        int i1 = r < a->rows - 1 ? r : a->rows - 1;
+        double *dst = out + (size_t)r * out_cols;
+        for (int i = i0; i <= i1; i++) {
+            const double *arow = a->data + (size_t)i * a->cols;
+            const double *brow = b->data + (size_t)(r - i) * b->cols;
+            for (int j = 0; j < a->cols; j++) {
+                if (arow[j] != 0.0) kernels->axpy(arow[j], brow, dst + j, b->cols);
+            }
+        }
+    }
+}
+
+static void conv_direct_complex(const ComplexContainer *a, const ComplexContainer *b, Complex *out, int out_cols) {
+    for (int i = 0; i < a->rows; i++) {
+        for (int j = 0; j < a->cols; j++) {
+            Complex x = a->data[(size_t)i * a->cols + j];
+            for (int p = 0; p < b->rows; p++) {
+                const Complex *brow = b->data + (size_t)p * b->cols;
+                Complex *dst = out + (size_t)(i + p) * out_cols + j;
+                for (int q = 0; q < b->cols; q++) {
+                    Complex t = c_mul(x, brow[q]);
+                    dst[q].re += t.re;
+                    dst[q].im += t.im;
+                }
+            }
+        }
+    }
+}
+
+// Двумерное БПФ массива rows x cols (строки, затем столбцы)
+static int fft2_inplace(Complex *data, int rows, int cols, int inverse) {
+    fft_rows(data, rows, cols, inverse);
+    return fft_columns(data, rows, cols, inverse);
+}
+
+// Вещественная свертка через одно прямое БПФ от z = a + i*b и одно обратное:
+// A[k] = (Z[k] + conj Z[-k])/2, B[k] = (Z[k] - conj Z[-k])/(2i)
+static int conv_fft_real(const MatrixContainer *a, const MatrixContainer *b, double *out, int out_rows, int out_cols) {
+    int M = fft_fast_size(out_rows), N = fft_fast_size(out_cols);
+    Complex *z = (Complex*)calloc((size_t)M * N, sizeof(Complex));
+    Complex *c = (Complex*)malloc((size_t)M * N * sizeof(Complex));
+    if (!z || !c) {
+        free(z);
+        free(c);
+        return 0;
+    }
+    for (int i = 0; i < a->rows; i++) {
+        for (int j = 0; j < a->cols; j++) z[(size_t)i * N + j].re = a->data[(size_t)i * a->cols + j];
+    }
+    for (int i = 0; i < b->rows; i++) {
+        for (int j = 0; j < b->cols; j++) z[(size_t)i * N + j].im = b->data[(size_t)i * b->cols + j];
+    }
+
+    int ok = fft2_inplace(z, M, N, 0);
+    for (int i = 0; ok && i < M; i++) {
+        int ni = i ? M - i : 0;
+        for (int j = 0; j < N; j++) {
+            int nj = j ? N - j : 0;
+            Complex p = z[(size_t)i * N + j];
+            Complex q = {z[(size_t)ni * N + nj].re, -z[(size_t)ni * N + nj].im};
+            Complex fa = {0.5 * (p.re + q.re), 0.5 * (p.im + q.im)};
+            Complex fb = {0.5 * (p.im - q.im), -0.5 * (p.re - q.re)};
+            c[(size_t)i * N + j] = c_mul(fa, fb);
+        }
+    }
+    if (ok) ok = fft2_inplace(c, M, N, 1);
+    for (int i = 0; ok && i < out_rows; i++) {
+        for (int j = 0; j < out_cols; j++) out[(size_t)i * out_cols + j] = c[(size_t)i * N + j].re;
+    }
+    free(z);
+    free(c);
+    return ok;
+}
+
+static int conv_fft_complex(const ComplexContainer *a, const ComplexContainer *b, Complex *out, int out_rows, int out_cols) {
+    int M = fft_fast_size(out_rows), N = fft_fast_size(out_cols);
+    Complex *fa = (Complex*)calloc((size_t)M * N, sizeof(Complex));
+    Complex *fb = (Complex*)calloc((size_t)M * N, sizeof(Complex));
+    int ok = fa && fb;
+    for (int i = 0; ok && i < a->rows; i++) memcpy(fa + (size_t)i * N, a->data + (size_t)i * a->cols, a->cols * sizeof(Complex));
+    for (int i = 0; ok && i < b->rows; i++) memcpy(fb + (size_t)i * N, b->data + (size_t)i * b->cols, b->cols * sizeof(Complex));
+
+    if (ok) ok = fft2_inplace(fa, M, N, 0) && fft2_inplace(fb, M, N, 0);
+    if (ok) {
+        for (size_t k = 0; k < (size_t)M * N; k++) fa[k] = c_mul(fa[k], fb[k]);
+        ok = fft2_inplace(fa, M, N, 1);
+    }
+    for (int i = 0; ok && i < out_rows; i++) memcpy(out + (size_t)i * out_cols, fa + (size_t)i * N, out_cols * sizeof(Complex));
+    free(fa);
+    free(fb);
+    return ok;
+}
+
+// Выбор пути по оценке числа операций: прямая свертка - произведение размеров
+// (вещественная еще и вызовы axpy по строкам ядра, комплексная - по 4 умножения),
+// через БПФ - преобразования размера M*N (для вещественных два, для комплексных три)
+static int conv_use_fft(int a_size, int b_rows, int b_cols, int out_rows, int out_cols, int complex_data) {
+    double direct = complex_data ? 4.0 * a_size * b_rows * b_cols
+                                 : (double)a_size * b_rows * (b_cols + CONV_ROW_COST);
+    double mn = (double)fft_fast_size(out_rows) * fft_fast_size(out_cols);
+    double fft = (complex_data ? 3 : 2) * FFT_COST * mn * log2(mn + 1);
+    return fft < direct;
+}
+
+// conv(a, b): полная свертка векторов или матриц (размер результата - сумма размеров минус 1).
+// Векторы приходят столбцами n x 1; два столбца сворачиваются как строки 1 x n
+// (элементы лежат в памяти так же), иначе прямая свертка делает по вызову axpy
+// длины 1 на каждый элемент и оценка пути уходит к БПФ с его погрешностью
+Container* conv_func(Container** args, int arg_count) {
+    if (arg_count != 2) {
+        print_log("conv: ожидается 2 аргумента\n");
+        return NULL;
+    }
+    if (!args[0] || !args[1] || args[0]->type == CT_STRING || args[1]->type == CT_STRING) {
+        print_log("conv: аргументы должны быть векторами или матрицами\n");
+        return NULL;
+    }
+
+    if (args[0]->type == CT_COMPLEX || args[1]->type == CT_COMPLEX) {
+        Container *za = to_complex(args[0]);
+        Container *zb = to_complex(args[1]);
+        Container *result = NULL;
+        if (za && zb) {
+            ComplexContainer ra = *(ComplexContainer*)za->data, rb = *(ComplexContainer*)zb->data;
+            ComplexContainer *a = &ra, *b = &rb;
+            result = create_complex_container(a->rows + b->rows - 1, a->cols + b->cols - 1);
+            if (a->cols == 1 && b->cols == 1) {
+                a->cols = a->rows;
+                b->cols = b->rows;
+                a->rows = b->rows = 1;
+            }
+            int rows = a->rows + b->rows - 1, cols = a->cols + b->cols - 1;
+            if (result) {
+                Complex *out = ((ComplexContainer*)result->data)->data;
+                if (conv_use_fft(a->rows * a->cols, b->rows, b->cols, rows, cols, 1)) {
+                    if (!conv_fft_complex(a, b, out, rows, cols)) {
+                        free_container(result);
+                        result = NULL;
+                    }
+                } else {
+                    conv_direct_complex(a, b, out, cols);
+                }
+            }
+        }
+        free_container(za);
+        free_container(zb);
+        return result;
+    }
+
+    Container *da = container_to_matrix(args[0]);
+    Container *db = container_to_matrix(args[1]);
+    Container *result = NULL;
+    if (!da || !db) {
+        print_log("conv: аргументы должны быть векторами или матрицами\n");
+    } else {
+        MatrixContainer ra = *(MatrixContainer*)da->data, rb = *(MatrixContainer*)db->data;
+        MatrixContainer *a = &ra, *b = &rb;
+        result = create_matrix_container(a->rows + b->rows - 1, a->cols + b->cols - 1);
+        if (a->cols == 1 && b->cols == 1) {
+            a->cols = a->rows;
+            b->cols = b->rows;
+            a->rows = b->rows = 1;
+        }
+        int rows = a->rows + b->rows - 1, cols = a->cols + b->cols - 1;
+        if (result) {
+            double *out = ((MatrixContainer*)result->data)->data;
+            if (conv_use_fft(a->rows * a->cols, b->rows, b->cols, rows, cols, 0)) {
+                if (!conv_fft_real(a, b, out, rows, cols)) {
+                    print_log("conv: недостаточно памяти\n");
+                    free_container(result);
+                    result = NULL;
+                }
+            } else {
+                conv_direct_real(a, b, out, cols);
+            }
+        }
+    }
+    free_container(da);
+    free_container(db);
+    return result;
+}
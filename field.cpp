@@ -0,0 +1,462 @@
+#include "lib.h"
+
+// Поля 3-векторов: count векторов хранятся тремя непрерывными массивами x, y, z
+// (структура массивов), поэтому cross, скалярное произведение, длины, сложение
+// и умножение на число идут векторными инструкциями по всему полю, а не по
+// одному VectorContainer. Вместо второго поля можно передать один вектор, он
+// применяется ко всем элементам. Поэлементные числа (скалярные произведения,
+// длины) возвращаются столбцом count x 1.
+
+#define FIELD_PRINT_LIMIT 10
+#define FIELD_PRINT_EDGE  4
+
+
+// Выделение поля; массивы выровнены на 8 элементов, чтобы каждый начинался с новой кэш-строки блока
+Container* create_field_container(int count) {
+    size_t stride = ((size_t)(count > 0 ? count : 1) + 7) & ~(size_t)7;
+    double *block = (double*)mem_calloc(MEM_CONTAINERS, 3 * stride, sizeof(double));
+    if (!block) {
+        print_log("Ошибка: недостаточно памяти для поля из %d векторов\n", count);
+        return NULL;
+    }
+
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
+    FieldContainer *data = (FieldContainer*)malloc(sizeof(FieldContainer));
+
+    data->count = count;
+    data->x = block;
+    data->y = block + stride;
+    data->z = block + 2 * stride;
+    container->type = CT_FIELD;
+    container->data = data;
+    container->free_func = free_field_container;
+    container->print_func = print_field_container;
+
+    return container;
+}
+
+void free_field_container(void *data) {
+    FieldContainer *f = (FieldContainer*)data;
+    mem_free(MEM_CONTAINERS, f->x);
+    free(f);
+}
+
+static void print_field_item(const FieldContainer *f, int i) {
+    print_log("[");
+    print_smart_double(f->x[i]);
+    print_log(", ");
+    print_smart_double(f->y[i]);
+    print_log(", ");
+    print_smart_double(f->z[i]);
+    print_log("]");
+}
+
+void print_field_container(void *data) {
+    if (!data) return;
+    FieldContainer *f = (FieldContainer*)data;
+
+    print_log("поле %d: [", f->count);
+    for (int i = 0; i < f->count; i++) {
+        if (f->count > FIELD_PRINT_LIMIT && i == FIELD_PRINT_EDGE) {
+            print_log("..., ");
+            i = f->count - FIELD_PRINT_EDGE;
+        }
+        print_field_item(f, i);
+        if (i + 1 < f->count) print_log(", ");
+    }
+    print_log("]");
+}
+
+Container* field_copy(FieldContainer *f) {
+    Container *copy = create_field_container(f->count);
+    if (!copy) return NULL;
+
+    FieldContainer *fc = (FieldContainer*)copy->data;
+    memcpy(fc->x, f->x, (size_t)f->count * sizeof(double));
+    memcpy(fc->y, f->y, (size_t)f->count * sizeof(double));
+    memcpy(fc->z, f->z, (size_t)f->count * sizeof(double));
+    return copy;
+}
+
+int field_compare(FieldContainer *a, FieldContainer *b) {
+    if (a->count != b->count) return 0;
+    for (int i = 0; i < a->count; i++) {
+        if (fabs(a->x[i] - b->x[i]) >= 1e-10 ||
+            fabs(a->y[i] - b->y[i]) >= 1e-10 ||
+            fabs(a->z[i] - b->z[i]) >= 1e-10) return 0;
+    }
+    return 1;
+}
+
+// Матрица count x 3, по вектору в строке
+Container* field_to_matrix(FieldContainer *f) {
+    Container *result = create_matrix_container(f->count, 3);
+    if (!result) return NULL;
+    double *d = ((MatrixContainer*)result->data)->data;
+    for (int i = 0; i < f->count; i++) {
+        d[3 * i]     = f->x[i];
+        d[3 * i + 1] = f->y[i];
+        d[3 * i + 2] = f->z[i];
+    }
+    return result;
+}
+
+
+// Ядра над одной координатой
+static FORCE_INLINE void comb_body(double alpha, const double *a, double beta, const double *b, double *out, int n) {
+    #pragma omp simd
+    for (int i = 0; i < n; i++) out[i] = alpha * a[i] + beta * b[i];
+}
+
+static FORCE_INLINE void affine_body(double alpha, const double *a, double c, double *out, int n) {
+    #pragma omp simd
+    for (int i = 0; i < n; i++) out[i] = alpha * a[i] + c;
+}
+
+static FORCE_INLINE void scale_body(const double *a, double s, double *out, int n) {
+    #pragma omp simd
+    for (int i = 0; i < n; i++) out[i] = a[i] * s;
+}
+
+static FORCE_INLINE void quot_body(const double *a, double s, double *out, int n) {
+    #pragma omp simd
+    for (int i = 0; i < n; i++) out[i] = a[i] / s;
+}
+
+// Ядра над тремя координатами; c - вектор, общий для всех элементов
+static FORCE_INLINE void cross_body(const FieldContainer *a, const FieldContainer *b, FieldContainer *out, int i0, int n) {
+    const double *ax = a->x + i0, *ay = a->y + i0, *az = a->z + i0;
+    const double *bx = b->x + i0, *by = b->y + i0, *bz = b->z + i0;
+    double *ox = out->x + i0, *oy = out->y + i0, *oz = out->z + i0;
+    #pragma omp simd
+    for (int i = 0; i < n; i++) {
+        ox[i] = ay[i] * bz[i] - az[i] * by[i];
+        oy[i] = az[i] * bx[i] - ax[i] * bz[i];
+        oz[i] = ax[i] * by[i] - ay[i] * bx[i];
+    }
+}
+
+static FORCE_INLINE void cross_const_body(const FieldContainer *a, const double *c, FieldContainer *out, int i0, int n) {
+    const double *ax = a->x + i0, *ay = a->y + i0, *az = a->z + i0;
+    double *ox = out->x + i0, *oy = out->y + i0, *oz = out->z + i0;
+    double cx = c[0], cy = c[1], cz = c[2];
+    #pragma omp simd
+    for (int i = 0; i < n; i++) {
+        ox[i] = ay[i] * cz - az[i] * cy;
+        oy[i] = az[i] * cx - ax[i] * cz;
+        oz[i] = ax[i] * cy - ay[i] * cx;
+    }
+}
+
+static FORCE_INLINE void dot_body(const FieldContainer *a, const FieldContainer *b, double *out, int i0, int n) {
+    const double *ax = a->x + i0, *ay = a->y + i0, *az = a->z + i0;
+    const double *bx = b->x + i0, *by = b->y + i0, *bz = b->z + i0;
+    double *o = out + i0;
+    #pragma omp simd
+    for (int i = 0; i < n; i++) o[i] = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i];
+}
+
+static FORCE_INLINE void dot_const_body(const FieldContainer *a, const double *c, double *out, int i0, int n) {
+    const double *ax = a->x + i0, *ay = a->y + i0, *az = a->z + i0;
+    double *o = out + i0;
+    double cx = c[0], cy = c[1], cz = c[2];
+    #pragma omp simd
+    for (int i = 0; i < n; i++) o[i] = ax[i] * cx + ay[i] * cy + az[i] * cz;
+}
+
+static FORCE_INLINE void norm_body(const FieldContainer *a, double *out, int i0, int n) {
+    const double *ax = a->x + i0, *ay = a->y + i0, *az = a->z + i0;
+    double *o = out + i0;
+    #pragma omp simd
+    for (int i = 0; i < n; i++) o[i] = sqrt(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+}
+
+KERNEL_VARIANTS(void, comb, (double alpha, const double *a, double beta, const double *b, double *out, int n), (alpha, a, beta, b, out, n))
+KERNEL_VARIANTS(void, affine, (double alpha, const double *a, double c, double *out, int n), (alpha, a, c, out, n))
+KERNEL_VARIANTS(void, scale, (const double *a, double s, double *out, int n), (a, s, out, n))
+KERNEL_VARIANTS(void, quot, (const double *a, double s, double *out, int n), (a, s, out, n))
+KERNEL_VARIANTS(void, cross, (const FieldContainer *a, const FieldContainer *b, FieldContainer *out, int i0, int n), (a, b, out, i0, n))
+KERNEL_VARIANTS(void, cross_const, (const FieldContainer *a, const double *c, FieldContainer *out, int i0, int n), (a, c, out, i0, n))
+KERNEL_VARIANTS(void, dot, (const FieldContainer *a, const FieldContainer *b, double *out, int i0, int n), (a, b, out, i0, n))
+KERNEL_VARIANTS(void, dot_const, (const FieldContainer *a, const double *c, double *out, int i0, int n), (a, c, out, i0, n))
+KERNEL_VARIANTS(void, norm, (const FieldContainer *a, double *out, int i0, int n), (a, out, i0, n))
+
+
+// Число порций и граница параллельности для поля из n векторов
+static int field_chunks(int n) {
+    return (n + KERNEL_CHUNK - 1) / KERNEL_CHUNK;
+}
+
+static int chunk_length(int n, int c) {
+    int i0 = c * KERNEL_CHUNK;
+    return n - i0 < KERNEL_CHUNK ? n - i0 : KERNEL_CHUNK;
+}
+
+#define FIELD_PARALLEL(n) if((size_t)(n) * 3 > PARALLEL_MIN_WORK) schedule(static)
+
+
+// Операнд: поле или вектор, общий для всех элементов
+typedef struct {
+    FieldContainer *field;
+    double v[3];
+} FieldOperand;
+
+static int field_operand(Container *c, FieldOperand *op) {
+    op->field = NULL;
+    if (c->type == CT_FIELD) {
+        op->field = (FieldContainer*)c->data;
+        return 1;
+    }
+    if (c->type == CT_VECTOR) {
+        VectorContainer *vc = (VectorContainer*)c->data;
+        op->v[0] = vc->x;
+        op->v[1] = vc->y;
+        op->v[2] = vc->z;
+        return 1;
+    }
+    return 0;
+}
+
+static int same_count(const FieldContainer *a, const FieldContainer *b) {
+    if (a->count == b->count) return 1;
+    print_log("Ошибка: в полях разное число векторов (%d и %d)\n", a->count, b->count);
+    return 0;
+}
+
+// Поле, вектор и число: a*s или a/s по координатам
+static Container* field_scale(FieldContainer *a, double s, int divide) {
+    Container *result = create_field_container(a->count);
+    if (!result) return NULL;
+    FieldContainer *r = (FieldContainer*)result->data;
+    void (*f)(const double*, double, double*, int) =
+        divide ? KERNEL_PICK(quot, kernels->level) : KERNEL_PICK(scale, kernels->level);
+
+    int n = a->count, chunks = field_chunks(n);
+    #pragma omp parallel for FIELD_PARALLEL(n)
+    for (int c = 0; c < chunks; c++) {
+        int i0 = c * KERNEL_CHUNK, len = chunk_length(n, c);
+        f(a->x + i0, s, r->x + i0, len);
+        f(a->y + i0, s, r->y + i0, len);
+        f(a->z + i0, s, r->z + i0, len);
+    }
+    return result;
+}
+
+// a + sign*b для полей и векторов
+Container* field_add(Container *a, Container *b, double sign) {
+    FieldOperand x, y;
+    if (!field_operand(a, &x) || !field_operand(b, &y)) {
+        print_log("Ошибка: с полем складываются только поля и векторы\n");
+        return NULL;
+    }
+
+    if (x.field && y.field) {
+        if (!same_count(x.field, y.field)) return NULL;
+        Container *result = create_field_container(x.field->count);
+        if (!result) return NULL;
+        FieldContainer *r = (FieldContainer*)result->data;
+        void (*f)(double, const double*, double, const double*, double*, int) = KERNEL_PICK(comb, kernels->level);
+
+        int n = r->count, chunks = field_chunks(n);
+        #pragma omp parallel for FIELD_PARALLEL(n)
+        for (int c = 0; c < chunks; c++) {
+            int i0 = c * KERNEL_CHUNK, len = chunk_length(n, c);
+            f(1.0, x.field->x + i0, sign, y.field->x + i0, r->x + i0, len);
+            f(1.0, x.field->y + i0, sign, y.field->y + i0, r->y + i0, len);
+            f(1.0, x.field->z + i0, sign, y.field->z + i0, r->z + i0, len);
+        }
+        return result;
+    }
+
+    // Поле + вектор: alpha*поле + c, для вектора слева поле берется со знаком sign
+    FieldContainer *fa = x.field ? x.field : y.field;
+    double alpha = x.field ? 1.0 : sign;
+    double c[3];
+    for (int k = 0; k < 3; k++) c[k] = x.field ? sign * y.v[k] : x.v[k];
+
+    Container *result = create_field_container(fa->count);
+    if (!result) return NULL;
+    FieldContainer *r = (FieldContainer*)result->data;
+    void (*f)(double, const double*, double, double*, int) = KERNEL_PICK(affine, kernels->level);
+
+    int n = r->count, chunks = field_chunks(n);
+    #pragma omp parallel for FIELD_PARALLEL(n)
+    for (int ch = 0; ch < chunks; ch++) {
+        int i0 = ch * KERNEL_CHUNK, len = chunk_length(n, ch);
+        f(alpha, fa->x + i0, c[0], r->x + i0, len);
+        f(alpha, fa->y + i0, c[1], r->y + i0, len);
+        f(alpha, fa->z + i0, c[2], r->z + i0, len);
+    }
+    return result;
+}
+
+// Поле на число - поле; поле на поле или вектор - скалярные произведения
+Container* field_mul(Container *a, Container *b) {
+    if (container_is_scalar(a) || container_is_scalar(b)) {
+        Container *f = container_is_scalar(a) ? b : a;
+        double s = container_to_double(container_is_scalar(a) ? a : b);
+        return field_scale((FieldContainer*)f->data, s, 0);
+    }
+
+    FieldOperand x, y;
+    if (!field_operand(a, &x) || !field_operand(b, &y)) {
+        print_log("Ошибка: поле умножается на число, вектор или поле\n");
+        return NULL;
+    }
+    if (x.field && y.field && !same_count(x.field, y.field)) return NULL;
+
+    FieldContainer *fa = x.field ? x.field : y.field;
+    const double *c = x.field ? y.v : x.v;
+    Container *result = create_matrix_container(fa->count, 1);
+    if (!result) return NULL;
+    double *out = ((MatrixContainer*)result->data)->data;
+
+    int n = fa->count, chunks = field_chunks(n);
+    if (x.field && y.field) {
+        void (*f)(const FieldContainer*, const FieldContainer*, double*, int, int) = KERNEL_PICK(dot, kernels->level);
+        #pragma omp parallel for FIELD_PARALLEL(n)
+        for (int ch = 0; ch < chunks; ch++) {
+            f(x.field, y.field, out, ch * KERNEL_CHUNK, chunk_length(n, ch));
+        }
+    } else {
+        void (*f)(const FieldContainer*, const double*, double*, int, int) = KERNEL_PICK(dot_const, kernels->level);
+        #pragma omp parallel for FIELD_PARALLEL(n)
+        for (int ch = 0; ch < chunks; ch++) {
+            f(fa, c, out, ch * KERNEL_CHUNK, chunk_length(n, ch));
+        }
+    }
+    return result;
+}
+
+// Деление поля на число
+Container* field_div(Container *a, Container *b) {
+    if (a->type != CT_FIELD || !container_is_scalar(b)) {
+        print_log("Ошибка: поле можно делить только на число\n");
+        return NULL;
+    }
+    double divisor = container_to_double(b);
+    if (divisor == 0.0) {
+        print_log("Ошибка: деление на ноль\n");
+        return NULL;
+    }
+    if (reciprocal_exact(divisor)) return field_scale((FieldContainer*)a->data, 1.0 / divisor, 0);
+    return field_scale((FieldContainer*)a->data, divisor, 1);
+}
+
+// Векторные произведения; вектор слева: c x a = a x (-c)
+Container* field_cross(Container *a, Container *b) {
+    FieldOperand x, y;
+    if (!field_operand(a, &x) || !field_operand(b, &y)) {
+        print_log("cross: аргументы должны быть полями или векторами\n");
+        return NULL;
+    }
+    if (x.field && y.field && !same_count(x.field, y.field)) return NULL;
+
+    FieldContainer *fa = x.field ? x.field : y.field;
+    double c[3];
+    for (int k = 0; k < 3; k++) c[k] = x.field ? y.v[k] : -x.v[k];
+
+    Container *result = create_field_container(fa->count);
+    if (!result) return NULL;
+    FieldContainer *r = (FieldContainer*)result->data;
+
+    int n = fa->count, chunks = field_chunks(n);
+    if (x.field && y.field) {
+        void (*f)(const FieldContainer*, const FieldContainer*, FieldContainer*, int, int) = KERNEL_PICK(cross, kernels->level);
+        #pragma omp parallel for FIELD_PARALLEL(n)
+        for (int ch = 0; ch < chunks; ch++) {
+            f(x.field, y.field, r, ch * KERNEL_CHUNK, chunk_length(n, ch));
+        }
+    } else {
+        void (*f)(const FieldContainer*, const double*, FieldContainer*, int, int) = KERNEL_PICK(cross_const, kernels->level);
+        #pragma omp parallel for FIELD_PARALLEL(n)
+        for (int ch = 0; ch < chunks; ch++) {
+            f(fa, c, r, ch * KERNEL_CHUNK, chunk_length(n, ch));
+        }
+    }
+    return result;
+}
+
+// Длины всех векторов поля
+Container* field_norms(Container *a) {
+    FieldContainer *fa = (FieldContainer*)a->data;
+    Container *result = create_matrix_container(fa->count, 1);
+    if (!result) return NULL;
+    double *out = ((MatrixContainer*)result->data)->data;
+    void (*f)(const FieldContainer*, double*, int, int) = KERNEL_PICK(norm, kernels->level);
+
+    int n = fa->count, chunks = field_chunks(n);
+    #pragma omp parallel for FIELD_PARALLEL(n)
+    for (int ch = 0; ch < chunks; ch++) {
+        f(fa, out, ch * KERNEL_CHUNK, chunk_length(n, ch));
+    }
+    return result;
+}
+
+
+// field(A) из матрицы n x 3 (по вектору в строке) или field(x, y, z) из трех столбцов
+Container* field_func(Container** args, int arg_count) {
+    if (arg_count != 1 && arg_count != 3) {
+        print_log("field: ожидается 1 или 3 аргумента\n");
+        return NULL;
+    }
+    for (int k = 0; k < arg_count; k++) {
+        if (!args[k]) return NULL;
+    }
+    if (arg_count == 1 && args[0]->type == CT_FIELD) return field_copy((FieldContainer*)args[0]->data);
+
+    if (arg_count == 1) {
+        if (args[0]->type == CT_VECTOR) {
+            VectorContainer *vc = (VectorContainer*)args[0]->data;
+            Container *result = create_field_container(1);
+            if (!result) return NULL;
+            FieldContainer *r = (FieldContainer*)result->data;
+            r->x[0] = vc->x;
+            r->y[0] = vc->y;
+            r->z[0] = vc->z;
+            return result;
+        }
+
+        Container *temp;
+        MatrixContainer *m = args[0]->type == CT_MATRIX || args[0]->type == CT_SPARSE ? dense_view(args[0], &temp) : NULL;
+        if (!m || m->cols != 3) {
+            print_log("field: ожидается матрица n x 3, вектор или три столбца координат\n");
+            if (m) free_container(temp);
+            return NULL;
+        }
+        Container *result = create_field_container(m->rows);
+        if (result) {
+            FieldContainer *r = (FieldContainer*)result->data;
+            for (int i = 0; i < m->rows; i++) {
+                r->x[i] = m->data[3 * (size_t)i];
+                r->y[i] = m->data[3 * (size_t)i + 1];
+                r->z[i] = m->data[3 * (size_t)i + 2];
+            }
+        }
+        free_container(temp);
+        return result;
+    }
+
+    double *coords[3] = {NULL, NULL, NULL};
+    int counts[3] = {0, 0, 0};
+    Container *result = NULL;
+    int valid = 1;
+    for (int k = 0; k < 3 && valid; k++) {
+        if (args[k]->type != CT_MATRIX && args[k]->type != CT_SPARSE) valid = 0;
+        else coords[k] = container_values(args[k], &counts[k]);
+        if (!coords[k]) valid = 0;
+    }
+    if (!valid || counts[1] != counts[0] || counts[2] != counts[0]) {
+        print_log("field: координаты должны быть столбцами одной длины\n");
+    } else {
+        result = create_field_container(counts[0]);
+        if (result) {
+            FieldContainer *r = (FieldContainer*)result->data;
+            memcpy(r->x, coords[0], (size_t)counts[0] * sizeof(double));
+            memcpy(r->y, coords[1], (size_t)counts[0] * sizeof(double));
+            memcpy(r->z, coords[2], (size_t)counts[0] * sizeof(double));
+        }
+    }
+    for (int k = 0; k < 3; k++) free(coords[k]);
+    return result;
+}
@@ -1,16 +1,28 @@
 #include "lib.h"
 
-//  
+// Вывод потока выключен (потоки разбора сценария: их сообщения печатает
+// вычислитель, повторяя разбор строки в своём порядке)
+static thread_local int log_muted = 0;
+
+int log_mute(int muted) {
+    int was = log_muted;
+    log_muted = muted;
+    return was;
+}
+
+// Универсальный вывод
 void print_log(const char* format, ...)
 {
+    if (log_muted) return;
+
     va_list args;
 
-    //  
+    //Вывод на экран
     va_start(args, format);
     vprintf(format, args);
     va_end(args);
 
-    //  
+    //Вывод в файл
     FILE* f = fopen("session.tmp", "a");
     if (f) {
         va_start(args, format);
@@ -21,7 +33,7 @@ void print_log(const char* format, ...)
 }
 
 
-//    
+//Дописать строку в конец файла
 void append_to_file(const char* filename, const char* text) {
     FILE* f = fopen(filename, "a"); //
     if (f) {
@@ -31,25 +43,25 @@ void append_to_file(const char* filename, const char* text) {
 }
 
 
-//      
+//Копирование данных из одного файла в другой
 void copy_file(const char* src_name, const char* dst_name) {
     FILE* src = fopen(src_name, "rb");
     if (!src)
     {
-        printf(":     %s (,   ).\n", src_name);
-        printf("      \n");
+        printf("Ошибка: не удалось открыть файл %s (возможно, он не существует).\n", src_name);
+        printf("Попробуйте повторить ввод команд или перезапустите приложение\n");
         return;
     }
 
 
     FILE* dst = fopen(dst_name, "wb");
     if (!dst) {
-        printf("   %s\n", dst_name);
+        printf("Ошибка создания файла %s\n", dst_name);
         fclose(src);
         return;
     }
 
-    char buffer[4096]; //   4 
+    char buffer[4096]; // Буфер на 4 КБ
     size_t bytesRead;
 
     while ((bytesRead = fread(buffer, 1, sizeof(buffer), src)) > 0) {
@@ -58,11 +70,11 @@ void copy_file(const char* src_name, const char* dst_name) {
 
     fclose(src);
     fclose(dst);
-    printf(" : %s\n", dst_name);
+    printf("Файл сохранен: %s\n", dst_name);
 }
 
-//   (   cls)
+// Очистить файл (при запуске или cls)
 void clear_file(const char* filename) {
-    FILE* f = fopen(filename, "w"); // "w"   
+    FILE* f = fopen(filename, "w"); // "w" перезаписывает файл пустым
     if (f) fclose(f);
 }
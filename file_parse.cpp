@@ -1,47 +1,390 @@
 #include "lib.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
+// Анализ сценария перед выполнением: присваивание без вывода "x = выражение;",
+// после которого x перезаписывается раньше, чем читается, откладывается
+// (lazy.cpp) и при перезаписи выбрасывается, не вычисляясь. Откладывается только
+// выражение, которое не может завершиться ошибкой (lazy.cpp проверяет формы
+// значений), иначе пропало бы её сообщение; строки с функциями, печатающими
+// сообщения (MEMO_PRINT), отсеиваются уже здесь. Анализ смотрит только на имена
+// в тексте строк; если он ошибся, отложенное значение будет вычислено при чтении.
+//
+// Строки сценария проходят конвейер из трёх стадий: лексер и сортировочная
+// станция работают в своих потоках впереди вычислителя и передают строки дальше
+// через очереди одного писателя и одного читателя. Вычисление строки N идёт
+// одновременно с разбором строк N+1, N+2... Вычислитель (основной поток) берёт
+// строки по порядку и делает всё, что зависит от предыдущих строк: определения
+// функций, подстановку, вычисление и вывод. Сообщения потоков разбора
+// выключены; строку с ошибкой вычислитель разбирает заново сам, поэтому ошибки
+// печатаются на своём месте.
 
+#define SCRIPT_NAME 64
+#define PIPE_QUEUE  64      // Строк в очереди между стадиями (степень двойки)
 
-void execute_from_file(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
-        print_log(":      '%s'\n", filename);
-        return;
-    }
+typedef struct {
+    char text[256];
+    char target[SCRIPT_NAME];   // x в строке "x = ..." или пусто
+    int quiet;                  // Строка заканчивается ';'
+    int opaque;                 // Функция пользователя или grad: может прочесть любую переменную
+    int prints;                 // Функция может напечатать сообщение (MEMO_PRINT)
+    Token *tokens;              // Результат лексера (NULL - пропуск или ошибка)
+    Token *rpn;                 // Результат разбора (NULL - ошибка или определение функции)
+} ScriptLine;
 
-    print_log("---    %s ---\n", filename);
+// Очередь номеров строк: пишет один поток, читает другой. Каждый конец меняет
+// только свой счётчик. На полной или пустой очереди поток сначала недолго ждёт
+// с yield, а потом засыпает на условной переменной: пока вычислитель считает
+// долгое выражение на всех ядрах через OpenMP, потоки разбора не занимают ядра.
+// Будит поток только другой конец и только если кто-то спит (sleepers)
+#define PIPE_SPIN 64        // Попыток с yield перед сном
 
-    char line[256];
-    while (fgets(line, sizeof(line), file) != NULL) {
-        //   
-        line[strcspn(line, "\n")] = 0;
+typedef struct {
+    int slots[PIPE_QUEUE];
+    std::atomic<unsigned> head{0};      // Следующая запись
+    std::atomic<unsigned> tail{0};      // Следующее чтение
+    std::atomic<int> sleepers{0};
+    std::mutex lock;
+    std::condition_variable wake;
+} PipeQueue;
 
-        //   
-        if (strlen(line) == 0) continue;
+// Можно писать в позицию pos (writer) или читать из неё
+static int queue_ready(PipeQueue *q, int writer, unsigned pos) {
+    if (writer) return pos - q->tail.load() != PIPE_QUEUE;
+    return q->head.load() != pos;
+}
 
-        //  ,  ,  
-        print_log(">> %s\n", line);
+static void queue_wait(PipeQueue *q, int writer, unsigned pos) {
+    for (int spin = 0; spin < PIPE_SPIN; spin++) {
+        if (queue_ready(q, writer, pos)) return;
+        std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> guard(q->lock);
+    q->sleepers.fetch_add(1);
+    while (!queue_ready(q, writer, pos)) q->wake.wait(guard);
+    q->sleepers.fetch_sub(1);
+}
 
+// Разбудить другой конец; счётчик уже изменён
+static void queue_notify(PipeQueue *q) {
+    if (q->sleepers.load() == 0) return;
+    // Захват мьютекса: спящий либо ещё проверит условие, либо уже ждёт сигнала
+    { std::lock_guard<std::mutex> guard(q->lock); }
+    q->wake.notify_one();
+}
 
-        //       ,    .
-        if (strncmp(line, "open", 4) == 0 ||
-            strcmp(line, "save") == 0 ||
-            strcmp(line, "screen") == 0 ||
-            strcmp(line, "exit") == 0 ||
-            strcmp(line, "cls") == 0) {
+static void queue_push(PipeQueue *q, int value) {
+    unsigned head = q->head.load(std::memory_order_relaxed);
+    queue_wait(q, 1, head);
+    q->slots[head % PIPE_QUEUE] = value;
+    q->head.store(head + 1);
+    queue_notify(q);
+}
 
-            print_log("<<   ()\n\n");
+static int queue_pop(PipeQueue *q) {
+    unsigned tail = q->tail.load(std::memory_order_relaxed);
+    queue_wait(q, 0, tail);
+    int value = q->slots[tail % PIPE_QUEUE];
+    q->tail.store(tail + 1);
+    queue_notify(q);
+    return value;
+}
+
+// Следующий идентификатор в строке начиная с *pos (строки в кавычках пропускаются).
+// Возвращает 0 в конце строки; *call - за именем идёт '('
+static int next_name(const char *s, int *pos, char *name, int *call) {
+    int i = *pos;
+    while (s[i]) {
+        if (s[i] == '"') {
+            i++;
+            while (s[i] && s[i] != '"') i++;
+            if (s[i]) i++;
             continue;
         }
+        if (isalpha((unsigned char)s[i]) || s[i] == '_') {
+            int n = 0;
+            while (isalnum((unsigned char)s[i]) || s[i] == '_') {
+                if (n < SCRIPT_NAME - 1) name[n++] = s[i];
+                i++;
+            }
+            name[n] = 0;
+            int j = i;
+            while (s[j] == ' ' || s[j] == '\t') j++;
+            *call = s[j] == '(';
+            *pos = i;
+            return 1;
+        }
+        // Цифры с буквами (1e5) не должны дать имя e5
+        if (isdigit((unsigned char)s[i])) {
+            while (isalnum((unsigned char)s[i]) || s[i] == '.') i++;
+            continue;
+        }
+        i++;
+    }
+    *pos = i;
+    return 0;
+}
+
+static void scan_line(ScriptLine *line) {
+    const char *s = line->text;
+    line->target[0] = 0;
+    line->opaque = 0;
+    line->prints = 0;
+
+    size_t len = strlen(s);
+    while (len > 0 && isspace((unsigned char)s[len - 1])) len--;
+    line->quiet = len > 0 && s[len - 1] == ';';
 
-        //  
-        process_expression(line);
+    char name[SCRIPT_NAME];
+    int pos = 0, call = 0, first = 1;
+    while (next_name(s, &pos, name, &call)) {
+        if (call) {
+            FunctionDef *f = find_function(name);
+            if (!f || (f->memo & MEMO_EFFECT)) line->opaque = 1;
+            if (f && (f->memo & MEMO_PRINT)) line->prints = 1;
+        } else if (first) {
+            // "x = ..."
+            int j = pos;
+            while (s[j] == ' ' || s[j] == '\t') j++;
+            if (s[j] == '=') strcpy(line->target, name);
+        }
+        first = 0;
+    }
+}
+
+// Строка читает переменную name (имя слева от '=' не считается)
+static int line_reads(const ScriptLine *line, const char *name) {
+    char found[SCRIPT_NAME];
+    int pos = 0, call = 0, first = 1;
+    while (next_name(line->text, &pos, found, &call)) {
+        if (!call && strcmp(found, name) == 0 && !(first && line->target[0])) return 1;
+        first = 0;
+    }
+    return 0;
+}
+
+// Значение строки i перезаписывается раньше, чем читается
+static int store_is_dead(const ScriptLine *lines, int count, int i) {
+    const ScriptLine *line = &lines[i];
+    if (!line->quiet || !line->target[0] || line->opaque || line->prints) return 0;
+    for (int k = i + 1; k < count; k++) {
+        if (lines[k].opaque || line_reads(&lines[k], line->target)) return 0;
+        // ans после строки i - её значение
+        if (k == i + 1 && line_reads(&lines[k], "ans")) return 0;
+        if (strcmp(lines[k].target, line->target) == 0) return 1;
+    }
+    // Последнее значение остаётся в сессии
+    return 0;
+}
+
+// Команды, которые сценарию выполнять нельзя
+static int script_forbidden(const char *line) {
+    // Мы не разрешаем скрипту вызывать другой скрипт, сохранять файлы или выходить.
+    return strncmp(line, "open", 4) == 0 ||
+           strcmp(line, "save") == 0 ||
+           strcmp(line, "screen") == 0 ||
+           strcmp(line, "exit") == 0 ||
+           strcmp(line, "cls") == 0;
+}
+
+// Стадия 1: лексер
+static void lex_line(ScriptLine *line) {
+    char expr[256];
+    expression_quiet(line->text, expr, sizeof(expr));
+    line->tokens = script_forbidden(line->text) ? NULL : lex(expr);
+}
+
+// Стадия 2: сортировочная станция. Разбор не зависит от переменных и функций
+// пользователя, поэтому может идти впереди вычисления
+static void parse_line(ScriptLine *line) {
+    line->rpn = line->tokens ? shuntingYard(line->tokens) : NULL;
+}
+
+// Стадия 3: строки по порядку. echo - печатать строки и записывать их в
+// историю, как при вводе
+static void evaluate_line(ScriptLine *lines, int count, int i, int echo) {
+    ScriptLine *line = &lines[i];
+
+    // Печать команды, чтобы видеть, что выполняется
+    if (echo) print_log(">> %s\n", line->text);
+
+    if (script_forbidden(line->text)) {
+        print_log("<< Команда пропущена (безопасность)\n\n");
+        return;
+    }
+
+    // выполение команды
+    int defer = store_is_dead(lines, count, i);
+    if (line->tokens && user_define(line->tokens)) {
+        free_tokens(line->rpn);
+    } else if (line->tokens && line->rpn) {
+        evaluate_rpn(line->rpn, line->quiet, defer);
+    } else {
+        // Ошибка разбора: повтор целиком, чтобы напечатать сообщения
+        free_tokens(line->rpn);
+        process_expression(line->text, defer);
+    }
+    free_tokens(line->tokens);
+    line->tokens = line->rpn = NULL;
 
+    if (echo) {
         char cmd_with_newline[300];
-        sprintf(cmd_with_newline, "%s\n", line);
+        sprintf(cmd_with_newline, "%s\n", line->text);
         append_to_file("history.tmp", cmd_with_newline);
     }
+}
+
+static void lex_stage(ScriptLine *lines, int count, PipeQueue *out) {
+    log_mute(1);
+    for (int i = 0; i < count; i++) {
+        lex_line(&lines[i]);
+        queue_push(out, i);
+    }
+}
+
+static void parse_stage(ScriptLine *lines, int count, PipeQueue *in, PipeQueue *out) {
+    log_mute(1);
+    for (int k = 0; k < count; k++) {
+        int i = queue_pop(in);
+        parse_line(&lines[i]);
+        queue_push(out, i);
+    }
+}
+
+// Выполнение строк сценария. Конвейеру нужно три потока; на меньшем числе ядер
+// стадии идут по очереди в текущем потоке
+static void run_script(ScriptLine *lines, int count, int echo, int pipelined) {
+    if (!pipelined) {
+        for (int i = 0; i < count; i++) {
+            int muted = log_mute(1);
+            lex_line(&lines[i]);
+            parse_line(&lines[i]);
+            log_mute(muted);
+            evaluate_line(lines, count, i, echo);
+        }
+        return;
+    }
+
+    PipeQueue lexed, parsed;
+    std::thread lexer(lex_stage, lines, count, &lexed);
+    std::thread parser(parse_stage, lines, count, &lexed, &parsed);
+    for (int k = 0; k < count; k++) {
+        evaluate_line(lines, count, queue_pop(&parsed), echo);
+    }
+    lexer.join();
+    parser.join();
+}
+
+static int pipeline_useful() {
+    return std::thread::hardware_concurrency() >= 3;
+}
+
+// Выполнить сценарий; echo - печатать строки и начало/конец файла и записывать
+// строки в историю. Возвращает число строк или -1, если файл не открылся
+int execute_script(const char* filename, int echo) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        print_log("Ошибка: не удалось открыть файл скрипта '%s'\n", filename);
+        return -1;
+    }
 
+    // Сценарий читается целиком, чтобы видеть, где переменные читаются
+    int count = 0, capacity = 0;
+    ScriptLine* lines = NULL;
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), file) != NULL) {
+        // Удаляем перенос строки
+        buffer[strcspn(buffer, "\n")] = 0;
+
+        // Пропускаем пустые строки
+        if (strlen(buffer) == 0) continue;
+
+        if (count == capacity) {
+            int new_capacity = capacity ? capacity * 2 : 64;
+            ScriptLine* grown = (ScriptLine*)realloc(lines, new_capacity * sizeof(ScriptLine));
+            if (!grown) break;
+            lines = grown;
+            capacity = new_capacity;
+        }
+        strcpy(lines[count].text, buffer);
+        scan_line(&lines[count]);
+        count++;
+    }
     fclose(file);
-    print_log("---    %s ---\n", filename);
+
+    if (echo) print_log("--- Начало выполнения файла %s ---\n", filename);
+    run_script(lines, count, echo, pipeline_useful());
+    free(lines);
+    if (echo) print_log("--- Конец выполнения файла %s ---\n", filename);
+    return count;
+}
+
+void execute_from_file(const char* filename) {
+    execute_script(filename, 1);
+}
+
+// Сравнение последовательного выполнения и конвейера на сценарии из n длинных
+// выражений без вывода, где разбор занимает заметную долю времени
+void pipeline_benchmark(int n) {
+    ScriptLine *lines = (ScriptLine*)malloc((size_t)n * sizeof(ScriptLine));
+    if (!lines) {
+        print_log("Ошибка: не хватает памяти\n");
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        char *t = lines[i].text;
+        int len = sprintf(t, "%d", i);
+        for (int term = 1; len < 200; term++) {
+            len += sprintf(t + len, " + (%d.5*%d - %d/4) * -(%d - 0.25)", term, i % 7 + 1, term + i % 5, term % 3);
+        }
+        strcpy(t + len, ";");
+        scan_line(&lines[i]);
+    }
+
+    // Переменные пользователя и режим lazy на время теста откладываются
+    Ident *saved = FirstIdent;
+    FirstIdent = NULL;
+    int saved_lazy = lazy_enabled;
+    lazy_enabled = 0;
+
+    double lex_time = 0, parse_time = 0, eval_time = 0;
+    for (int i = 0; i < n; i++) {
+        double t0 = wall_time();
+        lex_line(&lines[i]);
+        double t1 = wall_time();
+        parse_line(&lines[i]);
+        double t2 = wall_time();
+        evaluate_line(lines, n, i, 0);
+        double t3 = wall_time();
+        lex_time += t1 - t0;
+        parse_time += t2 - t1;
+        eval_time += t3 - t2;
+    }
+    double sequential = lex_time + parse_time + eval_time;
+    Ident *ans = find_ident(FirstIdent, "ans");
+    Container *expected = ans ? container_deep_copy(ans->value->container) : NULL;
+
+    double start = wall_time();
+    run_script(lines, n, 0, 1);
+    double pipelined = wall_time() - start;
+    ans = find_ident(FirstIdent, "ans");
+    int same = expected && ans && container_compare(expected, ans->value->container);
+
+    print_log("Сценарий: %d строк по %d символов, потоков %u\n", n, (int)strlen(lines[0].text),
+              std::thread::hardware_concurrency());
+    print_log("  лексер %8.2f мс, разбор %8.2f мс, вычисление %8.2f мс\n",
+              lex_time * 1e3, parse_time * 1e3, eval_time * 1e3);
+    print_log("  последовательно %8.2f мс, %9.0f строк/с\n", sequential * 1e3, n / sequential);
+    print_log("  конвейер        %8.2f мс, %9.0f строк/с, ускорение %.2fx%s\n",
+              pipelined * 1e3, n / pipelined, sequential / pipelined,
+              same ? "" : "  (РАСХОЖДЕНИЕ)");
+    if (!pipeline_useful()) print_log("  (меньше трёх потоков: сценарии выполняются без конвейера)\n");
+
+    free_container(expected);
+    cleanup_global_data(FirstIdent);
+    FirstIdent = saved;
+    lazy_enabled = saved_lazy;
+    free(lines);
 }
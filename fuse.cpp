@@ -0,0 +1,630 @@
+#include "lib.h"
+
+// Слияние цепочек поэлементных операций над матрицами.
+//
+// Обычный countRPN создает для каждого оператора полноразмерную временную
+// матрицу, и выражение вида a*2 + b/c - d упирается в пропускную способность
+// памяти. Здесь в ОПЗ находятся максимальные поддеревья из поэлементных операций
+// (+, -, унарный минус, умножение и деление на число, sin, cos, log, abs, pow, max, min),
+// каждое компилируется в короткую программу и выполняется одним проходом по
+// входным матрицам порциями по FUSE_TILE элементов, которые остаются в кэше.
+//
+// Арифметика совпадает с обычными функциями (a/c считается как a*(1/c), как в
+// matrix_scale), поэтому результат побитно тот же. Если цепочку нельзя слить
+// (разреженные или векторные операнды, матричное умножение, несовпадение
+// размеров) или при вычислении встретилась ошибка (log от неположительного
+// числа, ноль в отрицательной степени), fuse_eval возвращает NULL и цепочка
+// считается обычным путем, который и сообщит об ошибке.
+
+// Элементов в одной порции: буферы всех уровней стека помещаются в L1/L2
+#define FUSE_TILE 1024
+
+// Меньшие матрицы считаются обычным путем, временные массивы и так в кэше
+#define FUSE_MIN_ELEMENTS 4096
+
+// Наибольшая глубина стека программы
+#define FUSE_MAX_DEPTH 16
+
+typedef enum {
+    FI_INPUT,       // Входная матрица
+    FI_ADD,         // a + sign*b
+    FI_SCALE,       // a * value
+    FI_DIV,         // a / value, когда 1/value неточно
+    FI_UNARY,       // Поэлементная функция одного аргумента
+    FI_BINARY       // pow, max или min, число размножается на весь массив
+} FuseCode;
+
+typedef struct {
+    FuseCode code;
+    ElementwiseOp op;
+    const double *src;      // FI_INPUT: данные матрицы
+    double value;           // FI_SCALE: множитель, FI_DIV: делитель, FI_BINARY: числовой операнд
+    int scalar_side;        // FI_BINARY: 0 - оба массивы, 1 - число слева, 2 - справа
+} FuseInstr;
+
+typedef struct {
+    FuseInstr *code;
+    int count;
+    int depth;
+    int inputs;
+    int rows, cols;
+} FuseProgram;
+
+static int fusion_enabled = 1;
+
+
+// Поэлементные функции, которые можно включить в цепочку
+typedef struct {
+    const char *name;
+    int arg_count;
+    ElementwiseOp op;
+} FuseFunction;
+
+static const FuseFunction fuse_functions[] = {
+    {"sin", 1, EW_SIN},
+    {"cos", 1, EW_COS},
+    {"log", 1, EW_LOG},
+    {"abs", 1, EW_ABS},
+    {"pow", 2, EW_POW},
+    {"max", 2, EW_MAX},
+    {"min", 2, EW_MIN},
+    {NULL,  0, EW_SIN}
+};
+
+static const FuseFunction* find_fuse_function(const Token *t) {
+    if (t->type != TOK_FUNCTION) return NULL;
+    for (const FuseFunction *f = fuse_functions; f->name; f++) {
+        if (strcmp(f->name, t->value) == 0 && f->arg_count == t->arg_count) return f;
+    }
+    return NULL;
+}
+
+// Сколько значений снимает со стека токен ОПЗ (-1 для операнда)
+int token_arity(const Token *t) {
+    switch (t->type) {
+        case TOK_NUMBER:
+        case TOK_IDENT:
+        case TOK_STRING:
+        case TOK_PARAM:
+            return -1;
+        case TOK_UMINUS:
+            return 1;
+        case TOK_PLUS:
+        case TOK_MINUS:
+        case TOK_MULTIPLY:
+        case TOK_DIVIDE:
+        case TOK_ASSIGN:
+            return 2;
+        default:
+            return t->arg_count;
+    }
+}
+
+static int token_fusable(const Token *t) {
+    switch (t->type) {
+        case TOK_NUMBER:
+        case TOK_IDENT:
+        case TOK_PARAM:
+        case TOK_UMINUS:
+        case TOK_PLUS:
+        case TOK_MINUS:
+        case TOK_MULTIPLY:
+        case TOK_DIVIDE:
+            return 1;
+        default:
+            return find_fuse_function(t) != NULL;
+    }
+}
+
+
+// Поиск максимальных цепочек: поддерево в ОПЗ - непрерывный отрезок токенов,
+// поэтому достаточно симулировать стек, храня для каждого значения начало его отрезка
+int fuse_find_chains(Token *head, FuseChain *chains, int max_chains) {
+    if (!fusion_enabled) return 0;
+
+    typedef struct {
+        Token *start;
+        Token *end;
+        int fusable;
+        int ops;
+    } Entry;
+
+    int capacity = 0;
+    for (Token *t = head; t; t = t->next) capacity++;
+    Entry *stack = (Entry*)malloc((size_t)(capacity > 0 ? capacity : 1) * sizeof(Entry));
+    if (!stack) return 0;
+
+    int top = 0, found = 0;
+    for (Token *t = head; t; t = t->next) {
+        int arity = token_arity(t);
+        if (arity < 0) {
+            stack[top].start = t;
+            stack[top].end = t;
+            stack[top].fusable = token_fusable(t);
+            stack[top].ops = 0;
+            top++;
+            continue;
+        }
+        if (arity > top) {
+            free(stack);
+            return 0;
+        }
+
+        int fusable = token_fusable(t);
+        int ops = 1;
+        for (int i = top - arity; i < top; i++) {
+            fusable = fusable && stack[i].fusable;
+            ops += stack[i].ops;
+        }
+
+        // Слитый операнд несливаемого оператора - законченная цепочка
+        for (int i = top - arity; !fusable && i < top; i++) {
+            if (stack[i].fusable && stack[i].ops >= 2 && found < max_chains) {
+                chains[found].start = stack[i].start;
+                chains[found].end = stack[i].end;
+                found++;
+            }
+        }
+
+        Token *start = arity > 0 ? stack[top - arity].start : t;
+        top -= arity;
+        stack[top].start = start;
+        stack[top].end = t;
+        stack[top].fusable = fusable;
+        stack[top].ops = fusable ? ops : 0;
+        top++;
+    }
+
+    for (int i = 0; i < top; i++) {
+        if (stack[i].fusable && stack[i].ops >= 2 && found < max_chains) {
+            chains[found].start = stack[i].start;
+            chains[found].end = stack[i].end;
+            found++;
+        }
+    }
+
+    free(stack);
+    return found;
+}
+
+FuseChain* fuse_chain_at(FuseChain *chains, int count, const Token *token) {
+    for (int i = 0; i < count; i++) {
+        if (chains[i].start == token) return &chains[i];
+    }
+    return NULL;
+}
+
+
+// Значение на стеке компиляции: число или массив, вычисляемый программой
+typedef struct {
+    int is_array;
+    double value;
+} FuseValue;
+
+static double fold_unary(ElementwiseOp op, double x) {
+    switch (op) {
+        case EW_SIN: return sin(x);
+        case EW_COS: return cos(x);
+        case EW_LOG: return log(x);
+        default:     return fabs(x);
+    }
+}
+
+// Тем же ядром, что и массивы, чтобы pow(2, 3) совпадало с обычным путем
+static double fold_pow(double x, double e) {
+    double r;
+    kernels->binary[EW_POW - EW_POW](&x, 0, &e, 0, &r, 1);
+    return r;
+}
+
+static int add_instr(FuseProgram *prog, FuseCode code, int *top) {
+    FuseInstr *in = &prog->code[prog->count++];
+    memset(in, 0, sizeof(*in));
+    in->code = code;
+    if (*top > prog->depth) prog->depth = *top;
+    return prog->count - 1;
+}
+
+// Компиляция цепочки. Числовые подвыражения сворачиваются сразу, в программу
+// попадают только операции над массивами. Возвращает 0, если цепочку нельзя слить
+static int fuse_compile(const FuseChain *chain, Container **slots, FuseProgram *prog) {
+    int capacity = 0;
+    for (Token *t = chain->start; ; t = t->next) {
+        capacity++;
+        if (t == chain->end) break;
+    }
+
+    prog->code = (FuseInstr*)malloc((size_t)capacity * sizeof(FuseInstr));
+    FuseValue *stack = (FuseValue*)malloc((size_t)capacity * sizeof(FuseValue));
+    if (!prog->code || !stack) {
+        free(prog->code);
+        free(stack);
+        return 0;
+    }
+    prog->count = 0;
+    prog->depth = 0;
+    prog->inputs = 0;
+    prog->rows = prog->cols = 0;
+
+    int top = 0;        // Стек компиляции
+    int arrays = 0;     // Массивов на стеке программы
+    int ok = 1;
+
+    for (Token *t = chain->start; ok; t = t->next) {
+        if (t->type == TOK_NUMBER || t->type == TOK_IDENT || t->type == TOK_PARAM) {
+            Container *c = t->container;
+            if (t->type == TOK_IDENT) {
+                Ident *ident = find_ident(FirstIdent, t->value);
+                c = ident && ident->value ? ident->value->container : NULL;
+            } else if (t->type == TOK_PARAM) {
+                c = slots ? slots[t->arg_count] : NULL;
+            }
+            if (!c) {
+                ok = 0;
+            } else if (c->type == CT_INT || c->type == CT_FLOAT) {
+                stack[top].is_array = 0;
+                stack[top].value = container_to_double(c);
+                top++;
+            } else if (c->type == CT_MATRIX) {
+                MatrixContainer *m = (MatrixContainer*)c->data;
+                if (prog->inputs == 0) {
+                    prog->rows = m->rows;
+                    prog->cols = m->cols;
+                } else if (m->rows != prog->rows || m->cols != prog->cols) {
+                    ok = 0;
+                }
+                arrays++;
+                int k = add_instr(prog, FI_INPUT, &arrays);
+                prog->code[k].src = m->data;
+                prog->inputs++;
+                stack[top++].is_array = 1;
+            } else {
+                ok = 0;
+            }
+        } else if (t->type == TOK_UMINUS) {
+            FuseValue *a = &stack[top - 1];
+            if (a->is_array) {
+                int k = add_instr(prog, FI_SCALE, &arrays);
+                prog->code[k].value = -1.0;
+            } else {
+                a->value = -a->value;
+            }
+        } else if (t->type == TOK_PLUS || t->type == TOK_MINUS) {
+            FuseValue *a = &stack[top - 2], *b = &stack[top - 1];
+            double sign = t->type == TOK_PLUS ? 1.0 : -1.0;
+            if (a->is_array && b->is_array) {
+                int k = add_instr(prog, FI_ADD, &arrays);
+                prog->code[k].value = sign;
+                arrays--;
+            } else if (!a->is_array && !b->is_array) {
+                a->value = sign > 0 ? a->value + b->value : a->value - b->value;
+            } else {
+                ok = 0;     // Матрица и число не складываются
+            }
+            top--;
+        } else if (t->type == TOK_MULTIPLY || t->type == TOK_DIVIDE) {
+            FuseValue *a = &stack[top - 2], *b = &stack[top - 1];
+            int divide = t->type == TOK_DIVIDE;
+            if (!b->is_array && divide && b->value == 0.0) {
+                ok = 0;
+            } else if (a->is_array && b->is_array) {
+                ok = 0;     // Матричное умножение не поэлементное
+            } else if (a->is_array || b->is_array) {
+                if (divide && b->is_array) {
+                    ok = 0;
+                } else {
+                    double s = a->is_array ? b->value : a->value;
+                    if (divide && reciprocal_exact(s)) {
+                        divide = 0;
+                        s = 1.0 / s;
+                    }
+                    int k = add_instr(prog, divide ? FI_DIV : FI_SCALE, &arrays);
+                    prog->code[k].value = s;
+                    a->is_array = 1;
+                }
+            } else {
+                a->value = divide ? a->value / b->value : a->value * b->value;
+            }
+            top--;
+        } else {
+            const FuseFunction *f = find_fuse_function(t);
+            if (f->arg_count == 1) {
+                FuseValue *a = &stack[top - 1];
+                if (a->is_array) {
+                    int k = add_instr(prog, FI_UNARY, &arrays);
+                    prog->code[k].op = f->op;
+                } else if (f->op == EW_LOG && !(a->value > 0)) {
+                    ok = 0;
+                } else {
+                    a->value = fold_unary(f->op, a->value);
+                }
+            } else {
+                FuseValue *a = &stack[top - 2], *b = &stack[top - 1];
+                if (a->is_array || b->is_array) {
+                    if (f->op == EW_POW && !a->is_array && a->value == 0.0) {
+                        ok = 0;     // Знаки показателя проверит обычный путь
+                    } else {
+                        int k = add_instr(prog, FI_BINARY, &arrays);
+                        prog->code[k].op = f->op;
+                        prog->code[k].scalar_side = !a->is_array ? 1 : !b->is_array ? 2 : 0;
+                        prog->code[k].value = !a->is_array ? a->value : b->value;
+                        if (a->is_array && b->is_array) arrays--;
+                        a->is_array = 1;
+                    }
+                } else if (f->op == EW_POW) {
+                    if (a->value == 0 && b->value < 0) ok = 0;
+                    else a->value = fold_pow(a->value, b->value);
+                } else if (f->op == EW_MAX) {
+                    a->value = a->value > b->value ? a->value : b->value;
+                } else {
+                    a->value = a->value < b->value ? a->value : b->value;
+                }
+                top--;
+            }
+        }
+        if (t == chain->end) break;
+    }
+
+    ok = ok && top == 1 && stack[0].is_array && prog->depth < FUSE_MAX_DEPTH &&
+         (size_t)prog->rows * prog->cols >= FUSE_MIN_ELEMENTS;
+    free(stack);
+    if (!ok) {
+        free(prog->code);
+        prog->code = NULL;
+    }
+    return ok;
+}
+
+
+// Выполнение программы на одной порции [t0, t0 + len). Буферы slot[0..depth-1]
+// соответствуют уровням стека, slot[depth] - запасной для функций, которым
+// нельзя писать на место аргумента. Последняя команда пишет сразу в результат
+static int run_tile(const FuseProgram *prog, size_t t0, int len, double **slot, double *out) {
+    const double *stack[FUSE_MAX_DEPTH];
+    int top = 0;
+
+    for (int k = 0; k < prog->count; k++) {
+        const FuseInstr *in = &prog->code[k];
+        int last = k == prog->count - 1;
+
+        switch (in->code) {
+            case FI_INPUT:
+                stack[top++] = in->src + t0;
+                break;
+
+            case FI_ADD: {
+                const double *a = stack[top - 2], *b = stack[top - 1];
+                double *y = last ? out : slot[top - 2];
+                double sign = in->value;
+                #pragma omp simd
+                for (int i = 0; i < len; i++) y[i] = a[i] + sign * b[i];
+                stack[--top - 1] = y;
+                break;
+            }
+
+            case FI_SCALE: {
+                const double *a = stack[top - 1];
+                double *y = last ? out : slot[top - 1];
+                double s = in->value;
+                #pragma omp simd
+                for (int i = 0; i < len; i++) y[i] = a[i] * s;
+                stack[top - 1] = y;
+                break;
+            }
+
+            case FI_DIV: {
+                const double *a = stack[top - 1];
+                double *y = last ? out : slot[top - 1];
+                double d = in->value;
+                #pragma omp simd
+                for (int i = 0; i < len; i++) y[i] = a[i] / d;
+                stack[top - 1] = y;
+                break;
+            }
+
+            case FI_UNARY: {
+                const double *a = stack[top - 1];
+                if (in->op == EW_LOG) {
+                    for (int i = 0; i < len; i++) {
+                        if (!(a[i] > 0)) return 0;
+                    }
+                }
+                double *y = last ? out : slot[prog->depth];
+                kernels->unary[in->op](a, y, len);
+                if (!last) {
+                    slot[prog->depth] = slot[top - 1];
+                    slot[top - 1] = y;
+                }
+                stack[top - 1] = y;
+                break;
+            }
+
+            case FI_BINARY: {
+                const double *a, *b;
+                int sa = 1, sb = 1;
+                if (in->scalar_side == 1) {
+                    a = &in->value;
+                    sa = 0;
+                    b = stack[top - 1];
+                } else if (in->scalar_side == 2) {
+                    a = stack[top - 1];
+                    b = &in->value;
+                    sb = 0;
+                } else {
+                    a = stack[top - 2];
+                    b = stack[--top];
+                }
+                if (in->op == EW_POW) {
+                    for (int i = 0; i < len; i++) {
+                        if (a[i * sa] == 0.0 && b[i * sb] < 0.0) return 0;
+                    }
+                }
+                // pow перечитывает аргумент после записи, ему нужен запасной буфер
+                int spare = in->op == EW_POW && !last;
+                double *y = last ? out : spare ? slot[prog->depth] : slot[top - 1];
+                kernels->binary[in->op - EW_POW](a, sa, b, sb, y, len);
+                if (spare) {
+                    slot[prog->depth] = slot[top - 1];
+                    slot[top - 1] = y;
+                }
+                stack[top - 1] = y;
+                break;
+            }
+        }
+    }
+    return 1;
+}
+
+static Container* fuse_run(const FuseProgram *prog) {
+    Container *result = create_matrix_container(prog->rows, prog->cols);
+    if (!result) return NULL;
+    double *out = ((MatrixContainer*)result->data)->data;
+
+    size_t n = (size_t)prog->rows * prog->cols;
+    int tiles = (int)((n + FUSE_TILE - 1) / FUSE_TILE);
+    int failed = 0;
+
+    #pragma omp parallel if(n > PARALLEL_MIN_WORK)
+    {
+        double *buffers = (double*)malloc((size_t)(prog->depth + 1) * FUSE_TILE * sizeof(double));
+        double *slot[FUSE_MAX_DEPTH + 1];
+        for (int l = 0; l <= prog->depth; l++) slot[l] = buffers + (size_t)l * FUSE_TILE;
+
+        #pragma omp for schedule(static)
+        for (int t = 0; t < tiles; t++) {
+            int stop;
+            #pragma omp atomic read
+            stop = failed;
+            if (stop || !buffers) {
+                #pragma omp atomic write
+                failed = 1;
+                continue;
+            }
+
+            size_t t0 = (size_t)t * FUSE_TILE;
+            int len = (int)(n - t0 < FUSE_TILE ? n - t0 : FUSE_TILE);
+            if (!run_tile(prog, t0, len, slot, out + t0)) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+        }
+        free(buffers);
+    }
+
+    if (failed) {
+        free_container(result);
+        return NULL;
+    }
+    return result;
+}
+
+// Вычисление цепочки одним проходом; NULL - цепочку нужно считать обычным путем.
+// slots - значения параметров, если цепочка из тела функции пользователя
+Container* fuse_eval(const FuseChain *chain, Container **slots) {
+    FuseProgram prog;
+    if (!fuse_compile(chain, slots, &prog)) return NULL;
+    Container *result = fuse_run(&prog);
+    free(prog.code);
+    return result;
+}
+
+
+// Байт памяти на элемент результата. Без слияния каждая переменная сначала
+// копируется (чтение и запись), каждая операция читает свои массивы и пишет
+// временный; со слиянием входы читаются один раз и пишется только результат
+static void fuse_traffic(const FuseProgram *prog, int *before, int *after) {
+    int unfused = 0;
+    for (int k = 0; k < prog->count; k++) {
+        const FuseInstr *in = &prog->code[k];
+        switch (in->code) {
+            case FI_INPUT:  unfused += 16; break;
+            case FI_ADD:    unfused += 24; break;
+            case FI_BINARY: unfused += in->scalar_side ? 16 : 24; break;
+            default:        unfused += 16; break;
+        }
+    }
+    *before = unfused;
+    *after = (prog->inputs + 1) * 8;
+}
+
+// Среднее время вычисления разобранного выражения
+static double time_expression(Token *rpn) {
+    int reps = 1;
+    double elapsed;
+    while (1) {
+        double start = wall_time();
+        for (int r = 0; r < reps; r++) free_container(countRPN(rpn));
+        elapsed = wall_time() - start;
+        if (elapsed > 0.2 || reps >= (1 << 20)) break;
+        reps *= 2;
+    }
+    return elapsed / reps;
+}
+
+static void set_bench_matrix(const char *name, int n) {
+    Container *m = create_matrix_container(n, n);
+    if (!m) return;
+    MatrixContainer *mc = (MatrixContainer*)m->data;
+    for (size_t i = 0; i < (size_t)n * n; i++) mc->data[i] = rand_uniform() + 0.5;
+    add_ident(&FirstIdent, create_ident((char*)name, create_token_with_container(TOK_NUMBER, NULL, m)));
+}
+
+// Сравнение вычисления выражений с временными матрицами и одним проходом.
+// Переменные пользователя на время теста откладываются, кэш memo выключается:
+// иначе повторы меряют попадание, а результаты остаются в кэше после теста
+void fuse_benchmark(int n) {
+    static const char *expressions[] = {
+        "a*2 + b/c - d",
+        "sin(a)*0.5 + cos(b)*0.5 - d",
+        "max(a - b, d*0) + pow(a, 2)",
+        "pow(a, 0.5)*2 + pow(b, -1) - pow(d, 3)"
+    };
+
+    Ident *saved = FirstIdent;
+    FirstIdent = NULL;
+    int saved_memo = memo_enabled;
+    memo_enabled = 0;
+    set_bench_matrix("a", n);
+    set_bench_matrix("b", n);
+    set_bench_matrix("d", n);
+    add_ident(&FirstIdent, create_ident((char*)"c", create_token_with_container(TOK_NUMBER, NULL, create_float_container(3.0))));
+
+    print_log("Матрицы %dx%d, порция %d элементов\n", n, n, FUSE_TILE);
+    print_log("%-30s %9s %9s %11s %11s %7s\n", "выражение", "байт/эл.", "слитно", "время", "слитно", "ускор.");
+
+    for (size_t e = 0; e < sizeof(expressions) / sizeof(expressions[0]); e++) {
+        Token *tokens = lex(expressions[e]);
+        Token *rpn = tokens ? shuntingYard(tokens) : NULL;
+        FuseChain chain;
+        FuseProgram prog;
+        if (!rpn || fuse_find_chains(rpn, &chain, 1) != 1 || !fuse_compile(&chain, NULL, &prog)) {
+            print_log("%-30s не удалось слить\n", expressions[e]);
+            free_tokens(rpn);
+            free_tokens(tokens);
+            continue;
+        }
+        int before, after;
+        fuse_traffic(&prog, &before, &after);
+        free(prog.code);
+
+        fusion_enabled = 0;
+        double plain = time_expression(rpn);
+        Container *expected = countRPN(rpn);
+        fusion_enabled = 1;
+        double fused = time_expression(rpn);
+        Container *actual = countRPN(rpn);
+
+        print_log("%-30s %9d %9d %9.2f мс %9.2f мс %6.1fx%s\n", expressions[e], before, after,
+                  plain * 1e3, fused * 1e3, plain / fused,
+                  container_compare(expected, actual) ? "" : "  (РАСХОЖДЕНИЕ)");
+
+        free_container(expected);
+        free_container(actual);
+        free_tokens(rpn);
+        free_tokens(tokens);
+    }
+
+    cleanup_global_data(FirstIdent);
+    FirstIdent = saved;
+    memo_enabled = saved_memo;
+}
@@ -0,0 +1,568 @@
+#include "lib.h"
+
+// Параметры по умолчанию для итерационных методов
+#define KRYLOV_DEFAULT_TOL   1e-8
+#define KRYLOV_DEFAULT_MAXIT 1000
+
+// Размер подпространства перед перезапуском GMRES
+#define GMRES_RESTART 30
+
+typedef enum {
+    PRECOND_NONE,
+    PRECOND_JACOBI,
+    PRECOND_ILU0
+} PrecondType;
+
+// Предобусловливатель M ~ A
+typedef struct {
+    PrecondType type;
+    int n;
+    double *dinv;           // Обратная диагональ (Якоби)
+    SparseContainer *ilu;   // L (без единичной диагонали) и U в одной CSR-матрице (ILU(0))
+    int *diag;              // Позиция диагонального элемента в каждой строке ilu
+} Precond;
+
+// Оператор y = A*x для плотной или разреженной (CSR) матрицы
+typedef struct {
+    int n;
+    const MatrixContainer *dense;
+    SparseContainer *csr;
+    int owns_csr;
+} Operator;
+
+
+// Скалярное произведение
+static double vec_dot(const double *a, const double *b, int n) {
+    int chunks = (n + KERNEL_CHUNK - 1) / KERNEL_CHUNK;
+    double sum = 0.0;
+    #pragma omp parallel for reduction(+:sum) if(n > PARALLEL_MIN_WORK) schedule(static)
+    for (int c = 0; c < chunks; c++) {
+        int i0 = c * KERNEL_CHUNK;
+        sum += kernels->dot(a + i0, b + i0, n - i0 < KERNEL_CHUNK ? n - i0 : KERNEL_CHUNK);
+    }
+    return sum;
+}
+
+static void op_apply(const Operator *op, const double *x, double *y) {
+    if (op->csr) {
+        sparse_spmm(op->csr, x, 1, y);
+    } else {
+        gemm(op->n, 1, op->n, 1.0, op->dense->data, op->n, x, 1, 0.0, y, 1);
+    }
+}
+
+// r = b - A*x, возвращает |r|^2
+static double residual(const Operator *op, const double *b, const double *x, double *r) {
+    int n = op->n;
+    op_apply(op, x, r);
+
+    double rr = 0.0;
+    #pragma omp parallel for reduction(+:rr) if(n > PARALLEL_MIN_WORK) schedule(static)
+    for (int i = 0; i < n; i++) {
+        r[i] = b[i] - r[i];
+        rr += r[i] * r[i];
+    }
+    return rr;
+}
+
+
+static void precond_free(Precond *pc) {
+    free(pc->dinv);
+    free(pc->diag);
+    sparse_free(pc->ilu);
+}
+
+// Неполное LU-разложение без заполнения: портрет L и U совпадает с портретом A
+static int precond_ilu0(Precond *pc, const SparseContainer *a) {
+    int n = a->rows;
+    SparseContainer *f = sparse_convert(a, SP_CSR);
+    int *diag = (int*)malloc((size_t)n * sizeof(int));
+    int *pos = (int*)malloc((size_t)n * sizeof(int));
+    if (!f || !diag || !pos) {
+        sparse_free(f);
+        free(diag);
+        free(pos);
+        return 0;
+    }
+
+    for (int i = 0; i < n; i++) {
+        diag[i] = -1;
+        pos[i] = -1;
+        for (int p = f->ptr[i]; p < f->ptr[i + 1]; p++) {
+            if (f->idx[p] == i) diag[i] = p;
+        }
+        if (diag[i] < 0 || f->val[diag[i]] == 0.0) {
+            print_log("ILU(0): нулевой диагональный элемент в строке %d\n", i);
+            sparse_free(f);
+            free(diag);
+            free(pos);
+            return 0;
+        }
+    }
+
+    // Вариант IKJ: строка i исключается предыдущими строками k < i внутри своего портрета
+    for (int i = 1; i < n; i++) {
+        for (int p = f->ptr[i]; p < f->ptr[i + 1]; p++) pos[f->idx[p]] = p;
+
+        for (int p = f->ptr[i]; p < f->ptr[i + 1] && f->idx[p] < i; p++) {
+            int k = f->idx[p];
+            double lik = f->val[p] / f->val[diag[k]];
+            f->val[p] = lik;
+            for (int q = diag[k] + 1; q < f->ptr[k + 1]; q++) {
+                int j = f->idx[q];
+                if (pos[j] >= 0) f->val[pos[j]] -= lik * f->val[q];
+            }
+        }
+
+        for (int p = f->ptr[i]; p < f->ptr[i + 1]; p++) pos[f->idx[p]] = -1;
+        if (f->val[diag[i]] == 0.0) {
+            print_log("ILU(0): нулевой ведущий элемент в строке %d\n", i);
+            sparse_free(f);
+            free(diag);
+            free(pos);
+            return 0;
+        }
+    }
+
+    free(pos);
+    pc->ilu = f;
+    pc->diag = diag;
+    return 1;
+}
+
+// Построение предобусловливателя по матрице оператора
+static int precond_init(Precond *pc, PrecondType type, const Operator *op) {
+    int n = op->n;
+    pc->type = type;
+    pc->n = n;
+    pc->dinv = NULL;
+    pc->ilu = NULL;
+    pc->diag = NULL;
+
+    if (type == PRECOND_JACOBI) {
+        pc->dinv = (double*)malloc((size_t)n * sizeof(double));
+        for (int i = 0; i < n; i++) {
+            double d = 0.0;
+            if (op->csr) {
+                for (int p = op->csr->ptr[i]; p < op->csr->ptr[i + 1]; p++) {
+                    if (op->csr->idx[p] == i) d += op->csr->val[p];
+                }
+            } else {
+                d = op->dense->data[(size_t)i * n + i];
+            }
+            if (d == 0.0) {
+                print_log("Якоби: нулевой диагональный элемент в строке %d\n", i);
+                precond_free(pc);
+                return 0;
+            }
+            pc->dinv[i] = 1.0 / d;
+        }
+    } else if (type == PRECOND_ILU0) {
+        if (op->csr) return precond_ilu0(pc, op->csr);
+
+        SparseContainer *sp = sparse_from_dense(op->dense);
+        int ok = sp && precond_ilu0(pc, sp);
+        sparse_free(sp);
+        return ok;
+    }
+    return 1;
+}
+
+// z = M^-1 * r
+static void precond_apply(const Precond *pc, const double *r, double *z) {
+    int n = pc->n;
+
+    if (pc->type == PRECOND_NONE) {
+        memcpy(z, r, (size_t)n * sizeof(double));
+        return;
+    }
+    if (pc->type == PRECOND_JACOBI) {
+        #pragma omp parallel for if(n > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < n; i++) z[i] = pc->dinv[i] * r[i];
+        return;
+    }
+
+    // Прямой ход с L и обратный с U (треугольные решения последовательны)
+    const SparseContainer *f = pc->ilu;
+    for (int i = 0; i < n; i++) {
+        double sum = r[i];
+        for (int p = f->ptr[i]; p < pc->diag[i]; p++) sum -= f->val[p] * z[f->idx[p]];
+        z[i] = sum;
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        double sum = z[i];
+        for (int p = pc->diag[i] + 1; p < f->ptr[i + 1]; p++) sum -= f->val[p] * z[f->idx[p]];
+        z[i] = sum / f->val[pc->diag[i]];
+    }
+}
+
+
+// Метод сопряженных градиентов с предобусловливанием (для SPD матриц)
+static int run_cg(const Operator *op, const Precond *pc, const double *b, double *x,
+                  double tol, int maxit, double bnorm, double *history) {
+    int n = op->n;
+    double *r = (double*)malloc((size_t)n * sizeof(double));
+    double *z = (double*)malloc((size_t)n * sizeof(double));
+    double *p = (double*)malloc((size_t)n * sizeof(double));
+    double *q = (double*)malloc((size_t)n * sizeof(double));
+
+    double rr = residual(op, b, x, r);
+    precond_apply(pc, r, z);
+    memcpy(p, z, (size_t)n * sizeof(double));
+    double rz = vec_dot(r, z, n);
+
+    int it = 0;
+    history[0] = sqrt(rr) / bnorm;
+    while (it < maxit && history[it] > tol) {
+        op_apply(op, p, q);
+        double alpha = rz / vec_dot(p, q, n);
+
+        // x += alpha*p, r -= alpha*q и |r|^2 за один проход
+        rr = 0.0;
+        #pragma omp parallel for reduction(+:rr) if(n > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < n; i++) {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * q[i];
+            rr += r[i] * r[i];
+        }
+
+        it++;
+        history[it] = sqrt(rr) / bnorm;
+        if (history[it] <= tol) break;
+
+        precond_apply(pc, r, z);
+        double rz_new = vec_dot(r, z, n);
+        double beta = rz_new / rz;
+        rz = rz_new;
+
+        #pragma omp parallel for if(n > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < n; i++) p[i] = z[i] + beta * p[i];
+    }
+
+    free(r);
+    free(z);
+    free(p);
+    free(q);
+    return it;
+}
+
+// Стабилизированный метод бисопряженных градиентов с правым предобусловливанием
+static int run_bicgstab(const Operator *op, const Precond *pc, const double *b, double *x,
+                        double tol, int maxit, double bnorm, double *history) {
+    int n = op->n;
+    double *r = (double*)malloc((size_t)n * sizeof(double));
+    double *r0 = (double*)malloc((size_t)n * sizeof(double));
+    double *p = (double*)calloc((size_t)n, sizeof(double));
+    double *v = (double*)calloc((size_t)n, sizeof(double));
+    double *ph = (double*)malloc((size_t)n * sizeof(double));
+    double *sh = (double*)malloc((size_t)n * sizeof(double));
+    double *t = (double*)malloc((size_t)n * sizeof(double));
+
+    double rr = residual(op, b, x, r);
+    memcpy(r0, r, (size_t)n * sizeof(double));
+    double rho = 1.0, alpha = 1.0, omega = 1.0;
+
+    int it = 0;
+    history[0] = sqrt(rr) / bnorm;
+    while (it < maxit && history[it] > tol) {
+        double rho_new = vec_dot(r0, r, n);
+        if (rho_new == 0.0 || omega == 0.0) {
+            print_log("bicgstab: метод прервался (rho = 0)\n");
+            break;
+        }
+        double beta = (rho_new / rho) * (alpha / omega);
+        rho = rho_new;
+
+        #pragma omp parallel for if(n > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < n; i++) p[i] = r[i] + beta * (p[i] - omega * v[i]);
+
+        precond_apply(pc, p, ph);
+        op_apply(op, ph, v);
+        alpha = rho / vec_dot(r0, v, n);
+
+        // s = r - alpha*v (хранится в r) и |s|^2
+        double ss = 0.0;
+        #pragma omp parallel for reduction(+:ss) if(n > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < n; i++) {
+            r[i] -= alpha * v[i];
+            ss += r[i] * r[i];
+        }
+
+        it++;
+        if (sqrt(ss) / bnorm <= tol) {
+            #pragma omp parallel for if(n > PARALLEL_MIN_WORK) schedule(static)
+            for (int i = 0; i < n; i++) x[i] += alpha * ph[i];
+            history[it] = sqrt(ss) / bnorm;
+            break;
+        }
+
+        precond_apply(pc, r, sh);
+        op_apply(op, sh, t);
+
+        // (t, s) и (t, t) за один проход
+        double ts = 0.0, tt = 0.0;
+        #pragma omp parallel for reduction(+:ts, tt) if(n > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < n; i++) {
+            ts += t[i] * r[i];
+            tt += t[i] * t[i];
+        }
+        omega = tt > 0.0 ? ts / tt : 0.0;
+
+        // x += alpha*ph + omega*sh, r = s - omega*t и |r|^2
+        rr = 0.0;
+        #pragma omp parallel for reduction(+:rr) if(n > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < n; i++) {
+            x[i] += alpha * ph[i] + omega * sh[i];
+            r[i] -= omega * t[i];
+            rr += r[i] * r[i];
+        }
+        history[it] = sqrt(rr) / bnorm;
+    }
+
+    free(r);
+    free(r0);
+    free(p);
+    free(v);
+    free(ph);
+    free(sh);
+    free(t);
+    return it;
+}
+
+// GMRES с перезапуском, правым предобусловливанием и вращениями Гивенса
+static int run_gmres(const Operator *op, const Precond *pc, const double *b, double *x,
+                     double tol, int maxit, double bnorm, double *history) {
+    int n = op->n;
+    int m = GMRES_RESTART < n ? GMRES_RESTART : n;
+    double *V = (double*)malloc((size_t)(m + 1) * n * sizeof(double));
+    double *H = (double*)calloc((size_t)(m + 1) * m, sizeof(double));
+    double *cs = (double*)malloc((size_t)m * sizeof(double));
+    double *sn = (double*)malloc((size_t)m * sizeof(double));
+    double *g = (double*)malloc((size_t)(m + 1) * sizeof(double));
+    double *y = (double*)malloc((size_t)m * sizeof(double));
+    double *w = (double*)malloc((size_t)n * sizeof(double));
+    double *z = (double*)malloc((size_t)n * sizeof(double));
+
+    int it = 0;
+    double rr = residual(op, b, x, V);
+    history[0] = sqrt(rr) / bnorm;
+
+    while (it < maxit && history[it] > tol) {
+        double beta = sqrt(rr);
+        #pragma omp parallel for if(n > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < n; i++) V[i] /= beta;
+        for (int i = 0; i <= m; i++) g[i] = 0.0;
+        g[0] = beta;
+
+        int j = 0;
+        for (; j < m && it < maxit; j++) {
+            double *vj = V + (size_t)j * n;
+            double *vn = V + (size_t)(j + 1) * n;
+            precond_apply(pc, vj, z);
+            op_apply(op, z, vn);
+
+            // Модифицированный процесс Грама-Шмидта
+            for (int i = 0; i <= j; i++) {
+                const double *vi = V + (size_t)i * n;
+                double h = vec_dot(vn, vi, n);
+                H[(size_t)i * m + j] = h;
+                #pragma omp parallel for if(n > PARALLEL_MIN_WORK) schedule(static)
+                for (int k = 0; k < n; k++) vn[k] -= h * vi[k];
+            }
+            double hn = sqrt(vec_dot(vn, vn, n));
+            H[(size_t)(j + 1) * m + j] = hn;
+            if (hn > 0.0) {
+                #pragma omp parallel for if(n > PARALLEL_MIN_WORK) schedule(static)
+                for (int k = 0; k < n; k++) vn[k] /= hn;
+            }
+
+            // Приведение нового столбца H к треугольному виду
+            for (int i = 0; i < j; i++) {
+                double a = H[(size_t)i * m + j];
+                double c = H[(size_t)(i + 1) * m + j];
+                H[(size_t)i * m + j] = cs[i] * a + sn[i] * c;
+                H[(size_t)(i + 1) * m + j] = -sn[i] * a + cs[i] * c;
+            }
+            double a = H[(size_t)j * m + j];
+            double c = H[(size_t)(j + 1) * m + j];
+            double rho = sqrt(a * a + c * c);
+            cs[j] = rho > 0.0 ? a / rho : 1.0;
+            sn[j] = rho > 0.0 ? c / rho : 0.0;
+            H[(size_t)j * m + j] = rho;
+            H[(size_t)(j + 1) * m + j] = 0.0;
+            g[j + 1] = -sn[j] * g[j];
+            g[j] = cs[j] * g[j];
+
+            it++;
+            history[it] = fabs(g[j + 1]) / bnorm;
+            if (history[it] <= tol || hn == 0.0) {
+                j++;
+                break;
+            }
+        }
+
+        // y = H^-1 * g, x += M^-1 * V * y
+        for (int i = j - 1; i >= 0; i--) {
+            double sum = g[i];
+            for (int k = i + 1; k < j; k++) sum -= H[(size_t)i * m + k] * y[k];
+            y[i] = H[(size_t)i * m + i] != 0.0 ? sum / H[(size_t)i * m + i] : 0.0;
+        }
+        #pragma omp parallel for if(n > PARALLEL_MIN_WORK) schedule(static)
+        for (int k = 0; k < n; k++) {
+            double sum = 0.0;
+            for (int i = 0; i < j; i++) sum += V[(size_t)i * n + k] * y[i];
+            w[k] = sum;
+        }
+        precond_apply(pc, w, z);
+        #pragma omp parallel for if(n > PARALLEL_MIN_WORK) schedule(static)
+        for (int k = 0; k < n; k++) x[k] += z[k];
+
+        // Истинная невязка для перезапуска
+        rr = residual(op, b, x, V);
+        history[it] = sqrt(rr) / bnorm;
+    }
+
+    free(V);
+    free(H);
+    free(cs);
+    free(sn);
+    free(g);
+    free(y);
+    free(w);
+    free(z);
+    return it;
+}
+
+
+typedef int (*KrylovMethod)(const Operator*, const Precond*, const double*, double*,
+                            double, int, double, double*);
+
+// Общая часть cg/bicgstab/gmres: разбор аргументов (A, b [, tol [, maxit [, "jacobi"|"ilu"]]])
+// и сборка результата (x, число итераций, история относительных невязок)
+static Container* krylov_call(Container** args, int arg_count, const char *name, KrylovMethod method) {
+    if (arg_count < 2 || arg_count > 5) {
+        print_log("%s: ожидается от 2 до 5 аргументов: A, b, tol, maxit, предобусловливатель\n", name);
+        return NULL;
+    }
+    for (int i = 0; i < arg_count; i++) {
+        if (!args[i]) return NULL;
+    }
+    if (args[0]->type != CT_MATRIX && args[0]->type != CT_SPARSE) {
+        print_log("%s: первый аргумент должен быть матрицей\n", name);
+        return NULL;
+    }
+
+    double tol = KRYLOV_DEFAULT_TOL;
+    int maxit = KRYLOV_DEFAULT_MAXIT;
+    PrecondType pc_type = PRECOND_NONE;
+
+    if (arg_count >= 3) {
+        if (!container_is_scalar(args[2]) || container_to_double(args[2]) <= 0.0) {
+            print_log("%s: точность должна быть положительным числом\n", name);
+            return NULL;
+        }
+        tol = container_to_double(args[2]);
+    }
+    if (arg_count >= 4) {
+        if (!container_is_scalar(args[3]) || container_to_double(args[3]) < 1) {
+            print_log("%s: число итераций должно быть натуральным\n", name);
+            return NULL;
+        }
+        maxit = (int)container_to_double(args[3]);
+    }
+    if (arg_count == 5) {
+        const char *pc_name = args[4]->type == CT_STRING ? ((StringContainer*)args[4]->data)->value : "";
+        if (strcmp(pc_name, "jacobi") == 0) pc_type = PRECOND_JACOBI;
+        else if (strcmp(pc_name, "ilu") == 0) pc_type = PRECOND_ILU0;
+        else if (strcmp(pc_name, "none") != 0) {
+            print_log("%s: предобусловливатель должен быть \"none\", \"jacobi\" или \"ilu\"\n", name);
+            return NULL;
+        }
+    }
+
+    Operator op;
+    op.dense = NULL;
+    op.csr = NULL;
+    op.owns_csr = 0;
+    if (args[0]->type == CT_SPARSE) {
+        SparseContainer *sp = (SparseContainer*)args[0]->data;
+        op.n = sp->rows;
+        if (sp->rows != sp->cols) {
+            print_log("%s: матрица %dx%d не квадратная\n", name, sp->rows, sp->cols);
+            return NULL;
+        }
+        // Для многократных умножений CSC выгоднее один раз перевести в CSR
+        if (sp->format == SP_CSR) {
+            op.csr = sp;
+        } else {
+            op.csr = sparse_convert(sp, SP_CSR);
+            op.owns_csr = 1;
+            if (!op.csr) return NULL;
+        }
+    } else {
+        op.dense = (MatrixContainer*)args[0]->data;
+        op.n = op.dense->rows;
+        if (op.dense->rows != op.dense->cols) {
+            print_log("%s: матрица %dx%d не квадратная\n", name, op.dense->rows, op.dense->cols);
+            return NULL;
+        }
+    }
+    int n = op.n;
+
+    int count;
+    double *b = container_values(args[1], &count);
+    Container *x = b ? create_matrix_container(n, 1) : NULL;
+    Container *hist = create_matrix_container(maxit + 1, 1);
+    Precond pc;
+    int pc_ready = 0;
+
+    Container *result = NULL;
+    if (!b || count != n) {
+        print_log("%s: правая часть должна быть вектором длины %d\n", name, n);
+    } else if (x && hist && (pc_ready = precond_init(&pc, pc_type, &op))) {
+        double *xv = ((MatrixContainer*)x->data)->data;
+        double *hv = ((MatrixContainer*)hist->data)->data;
+        double bnorm = sqrt(vec_dot(b, b, n));
+
+        int iterations = 0;
+        if (bnorm > 0.0) {
+            iterations = method(&op, &pc, b, xv, tol, maxit, bnorm, hv);
+            if (hv[iterations] > tol) {
+                print_log("%s: не сошелся за %d итераций, относительная невязка %g\n",
+                          name, iterations, hv[iterations]);
+            }
+        }
+        ((MatrixContainer*)hist->data)->rows = iterations + 1;
+
+        Container *items[3];
+        items[0] = x;
+        items[1] = create_int_container(iterations);
+        items[2] = hist;
+        if (args[1]->type == CT_VECTOR && n == 3) {
+            items[0] = create_vector_container(xv[0], xv[1], xv[2]);
+            free_container(x);
+        }
+        result = create_list_container(3, items);
+        x = NULL;
+        hist = NULL;
+    }
+
+    if (pc_ready) precond_free(&pc);
+    if (op.owns_csr) sparse_free(op.csr);
+    free(b);
+    free_container(x);
+    free_container(hist);
+    return result;
+}
+
+Container* cg_func(Container** args, int arg_count) {
+    return krylov_call(args, arg_count, "cg", run_cg);
+}
+
+Container* bicgstab_func(Container** args, int arg_count) {
+    return krylov_call(args, arg_count, "bicgstab", run_bicgstab);
+}
+
+Container* gmres_func(Container** args, int arg_count) {
+    return krylov_call(args, arg_count, "gmres", run_gmres);
+}
@@ -0,0 +1,310 @@
+#include "lib.h"
+
+// Отложенные вычисления переменных.
+//
+// Присваивание с подавленным выводом "x = выражение;" можно не считать сразу:
+// переменная хранит выражение в ОПЗ (поле lazy), а значение вычисляется при
+// первом чтении через find_ident. Если переменную перезапишут раньше, выражение
+// выбрасывается и не считается вовсе. Так делает сценарий (execute_from_file)
+// для присваиваний, которые перезаписываются до чтения, и режим "lazy on" для
+// всех таких присваиваний.
+//
+// Выражение читает другие переменные по имени, поэтому перед записью в
+// переменную вычисляются все отложенные выражения, которые её читают: результат
+// совпадает с немедленным вычислением. Откладываются только выражения, которые
+// не могут завершиться ошибкой: выброшенное выражение ничего не напечатало бы,
+// а немедленное напечатало бы ошибку. Проверка (shape_infer) проходит выражение
+// по формам значений: числа, векторы и матрицы из существующих переменных (или
+// отложенных, тогда по их выражению), +, - и * с подходящими размерами, унарный
+// минус, sin, cos и abs. Деление, log, pow, индексы, литералы, вызовы других
+// функций, чтение ans или самой переменной и любые вычисления при лимите памяти
+// не откладываются. Перед сменой точности, набора инструкций или лимита памяти
+// отложенные выражения вычисляются.
+
+int lazy_enabled = 0;
+
+static unsigned long lazy_deferred = 0;     // Отложено присваиваний
+static unsigned long lazy_forced = 0;       // Из них вычислено при чтении
+static unsigned long lazy_dropped = 0;      // Выброшено без вычисления
+
+// Выражение читает переменную name
+int lazy_reads(const Token *rpn, const char *name) {
+    for (const Token *t = rpn; t; t = t->next) {
+        if (t->type == TOK_IDENT && strcmp(t->value, name) == 0) return 1;
+    }
+    return 0;
+}
+
+// Копия списка токенов
+static Token* copy_tokens(const Token *head) {
+    Token *first = NULL, *last = NULL;
+    for (const Token *t = head; t; t = t->next) {
+        Token *copy = copy_token(t);
+        if (!copy) {
+            free_tokens(first);
+            return NULL;
+        }
+        copy->prev = last;
+        copy->next = NULL;
+        if (last) last->next = copy; else first = copy;
+        last = copy;
+    }
+    return first;
+}
+
+// Форма значения для проверки, что выражение не может завершиться ошибкой
+typedef enum { SHAPE_SCALAR, SHAPE_VECTOR, SHAPE_MATRIX } ShapeKind;
+
+typedef struct {
+    ShapeKind kind;
+    int rows, cols;         // Для SHAPE_MATRIX
+} Shape;
+
+#define LAZY_SHAPE_DEPTH 16     // Цепочка отложенных переменных, которую просматривает проверка
+
+static int shape_infer(const Token *body, int depth, Shape *out);
+
+// Форма числа, вектора или плотной матрицы двойной точности; 0 - другой тип
+static int shape_of_value(Container *c, Shape *out) {
+    if (container_is_scalar(c)) {
+        out->kind = SHAPE_SCALAR;
+        return 1;
+    }
+    if (c && c->type == CT_VECTOR) {
+        out->kind = SHAPE_VECTOR;
+        return 1;
+    }
+    if (c && c->type == CT_MATRIX) {
+        MatrixContainer *m = (MatrixContainer*)c->data;
+        out->kind = SHAPE_MATRIX;
+        out->rows = m->rows;
+        out->cols = m->cols;
+        return 1;
+    }
+    return 0;
+}
+
+// Форма результата операции; 0 - операция может напечатать ошибку
+static int shape_apply(const Token *t, Shape *args, int count, Shape *out) {
+    Shape a = args[0], b = count > 1 ? args[1] : args[0];
+    switch (t->type) {
+        case TOK_PLUS:
+        case TOK_MINUS:
+            // Сложение только одинаковых форм: число с матрицей - ошибка типов
+            if (a.kind != b.kind) return 0;
+            if (a.kind == SHAPE_MATRIX && (a.rows != b.rows || a.cols != b.cols)) return 0;
+            *out = a;
+            return 1;
+        case TOK_MULTIPLY:
+            if (a.kind == SHAPE_SCALAR) { *out = b; return 1; }
+            if (b.kind == SHAPE_SCALAR) { *out = a; return 1; }
+            if (a.kind == SHAPE_VECTOR && b.kind == SHAPE_VECTOR) {
+                out->kind = SHAPE_SCALAR;
+                return 1;
+            }
+            if (a.kind == SHAPE_MATRIX && b.kind == SHAPE_MATRIX && a.cols == b.rows) {
+                out->kind = SHAPE_MATRIX;
+                out->rows = a.rows;
+                out->cols = b.cols;
+                return 1;
+            }
+            return 0;
+        case TOK_UMINUS:
+            *out = a;
+            return 1;
+        case TOK_FUNCTION:
+            // Поэлементные функции без области определения
+            if (count != 1) return 0;
+            if (strcmp(t->value, "sin") == 0 || strcmp(t->value, "cos") == 0) {
+                if (a.kind == SHAPE_VECTOR) return 0;
+                *out = a;
+                return 1;
+            }
+            if (strcmp(t->value, "abs") == 0) {
+                if (a.kind == SHAPE_VECTOR) out->kind = SHAPE_SCALAR;
+                else *out = a;
+                return 1;
+            }
+            return 0;
+        default:
+            // Деление (ноль), log, pow, индексы, литералы матриц и прочее могут не сойтись
+            return 0;
+    }
+}
+
+// Форма значения выражения в ОПЗ, если его вычисление не может завершиться
+// ошибкой: читаются только существующие переменные, операции - из shape_apply
+static int shape_infer(const Token *body, int depth, Shape *out) {
+    if (depth > LAZY_SHAPE_DEPTH) return 0;
+    int length = 0;
+    for (const Token *t = body; t; t = t->next) length++;
+    Shape *stack = (Shape*)malloc((size_t)(length > 0 ? length : 1) * sizeof(Shape));
+    if (!stack) return 0;
+
+    int top = 0, ok = 1;
+    for (const Token *t = body; ok && t; t = t->next) {
+        int arity = token_arity(t);
+        if (t->type == TOK_NUMBER) {
+            ok = shape_of_value(t->container, &stack[top++]);
+        } else if (t->type == TOK_IDENT) {
+            Ident *ident = find_ident_slot(FirstIdent, t->value);
+            if (!ident) ok = 0;
+            else if (ident->lazy) ok = shape_infer(ident->lazy, depth + 1, &stack[top++]);
+            else ok = ident->value && shape_of_value(ident->value->container, &stack[top++]);
+        } else if (arity >= 1 && arity <= 2 && top >= arity) {
+            Shape result;
+            ok = shape_apply(t, stack + top - arity, arity, &result);
+            top -= arity;
+            stack[top++] = result;
+        } else {
+            ok = 0;
+        }
+    }
+    if (ok && top == 1) *out = stack[0];
+    else ok = 0;
+    free(stack);
+    return ok;
+}
+
+// Выражение можно вычислить позже с тем же результатом и тем же выводом
+static int deferrable(const Token *body, const char *target) {
+    if (mem_limited()) return 0;
+    if (lazy_reads(body, target) || lazy_reads(body, "ans")) return 0;
+    Shape shape;
+    return shape_infer(body, 0, &shape);
+}
+
+// Записать отложенное выражение в переменную (или ans) вместо значения
+static void install(const char *name, Token *body) {
+    Ident *ident = find_ident_slot(FirstIdent, name);
+    if (!ident) {
+        ident = create_ident((char*)name, NULL);
+        add_ident(&FirstIdent, ident);
+    } else {
+        lazy_drop(ident);
+        if (ident->value) free_token(ident->value);
+        ident->value = NULL;
+    }
+    ident->lazy = body;
+}
+
+// Отложить присваивание "x = выражение" в ОПЗ: x ... =. Возвращает 1, если
+// ОПЗ забрана (освобождать её не нужно), 0 - если выражение надо считать сразу
+int lazy_defer(Token *rpn) {
+    if (!rpn || rpn->type != TOK_IDENT || !rpn->next) return 0;
+
+    Token *assign = rpn->next;
+    while (assign->next) assign = assign->next;
+    Token *body = rpn->next;
+    if (assign->type != TOK_ASSIGN || body == assign) return 0;
+
+    // Отрезаем выражение от имени и знака присваивания
+    assign->prev->next = NULL;
+    if (!deferrable(body, rpn->value)) {
+        assign->prev->next = assign;
+        return 0;
+    }
+    Token *ans = copy_tokens(body);
+    if (!ans) {
+        assign->prev->next = assign;
+        return 0;
+    }
+    body->prev = NULL;
+
+    // Прежнее значение ans заменяется, вычислять его незачем
+    Ident *old_ans = find_ident_slot(FirstIdent, "ans");
+    if (old_ans) lazy_drop(old_ans);
+
+    // Старое значение x ещё нужно отложенным выражениям, которые его читают
+    lazy_invalidate(rpn->value);
+    install(rpn->value, body);
+
+    // ans получает то же выражение: строка без вывода всё равно меняет ans
+    install("ans", ans);
+
+    lazy_deferred++;
+    free_token(rpn);
+    free_token(assign);
+    return 1;
+}
+
+// Вычислить отложенное значение; при ошибке переменная удаляется
+Ident* lazy_force(Ident *ident) {
+    Token *body = ident->lazy;
+    if (!body) return ident;
+    ident->lazy = NULL;
+
+    Container *result = countRPN(body);
+    free_tokens(body);
+    if (!result) {
+        print_log("Ошибка в отложенном вычислении %s\n", ident->name);
+        remove_ident(&FirstIdent, ident);
+        return NULL;
+    }
+    ident->value = create_token_with_container(TOK_NUMBER, NULL, result);
+    if (strcmp(ident->name, "ans") != 0) lazy_forced++;
+    return ident;
+}
+
+// Выбросить отложенное выражение (переменная перезаписывается)
+void lazy_drop(Ident *ident) {
+    if (!ident->lazy) return;
+    free_tokens(ident->lazy);
+    ident->lazy = NULL;
+    if (strcmp(ident->name, "ans") != 0) lazy_dropped++;
+}
+
+// Перед записью в name вычислить отложенные выражения, которые её читают
+void lazy_invalidate(const char *name) {
+    int again = 1;
+    while (again) {
+        again = 0;
+        for (Ident *ident = FirstIdent; ident; ident = ident->next) {
+            if (ident->lazy && lazy_reads(ident->lazy, name)) {
+                // Вычисление может удалить переменную из списка: обход заново
+                lazy_force(ident);
+                again = 1;
+                break;
+            }
+        }
+    }
+}
+
+// Вычислить все отложенные выражения: перед сменой режима сессии (precision,
+// isa, лимит памяти), чтобы они считались в том же режиме, что и немедленно
+void lazy_force_all() {
+    int again = 1;
+    while (again) {
+        again = 0;
+        for (Ident *ident = FirstIdent; ident; ident = ident->next) {
+            if (ident->lazy) {
+                lazy_force(ident);
+                again = 1;
+                break;
+            }
+        }
+    }
+}
+
+// Команда "lazy [on|off]": режим и счётчики отложенных присваиваний
+void lazy_command(const char *arg) {
+    while (arg != NULL && *arg == ' ') arg++;
+    if (arg != NULL && *arg != 0) {
+        if (strcmp(arg, "on") == 0) {
+            lazy_enabled = 1;
+        } else if (strcmp(arg, "off") == 0) {
+            lazy_enabled = 0;
+        } else {
+            print_log("lazy: неизвестный режим %s (on или off)\n", arg);
+            return;
+        }
+    }
+
+    int pending = 0;
+    for (Ident *ident = FirstIdent; ident; ident = ident->next) {
+        if (ident->lazy && strcmp(ident->name, "ans") != 0) pending++;
+    }
+    print_log("Отложенные вычисления: %s\n", lazy_enabled ? "включены" : "только в сценариях");
+    print_log("  отложено %lu, вычислено при чтении %lu, выброшено %lu, ожидают %d\n",
+              lazy_deferred, lazy_forced, lazy_dropped, pending);
+}
@@ -1,22 +1,22 @@
 #include "lib.h"
 
 
-//    
-static const char *src;
-static int pos = 0;
+// Состояние лексера; у каждого потока своё (сценарий разбирается в отдельном потоке)
+static thread_local const char *src;
+static thread_local int pos = 0;
 
 
-//     
+// Пропуск пробелов и управляющих символов
 void skip_whitespace() {
     while (src[pos] != '\0' && isspace((unsigned char)src[pos])) {
         pos++;
     }
 }
 
-//    
+// Чтение числа из строки
 char *read_number() {
     int start = pos;
-    //    ,   
+    // Считываем цифры и точку, если она есть
     while (isdigit((unsigned char)src[pos]) || src[pos] == '.') {
         pos++;
     }
@@ -27,7 +27,7 @@ char *read_number() {
     return number;
 }
 
-//  
+// Чтение идентификатора
 char *read_identifier() {
     int start = pos;
     while (isalnum((unsigned char)src[pos]) || src[pos] == '_') {
@@ -40,7 +40,25 @@ char *read_identifier() {
     return ident;
 }
 
-// ,    
+// Чтение строкового литерала в кавычках (без самих кавычек)
+char *read_string() {
+    pos++; // открывающая кавычка
+    int start = pos;
+    while (src[pos] != '\0' && src[pos] != '"') {
+        pos++;
+    }
+    if (src[pos] != '"') {
+        return NULL;
+    }
+    int length = pos - start;
+    char *str = (char*)malloc(length + 1);
+    strncpy(str, &src[start], length);
+    str[length] = '\0';
+    pos++; // закрывающая кавычка
+    return str;
+}
+
+// Определение, является ли минус унарным
 int is_unary_minus(Token *last_token) {
 
     if (last_token == nullptr) {
@@ -56,13 +74,14 @@ int is_unary_minus(Token *last_token) {
         case TOK_LPAREN:
         case TOK_LBRACKET:
         case TOK_COMMA:
+        case TOK_COLON:
             return 1;
         default:
             return 0;
     }
 }
 
-//  
+//Функция лексического анализа
 Token *lex(const char *input) {
     src = input;
     pos = 0;
@@ -70,7 +89,7 @@ Token *lex(const char *input) {
     Token *head = nullptr;
     Token *tail = nullptr;
 
-    //   
+    // Последний добавленный токен
     Token *last_token = nullptr;
 
     while (src[pos] != '\0') {
@@ -80,7 +99,7 @@ Token *lex(const char *input) {
 
         if (current == '\0') break;
 
-        //  
+        // Обработка чисел
         if (isdigit((unsigned char)current)) {
             char *number = read_number();
             Token *token = create_number_token(number);
@@ -90,11 +109,11 @@ Token *lex(const char *input) {
             continue;
         }
 
-        //  
+        // Обработка идентификаторов
         if (isalpha((unsigned char)current) || current == '_') {
             char *ident = read_identifier();
 
-            //   
+            // Проверка на функцию
             int is_func = 0;
             int next_pos = pos;
             skip_whitespace();
@@ -110,7 +129,22 @@ Token *lex(const char *input) {
             continue;
         }
 
-        //     
+        // Обработка строк (например, имя файла: mmread("a.mtx"))
+        if (current == '"') {
+            char *str = read_string();
+            if (str == NULL) {
+                print_log("Незакрытая строка\n");
+                free_tokens(head);
+                return NULL;
+            }
+            Token *token = create_token_with_container(TOK_STRING, str, create_string_container(str));
+            add_token(&head, &tail, token);
+            last_token = token;
+            free(str);
+            continue;
+        }
+
+        // Обработка операторов и символов пунктуации
         Token *token = nullptr;
         switch (current) {
             case '+': token = create_token(TOK_PLUS, "+"); break;
@@ -123,8 +157,9 @@ Token *lex(const char *input) {
             case '[': token = create_token(TOK_LBRACKET, "[");break;
             case ']': token = create_token(TOK_RBRACKET, "]"); break;
             case ',': token = create_token(TOK_COMMA, ","); break;
+            case ':': token = create_token(TOK_COLON, ":"); break;
             default:
-                printf(" : %c\n", current);
+                print_log("Неизвестный символ: %c\n", current);
                 free_tokens(head);
                 return NULL;
                 //pos++;
@@ -136,7 +171,7 @@ Token *lex(const char *input) {
         pos++;
     }
 
-    //    
+    // Добавление токена конца ввода
     Token *eof = create_token(TOK_EOF, "EOF");
     add_token(&head, &tail, eof);
 
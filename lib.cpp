@@ -1,9 +1,10 @@
 #include "lib.h"
+#include <errno.h>
 
-//   :     
+// Умный вывод числа: целые выводятся без дробной части
 void print_smart_double(double value) {
     double int_part;
-     // ,     (    0)
+     // Проверка, является ли число целым (дробная часть близка к 0)
     if (fabs(modf(value, &int_part)) < 1e-9) {
 
         print_log("%.0f", value);
@@ -13,25 +14,52 @@ void print_smart_double(double value) {
     }
 }
 
-//    
+// Текущее время в секундах по высокоточному счётчику
+double wall_time() {
+    static LARGE_INTEGER frequency = {0};
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+// Генератор псевдослучайных чисел xorshift64* (воспроизводимая последовательность)
+static unsigned long long rand_state = 88172645463325252ULL;
+
+unsigned long long rand_next() {
+    rand_state ^= rand_state >> 12;
+    rand_state ^= rand_state << 25;
+    rand_state ^= rand_state >> 27;
+    return rand_state * 2685821657736338717ULL;
+}
+
+// Равномерно распределённое число из [0, 1)
+double rand_uniform() {
+    return (double)(rand_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Полная очистка списка переменных
 void cleanup_global_data(Ident* FirstIdent) {
 
     Ident* current = FirstIdent;
     while (current != NULL) {
         Ident* next = current->next;
 
-        //  
+        // Освобождение имени
         if (current->name) {
-            free(current->name);
+            mem_free(MEM_VARIABLES, current->name);
         }
 
 
         if (current->value) {
             free_token(current->value);
         }
+        free_tokens(current->lazy);
 
 
-        free(current);
+        mem_free(MEM_VARIABLES, current);
         current = next;
     }
     FirstIdent = NULL;
@@ -39,21 +67,22 @@ void cleanup_global_data(Ident* FirstIdent) {
 
 
 
-//  
+// Инициализация переменной
 Ident* create_ident(char *name, Token *value)
 {
-    Ident *new_ident = (Ident*)malloc(sizeof(Ident));
+    Ident *new_ident = (Ident*)mem_alloc(MEM_VARIABLES, sizeof(Ident));
     if (!new_ident) return nullptr;
 
-    new_ident->name = strdup(name);
+    new_ident->name = mem_strdup(MEM_VARIABLES, name);
     new_ident->value = value;
+    new_ident->lazy = nullptr;
     new_ident->prev = nullptr;
     new_ident->next = nullptr;
 
     return new_ident;
 }
 
-//      
+// Добавление переменной в начало связного списка
 void add_ident(Ident **first, Ident *new_ident) {
     if (new_ident == nullptr) return;
 
@@ -66,7 +95,7 @@ void add_ident(Ident **first, Ident *new_ident) {
     *first = new_ident;
 }
 
-//     
+// Удаление переменной из двусвязного списка
 void remove_ident(Ident **first, Ident *ident_to_remove) {
     if (!first || !*first || !ident_to_remove) return;
 
@@ -83,12 +112,13 @@ void remove_ident(Ident **first, Ident *ident_to_remove) {
         ident_to_remove->next->prev = ident_to_remove->prev;
 
 
-    free(ident_to_remove->name);
-    free(ident_to_remove);
+    mem_free(MEM_VARIABLES, ident_to_remove->name);
+    mem_free(MEM_VARIABLES, ident_to_remove);
 }
 
-//     
-Ident* find_ident(Ident *first, const char *name) {
+// Линейный поиск переменной по имени без вычисления отложенного значения
+// (для записи в переменную)
+Ident* find_ident_slot(Ident *first, const char *name) {
     Ident *current = first;
 
     while (current) {
@@ -100,10 +130,17 @@ Ident* find_ident(Ident *first, const char *name) {
     return nullptr;
 }
 
+// Поиск переменной для чтения: отложенное значение вычисляется здесь
+Ident* find_ident(Ident *first, const char *name) {
+    Ident *current = find_ident_slot(first, name);
+    if (current && current->lazy) return lazy_force(current);
+    return current;
+}
+
 
 
 
-//       
+// Обертки для освобождения памяти конкретных типов данных
 void free_int_container(void *data) {
     if (data) free(data);
 }
@@ -124,13 +161,24 @@ void free_vector_container(void *data) {
     if (data) free(data);
 }
 
+void free_list_container(void *data) {
+    ListContainer *lc = (ListContainer*)data;
+    if (lc) {
+        for (int i = 0; i < lc->count; i++) {
+            free_container(lc->items[i]);
+        }
+        free(lc->items);
+        free(lc);
+    }
+}
 
 
-//      
+
+// Реализация вывода для различных типов данных
 void print_int_container(void *data) {
     if (data) {
         IntContainer *ic = (IntContainer*)data;
-        print_log("%d", ic->value);
+        print_log("%lld", ic->value);
     }
 }
 
@@ -161,10 +209,22 @@ void print_vector_container(void *data) {
     }
 }
 
+void print_list_container(void *data) {
+    if (data) {
+        ListContainer *lc = (ListContainer*)data;
+        print_log("(");
+        for (int i = 0; i < lc->count; i++) {
+            if (i > 0) print_log(", ");
+            print_container(lc->items[i]);
+        }
+        print_log(")");
+    }
+}
+
 
-//  int 
-Container* create_int_container(int value) {
-    Container *container = (Container*)malloc(sizeof(Container));
+// Инициализация int контейнера
+Container* create_int_container(long long value) {
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
     IntContainer *data = (IntContainer*)malloc(sizeof(IntContainer));
 
     data->value = value;
@@ -176,9 +236,9 @@ Container* create_int_container(int value) {
     return container;
 }
 
-//  float 
+// Инициализация float контейнера
 Container* create_float_container(double value) {
-    Container *container = (Container*)malloc(sizeof(Container));
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
     FloatContainer *data = (FloatContainer*)malloc(sizeof(FloatContainer));
 
     data->value = value;
@@ -190,9 +250,9 @@ Container* create_float_container(double value) {
     return container;
 }
 
-//   
+// Инициализация строкового контейнера
 Container* create_string_container(const char *value) {
-    Container *container = (Container*)malloc(sizeof(Container));
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
     StringContainer *data = (StringContainer*)malloc(sizeof(StringContainer));
 
     data->value = strdup(value);
@@ -205,9 +265,9 @@ Container* create_string_container(const char *value) {
     return container;
 }
 
-//   
+// Инициализация векторного контейнера
 Container* create_vector_container(double x, double y, double z) {
-    Container *container = (Container*)malloc(sizeof(Container));
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
     VectorContainer *data = (VectorContainer*)malloc(sizeof(VectorContainer));
 
     data->x = x;
@@ -222,17 +282,36 @@ Container* create_vector_container(double x, double y, double z) {
 }
 
 
-//        
+// Инициализация набора значений (набор становится владельцем элементов)
+Container* create_list_container(int count, Container **items) {
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
+    ListContainer *data = (ListContainer*)malloc(sizeof(ListContainer));
+
+    data->count = count;
+    data->items = (Container**)malloc((count > 0 ? count : 1) * sizeof(Container*));
+    for (int i = 0; i < count; i++) {
+        data->items[i] = items[i];
+    }
+    container->type = CT_LIST;
+    container->data = data;
+    container->free_func = free_list_container;
+    container->print_func = print_list_container;
+
+    return container;
+}
+
+
+// Уничтожение контейнера с использованием его внутренней функции очистки
 void free_container(Container *container) {
     if (container) {
         if (container->free_func && container->data) {
             container->free_func(container->data);
         }
-        free(container);
+        mem_free(MEM_CONTAINERS, container);
     }
 }
 
-//         
+// Вывод содержимого контейнера с использованием его внутренней функции очистки
 void print_container(Container *container) {
     if (container && container->print_func) {
 
@@ -240,7 +319,7 @@ void print_container(Container *container) {
     }
 }
 
-//  
+// Клонирование контейнера
 Container* container_deep_copy(Container *src) {
     if (!src) return NULL;
 
@@ -261,13 +340,45 @@ Container* container_deep_copy(Container *src) {
             VectorContainer *vc = (VectorContainer*)src->data;
             return create_vector_container(vc->x, vc->y, vc->z);
         }
+        case CT_MATRIX:
+            return matrix_copy((MatrixContainer*)src->data);
+        case CT_SPARSE:
+            return sparse_copy((SparseContainer*)src->data);
+        case CT_FIELD:
+            return field_copy((FieldContainer*)src->data);
+        case CT_QUAT: {
+            QuatContainer *qc = (QuatContainer*)src->data;
+            return create_quat_container(qc->w, qc->x, qc->y, qc->z);
+        }
+        case CT_VIEW:
+            return view_copy((ViewContainer*)src->data);
+        case CT_DISK:
+            return disk_copy((DiskContainer*)src->data);
+        case CT_SINGLE:
+            return single_copy((SingleContainer*)src->data);
+        case CT_COMPLEX:
+            return complex_copy((ComplexContainer*)src->data);
+        case CT_RANGE: {
+            RangeContainer *rc = (RangeContainer*)src->data;
+            return create_range_container(rc->has_start, rc->start, rc->has_stop, rc->stop, rc->step);
+        }
+        case CT_LIST: {
+            ListContainer *lc = (ListContainer*)src->data;
+            Container **items = (Container**)malloc((lc->count > 0 ? lc->count : 1) * sizeof(Container*));
+            for (int i = 0; i < lc->count; i++) {
+                items[i] = container_deep_copy(lc->items[i]);
+            }
+            Container *copy = create_list_container(lc->count, items);
+            free(items);
+            return copy;
+        }
         default:
             return NULL;
     }
 }
 
 
-//    
+// Сравнение значений двух контейнеров
 int container_compare(Container *a, Container *b) {
     if (!a || !b) return 0;
     if (a->type != b->type) return 0;
@@ -295,6 +406,41 @@ int container_compare(Container *a, Container *b) {
                    fabs(va->y - vb->y) < 1e-10 &&
                    fabs(va->z - vb->z) < 1e-10;
         }
+        case CT_MATRIX:
+            return matrix_compare((MatrixContainer*)a->data, (MatrixContainer*)b->data);
+        case CT_SPARSE:
+            return sparse_compare((SparseContainer*)a->data, (SparseContainer*)b->data);
+        case CT_FIELD:
+            return field_compare((FieldContainer*)a->data, (FieldContainer*)b->data);
+        case CT_QUAT:
+            return quat_compare((QuatContainer*)a->data, (QuatContainer*)b->data);
+        case CT_VIEW: {
+            Container *da = container_to_matrix(a);
+            Container *db = container_to_matrix(b);
+            int equal = da && db && matrix_compare((MatrixContainer*)da->data, (MatrixContainer*)db->data);
+            free_container(da);
+            free_container(db);
+            return equal;
+        }
+        case CT_SINGLE:
+            return single_compare((SingleContainer*)a->data, (SingleContainer*)b->data);
+        case CT_COMPLEX:
+            return complex_compare((ComplexContainer*)a->data, (ComplexContainer*)b->data);
+        case CT_DISK: {
+            // Файлы не читаются целиком: равны ссылки на один и тот же файл
+            DiskContainer *da = (DiskContainer*)a->data;
+            DiskContainer *db = (DiskContainer*)b->data;
+            return strcmp(da->file->path, db->file->path) == 0;
+        }
+        case CT_LIST: {
+            ListContainer *la = (ListContainer*)a->data;
+            ListContainer *lb = (ListContainer*)b->data;
+            if (la->count != lb->count) return 0;
+            for (int i = 0; i < la->count; i++) {
+                if (!container_compare(la->items[i], lb->items[i])) return 0;
+            }
+            return 1;
+        }
         default:
             return 0;
     }
@@ -303,19 +449,20 @@ int container_compare(Container *a, Container *b) {
 
 
 
-//C 
+//Cоздание токена
 Token *create_token(TokenT type, const char *value) {
-    Token *token = (Token*)malloc(sizeof(Token));
+    Token *token = (Token*)mem_alloc(MEM_TOKENS, sizeof(Token));
     token->type = type;
-    token->value = value ? strdup(value) : NULL;
+    token->value = value ? mem_strdup(MEM_TOKENS, value) : NULL;
     token->container = NULL;
+    token->arg_count = 0;
     token->prev = NULL;
     token->next = NULL;
     return token;
 }
 
 
-//   c  
+// Создание токена c привязкой контейнера
 Token *create_token_with_container(TokenT type, const char *value, Container *container) {
     Token *token = create_token(type, value);
     if (token) {
@@ -324,7 +471,7 @@ Token *create_token_with_container(TokenT type, const char *value, Container *co
     return token;
 }
 
-//     
+// Добавление токена в конец списка
 void add_token(Token **head, Token **tail, Token *token) {
     if (token == NULL) return;
 
@@ -338,13 +485,13 @@ void add_token(Token **head, Token **tail, Token *token) {
     }
 }
 
-//     
+// Очистка токена и его содержимого
 void free_token(Token *token) {
     if (token == NULL) return;
 
 
     if (token->value) {
-        free(token->value);
+        mem_free(MEM_TOKENS, token->value);
     }
 
 
@@ -352,10 +499,10 @@ void free_token(Token *token) {
         free_container(token->container);
     }
 
-    free(token);
+    mem_free(MEM_TOKENS, token);
 }
 
-//    
+// Очистка всего списка токенов
 void free_tokens(Token *head) {
     Token *current = head;
     while (current != NULL) {
@@ -365,7 +512,7 @@ void free_tokens(Token *head) {
     }
 }
 
-//   
+// Присвоение контейнера токену
 void token_set_container(Token *token, Container *container) {
     if (token == NULL) return;
 
@@ -378,7 +525,7 @@ void token_set_container(Token *token, Container *container) {
 }
 
 
-//          
+// Получение числа из строки и создание токена с соответствующим контейнером
 Token *create_number_token(const char *value) {
     if (value == NULL) return NULL;
 
@@ -390,15 +537,18 @@ Token *create_number_token(const char *value) {
 
             token->container = create_float_container(float_value);
         } else {
-            int int_value = atoi(value);
+            // Литерал вне диапазона 64-битных целых становится числом с плавающей точкой
+            errno = 0;
+            long long int_value = strtoll(value, NULL, 10);
 
-            token->container = create_int_container(int_value);
+            if (errno == ERANGE) token->container = create_float_container(atof(value));
+            else token->container = create_int_container(int_value);
         }
     }
     return token;
 }
 
-//     
+//Копия токена с глубоким копированием данных
 Token *copy_token(const Token *src) {
     if (src == NULL) return NULL;
 
@@ -406,10 +556,13 @@ Token *copy_token(const Token *src) {
     if (copy && src->container) {
         copy->container = container_deep_copy(src->container);
     }
+    if (copy) {
+        copy->arg_count = src->arg_count;
+    }
     return copy;
 }
 
-//     
+// Добавление токена на вершину стека
 void push_to_stack(Token** stack_top, Token* item)
 {
     if (stack_top == nullptr || item == nullptr) return;
@@ -424,7 +577,7 @@ void push_to_stack(Token** stack_top, Token* item)
     *stack_top = item;
 }
 
-//     
+// Извлечение элемента с вершины стека
 Token* pop_from_stack(Token** stack_top)
 {
     if (stack_top == nullptr || *stack_top == nullptr) {
@@ -444,7 +597,7 @@ Token* pop_from_stack(Token** stack_top)
 }
 
 
-//    
+// Добавление элемента в очередь
 void enqueue(Token** queue_front, Token** queue_rear, Token* item)
 {
     if (item == nullptr) return;
@@ -463,7 +616,7 @@ void enqueue(Token** queue_front, Token** queue_rear, Token* item)
     }
 }
 
-//    
+// Извлечение элемента из очереди
 Token* dequeue(Token** queue_front, Token** queue_rear)
 {
     if (queue_front == nullptr || *queue_front == nullptr) {
@@ -486,7 +639,7 @@ Token* dequeue(Token** queue_front, Token** queue_rear)
 
 
 
-//     double
+// Приведение числового контейнера к double
 double container_to_double(Container* container) {
     if (!container) return 0.0;
 
@@ -504,7 +657,12 @@ double container_to_double(Container* container) {
     }
 }
 
-//  
+// Проверка, является ли контейнер числом
+int container_is_scalar(Container* container) {
+    return container && (container->type == CT_INT || container->type == CT_FLOAT);
+}
+
+// Вычисление синуса
 Container* sin_func(Container** args, int arg_count) {
 
     if (!args[0]) return NULL;
@@ -513,19 +671,23 @@ Container* sin_func(Container** args, int arg_count) {
         double value = container_to_double(args[0]);
         return create_float_container(sin(value));
     }
-    return NULL;
+
+    Container *result = map_unary(args[0], EW_SIN);
+    if (!result) print_log("sin: аргумент должен быть числом, вектором или матрицей\n");
+    return result;
 }
 
-//  
+// Вычисление косинуса
 Container* cos_func(Container** args, int arg_count) {
     if (arg_count != 1) {
-        print_log("cos:  1 \n");
+        print_log("cos: ожидается 1 аргумент\n");
         return NULL;
     }
     if (!args[0]) return NULL;
     if (args[0]->type != CT_INT && args[0]->type != CT_FLOAT) {
-        print_log("cos:    \n");
-        return NULL;
+        Container *result = map_unary(args[0], EW_COS);
+        if (!result) print_log("cos: аргумент должен быть числом, вектором или матрицей\n");
+        return result;
     }
 
     double value = container_to_double(args[0]);
@@ -533,62 +695,74 @@ Container* cos_func(Container** args, int arg_count) {
 }
 
 
-//      
+static int is_positive(double x) {
+    return x > 0;
+}
+
+// Натуральный логарифм с проверкой области определения
 Container* log_func(Container** args, int arg_count) {
     if (arg_count != 1) {
-        print_log("log:  1 \n");
+        print_log("log: ожидается 1 аргумент\n");
         return NULL;
     }
     if (!args[0]) return NULL;
     if (args[0]->type != CT_INT && args[0]->type != CT_FLOAT) {
-        print_log("log:    \n");
-        return NULL;
+        if (args[0]->type != CT_VECTOR && args[0]->type != CT_MATRIX && args[0]->type != CT_SPARSE) {
+            print_log("log: аргумент должен быть числом, вектором или матрицей\n");
+            return NULL;
+        }
+        if (!elements_all(args[0], is_positive)) {
+            print_log("log: все элементы должны быть положительными\n");
+            return NULL;
+        }
+        return map_unary(args[0], EW_LOG);
     }
 
     double value = container_to_double(args[0]);
     if (value <= 0) {
-        print_log("log:    \n");
+        print_log("log: аргумент должен быть положительным\n");
         return NULL;
     }
     return create_float_container(log(value));
 }
 
 
-//   
+// Возведение в степень
 Container* pow_func(Container** args, int arg_count) {
     if (arg_count != 2) {
-        print_log("pow:  2 \n");
+        print_log("pow: ожидается 2 аргумента\n");
         return NULL;
     }
     if (!args[0] || !args[1]) return NULL;
     if ((args[0]->type != CT_INT && args[0]->type != CT_FLOAT) ||
         (args[1]->type != CT_INT && args[1]->type != CT_FLOAT)) {
-        print_log("pow:    \n");
-        return NULL;
+        return map_binary(args[0], args[1], EW_POW, "pow");
     }
 
     double base = container_to_double(args[0]);
     double exponent = container_to_double(args[1]);
 
     if (base == 0 && exponent < 0) {
-        print_log("pow:   \n");
+        print_log("pow: деление на ноль\n");
         return NULL;
     }
-    return create_float_container(pow(base, exponent));
+
+    // Ядро массивов сокращает pow(x, 2), pow(x, 0.5) и т.п. до умножений и sqrt
+    double result;
+    kernels->binary[EW_POW - EW_POW](&base, 0, &exponent, 0, &result, 1);
+    return create_float_container(result);
 }
 
 
-//     
+// Выбор максимального из двух чисел; с одним аргументом или осью - наибольший элемент
 Container* max_func(Container* args[], int arg_count) {
-    if (arg_count != 2) {
-        print_log("max:  2 \n");
-        return NULL;
+    if (arg_count != 2 || (args[1] && args[1]->type == CT_STRING)) {
+        return extremum_reduce(args, arg_count, 1, "max");
     }
     if (!args[0] || !args[1]) return NULL;
     if ((args[0]->type != CT_INT && args[0]->type != CT_FLOAT) ||
         (args[1]->type != CT_INT && args[1]->type != CT_FLOAT)) {
-        print_log("max:    \n");
-        return NULL;
+        return map_binary(args[0], args[1], EW_MAX, "max");
     }
 
     double a = container_to_double(args[0]);
@@ -596,16 +770,35 @@ Container* max_func(Container* args[], int arg_count) {
     return create_float_container(a > b ? a : b);
 }
 
+// Выбор минимального из двух чисел; с одним аргументом или осью - наименьший элемент
+Container* min_func(Container* args[], int arg_count) {
+    if (arg_count != 2 || (args[1] && args[1]->type == CT_STRING)) {
+        return extremum_reduce(args, arg_count, 0, "min");
+    }
+    if (!args[0] || !args[1]) return NULL;
+    if ((args[0]->type != CT_INT && args[0]->type != CT_FLOAT) ||
+        (args[1]->type != CT_INT && args[1]->type != CT_FLOAT)) {
+        return map_binary(args[0], args[1], EW_MIN, "min");
+    }
 
-//  
+    double a = container_to_double(args[0]);
+    double b = container_to_double(args[1]);
+    return create_float_container(a < b ? a : b);
+}
+
+
+// Векторное произведение
 Container* cross_func(Container** args, int arg_count) {
     if (arg_count != 2) {
-        print_log("cross:  2 \n");
+        print_log("cross: ожидается 2 аргумента\n");
         return NULL;
     }
     if (!args[0] || !args[1]) return NULL;
+    if (args[0]->type == CT_FIELD || args[1]->type == CT_FIELD) {
+        return field_cross(args[0], args[1]);
+    }
     if (args[0]->type != CT_VECTOR || args[1]->type != CT_VECTOR) {
-        print_log("cross:     \n");
+        print_log("cross: оба аргумента должны быть векторами\n");
         return NULL;
     }
 
@@ -623,7 +816,7 @@ Container* cross_func(Container** args, int arg_count) {
 Container* abs_func(Container** args, int arg_count)
 {
     if (arg_count != 1) {
-        print_log("length:  1 \n");
+        print_log("length: ожидается 1 аргумент\n");
         return NULL;
     }
     if (!args[0]) return NULL;
@@ -634,8 +827,24 @@ Container* abs_func(Container** args, int arg_count)
         return create_float_container(fabs(value));
     }
 
+    // Для матриц модуль берется поэлементно, для вектора - его длина
+    if (args[0]->type == CT_MATRIX || args[0]->type == CT_SPARSE) {
+        return map_unary(args[0], EW_ABS);
+    }
+
+    // Для поля - длины всех векторов столбцом
+    if (args[0]->type == CT_FIELD) {
+        return field_norms(args[0]);
+    }
+    if (args[0]->type == CT_QUAT) {
+        return quat_norm(args[0]);
+    }
+    if (args[0]->type == CT_COMPLEX) {
+        return complex_abs(args[0]);
+    }
+
     if (args[0]->type != CT_VECTOR) {
-        print_log("length:    \n");
+        print_log("abs: аргумент должен быть числом, вектором или матрицей\n");
         return NULL;
     }
 
@@ -647,24 +856,83 @@ Container* abs_func(Container** args, int arg_count)
 }
 
 
-//  
+// Целочисленная арифметика: 1 - результат в *r, 0 - переполнение, считать в double
+#ifdef __GNUC__
+static int int_add(long long a, long long b, long long *r) { return !__builtin_add_overflow(a, b, r); }
+static int int_sub(long long a, long long b, long long *r) { return !__builtin_sub_overflow(a, b, r); }
+static int int_mul(long long a, long long b, long long *r) { return !__builtin_mul_overflow(a, b, r); }
+#else
+static int int_add(long long a, long long b, long long *r) {
+    if ((b > 0 && a > LLONG_MAX - b) || (b < 0 && a < LLONG_MIN - b)) return 0;
+    *r = a + b;
+    return 1;
+}
+static int int_sub(long long a, long long b, long long *r) {
+    if ((b < 0 && a > LLONG_MAX + b) || (b > 0 && a < LLONG_MIN + b)) return 0;
+    *r = a - b;
+    return 1;
+}
+static int int_mul(long long a, long long b, long long *r) {
+    if (a > 0 && b > 0 && a > LLONG_MAX / b) return 0;
+    if (a > 0 && b < 0 && b < LLONG_MIN / a) return 0;
+    if (a < 0 && b > 0 && a < LLONG_MIN / b) return 0;
+    if (a < 0 && b < 0 && a < LLONG_MAX / b) return 0;
+    *r = a * b;
+    return 1;
+}
+#endif
+
+// Деление нацело остается целым, иначе (и для LLONG_MIN / -1) - double
+static int int_div(long long a, long long b, long long *r) {
+    if (b == -1 && a == LLONG_MIN) return 0;
+    if (a % b != 0) return 0;
+    *r = a / b;
+    return 1;
+}
+
+static long long int_value(Container *c) {
+    return ((IntContainer*)c->data)->value;
+}
+
+// Операция вычитания
 Container* sub_func(Container** args, int arg_count)
 {
     if (arg_count != 2) {
-        print_log(":  2 \n");
+        print_log("Вычитание: ожидается 2 аргумента\n");
         return NULL;
     }
     if (!args[0] || !args[1]) {
-        print_log(":     NULL\n");
+        print_log("Вычитание: аргументы не могут быть NULL\n");
         return NULL;
     }
 
     Container* a = args[0];
     Container* b = args[1];
 
+    if (a->type == CT_FIELD || b->type == CT_FIELD) {
+        return field_add(a, b, -1.0);
+    }
+    if (a->type == CT_QUAT || b->type == CT_QUAT) {
+        return quat_add(a, b, -1.0);
+    }
+    if (a->type == CT_COMPLEX || b->type == CT_COMPLEX) {
+        return complex_add(a, b, -1.0);
+    }
+    if (a->type == CT_SINGLE || b->type == CT_SINGLE) {
+        return single_add(a, b, -1.0);
+    }
+
+    if (a->type == CT_MATRIX || a->type == CT_SPARSE ||
+        b->type == CT_MATRIX || b->type == CT_SPARSE) {
+        return matrix_add(a, b, -1.0);
+    }
 
     if ((a->type == CT_INT || a->type == CT_FLOAT) &&
         (b->type == CT_INT || b->type == CT_FLOAT)) {
+        long long r;
+        if (a->type == CT_INT && b->type == CT_INT && int_sub(int_value(a), int_value(b), &r)) {
+            return create_int_container(r);
+        }
         double result = container_to_double(a) - container_to_double(b);
         return create_float_container(result);
     }
@@ -676,28 +944,49 @@ Container* sub_func(Container** args, int arg_count)
         return create_vector_container(va->x - vb->x, va->y - vb->y, va->z - vb->z);
     }
 
-    print_log(":    \n");
+    print_log("Ошибка: несовместимые типы для вычитания\n");
     return NULL;
 }
 
 
-//  
+// Операция сложения
 Container* add_func(Container** args, int arg_count) {
     if (arg_count != 2) {
-        print_log(":  2 \n");
+        print_log("Сложение: ожидается 2 аргумента\n");
         return NULL;
     }
     if (!args[0] || !args[1]) {
-        print_log(":     NULL\n");
+        print_log("Сложение: аргументы не могут быть NULL\n");
         return NULL;
     }
 
     Container* a = args[0];
     Container* b = args[1];
 
+    if (a->type == CT_FIELD || b->type == CT_FIELD) {
+        return field_add(a, b, 1.0);
+    }
+    if (a->type == CT_QUAT || b->type == CT_QUAT) {
+        return quat_add(a, b, 1.0);
+    }
+    if (a->type == CT_COMPLEX || b->type == CT_COMPLEX) {
+        return complex_add(a, b, 1.0);
+    }
+    if (a->type == CT_SINGLE || b->type == CT_SINGLE) {
+        return single_add(a, b, 1.0);
+    }
+
+    if (a->type == CT_MATRIX || a->type == CT_SPARSE ||
+        b->type == CT_MATRIX || b->type == CT_SPARSE) {
+        return matrix_add(a, b, 1.0);
+    }
 
     if ((a->type == CT_INT || a->type == CT_FLOAT) &&
         (b->type == CT_INT || b->type == CT_FLOAT)) {
+        long long r;
+        if (a->type == CT_INT && b->type == CT_INT && int_add(int_value(a), int_value(b), &r)) {
+            return create_int_container(r);
+        }
         double result = container_to_double(a) + container_to_double(b);
         return create_float_container(result);
     }
@@ -709,18 +998,18 @@ Container* add_func(Container** args, int arg_count) {
         return create_vector_container(va->x + vb->x, va->y + vb->y, va->z + vb->z);
     }
 
-    print_log(":    \n");
+    print_log("Ошибка: несовместимые типы для сложения\n");
     return NULL;
 }
 
-//  
+// Унарный минус
 Container* neg_func(Container** args, int arg_count) {
     if (arg_count != 1) {
-        print_log(" :  1 \n");
+        print_log("Унарный минус: ожидается 1 аргумент\n");
         return NULL;
     }
     if (!args[0]) {
-        print_log(" :     NULL\n");
+        print_log("Унарный минус: аргумент не может быть NULL\n");
         return NULL;
     }
 
@@ -729,6 +1018,7 @@ Container* neg_func(Container** args, int arg_count) {
     switch (a->type) {
         case CT_INT: {
             IntContainer* ic = (IntContainer*)a->data;
+            if (ic->value == LLONG_MIN) return create_float_container(-(double)ic->value);
             return create_int_container(-ic->value);
         }
         case CT_FLOAT: {
@@ -739,36 +1029,71 @@ Container* neg_func(Container** args, int arg_count) {
             VectorContainer* vc = (VectorContainer*)a->data;
             return create_vector_container(-vc->x, -vc->y, -vc->z);
         }
+        case CT_MATRIX:
+        case CT_SPARSE:
+            return matrix_scale(a, -1.0);
+        case CT_SINGLE:
+            return single_scale(a, -1.0);
+        case CT_COMPLEX:
+            return complex_scale(a, -1.0);
+        case CT_FIELD: {
+            Container *minus_one = create_float_container(-1.0);
+            Container *result = field_mul(a, minus_one);
+            free_container(minus_one);
+            return result;
+        }
+        case CT_QUAT: {
+            QuatContainer* qc = (QuatContainer*)a->data;
+            return create_quat_container(-qc->w, -qc->x, -qc->y, -qc->z);
+        }
         default:
-            print_log(":       \n");
+            print_log("Ошибка: унарный минус не применим к данному типу\n");
             return NULL;
     }
 }
 
 
-// 
+// Деление на степень двойки можно заменить умножением: 1/d точно, результат тот же
+int reciprocal_exact(double d) {
+    int e;
+    double m = frexp(d, &e);
+    return fabs(m) == 0.5 && isfinite(1.0 / d);
+}
+
+// Деление
 Container* div_func(Container** args, int arg_count) {
     if (arg_count != 2) {
-        print_log(":  2 \n");
+        print_log("Деление: ожидается 2 аргумента\n");
         return NULL;
     }
     if (!args[0] || !args[1]) {
-        print_log(":     NULL\n");
+        print_log("Деление: аргументы не могут быть NULL\n");
         return NULL;
     }
 
     Container* a = args[0];
     Container* b = args[1];
 
+    if (a->type == CT_FIELD || b->type == CT_FIELD) {
+        return field_div(a, b);
+    }
+    if (a->type == CT_QUAT || b->type == CT_QUAT) {
+        return quat_div(a, b);
+    }
 
     if ((a->type == CT_INT || a->type == CT_FLOAT) &&
         (b->type == CT_INT || b->type == CT_FLOAT)) {
         double divisor = container_to_double(b);
         if (divisor == 0.0) {
-            print_log(":   \n");
+            print_log("Ошибка: деление на ноль\n");
             return NULL;
         }
-        double result = container_to_double(a) / divisor;
+        long long r;
+        if (a->type == CT_INT && b->type == CT_INT && int_div(int_value(a), int_value(b), &r)) {
+            return create_int_container(r);
+        }
+        double result = reciprocal_exact(divisor) ? container_to_double(a) * (1.0 / divisor)
+                                                  : container_to_double(a) / divisor;
         return create_float_container(result);
     }
 
@@ -776,35 +1101,73 @@ Container* div_func(Container** args, int arg_count) {
     if (a->type == CT_VECTOR && (b->type == CT_INT || b->type == CT_FLOAT)) {
         double divisor = container_to_double(b);
         if (divisor == 0.0) {
-            print_log(":   \n");
+            print_log("Ошибка: деление на ноль\n");
             return NULL;
         }
         VectorContainer* va = (VectorContainer*)a->data;
+        if (reciprocal_exact(divisor)) {
+            double s = 1.0 / divisor;
+            return create_vector_container(va->x * s, va->y * s, va->z * s);
+        }
         return create_vector_container(va->x / divisor, va->y / divisor, va->z / divisor);
     }
 
-    print_log(":    \n");
+
+    if ((a->type == CT_MATRIX || a->type == CT_SPARSE || a->type == CT_SINGLE || a->type == CT_COMPLEX) &&
+        (b->type == CT_INT || b->type == CT_FLOAT)) {
+        double divisor = container_to_double(b);
+        if (divisor == 0.0) {
+            print_log("Ошибка: деление на ноль\n");
+            return NULL;
+        }
+        if (a->type == CT_SINGLE) return single_divide(a, divisor);
+        if (a->type == CT_COMPLEX) return complex_divide(a, divisor);
+        return matrix_divide(a, divisor);
+    }
+
+    print_log("Ошибка: несовместимые типы для деления\n");
     return NULL;
 }
 
 
-//  
+// Универсальное умножение
 Container* mul_func(Container** args, int arg_count) {
     if (arg_count != 2) {
-        print_log(":  2 \n");
+        print_log("Умножение: ожидается 2 аргумента\n");
         return NULL;
     }
     if (!args[0] || !args[1]) {
-        print_log(":     NULL\n");
+        print_log("Умножение: аргументы не могут быть NULL\n");
         return NULL;
     }
 
     Container* a = args[0];
     Container* b = args[1];
 
+    // Поля, кватернионы, матричные и разреженные операнды обрабатываются своими модулями
+    if (a->type == CT_FIELD || b->type == CT_FIELD) {
+        return field_mul(a, b);
+    }
+    if (a->type == CT_QUAT || b->type == CT_QUAT) {
+        return quat_mul(a, b);
+    }
+    if (a->type == CT_COMPLEX || b->type == CT_COMPLEX) {
+        return complex_mul(a, b);
+    }
+    if (a->type == CT_SINGLE || b->type == CT_SINGLE) {
+        return single_mul(a, b);
+    }
+    if (a->type == CT_MATRIX || a->type == CT_SPARSE || a->type == CT_VIEW ||
+        b->type == CT_MATRIX || b->type == CT_SPARSE || b->type == CT_VIEW) {
+        return matrix_mul(a, b);
+    }
 
     if ((a->type == CT_INT || a->type == CT_FLOAT) &&
         (b->type == CT_INT || b->type == CT_FLOAT)) {
+        long long r;
+        if (a->type == CT_INT && b->type == CT_INT && int_mul(int_value(a), int_value(b), &r)) {
+            return create_int_container(r);
+        }
         double result = container_to_double(a) * container_to_double(b);
         return create_float_container(result);
     }
@@ -830,7 +1193,7 @@ Container* mul_func(Container** args, int arg_count) {
         return create_float_container(va->x * vb->x + va->y * vb->y + va->z * vb->z);
     }
 
-    print_log(":    \n");
+    print_log("Ошибка: несовместимые типы для умножения\n");
     return NULL;
 }
 
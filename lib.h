@@ -8,6 +8,17 @@
 #include <ctype.h>
 #include <math.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <limits.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Минимальный объём работы (в операциях), начиная с которого ядра распараллеливаются
+#define PARALLEL_MIN_WORK 32768
+
+// Количество аргументов для функций с переменным числом параметров
+#define ARGS_VARIADIC -1
 
 
 typedef enum {
@@ -17,6 +28,7 @@ typedef enum {
     TOK_FUNCTION,   // Функция
     TOK_VECTOR,     // Вектор
     TOK_STRING,     // Строковый литерал (если понадобится)
+    TOK_PARAM,      // Параметр функции пользователя (arg_count - номер параметра)
 
     // Операторы
     TOK_PLUS,       // +
@@ -31,14 +43,25 @@ typedef enum {
     TOK_RPAREN,     // )
     TOK_LBRACKET,   // [
     TOK_RBRACKET,   // ]
-    TOK_COMMA       // ,
+    TOK_COMMA,      // ,
+    TOK_COLON       // : (только в индексах)
 } TokenT;
 
 typedef enum {
     CT_INT,
     CT_FLOAT,
     CT_VECTOR,
-    CT_STRING
+    CT_STRING,
+    CT_MATRIX,      // Плотная матрица
+    CT_SPARSE,      // Разреженная матрица (CSR/CSC)
+    CT_LIST,        // Набор значений (результат функций с несколькими выходами)
+    CT_FIELD,       // Массив 3-векторов (поле), координаты в трех отдельных массивах
+    CT_QUAT,        // Кватернион
+    CT_VIEW,        // Срез или транспонирование матрицы без копирования
+    CT_RANGE,       // Диапазон индексов начало:конец:шаг
+    CT_DISK,        // Матрица в файле на диске (по тайлам)
+    CT_SINGLE,      // Плотная матрица одинарной точности (float)
+    CT_COMPLEX      // Комплексное число, вектор или матрица
 } ContainerType;
 
 typedef struct Token Token;
@@ -46,7 +69,7 @@ typedef struct Ident Ident;
 typedef struct Container Container;
 
 typedef struct {
-    int value;
+    long long value;        // 64 бита: целые точны и выше 2^53
 } IntContainer;
 
 typedef struct {
@@ -64,6 +87,159 @@ typedef struct {
     size_t length;
 } StringContainer;
 
+// LU-разложение с выбором ведущего элемента по столбцу
+typedef struct {
+    int n;
+    double *lu;     // L (единичная диагональ, не хранится) и U в одной матрице по строкам
+    int *piv;       // На шаге i строка i менялась местами со строкой piv[i]
+    int sign;       // Четность перестановки (для определителя)
+    int singular;   // Найден нулевой ведущий элемент
+} LUFactor;
+
+// Разложение Холецкого A = L*L^T
+typedef struct {
+    int n;
+    double *l;      // Нижнетреугольная L по строкам
+} CholFactor;
+
+// QR-разложение отражениями Хаусхолдера
+typedef struct {
+    int rows;
+    int cols;
+    double *qr;     // R на и над диагональю, векторы отражений (без единицы) под ней
+    double *tau;    // Коэффициенты отражений, min(rows, cols) штук
+} QRFactor;
+
+// LU-разложение в одинарной точности (для решения с уточнением)
+typedef struct {
+    int n;
+    float *lu;
+    int *piv;
+    int singular;
+} SingleLU;
+
+// Кэш разложений, общий для всех копий одного значения матрицы
+typedef struct {
+    int refs;
+    int spd;        // 1 - симметричная положительно определенная, -1 - нет, 0 - не проверялась
+    LUFactor *lu;
+    CholFactor *chol;
+    QRFactor *qr;
+    SingleLU *slu;
+} MatrixCache;
+
+// Буфер элементов, общий для копий одного значения и срезов. Значения не изменяются
+// после создания, поэтому копия берет ссылку на буфер, а запись идет только в новые матрицы
+typedef struct {
+    int refs;
+    double *data;
+} MatrixBuffer;
+
+// Плотная матрица, элементы хранятся по строкам
+typedef struct {
+    int rows;
+    int cols;
+    double *data;           // Может указывать внутрь общего буфера (срез строк)
+    MatrixCache *cache;
+    MatrixBuffer *buffer;   // NULL - data принадлежит только этой матрице
+} MatrixContainer;
+
+// Матрица с произвольными шагами в общем буфере: элемент (i, j) лежит в
+// data[i*row_stride + j*col_stride]. Транспонирование меняет шаги местами
+typedef struct {
+    int rows;
+    int cols;
+    double *data;
+    int row_stride;
+    int col_stride;
+    MatrixBuffer *buffer;
+} ViewContainer;
+
+// Диапазон индексов среза; пропущенные начало и конец берутся по шагу
+typedef struct {
+    int has_start;
+    int has_stop;
+    int start;
+    int stop;
+    int step;
+} RangeContainer;
+
+// Плотная матрица одинарной точности, элементы по строкам
+typedef struct {
+    int rows;
+    int cols;
+    float *data;
+    MatrixCache *cache;
+} SingleContainer;
+
+// Файл матрицы на диске, общий для копий значения
+typedef struct {
+    int refs;
+    HANDLE file;
+    HANDLE mapping;
+    char path[MAX_PATH];
+} DiskFile;
+
+// Матрица на диске: в память отображаются только нужные тайлы DISK_TILE x DISK_TILE
+typedef struct {
+    int rows;
+    int cols;
+    int tile_rows;      // Количество тайлов по строкам и столбцам
+    int tile_cols;
+    DiskFile *file;
+} DiskContainer;
+
+typedef enum {
+    SP_CSR,         // Сжатые строки
+    SP_CSC          // Сжатые столбцы
+} SparseFormat;
+
+// Разреженная матрица в формате CSR или CSC
+typedef struct {
+    SparseFormat format;
+    int rows;
+    int cols;
+    int nnz;        // Количество хранимых элементов
+    int *ptr;       // Начала строк (CSR) или столбцов (CSC), длина rows+1 / cols+1
+    int *idx;       // Номера столбцов (CSR) или строк (CSC)
+    double *val;
+    MatrixCache *cache;
+} SparseContainer;
+
+// Набор значений
+typedef struct {
+    int count;
+    Container **items;
+} ListContainer;
+
+// Поле из count 3-векторов: x, y, z указывают в один блок памяти
+typedef struct {
+    int count;
+    double *x;
+    double *y;
+    double *z;
+} FieldContainer;
+
+// Кватернион w + xi + yj + zk
+typedef struct {
+    double w;
+    double x;
+    double y;
+    double z;
+} QuatContainer;
+
+typedef struct {
+    double re;
+    double im;
+} Complex;
+
+// Комплексная матрица, элементы по строкам (вектор - столбец или строка)
+typedef struct {
+    int rows;
+    int cols;
+    Complex *data;
+} ComplexContainer;
+
 struct Container {
     ContainerType type;
     void *data;
@@ -76,6 +252,7 @@ struct Token {
     TokenT type;
     char *value;            // Строковое представление (для лексера)
     Container *container;   // Хранение значения (число, вектор и т.д.)
+    int arg_count;          // Число аргументов функции или элементов вектора
     Token *prev;
     Token *next;
 };
@@ -84,6 +261,7 @@ struct Token {
 struct Ident {
     char *name;
     Token *value;
+    Token *lazy;            // Отложенное выражение в ОПЗ (lazy.cpp); value до вычисления пуст
     Ident *prev;
     Ident *next;
 };
@@ -97,15 +275,34 @@ typedef struct {
     const char* name;
     int arg_count;
     MathFunction func;
+    int raw;            // Какие значения передаются как есть (RAW_VIEW, RAW_SINGLE); остальные
+                        // приводятся к плотной матрице двойной точности
+    int memo;           // MEMO_PURE - результат зависит только от аргументов и кэшируется;
+                        // MEMO_EFFECT - случайность, файлы или чтение переменных по имени;
+                        // MEMO_PRINT - печатает при аргументах верного типа и размера
+                        // (вырожденная матрица, нет сходимости)
 } FunctionDef;
 
+#define RAW_VIEW   1    // Срезы с шагами
+#define RAW_SINGLE 2    // Матрицы одинарной точности
+
+#define MEMO_PURE   1
+#define MEMO_EFFECT 2
+#define MEMO_PRINT  4
+
+// Встроенная функция по имени (main.cpp)
+FunctionDef* find_function(const char* name);
+
 
 
 // Создание
-Container* create_int_container(int value);
+Container* create_int_container(long long value);
 Container* create_float_container(double value);
 Container* create_string_container(const char *value);
 Container* create_vector_container(double x, double y, double z);
+Container* create_matrix_container(int rows, int cols);
+Container* create_sparse_container(SparseContainer *sparse);
+Container* create_list_container(int count, Container **items);
 
 // Управление памятью
 void free_container(Container *container);
@@ -113,12 +310,17 @@ void free_int_container(void *data);
 void free_float_container(void *data);
 void free_string_container(void *data);
 void free_vector_container(void *data);
+void free_matrix_container(void *data);
+void free_sparse_container(void *data);
+void free_list_container(void *data);
 
 // Операции
 Container* get_container(Token* token);
 Container* container_deep_copy(Container *src);
 int        container_compare(Container *a, Container *b);
 double     container_to_double(Container* container);
+int        container_is_scalar(Container* container);
+int        reciprocal_exact(double d);
 
 // Вывод
 void print_container(Container *container);
@@ -126,6 +328,10 @@ void print_int_container(void *data);
 void print_float_container(void *data);
 void print_string_container(void *data);
 void print_vector_container(void *data);
+void print_matrix_container(void *data);
+void print_sparse_container(void *data);
+void print_list_container(void *data);
+void print_smart_double(double value);
 
 
 // Создание токенов
@@ -157,16 +363,24 @@ Token* shuntingYard(Token* tokens);
 
 // Вычислитель: считает результат выражения в обратной польской записи
 Container* countRPN(Token *head);
+Container* countRPN_frame(Token *head, Container **slots);
+
+// Главная функция обработки строки; defer - отложить "x = выражение;" (lazy.cpp)
+void process_expression(char* input, int defer);
+int  expression_quiet(const char* input, char* expr, size_t size);
+void evaluate_rpn(Token* rpn, int quiet, int defer);
 
-// Главная функция обработки строки
-void process_expression(char* input);
 
 
+// Глобальный список переменных (main.cpp)
+extern Ident* FirstIdent;
+
 // Работа с перменными
 Ident* create_ident(char *name, Token *value);
 void   add_ident(Ident **first, Ident *new_ident);
 void   remove_ident(Ident **first, Ident *ident_to_remove);
 Ident* find_ident(Ident *first, const char *name);
+Ident* find_ident_slot(Ident *first, const char *name);
 void   cleanup_global_data(Ident* FirstIdent);
 
 
@@ -184,15 +398,376 @@ Container* log_func(Container** args, int arg_count);
 Container* pow_func(Container** args, int arg_count);
 Container* abs_func(Container** args, int arg_count);
 Container* max_func(Container** args, int arg_count);
+Container* min_func(Container** args, int arg_count);
 
 // Векторные операции
 Container* cross_func(Container** args, int arg_count);
 
+// Поэлементные функции над векторами и матрицами (vmath.cpp)
+typedef enum {
+    EW_SIN,
+    EW_COS,
+    EW_LOG,
+    EW_ABS,
+    EW_POW,
+    EW_MAX,
+    EW_MIN
+} ElementwiseOp;
+
+Container* map_unary(Container *a, ElementwiseOp op);
+Container* map_binary(Container *a, Container *b, ElementwiseOp op, const char *name);
+int        elements_all(Container *a, int (*pred)(double));
+
+// Вычислительные ядра с выбором набора инструкций при запуске (dispatch.cpp)
+typedef enum {
+    ISA_SSE2,
+    ISA_AVX2,
+    ISA_AVX512,
+    ISA_COUNT
+} IsaLevel;
+
+// Размер порции массива для одного вызова ядра
+#define KERNEL_CHUNK 4096
+
+typedef void (*UnaryKernel)(const double *x, double *y, int n);
+typedef void (*BinaryKernel)(const double *a, int sa, const double *b, int sb, double *y, int n);
+
+typedef struct {
+    IsaLevel level;
+    UnaryKernel  unary[EW_ABS + 1];                 // sin, cos, log, abs
+    BinaryKernel binary[EW_MIN - EW_POW + 1];       // pow, max, min (шаг 0 - скалярный операнд)
+    void   (*axpy)(double a, const double *x, double *y, int n);   // y += a*x
+    void   (*scal)(double a, double *x, int n);                    // x *= a
+    void   (*scal_div)(double a, double *x, int n);                // x /= a
+    double (*dot)(const double *x, const double *y, int n);
+    double (*dot_kahan)(const double *x, const double *y, int n);  // С компенсацией Кэхэна
+    double (*sum)(const double *x, int n);
+    double (*sum_kahan)(const double *x, int n);
+    double (*minval)(const double *x, int n);
+    double (*maxval)(const double *x, int n);
+    void   (*saxpy)(float a, const float *x, float *y, int n);     // y += a*x в float
+    float  (*sdot)(const float *x, const float *y, int n);
+} KernelTable;
+
+extern const KernelTable *kernels;
+
+// Варианты ядер под AVX2 и AVX-512 собираются атрибутами GCC из общего тела name##_body.
+// avx512f включает FMA, слияние умножения со сложением отключено, чтобы результаты
+// не зависели от уровня
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ISA_DISPATCH
+#define TARGET_AVX2   __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#define FORCE_INLINE  inline __attribute__((always_inline))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#define FORCE_INLINE  inline
+#endif
+
+#define KERNEL_VARIANTS(ret, name, params, args) \
+    static ret name##_sse2 params { return name##_body args; } \
+    TARGET_AVX2 static ret name##_avx2 params { return name##_body args; } \
+    TARGET_AVX512 static ret name##_avx512 params { return name##_body args; }
+
+#define KERNEL_PICK(name, level) \
+    ((level) == ISA_AVX512 ? name##_avx512 : (level) == ISA_AVX2 ? name##_avx2 : name##_sse2)
+
+void        dispatch_init();
+void        isa_command(const char *arg);
+const char* isa_name(IsaLevel level);
+void        vmath_register(KernelTable *table);
+void        neumaier_add(double *sum, double *comp, double x);
+
+// Функции пользователя: f(x, y) = выражение (userfunc.cpp)
+typedef struct UserFunction UserFunction;
+
+int           user_define(Token *tokens);
+UserFunction* find_user_function(const char *name);
+int           user_param_count(const UserFunction *f);
+Container*    user_call(UserFunction *f, Container **args);
+Token*        user_inline(Token *rpn);
+Token*        user_expand(Token *rpn);
+void          user_cleanup();
+
+// Учет памяти по подсистемам и лимит (mem.cpp)
+typedef enum {
+    MEM_TOKENS,         // Токены лексера, ОПЗ и стека вычислителя
+    MEM_CONTAINERS,     // Контейнеры и элементы матриц
+    MEM_VARIABLES,      // Записи переменных
+    MEM_CACHES,         // Кэши разложений и результатов memo
+    MEM_SCRATCH,        // Рабочие буферы функций (ключи сортировки, тайлы)
+    MEM_KINDS
+} MemKind;
+
+void*  mem_alloc(MemKind kind, size_t bytes);
+void*  mem_calloc(MemKind kind, size_t count, size_t size);
+char*  mem_strdup(MemKind kind, const char *s);
+void   mem_free(MemKind kind, void *p);
+void   mem_untrack(MemKind kind, void *p);
+void   mem_transfer(MemKind from, MemKind to, size_t bytes);
+void   mem_mark_begin();
+void   mem_mark_end();
+void   mem_counters(unsigned long long *allocations, unsigned long long *bytes);
+size_t container_bytes(Container *c);
+void   mem_command(const char *arg);
+int    mem_limited();
+
+// Кэш результатов чистых функций (memo.cpp)
+Container* memo_call(const FunctionDef *f, Container **args, int count);
+void       memo_clear();
+int        memo_evict_oldest();
+void       memo_command(const char *arg);
+
+extern int memo_enabled;
+
+// Отложенные вычисления переменных (lazy.cpp)
+int    lazy_defer(Token *rpn);
+Ident* lazy_force(Ident *ident);
+void   lazy_drop(Ident *ident);
+void   lazy_invalidate(const char *name);
+void   lazy_force_all();
+int    lazy_reads(const Token *rpn, const char *name);
+void   lazy_command(const char *arg);
+
+extern int lazy_enabled;
+
+// Замеры времени выражений и сценариев (bench.cpp)
+void timeit_command(const char *expr);
+void bench_command(const char *arg);
+
+// Слияние цепочек поэлементных операций в один проход (fuse.cpp)
+#define FUSE_MAX_CHAINS 16
+
+typedef struct {
+    Token *start;       // Первый токен поддерева в ОПЗ
+    Token *end;         // Корневой оператор поддерева
+} FuseChain;
+
+int        token_arity(const Token *t);
+int        fuse_find_chains(Token *head, FuseChain *chains, int max_chains);
+FuseChain* fuse_chain_at(FuseChain *chains, int count, const Token *token);
+Container* fuse_eval(const FuseChain *chain, Container **slots);
+void       fuse_benchmark(int n);
+
+// Плотные матрицы
+Container* matrix_literal(Container** items, int count);
+Container* container_to_matrix(Container *container);
+double*    container_values(Container *container, int *count);
+Container* matrix_copy(MatrixContainer *m);
+MatrixCache* matrix_cache_get(MatrixCache **slot);
+MatrixCache* matrix_cache_share(MatrixCache **slot);
+void       matrix_cache_release(MatrixCache *cache);
+MatrixCache** container_cache_slot(Container *container);
+int        matrix_compare(MatrixContainer *a, MatrixContainer *b);
+Container* matrix_mul(Container *a, Container *b);
+Container* matrix_add(Container *a, Container *b, double sign);
+Container* matrix_scale(Container *a, double scalar);
+Container* matrix_divide(Container *a, double divisor);
+void       gemm(int m, int n, int k, double alpha, const double *A, int lda,
+                const double *B, int ldb, double beta, double *C, int ldc);
+int        gemm_strided(int m, int n, int k, const double *A, int a_rs, int a_cs,
+                        const double *B, int b_rs, int b_cs, double *C);
+Container* zeros_func(Container** args, int arg_count);
+Container* eye_func(Container** args, int arg_count);
+Container* rand_func(Container** args, int arg_count);
+int        arg_to_size(Container *arg, const char *func_name, int *out);
+
+// Разреженные матрицы
+SparseContainer* sparse_alloc(SparseFormat format, int rows, int cols, int nnz);
+void             sparse_free(SparseContainer *sp);
+SparseContainer* sparse_from_coo(int rows, int cols, int nnz, const int *ri, const int *ci,
+                                 const double *v, SparseFormat format);
+SparseContainer* sparse_convert(const SparseContainer *sp, SparseFormat format);
+SparseContainer* sparse_from_dense(const MatrixContainer *m);
+Container*       sparse_to_dense(const SparseContainer *sp);
+Container*       sparse_copy(SparseContainer *sp);
+int              sparse_compare(const SparseContainer *a, const SparseContainer *b);
+Container*       sparse_load_mm(const char *filename);
+void             sparse_spmm(const SparseContainer *sp, const double *B, int k, double *C);
+void             dense_sparse_mm(const double *A, int m, const SparseContainer *sp, double *C);
+void             sparse_benchmark(int n);
+Container* sparse_func(Container** args, int arg_count);
+Container* dense_func(Container** args, int arg_count);
+Container* csr_func(Container** args, int arg_count);
+Container* csc_func(Container** args, int arg_count);
+Container* nnz_func(Container** args, int arg_count);
+Container* mmread_func(Container** args, int arg_count);
+Container* sprand_func(Container** args, int arg_count);
+
+// Линейная алгебра
+LUFactor*  lu_factor(const double *a, int n);
+void       lu_free(LUFactor *lu);
+void       lu_solve(const LUFactor *lu, double *B, int k);
+LUFactor*  matrix_lu(Container *a);
+Container* lu_func(Container** args, int arg_count);
+Container* solve_func(Container** args, int arg_count);
+Container* det_func(Container** args, int arg_count);
+Container* inv_func(Container** args, int arg_count);
+Container* get_func(Container** args, int arg_count);
+CholFactor* chol_factor(const double *a, int n);
+void       chol_free(CholFactor *chol);
+void       chol_solve(const CholFactor *chol, double *B, int k);
+QRFactor*  qr_factor(const double *a, int rows, int cols);
+void       qr_free(QRFactor *qr);
+void       qr_apply_qt(const QRFactor *qr, double *B, int k);
+void       qr_form_q(const QRFactor *qr, double *Q, int k);
+MatrixContainer* dense_view(Container *a, Container **temp);
+CholFactor* matrix_chol(Container *a, int report);
+Container* chol_func(Container** args, int arg_count);
+Container* qr_func(Container** args, int arg_count);
+Container* lstsq_func(Container** args, int arg_count);
+Container* spd_func(Container** args, int arg_count);
+
+// Итерационные методы (krylov.cpp)
+Container* cg_func(Container** args, int arg_count);
+Container* bicgstab_func(Container** args, int arg_count);
+Container* gmres_func(Container** args, int arg_count);
+
+// Поля 3-векторов (field.cpp)
+Container* create_field_container(int count);
+void       free_field_container(void *data);
+void       print_field_container(void *data);
+Container* field_copy(FieldContainer *f);
+int        field_compare(FieldContainer *a, FieldContainer *b);
+Container* field_to_matrix(FieldContainer *f);
+Container* field_add(Container *a, Container *b, double sign);
+Container* field_mul(Container *a, Container *b);
+Container* field_div(Container *a, Container *b);
+Container* field_cross(Container *a, Container *b);
+Container* field_norms(Container *a);
+Container* field_func(Container** args, int arg_count);
+
+// Малые матрицы 2x2 - 4x4 и кватернионы (small.cpp)
+#define SMALL_MIN 2
+#define SMALL_MAX 4
+void       small_matmul(int n, const double *a, const double *b, double *c);
+void       small_matvec(int n, const double *a, const double *x, double *y);
+double     small_det(int n, const double *a);
+int        small_inv(int n, const double *a, double *out);
+Container* small_matrix_mul(Container *a, Container *b);
+Container* create_quat_container(double w, double x, double y, double z);
+void       free_quat_container(void *data);
+void       print_quat_container(void *data);
+int        quat_compare(QuatContainer *a, QuatContainer *b);
+Container* quat_add(Container *a, Container *b, double sign);
+Container* quat_mul(Container *a, Container *b);
+Container* quat_div(Container *a, Container *b);
+Container* quat_inverse(Container *a);
+Container* quat_norm(Container *a);
+Container* quat_func(Container** args, int arg_count);
+Container* rotm_func(Container** args, int arg_count);
+
+// Срезы и транспонирование без копирования (view.cpp)
+MatrixBuffer* matrix_share_buffer(MatrixContainer *m);
+void       matrix_buffer_release(MatrixBuffer *buffer);
+Container* create_view_container(int rows, int cols, double *data, int row_stride, int col_stride,
+                                 MatrixBuffer *buffer);
+void       free_view_container(void *data);
+void       print_view_container(void *data);
+Container* view_copy(ViewContainer *v);
+Container* view_to_matrix(ViewContainer *v);
+int        strided_operand(Container *c, ViewContainer *out);
+void       args_materialize(Container **args, int count, int raw);
+Container* create_range_container(int has_start, int start, int has_stop, int stop, int step);
+void       free_range_container(void *data);
+void       print_range_container(void *data);
+Container* range_func(Container** args, int arg_count);
+Container* index_func(Container** args, int arg_count);
+Container* transpose_func(Container** args, int arg_count);
+
+// Матрицы на диске и умножение по тайлам (disk.cpp)
+// Тайл 1024 x 1024 (8 МиБ) кратен гранулярности отображения файлов (64 КиБ)
+#define DISK_TILE   1024
+#define DISK_HEADER 65536
+void       free_disk_container(void *data);
+void       print_disk_container(void *data);
+Container* disk_copy(DiskContainer *d);
+Container* disk_to_matrix(DiskContainer *d);
+Container* disk_func(Container** args, int arg_count);
+Container* diskrand_func(Container** args, int arg_count);
+Container* diskmul_func(Container** args, int arg_count);
+void       disk_benchmark(int n);
+
+// Одинарная и смешанная точность (single.cpp)
+Container* create_single_container(int rows, int cols);
+void       free_single_container(void *data);
+void       print_single_container(void *data);
+Container* single_copy(SingleContainer *s);
+int        single_compare(SingleContainer *a, SingleContainer *b);
+Container* single_to_matrix(SingleContainer *s);
+Container* matrix_to_single(Container *c);
+void       sgemm(int m, int n, int k, float alpha, const float *A, int lda,
+                 const float *B, int ldb, float beta, float *C, int ldc);
+SingleLU*  slu_factor(const float *a, int n);
+void       slu_free(SingleLU *f);
+int        solve_refined(Container *a, double *X, int k);
+Container* single_scale(Container *a, double scalar);
+Container* single_divide(Container *a, double divisor);
+Container* single_add(Container *a, Container *b, double sign);
+Container* single_mul(Container *a, Container *b);
+Container* single_func(Container** args, int arg_count);
+Container* double_func(Container** args, int arg_count);
+Container* precision_apply(Container *result);
+void       precision_command(const char *arg);
+
+// Комплексные массивы, БПФ и свертка (fft.cpp)
+Container* create_complex_container(int rows, int cols);
+void       free_complex_container(void *data);
+void       print_complex_container(void *data);
+Container* complex_copy(ComplexContainer *z);
+int        complex_compare(ComplexContainer *a, ComplexContainer *b);
+Container* complex_add(Container *a, Container *b, double sign);
+Container* complex_scale(Container *a, double scalar);
+Container* complex_divide(Container *a, double divisor);
+Container* complex_mul(Container *a, Container *b);
+Container* complex_abs(Container *a);
+Container* complex_func(Container** args, int arg_count);
+Container* real_func(Container** args, int arg_count);
+Container* imag_func(Container** args, int arg_count);
+Container* conj_func(Container** args, int arg_count);
+Container* angle_func(Container** args, int arg_count);
+Container* fft_func(Container** args, int arg_count);
+Container* ifft_func(Container** args, int arg_count);
+Container* fft2_func(Container** args, int arg_count);
+Container* ifft2_func(Container** args, int arg_count);
+Container* rfft_func(Container** args, int arg_count);
+Container* conv_func(Container** args, int arg_count);
+
+// Автоматическое дифференцирование (autodiff.cpp)
+Container* grad_func(Container** args, int arg_count);
+
+// Сортировка и порядковые статистики (sort.cpp)
+Container* sort_func(Container** args, int arg_count);
+Container* argsort_func(Container** args, int arg_count);
+Container* median_func(Container** args, int arg_count);
+Container* quantile_func(Container** args, int arg_count);
+
+// Свертки массивов (reduce.cpp)
+Container* sum_func(Container** args, int arg_count);
+Container* mean_func(Container** args, int arg_count);
+Container* norm_func(Container** args, int arg_count);
+Container* dot_func(Container** args, int arg_count);
+Container* extremum_reduce(Container** args, int arg_count, int is_max, const char *name);
+
+// Собственные значения и SVD (eigen.cpp)
+Container* eig_func(Container** args, int arg_count);
+Container* svd_func(Container** args, int arg_count);
+Container* svds_func(Container** args, int arg_count);
+
+// Служебные
+double             wall_time();
+unsigned long long rand_next();
+double             rand_uniform();
+
 // Логирование
 void print_log(const char* format, ...);
+int  log_mute(int muted);       // Только для текущего потока; возвращает прежнее состояние
 
-// Работа с файлами
+// Работа с файлами; сценарий разбирается в потоках впереди вычисления (file_parse.cpp)
 void execute_from_file(const char* filename);
+int  execute_script(const char* filename, int echo);
+void pipeline_benchmark(int n);
 void clear_file(const char* filename);
 void copy_file(const char* src_name, const char* dst_name);
 void append_to_file(const char* filename, const char* text);
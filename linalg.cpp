@@ -0,0 +1,973 @@
+#include "lib.h"
+
+// Ширина блока столбцов в блочном LU-разложении
+#define LU_BLOCK 64
+
+// Ширина полосы столбцов при решении треугольных систем
+#define TRSM_BLOCK 256
+
+// Ширина блока в разложении Холецкого и QR
+#define CHOL_BLOCK 64
+#define QR_BLOCK   32
+
+
+void lu_free(LUFactor *lu) {
+    if (lu) {
+        mem_free(MEM_CACHES, lu->lu);
+        mem_free(MEM_CACHES, lu->piv);
+        free(lu);
+    }
+}
+
+// Разложение панели столбцов [k, k+nb) с выбором ведущего элемента; строки меняются целиком
+static void lu_panel(LUFactor *f, int k, int nb) {
+    int n = f->n;
+    double *a = f->lu;
+
+    for (int j = k; j < k + nb; j++) {
+        int p = j;
+        double best = fabs(a[(size_t)j * n + j]);
+        for (int i = j + 1; i < n; i++) {
+            double value = fabs(a[(size_t)i * n + j]);
+            if (value > best) {
+                best = value;
+                p = i;
+            }
+        }
+
+        f->piv[j] = p;
+        if (best == 0.0) {
+            f->singular = 1;
+            continue;
+        }
+
+        if (p != j) {
+            double *rj = a + (size_t)j * n;
+            double *rp = a + (size_t)p * n;
+            for (int c = 0; c < n; c++) {
+                double t = rj[c];
+                rj[c] = rp[c];
+                rp[c] = t;
+            }
+            f->sign = -f->sign;
+        }
+
+        // Столбец L и обновление оставшихся столбцов панели
+        const double *urow = a + (size_t)j * n;
+        double inv = 1.0 / urow[j];
+        double work = (double)(n - j) * (k + nb - j);
+
+        #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = j + 1; i < n; i++) {
+            double *row = a + (size_t)i * n;
+            double l = row[j] * inv;
+            row[j] = l;
+            for (int c = j + 1; c < k + nb; c++) {
+                row[c] -= l * urow[c];
+            }
+        }
+    }
+}
+
+// Строки U12 = L11^-1 * A12 для блока [k, k+nb); полосы столбцов обрабатываются параллельно
+static void lu_trsm(LUFactor *f, int k, int nb) {
+    int n = f->n;
+    double *a = f->lu;
+    int first = k + nb;
+    double work = (double)nb * nb * (n - first);
+
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+    for (int c0 = first; c0 < n; c0 += TRSM_BLOCK) {
+        int c1 = c0 + TRSM_BLOCK < n ? c0 + TRSM_BLOCK : n;
+        for (int i = k + 1; i < k + nb; i++) {
+            double *row = a + (size_t)i * n;
+            for (int p = k; p < i; p++) {
+                double l = row[p];
+                if (l == 0.0) continue;
+                const double *up = a + (size_t)p * n;
+                for (int c = c0; c < c1; c++) {
+                    row[c] -= l * up[c];
+                }
+            }
+        }
+    }
+}
+
+// Блочное правостороннее LU-разложение: панель, треугольное решение и GEMM для остатка
+LUFactor* lu_factor(const double *a, int n) {
+    LUFactor *f = (LUFactor*)malloc(sizeof(LUFactor));
+    if (!f) return NULL;
+
+    f->n = n;
+    f->sign = 1;
+    f->singular = 0;
+    f->lu = (double*)mem_alloc(MEM_CACHES, (size_t)n * n * sizeof(double));
+    f->piv = (int*)mem_alloc(MEM_CACHES, (size_t)n * sizeof(int));
+    if (!f->lu || !f->piv) {
+        print_log("Ошибка: недостаточно памяти для разложения %dx%d\n", n, n);
+        lu_free(f);
+        return NULL;
+    }
+    memcpy(f->lu, a, (size_t)n * n * sizeof(double));
+
+    for (int k = 0; k < n; k += LU_BLOCK) {
+        int nb = k + LU_BLOCK < n ? LU_BLOCK : n - k;
+
+        lu_panel(f, k, nb);
+
+        int rest = n - k - nb;
+        if (rest > 0) {
+            lu_trsm(f, k, nb);
+
+            // A22 -= L21 * U12
+            double *a21 = f->lu + (size_t)(k + nb) * n + k;
+            double *u12 = f->lu + (size_t)k * n + k + nb;
+            double *a22 = f->lu + (size_t)(k + nb) * n + k + nb;
+            gemm(rest, rest, nb, -1.0, a21, n, u12, n, 1.0, a22, n);
+        }
+    }
+    return f;
+}
+
+// Решение A*X = B по готовому разложению; B (n x k, по строкам) заменяется на X
+void lu_solve(const LUFactor *f, double *B, int k) {
+    int n = f->n;
+    const double *a = f->lu;
+
+    for (int i = 0; i < n; i++) {
+        int p = f->piv[i];
+        if (p != i) {
+            double *bi = B + (size_t)i * k;
+            double *bp = B + (size_t)p * k;
+            for (int c = 0; c < k; c++) {
+                double t = bi[c];
+                bi[c] = bp[c];
+                bp[c] = t;
+            }
+        }
+    }
+
+    // Прямой ход с L (единичная диагональ)
+    for (int i = 1; i < n; i++) {
+        const double *row = a + (size_t)i * n;
+        double *bi = B + (size_t)i * k;
+        for (int p = 0; p < i; p++) {
+            double l = row[p];
+            if (l == 0.0) continue;
+            const double *bp = B + (size_t)p * k;
+            for (int c = 0; c < k; c++) bi[c] -= l * bp[c];
+        }
+    }
+
+    // Обратный ход с U
+    for (int i = n - 1; i >= 0; i--) {
+        const double *row = a + (size_t)i * n;
+        double *bi = B + (size_t)i * k;
+        for (int p = i + 1; p < n; p++) {
+            double u = row[p];
+            if (u == 0.0) continue;
+            const double *bp = B + (size_t)p * k;
+            for (int c = 0; c < k; c++) bi[c] -= u * bp[c];
+        }
+        double inv = 1.0 / row[i];
+        for (int c = 0; c < k; c++) bi[c] *= inv;
+    }
+}
+
+void chol_free(CholFactor *chol) {
+    if (chol) {
+        mem_free(MEM_CACHES, chol->l);
+        free(chol);
+    }
+}
+
+// Разложение диагонального блока [k, k+nb); 0, если матрица не положительно определена
+static int chol_block(double *a, int n, int k, int nb) {
+    for (int j = k; j < k + nb; j++) {
+        double *rj = a + (size_t)j * n;
+        double d = rj[j];
+        for (int p = k; p < j; p++) d -= rj[p] * rj[p];
+        if (!(d > 0.0)) return 0;
+        rj[j] = sqrt(d);
+
+        for (int i = j + 1; i < k + nb; i++) {
+            double *ri = a + (size_t)i * n;
+            double sum = ri[j];
+            for (int p = k; p < j; p++) sum -= ri[p] * rj[p];
+            ri[j] = sum / rj[j];
+        }
+    }
+    return 1;
+}
+
+// Блочное разложение Холецкого: блок диагонали, столбец L21 и симметричное обновление остатка
+CholFactor* chol_factor(const double *a, int n) {
+    CholFactor *f = (CholFactor*)malloc(sizeof(CholFactor));
+    if (!f) return NULL;
+
+    f->n = n;
+    f->l = (double*)mem_alloc(MEM_CACHES, (size_t)n * n * sizeof(double));
+    if (!f->l) {
+        print_log("Ошибка: недостаточно памяти для разложения %dx%d\n", n, n);
+        chol_free(f);
+        return NULL;
+    }
+    memcpy(f->l, a, (size_t)n * n * sizeof(double));
+    double *l = f->l;
+
+    for (int k = 0; k < n; k += CHOL_BLOCK) {
+        int nb = k + CHOL_BLOCK < n ? CHOL_BLOCK : n - k;
+
+        if (!chol_block(l, n, k, nb)) {
+            chol_free(f);
+            return NULL;
+        }
+
+        int first = k + nb;
+        double work = (double)(n - first) * nb * nb;
+
+        // L21 = A21 * L11^-T, строки независимы
+        #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = first; i < n; i++) {
+            double *ri = l + (size_t)i * n;
+            for (int j = k; j < first; j++) {
+                const double *rj = l + (size_t)j * n;
+                double sum = ri[j];
+                for (int p = k; p < j; p++) sum -= ri[p] * rj[p];
+                ri[j] = sum / rj[j];
+            }
+        }
+
+        // A22 -= L21 * L21^T, только нижний треугольник
+        work = (double)(n - first) * (n - first) * nb / 2;
+        #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(dynamic, 16)
+        for (int i = first; i < n; i++) {
+            double *ri = l + (size_t)i * n;
+            for (int j = first; j <= i; j++) {
+                const double *rj = l + (size_t)j * n;
+                double sum = 0.0;
+                for (int p = k; p < first; p++) sum += ri[p] * rj[p];
+                ri[j] -= sum;
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) l[(size_t)i * n + j] = 0.0;
+    }
+    return f;
+}
+
+// Решение A*X = B по разложению Холецкого; B (n x k) заменяется на X
+void chol_solve(const CholFactor *f, double *B, int k) {
+    int n = f->n;
+    const double *l = f->l;
+
+    // L*Y = B
+    for (int i = 0; i < n; i++) {
+        const double *row = l + (size_t)i * n;
+        double *bi = B + (size_t)i * k;
+        for (int p = 0; p < i; p++) {
+            double v = row[p];
+            if (v == 0.0) continue;
+            const double *bp = B + (size_t)p * k;
+            for (int c = 0; c < k; c++) bi[c] -= v * bp[c];
+        }
+        double inv = 1.0 / row[i];
+        for (int c = 0; c < k; c++) bi[c] *= inv;
+    }
+
+    // L^T*X = Y: после нахождения строки i она вычитается из предыдущих по строке i матрицы L
+    for (int i = n - 1; i >= 0; i--) {
+        const double *row = l + (size_t)i * n;
+        double *bi = B + (size_t)i * k;
+        double inv = 1.0 / row[i];
+        for (int c = 0; c < k; c++) bi[c] *= inv;
+        for (int p = 0; p < i; p++) {
+            double v = row[p];
+            if (v == 0.0) continue;
+            double *bp = B + (size_t)p * k;
+            for (int c = 0; c < k; c++) bp[c] -= v * bi[c];
+        }
+    }
+}
+
+
+void qr_free(QRFactor *qr) {
+    if (qr) {
+        mem_free(MEM_CACHES, qr->qr);
+        mem_free(MEM_CACHES, qr->tau);
+        free(qr);
+    }
+}
+
+// Отражение Хаусхолдера для столбца j: R(j, j) и вектор v (v_j = 1) записываются на место столбца
+static double qr_house(double *a, int m, int n, int j) {
+    double alpha = a[(size_t)j * n + j];
+    double sigma = 0.0;
+    for (int i = j + 1; i < m; i++) {
+        double x = a[(size_t)i * n + j];
+        sigma += x * x;
+    }
+    if (sigma == 0.0) return 0.0;
+
+    double beta = -copysign(sqrt(alpha * alpha + sigma), alpha);
+    double scale = 1.0 / (alpha - beta);
+    for (int i = j + 1; i < m; i++) a[(size_t)i * n + j] *= scale;
+    a[(size_t)j * n + j] = beta;
+    return (beta - alpha) / beta;
+}
+
+// Применение отражения H_j к столбцам [c0, c1) строк [j, m); w - рабочий массив
+static void qr_apply_house(double *a, int m, int n, int j, double tau, int c0, int c1, double *w) {
+    if (tau == 0.0 || c0 >= c1) return;
+
+    const double *rj = a + (size_t)j * n;
+    for (int c = c0; c < c1; c++) w[c] = rj[c];
+    for (int i = j + 1; i < m; i++) {
+        const double *ri = a + (size_t)i * n;
+        double v = ri[j];
+        for (int c = c0; c < c1; c++) w[c] += v * ri[c];
+    }
+
+    double work = (double)(m - j) * (c1 - c0);
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+    for (int i = j; i < m; i++) {
+        double *ri = a + (size_t)i * n;
+        double v = i == j ? 1.0 : ri[j];
+        double tv = tau * v;
+        for (int c = c0; c < c1; c++) ri[c] -= tv * w[c];
+    }
+}
+
+// Применение блока отражений (I - V*T*V^T)^T к столбцам справа от панели через GEMM
+static void qr_apply_block(QRFactor *f, int k0, int nb) {
+    int m = f->rows, n = f->cols;
+    int mm = m - k0;
+    int c0 = k0 + nb;
+    int nc = n - c0;
+    double *a = f->qr;
+
+    double *V = (double*)calloc((size_t)mm * nb, sizeof(double));
+    double *Vt = (double*)malloc((size_t)nb * mm * sizeof(double));
+    double *T = (double*)calloc((size_t)nb * nb, sizeof(double));
+    double *W = (double*)malloc((size_t)nb * nc * sizeof(double));
+    if (!V || !Vt || !T || !W) {
+        // Нехватка памяти: отражения применяются по одному
+        double *w = (double*)malloc((size_t)n * sizeof(double));
+        for (int j = k0; w && j < k0 + nb; j++) qr_apply_house(a, m, n, j, f->tau[j], c0, n, w);
+        free(w);
+        free(V);
+        free(Vt);
+        free(T);
+        free(W);
+        return;
+    }
+
+    for (int i = 0; i < mm; i++) {
+        for (int p = 0; p < nb && p <= i; p++) {
+            double v = i == p ? 1.0 : a[(size_t)(k0 + i) * n + k0 + p];
+            V[(size_t)i * nb + p] = v;
+            Vt[(size_t)p * mm + i] = v;
+        }
+    }
+    for (int p = 0; p < nb; p++) {
+        for (int i = 0; i < p; i++) Vt[(size_t)p * mm + i] = 0.0;
+    }
+
+    // Верхнетреугольная T: H_1 * ... * H_nb = I - V*T*V^T
+    for (int i = 0; i < nb; i++) {
+        double tau = f->tau[k0 + i];
+        T[(size_t)i * nb + i] = tau;
+        for (int r = 0; r < i; r++) {
+            double z = 0.0;
+            for (int row = i; row < mm; row++) z += Vt[(size_t)r * mm + row] * Vt[(size_t)i * mm + row];
+            T[(size_t)r * nb + i] = z;
+        }
+        for (int r = 0; r < i; r++) {
+            double sum = 0.0;
+            for (int q = r; q < i; q++) sum += T[(size_t)r * nb + q] * T[(size_t)q * nb + i];
+            W[r] = sum;
+        }
+        for (int r = 0; r < i; r++) T[(size_t)r * nb + i] = -tau * W[r];
+    }
+
+    double *C = a + (size_t)k0 * n + c0;
+
+    // W = V^T * C
+    gemm(nb, nc, mm, 1.0, Vt, mm, C, n, 0.0, W, nc);
+
+    // W = T^T * W (снизу вверх, чтобы не затирать нужные строки)
+    for (int i = nb - 1; i >= 0; i--) {
+        double *wi = W + (size_t)i * nc;
+        double tii = T[(size_t)i * nb + i];
+        for (int c = 0; c < nc; c++) wi[c] *= tii;
+        for (int r = 0; r < i; r++) {
+            double t = T[(size_t)r * nb + i];
+            if (t == 0.0) continue;
+            const double *wr = W + (size_t)r * nc;
+            for (int c = 0; c < nc; c++) wi[c] += t * wr[c];
+        }
+    }
+
+    // C -= V * W
+    gemm(mm, nc, nb, -1.0, V, nb, W, nc, 1.0, C, n);
+
+    free(V);
+    free(Vt);
+    free(T);
+    free(W);
+}
+
+// Блочное QR-разложение: панель отражениями по одному, остаток блочным отражением
+QRFactor* qr_factor(const double *a, int rows, int cols) {
+    QRFactor *f = (QRFactor*)malloc(sizeof(QRFactor));
+    if (!f) return NULL;
+
+    int kmin = rows < cols ? rows : cols;
+    f->rows = rows;
+    f->cols = cols;
+    f->qr = (double*)mem_alloc(MEM_CACHES, (size_t)rows * cols * sizeof(double));
+    f->tau = (double*)mem_alloc(MEM_CACHES, (size_t)(kmin > 0 ? kmin : 1) * sizeof(double));
+    double *w = (double*)malloc((size_t)cols * sizeof(double));
+    if (!f->qr || !f->tau || !w) {
+        print_log("Ошибка: недостаточно памяти для разложения %dx%d\n", rows, cols);
+        free(w);
+        qr_free(f);
+        return NULL;
+    }
+    memcpy(f->qr, a, (size_t)rows * cols * sizeof(double));
+
+    for (int k0 = 0; k0 < kmin; k0 += QR_BLOCK) {
+        int nb = k0 + QR_BLOCK < kmin ? QR_BLOCK : kmin - k0;
+
+        for (int j = k0; j < k0 + nb; j++) {
+            f->tau[j] = qr_house(f->qr, rows, cols, j);
+            qr_apply_house(f->qr, rows, cols, j, f->tau[j], j + 1, k0 + nb, w);
+        }
+        if (k0 + nb < cols) qr_apply_block(f, k0, nb);
+    }
+
+    free(w);
+    return f;
+}
+
+// B = Q^T * B, B (rows x k)
+void qr_apply_qt(const QRFactor *f, double *B, int k) {
+    int m = f->rows, n = f->cols;
+    int kmin = m < n ? m : n;
+    double *w = (double*)malloc((size_t)k * sizeof(double));
+
+    for (int j = 0; j < kmin; j++) {
+        double tau = f->tau[j];
+        if (tau == 0.0) continue;
+
+        double *bj = B + (size_t)j * k;
+        for (int c = 0; c < k; c++) w[c] = bj[c];
+        for (int i = j + 1; i < m; i++) {
+            double v = f->qr[(size_t)i * n + j];
+            const double *bi = B + (size_t)i * k;
+            for (int c = 0; c < k; c++) w[c] += v * bi[c];
+        }
+        for (int c = 0; c < k; c++) bj[c] -= tau * w[c];
+        for (int i = j + 1; i < m; i++) {
+            double tv = tau * f->qr[(size_t)i * n + j];
+            double *bi = B + (size_t)i * k;
+            for (int c = 0; c < k; c++) bi[c] -= tv * w[c];
+        }
+    }
+    free(w);
+}
+
+// Первые k столбцов Q = H_1 * ... * H_k (Q: rows x k), отражения применяются в обратном порядке
+void qr_form_q(const QRFactor *f, double *Q, int k) {
+    int m = f->rows, n = f->cols;
+    memset(Q, 0, (size_t)m * k * sizeof(double));
+    for (int i = 0; i < k; i++) Q[(size_t)i * k + i] = 1.0;
+
+    double *w = (double*)malloc((size_t)k * sizeof(double));
+    for (int j = k - 1; j >= 0; j--) {
+        double tau = f->tau[j];
+        if (tau == 0.0) continue;
+
+        for (int c = 0; c < k; c++) w[c] = Q[(size_t)j * k + c];
+        for (int i = j + 1; i < m; i++) {
+            double v = f->qr[(size_t)i * n + j];
+            for (int c = 0; c < k; c++) w[c] += v * Q[(size_t)i * k + c];
+        }
+        for (int c = 0; c < k; c++) Q[(size_t)j * k + c] -= tau * w[c];
+        for (int i = j + 1; i < m; i++) {
+            double tv = tau * f->qr[(size_t)i * n + j];
+            for (int c = 0; c < k; c++) Q[(size_t)i * k + c] -= tv * w[c];
+        }
+    }
+    free(w);
+}
+
+
+// Плотное представление матрицы; для разреженной матрицы и среза создается временная копия в *temp
+MatrixContainer* dense_view(Container *a, Container **temp) {
+    *temp = NULL;
+    if (a->type == CT_MATRIX) return (MatrixContainer*)a->data;
+    if (a->type == CT_VIEW) *temp = view_to_matrix((ViewContainer*)a->data);
+    else if (a->type == CT_SPARSE) *temp = sparse_to_dense((SparseContainer*)a->data);
+    else if (a->type == CT_SINGLE) *temp = single_to_matrix((SingleContainer*)a->data);
+    else return NULL;
+
+    return *temp ? (MatrixContainer*)(*temp)->data : NULL;
+}
+
+// LU-разложение матрицы из кэша значения; при отсутствии вычисляется и сохраняется
+LUFactor* matrix_lu(Container *a) {
+    MatrixCache **slot = container_cache_slot(a);
+    if (!slot) {
+        print_log("Ошибка: ожидается матрица\n");
+        return NULL;
+    }
+    if (*slot && (*slot)->lu) return (*slot)->lu;
+
+    Container *dense;
+    MatrixContainer *mc = dense_view(a, &dense);
+    if (!mc) return NULL;
+
+    if (mc->rows != mc->cols) {
+        print_log("Ошибка: матрица %dx%d не квадратная\n", mc->rows, mc->cols);
+        free_container(dense);
+        return NULL;
+    }
+
+    LUFactor *lu = lu_factor(mc->data, mc->rows);
+    free_container(dense);
+    if (!lu) return NULL;
+
+    matrix_cache_get(slot)->lu = lu;
+    return lu;
+}
+
+
+// LU-разложение: lu(A) возвращает (L, U, P), где P*A = L*U
+Container* lu_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("lu: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    LUFactor *f = matrix_lu(args[0]);
+    if (!f) return NULL;
+
+    int n = f->n;
+    Container *items[3];
+    items[0] = create_matrix_container(n, n);
+    items[1] = create_matrix_container(n, n);
+    items[2] = create_matrix_container(n, n);
+    if (!items[0] || !items[1] || !items[2]) {
+        for (int i = 0; i < 3; i++) free_container(items[i]);
+        return NULL;
+    }
+
+    double *L = ((MatrixContainer*)items[0]->data)->data;
+    double *U = ((MatrixContainer*)items[1]->data)->data;
+    double *P = ((MatrixContainer*)items[2]->data)->data;
+
+    for (int i = 0; i < n; i++) {
+        const double *row = f->lu + (size_t)i * n;
+        for (int j = 0; j < n; j++) {
+            if (j < i) L[(size_t)i * n + j] = row[j];
+            else U[(size_t)i * n + j] = row[j];
+        }
+        L[(size_t)i * n + i] = 1.0;
+    }
+
+    // Перестановка строк, накопленная по обменам piv
+    int *perm = (int*)malloc((size_t)n * sizeof(int));
+    for (int i = 0; i < n; i++) perm[i] = i;
+    for (int i = 0; i < n; i++) {
+        int t = perm[i];
+        perm[i] = perm[f->piv[i]];
+        perm[f->piv[i]] = t;
+    }
+    for (int i = 0; i < n; i++) P[(size_t)i * n + perm[i]] = 1.0;
+    free(perm);
+
+    return create_list_container(3, items);
+}
+
+// Решение системы A*x = b; b может быть вектором или матрицей из нескольких столбцов
+Container* solve_func(Container** args, int arg_count) {
+    if (arg_count != 2 && arg_count != 3) {
+        print_log("solve: ожидается 2 или 3 аргумента\n");
+        return NULL;
+    }
+    if (!args[0] || !args[1]) return NULL;
+
+    // Смешанная точность: разложение в float и уточнение решения до double.
+    // Для матрицы одинарной точности включается само
+    int mixed = args[0]->type == CT_SINGLE;
+    if (arg_count == 3) {
+        if (!args[2] || args[2]->type != CT_STRING || strcmp(((StringContainer*)args[2]->data)->value, "mixed") != 0) {
+            print_log("solve: третий аргумент может быть только \"mixed\"\n");
+            return NULL;
+        }
+        mixed = 1;
+    }
+    if (mixed) {
+        Container *x = container_to_matrix(args[1]);
+        MatrixContainer *xm = x ? (MatrixContainer*)x->data : NULL;
+        MatrixCache **slot = container_cache_slot(args[0]);
+        int n = 0;
+        if (slot && args[0]->type == CT_SINGLE) n = ((SingleContainer*)args[0]->data)->rows;
+        else if (slot && args[0]->type == CT_MATRIX) n = ((MatrixContainer*)args[0]->data)->rows;
+
+        if (xm && n == xm->rows && solve_refined(args[0], xm->data, xm->cols)) {
+            if (args[1]->type == CT_VECTOR) {
+                Container *vec = create_vector_container(xm->data[0], xm->data[1], xm->data[2]);
+                free_container(x);
+                return vec;
+            }
+            return x;
+        }
+        // Не сошлось или размеры не подошли: обычное решение в double (оно же сообщит об ошибке)
+        free_container(x);
+    }
+
+    // Для симметричных положительно определенных матриц вдвое дешевле разложение Холецкого
+    CholFactor *chol = matrix_chol(args[0], 0);
+    LUFactor *f = NULL;
+    if (!chol) {
+        f = matrix_lu(args[0]);
+        if (!f) return NULL;
+        if (f->singular) {
+            print_log("solve: матрица вырождена\n");
+            return NULL;
+        }
+    }
+    int n = chol ? chol->n : f->n;
+
+    Container *x = container_to_matrix(args[1]);
+    if (!x) {
+        print_log("solve: правая часть должна быть вектором или матрицей\n");
+        return NULL;
+    }
+    MatrixContainer *xm = (MatrixContainer*)x->data;
+    if (xm->rows != n) {
+        print_log("solve: правая часть имеет %d строк, ожидается %d\n", xm->rows, n);
+        free_container(x);
+        return NULL;
+    }
+
+    if (chol) {
+        chol_solve(chol, xm->data, xm->cols);
+    } else {
+        lu_solve(f, xm->data, xm->cols);
+    }
+
+    if (args[1]->type == CT_VECTOR) {
+        Container *vec = create_vector_container(xm->data[0], xm->data[1], xm->data[2]);
+        free_container(x);
+        return vec;
+    }
+    return x;
+}
+
+// Определитель через LU-разложение (до 4x4 - по формуле)
+Container* det_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("det: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (args[0] && args[0]->type == CT_MATRIX) {
+        MatrixContainer *mc = (MatrixContainer*)args[0]->data;
+        if (mc->rows == mc->cols && mc->rows >= SMALL_MIN && mc->rows <= SMALL_MAX) {
+            return create_float_container(small_det(mc->rows, mc->data));
+        }
+    }
+    LUFactor *f = matrix_lu(args[0]);
+    if (!f) return NULL;
+    if (f->singular) return create_float_container(0.0);
+
+    double det = f->sign;
+    for (int i = 0; i < f->n; i++) {
+        det *= f->lu[(size_t)i * f->n + i];
+    }
+    return create_float_container(det);
+}
+
+// Обратная матрица: решение A*X = I
+Container* inv_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("inv: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (args[0] && args[0]->type == CT_QUAT) return quat_inverse(args[0]);
+
+    // Малые матрицы обращаются по алгебраическим дополнениям, без LU-разложения
+    if (args[0] && args[0]->type == CT_MATRIX) {
+        MatrixContainer *mc = (MatrixContainer*)args[0]->data;
+        int n = mc->rows;
+        if (n == mc->cols && n >= SMALL_MIN && n <= SMALL_MAX) {
+            Container *result = create_matrix_container(n, n);
+            if (!result) return NULL;
+            if (!small_inv(n, mc->data, ((MatrixContainer*)result->data)->data)) {
+                print_log("inv: матрица вырождена\n");
+                free_container(result);
+                return NULL;
+            }
+            return result;
+        }
+    }
+    LUFactor *f = matrix_lu(args[0]);
+    if (!f) return NULL;
+    if (f->singular) {
+        print_log("inv: матрица вырождена\n");
+        return NULL;
+    }
+
+    int n = f->n;
+    Container *result = create_matrix_container(n, n);
+    if (!result) return NULL;
+    double *X = ((MatrixContainer*)result->data)->data;
+    for (int i = 0; i < n; i++) X[(size_t)i * n + i] = 1.0;
+
+    lu_solve(f, X, n);
+    return result;
+}
+
+// Проверка симметричности и положительности диагонали - необходимые признаки SPD
+static int looks_spd(const MatrixContainer *mc) {
+    int n = mc->rows;
+    if (n != mc->cols) return 0;
+
+    for (int i = 0; i < n; i++) {
+        if (!(mc->data[(size_t)i * n + i] > 0.0)) return 0;
+        for (int j = 0; j < i; j++) {
+            double a = mc->data[(size_t)i * n + j];
+            double b = mc->data[(size_t)j * n + i];
+            if (fabs(a - b) > 1e-12 * (fabs(a) + fabs(b))) return 0;
+        }
+    }
+    return 1;
+}
+
+// Разложение Холецкого из кэша значения. Признак SPD в кэше: задан через spd(A) или
+// выясняется проверкой симметрии и попыткой разложения. report - сообщать ли о неудаче
+CholFactor* matrix_chol(Container *a, int report) {
+    MatrixCache **slot = container_cache_slot(a);
+    if (!slot) {
+        if (report) print_log("Ошибка: ожидается матрица\n");
+        return NULL;
+    }
+    MatrixCache *cache = matrix_cache_get(slot);
+    if (cache->chol) return cache->chol;
+    if (cache->spd < 0) {
+        if (report) print_log("chol: матрица не является положительно определенной\n");
+        return NULL;
+    }
+
+    Container *dense;
+    MatrixContainer *mc = dense_view(a, &dense);
+    if (!mc) return NULL;
+
+    if (mc->rows != mc->cols) {
+        if (report) print_log("Ошибка: матрица %dx%d не квадратная\n", mc->rows, mc->cols);
+        free_container(dense);
+        return NULL;
+    }
+
+    CholFactor *chol = NULL;
+    if (cache->spd > 0 || looks_spd(mc)) {
+        chol = chol_factor(mc->data, mc->rows);
+    }
+    free_container(dense);
+
+    if (!chol) {
+        if (cache->spd > 0) print_log("Предупреждение: матрица отмечена как SPD, но разложение Холецкого невозможно\n");
+        else if (report) print_log("chol: матрица не является положительно определенной\n");
+        cache->spd = -1;
+        return NULL;
+    }
+
+    cache->spd = 1;
+    cache->chol = chol;
+    return chol;
+}
+
+// QR-разложение из кэша значения
+static QRFactor* matrix_qr(Container *a) {
+    MatrixCache **slot = container_cache_slot(a);
+    if (!slot) {
+        print_log("Ошибка: ожидается матрица\n");
+        return NULL;
+    }
+    if (*slot && (*slot)->qr) return (*slot)->qr;
+
+    Container *dense;
+    MatrixContainer *mc = dense_view(a, &dense);
+    if (!mc) return NULL;
+
+    QRFactor *qr = qr_factor(mc->data, mc->rows, mc->cols);
+    free_container(dense);
+    if (!qr) return NULL;
+
+    matrix_cache_get(slot)->qr = qr;
+    return qr;
+}
+
+// Разложение Холецкого: chol(A) возвращает нижнетреугольную L, A = L*L^T
+Container* chol_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("chol: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (!args[0]) return NULL;
+
+    CholFactor *f = matrix_chol(args[0], 1);
+    if (!f) return NULL;
+
+    Container *result = create_matrix_container(f->n, f->n);
+    if (!result) return NULL;
+    memcpy(((MatrixContainer*)result->data)->data, f->l, (size_t)f->n * f->n * sizeof(double));
+    return result;
+}
+
+// QR-разложение: qr(A) возвращает (Q, R), Q: m x k с ортонормированными столбцами, k = min(m, n)
+Container* qr_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("qr: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (!args[0]) return NULL;
+
+    QRFactor *f = matrix_qr(args[0]);
+    if (!f) return NULL;
+
+    int m = f->rows, n = f->cols;
+    int k = m < n ? m : n;
+    Container *items[2];
+    items[0] = create_matrix_container(m, k);
+    items[1] = create_matrix_container(k, n);
+    if (!items[0] || !items[1]) {
+        free_container(items[0]);
+        free_container(items[1]);
+        return NULL;
+    }
+
+    double *Q = ((MatrixContainer*)items[0]->data)->data;
+    double *R = ((MatrixContainer*)items[1]->data)->data;
+    for (int i = 0; i < k; i++) {
+        for (int j = i; j < n; j++) R[(size_t)i * n + j] = f->qr[(size_t)i * n + j];
+    }
+
+    qr_form_q(f, Q, k);
+
+    return create_list_container(2, items);
+}
+
+// Метод наименьших квадратов: lstsq(A, b) минимизирует |A*x - b| через QR (строк не меньше столбцов)
+Container* lstsq_func(Container** args, int arg_count) {
+    if (arg_count != 2) {
+        print_log("lstsq: ожидается 2 аргумента\n");
+        return NULL;
+    }
+    if (!args[0] || !args[1]) return NULL;
+
+    QRFactor *f = matrix_qr(args[0]);
+    if (!f) return NULL;
+
+    int m = f->rows, n = f->cols;
+    if (m < n) {
+        print_log("lstsq: строк (%d) меньше, чем столбцов (%d)\n", m, n);
+        return NULL;
+    }
+
+    // Проверка ранга по диагонали R
+    double rmax = 0.0;
+    for (int j = 0; j < n; j++) {
+        double r = fabs(f->qr[(size_t)j * n + j]);
+        if (r > rmax) rmax = r;
+    }
+    for (int j = 0; j < n; j++) {
+        if (fabs(f->qr[(size_t)j * n + j]) <= rmax * m * 2.220446049250313e-16) {
+            print_log("lstsq: матрица неполного ранга\n");
+            return NULL;
+        }
+    }
+
+    Container *b = container_to_matrix(args[1]);
+    if (!b) {
+        print_log("lstsq: правая часть должна быть вектором или матрицей\n");
+        return NULL;
+    }
+    MatrixContainer *bm = (MatrixContainer*)b->data;
+    if (bm->rows != m) {
+        print_log("lstsq: правая часть имеет %d строк, ожидается %d\n", bm->rows, m);
+        free_container(b);
+        return NULL;
+    }
+    int k = bm->cols;
+
+    qr_apply_qt(f, bm->data, k);
+
+    // R*x = (Q^T*b)(1:n)
+    Container *x = create_matrix_container(n, k);
+    if (!x) {
+        free_container(b);
+        return NULL;
+    }
+    double *X = ((MatrixContainer*)x->data)->data;
+    memcpy(X, bm->data, (size_t)n * k * sizeof(double));
+    free_container(b);
+
+    for (int i = n - 1; i >= 0; i--) {
+        const double *row = f->qr + (size_t)i * n;
+        double *xi = X + (size_t)i * k;
+        for (int p = i + 1; p < n; p++) {
+            const double *xp = X + (size_t)p * k;
+            for (int c = 0; c < k; c++) xi[c] -= row[p] * xp[c];
+        }
+        for (int c = 0; c < k; c++) xi[c] /= row[i];
+    }
+
+    if (args[1]->type == CT_VECTOR && n == 3) {
+        Container *vec = create_vector_container(X[0], X[1], X[2]);
+        free_container(x);
+        return vec;
+    }
+    return x;
+}
+
+// Отметка матрицы как симметричной положительно определенной: solve будет использовать Холецкого
+Container* spd_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("spd: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    MatrixCache **slot = container_cache_slot(args[0]);
+    if (!slot) {
+        print_log("spd: аргумент должен быть матрицей\n");
+        return NULL;
+    }
+
+    MatrixCache *cache = matrix_cache_get(slot);
+    if (cache->spd == 0) cache->spd = 1;
+    return container_deep_copy(args[0]);
+}
+
+// Элемент набора значений: get(набор, номер), нумерация с нуля
+Container* get_func(Container** args, int arg_count) {
+    if (arg_count != 2) {
+        print_log("get: ожидается 2 аргумента\n");
+        return NULL;
+    }
+    if (!args[0] || !args[1]) return NULL;
+    if (args[0]->type != CT_LIST || !container_is_scalar(args[1])) {
+        print_log("get: ожидается набор значений и номер элемента\n");
+        return NULL;
+    }
+
+    ListContainer *lc = (ListContainer*)args[0]->data;
+    int index = (int)container_to_double(args[1]);
+    if (index < 0 || index >= lc->count) {
+        print_log("get: номер %d вне набора из %d элементов\n", index, lc->count);
+        return NULL;
+    }
+    return container_deep_copy(lc->items[index]);
+}
@@ -2,27 +2,84 @@
 
 
 
-//   
+// Глобальный список переменных
 Ident* FirstIdent;
 
-//       
-FunctionDef functions[14] = {
-    {"sin",   1, sin_func  },
-    {"cos",   1, cos_func  },
-    {"log",   1, log_func  },
-    {"pow",   2, pow_func  },
-    {"max",   2, max_func  },
+// Таблица поддерживаемых функций и количество их аргументов
+FunctionDef functions[] = {
+    {"sin",   1, sin_func, 0, MEMO_PURE},
+    {"cos",   1, cos_func, 0, MEMO_PURE},
+    {"log",   1, log_func, 0, MEMO_PURE},
+    {"pow",   2, pow_func, 0, MEMO_PURE},
+    {"max",   ARGS_VARIADIC, max_func},
+    {"min",   ARGS_VARIADIC, min_func},
     {"cross", 2, cross_func},
+    {"field", ARGS_VARIADIC, field_func},
+    {"quat",  ARGS_VARIADIC, quat_func},
+    {"rotm",  1, rotm_func },
     {"abs" ,  1, abs_func  },
-    {"-",     2, sub_func  },
-    {"+",     2, add_func  },
-    {"u-",    1, neg_func  },
-    {"/",     2, div_func  },
-    {"*",     2, mul_func  },
+    {"-",     2, sub_func, RAW_SINGLE},
+    {"+",     2, add_func, RAW_SINGLE},
+    {"u-",    1, neg_func, RAW_SINGLE},
+    {"/",     2, div_func, RAW_SINGLE},
+    {"*",     2, mul_func, RAW_VIEW | RAW_SINGLE},
+    {"[]",    ARGS_VARIADIC, index_func, RAW_VIEW},
+    {":",     ARGS_VARIADIC, range_func},
+    {"transpose", 1, transpose_func, RAW_VIEW},
+    {"single", 1, single_func, RAW_VIEW | RAW_SINGLE},
+    {"double", 1, double_func, RAW_SINGLE},
+    {"zeros", 2, zeros_func},
+    {"eye",   1, eye_func  },
+    {"rand",  2, rand_func, 0, MEMO_EFFECT},
+    {"sparse", ARGS_VARIADIC, sparse_func},
+    {"dense",  1, dense_func },
+    {"csr",    1, csr_func   },
+    {"csc",    1, csc_func   },
+    {"nnz",    1, nnz_func   },
+    {"mmread", 1, mmread_func, 0, MEMO_EFFECT},
+    {"sprand", 3, sprand_func, 0, MEMO_EFFECT},
+    {"disk",     ARGS_VARIADIC, disk_func, 0, MEMO_EFFECT},
+    {"diskrand", 3, diskrand_func, 0, MEMO_EFFECT},
+    {"diskmul",  3, diskmul_func, 0, MEMO_EFFECT},
+    {"lu",     1, lu_func, 0, MEMO_PURE},
+    {"solve",  ARGS_VARIADIC, solve_func, RAW_SINGLE, MEMO_PURE | MEMO_PRINT},
+    {"det",    1, det_func, 0, MEMO_PURE},
+    {"inv",    1, inv_func, 0, MEMO_PURE | MEMO_PRINT},
+    {"get",    2, get_func   },
+    {"chol",   1, chol_func, 0, MEMO_PURE | MEMO_PRINT},
+    {"qr",     1, qr_func, 0, MEMO_PURE},
+    {"lstsq",  2, lstsq_func, 0, MEMO_PURE | MEMO_PRINT},
+    {"spd",    1, spd_func   },
+    {"cg",       ARGS_VARIADIC, cg_func, 0, MEMO_PRINT},
+    {"bicgstab", ARGS_VARIADIC, bicgstab_func, 0, MEMO_PRINT},
+    {"gmres",    ARGS_VARIADIC, gmres_func, 0, MEMO_PRINT},
+    {"sum",    ARGS_VARIADIC, sum_func },
+    {"mean",   ARGS_VARIADIC, mean_func},
+    {"norm",   ARGS_VARIADIC, norm_func},
+    {"dot",    ARGS_VARIADIC, dot_func },
+    {"sort",     ARGS_VARIADIC, sort_func, 0, MEMO_PURE},
+    {"argsort",  ARGS_VARIADIC, argsort_func, 0, MEMO_PURE},
+    {"median",   ARGS_VARIADIC, median_func, 0, MEMO_PURE},
+    {"quantile", ARGS_VARIADIC, quantile_func, 0, MEMO_PURE},
+    {"eig",    1, eig_func, 0, MEMO_PURE | MEMO_PRINT},
+    {"svd",    1, svd_func, 0, MEMO_PURE | MEMO_PRINT},
+    {"svds",   2, svds_func, 0, MEMO_EFFECT},
+    {"complex", ARGS_VARIADIC, complex_func},
+    {"real",   1, real_func  },
+    {"imag",   1, imag_func  },
+    {"conj",   1, conj_func  },
+    {"angle",  1, angle_func },
+    {"fft",    1, fft_func, 0, MEMO_PURE},
+    {"ifft",   1, ifft_func, 0, MEMO_PURE},
+    {"fft2",   1, fft2_func, 0, MEMO_PURE},
+    {"ifft2",  1, ifft2_func, 0, MEMO_PURE},
+    {"rfft",   1, rfft_func, 0, MEMO_PURE},
+    {"conv",   2, conv_func, 0, MEMO_PURE},
+    {"grad",   ARGS_VARIADIC, grad_func, 0, MEMO_EFFECT},
     {NULL,    0, NULL}
 };
 
-//       
+// Линейный поиск функции по имени в таблице
 FunctionDef* find_function(const char* name) {
     for (FunctionDef* f = functions; f->name; f++) {
         if (strcmp(f->name, name) == 0) return f;
@@ -30,7 +87,7 @@ FunctionDef* find_function(const char* name) {
     return NULL;
 }
 
-//    
+// Подсчет элементов в стеке
 int stack_size(Token* stack_top)
 {
     int count = 0;
@@ -40,10 +97,10 @@ int stack_size(Token* stack_top)
     return count;
 }
 
-//   N   
+// Безопасное извлечение N аргументов из стека
 Container** extract_args_safely(Token** stack, int arg_count, const char* func_name) {
     if (stack_size(*stack) < arg_count) {
-        printf("   %s ( %d)\n", func_name, arg_count);
+        printf("Недостаточно аргументов для %s (нужно %d)\n", func_name, arg_count);
         return NULL;
     }
 
@@ -68,32 +125,32 @@ Container** extract_args_safely(Token** stack, int arg_count, const char* func_n
 }
 
 
-//    
+// Получение контейнера из токена
 Container* get_container(Token* token)
 {
     if(token->type == TOK_IDENT)
     {
-        //   ,      
+        // Если это переменная, ищем её значение в глобальном списке
         Ident* existing = find_ident(FirstIdent, token->value);
         if (existing) {
-            //  ,    
+            // Делаем копию, чтобы не повредить переменную
             return container_deep_copy(existing->value->container);
         } else {
-            print_log(":  %s  \n", token->value);
+            print_log("Ошибка: переменная %s не существует\n", token->value);
             return NULL;
         }
     }
     else
     {
         Container* container = token->container;
-        //    
+        // Отвязываем контейнер от токена
         token->container = nullptr;
         return container;
     }
 }
 
 
-//      
+// Определение приоритета операторов для сортировочной станции
 int get_priority(TokenT type) {
     switch (type) {
         case TOK_PLUS:
@@ -111,14 +168,14 @@ int get_priority(TokenT type) {
     }
 }
 
-//  :     
+// Обработка запятой: выталкивание операторов до открывающей скобки
 int process_comma(Token** stack_top, Token** output_front, Token** output_rear) {
 
 
     while (*stack_top) {
         Token* top = *stack_top;
 
-        //     (   )
+        // Ищем границу текущего аргумента (скобку функции или вектора)
         if (top->type == TOK_LPAREN || top->type == TOK_LBRACKET) {
             break;
         }
@@ -128,21 +185,24 @@ int process_comma(Token** stack_top, Token** output_front, Token** output_rear)
         enqueue(output_front, output_rear, op);
     }
 
-     //   ,      
+     // Если стек кончился, а скобки нет — ошибка парсинга
     if (!*stack_top ||
         ((*stack_top)->type != TOK_LPAREN && (*stack_top)->type != TOK_LBRACKET)) {
-        printf(":    \n");
+        print_log("Ошибка: запятая находится вне скобок\n");
         return false;
     }
 
+    // Запятая начинает следующий аргумент функции или элемент вектора
+    (*stack_top)->arg_count++;
+
     return true;
 }
 
 
-//    
+// Обработка закрывающей круглой скобки
 int process_parenthesis(Token** stack_top, Token** output_front, Token** output_rear) {
 
-    //        
+    // Выталкиваем всё в выходную очередь до открывающей скобки
     while (*stack_top && (*stack_top)->type != TOK_LPAREN) {
         Token* op = pop_from_stack(stack_top);
         enqueue(output_front, output_rear, op);
@@ -150,24 +210,26 @@ int process_parenthesis(Token** stack_top, Token** output_front, Token** output_
 
 
     if (!*stack_top) {
-        printf(":   \n");
+        print_log("Ошибка: несогласованные круглые скобки\n");
         return false;
     }
 
-    //     
+    // Удаляем открывающую скобку из стека
     Token* bracket = pop_from_stack(stack_top);
+    int arg_count = bracket->arg_count;
     free_token(bracket);
 
-    //      (, sin(..)),     
+    // Если перед скобкой была функция (например, sin(..)), отправляем её в выходную очередь
     if (*stack_top && (*stack_top)->type == TOK_FUNCTION) {
         Token* func = pop_from_stack(stack_top);
+        func->arg_count = arg_count;
         enqueue(output_front, output_rear, func);
     }
 
     return true;
 }
 
-//    
+// Обработка закрывающей квадратной скобки
 int process_vector_end(Token** stack_top, Token** output_front, Token** output_rear) {
 
     while (*stack_top && (*stack_top)->type != TOK_LBRACKET) {
@@ -177,28 +239,95 @@ int process_vector_end(Token** stack_top, Token** output_front, Token** output_r
 
 
     if (!*stack_top) {
-        printf(":   \n");
+        print_log("Ошибка: несогласованные квадратные скобки\n");
         return false;
     }
 
 
     Token* bracket = pop_from_stack(stack_top);
+    int arg_count = bracket->arg_count;
+    int is_index = strcmp(bracket->value, "[]") == 0;
     free_token(bracket);
 
+    // Скобка после значения - индексация: значение и индексы уже в очереди
+    if (is_index) {
+        Token* index_op = create_token(TOK_FUNCTION, "[]");
+        index_op->arg_count = arg_count;
+        enqueue(output_front, output_rear, index_op);
+        return true;
+    }
 
-    //    TOK_VECTOR,     
+    // Генерируем специальный оператор TOK_VECTOR, который скажет вычислителю создать вектор
     Token* vector_op = create_token(TOK_VECTOR, "VECTOR");
+    vector_op->arg_count = arg_count;
     enqueue(output_front, output_rear, vector_op);
     return true;
 }
 
-//   
+// Выталкивание операторов до скобки или двоеточия текущего индекса
+static void pop_until_index_part(Token** stack_top, Token** output_front, Token** output_rear) {
+    while (*stack_top && (*stack_top)->type != TOK_LPAREN &&
+           (*stack_top)->type != TOK_LBRACKET && (*stack_top)->type != TOK_COLON) {
+        Token* op = pop_from_stack(stack_top);
+        enqueue(output_front, output_rear, op);
+    }
+}
+
+// Двоеточие в индексе: части среза копятся в токене ':' на стеке (arg_count - число частей),
+// пропущенная часть становится пустым операндом
+int process_colon(Token** stack_top, Token** output_front, Token** output_rear, int expect_operand) {
+    pop_until_index_part(stack_top, output_front, output_rear);
+
+    Token* top = *stack_top;
+    int in_index = top && (top->type == TOK_COLON ||
+                           (top->type == TOK_LBRACKET && strcmp(top->value, "[]") == 0));
+    if (!in_index) {
+        print_log("Ошибка: двоеточие допустимо только в индексах, например A[1:3, :]\n");
+        return false;
+    }
+    if (top->type == TOK_COLON && top->arg_count == 3) {
+        print_log("Ошибка: в срезе не больше трех частей (начало:конец:шаг)\n");
+        return false;
+    }
+
+    if (expect_operand) enqueue(output_front, output_rear, create_token(TOK_NUMBER, ""));
+    if (top->type == TOK_COLON) {
+        top->arg_count++;
+    } else {
+        Token* colon = create_token(TOK_COLON, ":");
+        colon->arg_count = 2;
+        push_to_stack(stack_top, colon);
+    }
+    return true;
+}
+
+// Завершение среза перед запятой или ']': части отдаются функции ":".
+// Возвращает 1, если срез был закрыт (он становится операндом)
+int finish_slice(Token** stack_top, Token** output_front, Token** output_rear, int expect_operand) {
+    pop_until_index_part(stack_top, output_front, output_rear);
+    if (!*stack_top || (*stack_top)->type != TOK_COLON) return 0;
+
+    if (expect_operand) enqueue(output_front, output_rear, create_token(TOK_NUMBER, ""));
+    Token* range = pop_from_stack(stack_top);
+    range->type = TOK_FUNCTION;
+    enqueue(output_front, output_rear, range);
+    return 1;
+}
+
+// Ошибка разбора: очередь вывода и стек операторов освобождаются
+static Token* parse_fail(Token* output_front, Token* stack_top) {
+    free_tokens(output_front);
+    free_tokens(stack_top);
+    return NULL;
+}
+
+// Алгоритм сортировочной станции
 Token* shuntingYard(Token* tokens) {
     Token* output_front = NULL;
     Token* output_rear = NULL;
     Token* stack_top = NULL;
 
-    //  : 1 -  , 0 -  
+    // Флаг состояния: 1 - ждем операнд, 0 - ждем оператор
     int expect_operand = 1;
 
     Token* current = tokens;
@@ -206,70 +335,93 @@ Token* shuntingYard(Token* tokens) {
         switch (current->type) {
             case TOK_NUMBER:
             case TOK_IDENT:
-                //    
+            case TOK_STRING:
+                // Проверка двух чисел подряд
                 if (!expect_operand) {
-                    printf(":    ,   / '%s'\n", current->value);
-                    return NULL; //  
+                    print_log("Ошибка: Ожидался оператор или запятая, а встречено число/переменная '%s'\n", current->value);
+                    return parse_fail(output_front, stack_top); // Прерываем выполнение
                 }
 
                 enqueue(&output_front, &output_rear, copy_token(current));
-                expect_operand = 0; //   
+                expect_operand = 0; // Теперь ждем оператор
                 break;
 
             case TOK_FUNCTION:
-                //     ,   
+                // Функция может быть только там, где ожидается операнд
                 if (!expect_operand) {
-                    printf(":  ,   '%s'\n", current->value);
-                    return NULL;
+                    print_log("Ошибка: Ожидался оператор, встречена функция '%s'\n", current->value);
+                    return parse_fail(output_front, stack_top);
                 }
                 push_to_stack(&stack_top, copy_token(current));
-                // expect_operand  1,        '('
+                // expect_operand остается 1, так как после имени функции обязательно идет '('
                 break;
 
             case TOK_COMMA:
-                //       (expect_operand == 0)
+                if (finish_slice(&stack_top, &output_front, &output_rear, expect_operand)) expect_operand = 0;
+                // Запятая может быть только после операнда (expect_operand == 0)
                 if (expect_operand) {
-                    printf(":   ( ?)\n");
-                    return NULL;
+                    print_log("Ошибка: Неожиданная запятая (пустой аргумент?)\n");
+                    return parse_fail(output_front, stack_top);
                 }
-                if(!process_comma(&stack_top, &output_front, &output_rear))return NULL;
-                expect_operand = 1; //     
+                if(!process_comma(&stack_top, &output_front, &output_rear))return parse_fail(output_front, stack_top);
+                expect_operand = 1; // После запятой ждем следующий аргумент
+                break;
+
+            case TOK_COLON:
+                if (!process_colon(&stack_top, &output_front, &output_rear, expect_operand)) return parse_fail(output_front, stack_top);
+                expect_operand = 1; // После двоеточия ждем следующую часть среза
                 break;
 
             case TOK_LBRACKET:
             case TOK_LPAREN:
-                 //         /
+                // Квадратная скобка после значения - индексация A[i, j]; счетчик включает само значение
+                if (!expect_operand && current->type == TOK_LBRACKET) {
+                    Token* bracket = create_token(TOK_LBRACKET, "[]");
+                    bracket->arg_count = 2;
+                    push_to_stack(&stack_top, bracket);
+                    expect_operand = 1;
+                    break;
+                }
+
+                 // Открывающая скобка возможна в начале выражения или после оператора/функции
                 if (!expect_operand) {
-                    printf(":    \n");
-                    return NULL;
+                    print_log("Ошибка: Ожидался оператор перед скобкой\n");
+                    return parse_fail(output_front, stack_top);
                 }
 
-                push_to_stack(&stack_top, copy_token(current));
-                expect_operand = 1; //     
+                {
+                    // Счетчик аргументов скобки увеличивается на каждой запятой
+                    Token* bracket = copy_token(current);
+                    bracket->arg_count = 1;
+                    push_to_stack(&stack_top, bracket);
+                }
+                expect_operand = 1; // Внутри скобок ждем новое выражение
                 break;
 
             case TOK_RBRACKET:
-                //       
+                if (finish_slice(&stack_top, &output_front, &output_rear, expect_operand)) expect_operand = 0;
+                // Закрывать скобку можно только после полного выражения
                 if (expect_operand) {
-                    printf(":    ']'\n");
-                    return NULL;
+                    print_log("Ошибка: Ожидалось значение перед ']'\n");
+                    return parse_fail(output_front, stack_top);
                 }
-                if(!process_vector_end(&stack_top, &output_front, &output_rear))return NULL;
-                expect_operand = 0; //   [..] -  ,   
+                if(!process_vector_end(&stack_top, &output_front, &output_rear))return parse_fail(output_front, stack_top);
+                expect_operand = 0; // Весь вектор [..] - это операнд, дальше ждем оператор
                 break;
 
             case TOK_RPAREN:
-                // :   "()"      '('
+                // Исключение: пустые скобки "()" допустимы только если в стеке '('
                 if (expect_operand) {
                      if (stack_top && stack_top->type == TOK_LPAREN) {
-                         //   ,     
+                         // Это пустые скобки, допустимо для функций без аргументов
+                         stack_top->arg_count = 0;
                      } else {
-                        printf(":    ')'\n");
-                        return NULL;
+                        print_log("Ошибка: Ожидалось значение перед ')'\n");
+                        return parse_fail(output_front, stack_top);
                      }
                 }
-                if(!process_parenthesis(&stack_top, &output_front, &output_rear))return NULL;
-                expect_operand = 0; //  (...) -  ,   
+                if(!process_parenthesis(&stack_top, &output_front, &output_rear))return parse_fail(output_front, stack_top);
+                expect_operand = 0; // Результат (...) - это операнд, дальше ждем оператор
                 break;
 
             case TOK_PLUS:
@@ -279,22 +431,22 @@ Token* shuntingYard(Token* tokens) {
             case TOK_UMINUS:
             case TOK_ASSIGN:
                 {
-                    //    ,    (    )
+                    // Если минус встречен там, где ждем число (начало строки или после скобки)
                     if (current->type == TOK_MINUS && expect_operand) {
                         push_to_stack(&stack_top, create_token(TOK_UMINUS, "u-"));
-                        // expect_operand  1,  
+                        // expect_operand остается 1, ждем число
                     }
                     else {
 
                         if (expect_operand) {
-                            printf(":   '%s' (  )\n", current->value);
-                            return NULL;
+                            print_log("Ошибка: Неожиданный оператор '%s' (нет левого операнда)\n", current->value);
+                            return parse_fail(output_front, stack_top);
                         }
 
                         int current_priority = get_priority(current->type);
                         int is_right_assoc = (current->type == TOK_ASSIGN);
 
-                        //       
+                        // Выталкивание операторов с большим или равным приоритетом
                         while (stack_top != nullptr &&
                                stack_top->type != TOK_LPAREN &&
                                stack_top->type != TOK_LBRACKET) {
@@ -312,7 +464,7 @@ Token* shuntingYard(Token* tokens) {
                         }
 
                         push_to_stack(&stack_top, create_token(current->type, current->value));
-                        expect_operand = 1; //     
+                        expect_operand = 1; // После оператора обязательно ждем операнд
                     }
                 }
                 break;
@@ -323,18 +475,18 @@ Token* shuntingYard(Token* tokens) {
         current = current->next;
     }
 
-    //        
+    // В конце строки мы не должны ждать операнда
     if (expect_operand) {
-        printf(":    ( )\n");
-        return NULL;
+        print_log("Ошибка: Выражение закончилось неожиданно (ожидался операнд)\n");
+        return parse_fail(output_front, stack_top);
     }
 
     while (stack_top) {
         Token* op = pop_from_stack(&stack_top);
         if (op->type == TOK_LPAREN || op->type == TOK_LBRACKET) {
-            printf(":   ( )\n");
+            print_log("Ошибка: несогласованные скобки (осталась открывающая)\n");
             free_token(op);
-            return NULL;
+            return parse_fail(output_front, stack_top);
         } else {
             enqueue(&output_front, &output_rear, op);
         }
@@ -344,7 +496,8 @@ Token* shuntingYard(Token* tokens) {
 }
 
 
-//    3 
+// Создание вектора из 3 компонентов
+// Создание вектора из 3 контейнеров
 Container* container_vector(Container* a, Container* b, Container* c) {
     if (!a || !b || !c) return NULL;
 
@@ -354,30 +507,67 @@ Container* container_vector(Container* a, Container* b, Container* c) {
         (c->type == CT_INT || c->type == CT_FLOAT)) {
         return create_vector_container(container_to_double(a), container_to_double(b), container_to_double(c));
     }
-    printf(":      \n");
+    printf("Ошибка: несовместимые типы для преобразования в вектор\n");
     return NULL;
 }
 
-//      
+// Литерал [...]: три числа дают вектор, остальные варианты - матрицу
+Container* container_literal(Container** items, int count) {
+    if (count == 3 && container_is_scalar(items[0]) &&
+        container_is_scalar(items[1]) && container_is_scalar(items[2])) {
+        return container_vector(items[0], items[1], items[2]);
+    }
+    return matrix_literal(items, count);
+}
+
+// Вычисление выражения в Обратной Польской Записи
 Container* countRPN(Token *head)
+{
+    return countRPN_frame(head, NULL);
+}
+
+// Ошибка вычисления: промежуточные значения на стеке освобождаются
+static Container* eval_fail(Token* stack_top) {
+    free_tokens(stack_top);
+    return NULL;
+}
+
+// Вычисление тела функции пользователя: slots - значения параметров (TOK_PARAM)
+Container* countRPN_frame(Token *head, Container **slots)
 {
     Token* stack_top = NULL;
     Token* current = head;
 
+    // Цепочки поэлементных операций над матрицами считаются одним проходом
+    FuseChain chains[FUSE_MAX_CHAINS];
+    int chain_count = fuse_find_chains(head, chains, FUSE_MAX_CHAINS);
+
     while (current != NULL) {
 
+        FuseChain* chain = chain_count > 0 ? fuse_chain_at(chains, chain_count, current) : NULL;
+        if (chain) {
+            Container* fused = precision_apply(fuse_eval(chain, slots));
+            if (fused) {
+                push_to_stack(&stack_top, create_token_with_container(TOK_NUMBER, NULL, fused));
+                current = chain->end->next;
+                continue;
+            }
+        }
+
         switch (current->type) {
             case TOK_VECTOR:{
-                //    3   
-                Container** args = extract_args_safely(&stack_top, 3, current->value);
-                if (!args) return NULL;
+                // Сборка вектора или матрицы из элементов на стеке
+                int count = current->arg_count;
+                Container** args = extract_args_safely(&stack_top, count, current->value);
+                if (!args) return eval_fail(stack_top);
+                args_materialize(args, count, 0);
 
-                Container* result = container_vector(args[0], args[1], args[2]);
+                Container* result = precision_apply(container_literal(args, count));
                 Token* result_token = create_token_with_container(TOK_NUMBER, NULL, result);
                 push_to_stack(&stack_top, result_token);
 
-                //   
-                for(int i(0); i<3; i++)
+                // Очистка временных аргументов
+                for(int i(0); i<count; i++)
                 {
                     if(args[i]) free_container(args[i]);
                 }
@@ -387,42 +577,88 @@ Container* countRPN(Token *head)
             }
             case TOK_NUMBER:
             case TOK_IDENT:
+            case TOK_STRING:
 
-                //       
+                // Числа и переменные просто кладем в стек
                 push_to_stack(&stack_top, copy_token(current));
                 break;
 
+            case TOK_PARAM:
+                // Параметр берется из ячейки по номеру, без поиска по имени
+                push_to_stack(&stack_top, create_token_with_container(TOK_NUMBER, NULL,
+                              container_deep_copy(slots[current->arg_count])));
+                break;
+
             case TOK_MULTIPLY:
             case TOK_DIVIDE:
             case TOK_UMINUS:
             case TOK_PLUS:
             case TOK_MINUS:
             case TOK_FUNCTION: {
-            // 
+            //Поиск функции
             FunctionDef* func_def = find_function(current->value);
+            UserFunction* user_def = func_def ? NULL : find_user_function(current->value);
+            if (user_def) {
+                int user_args = user_param_count(user_def);
+                if (current->arg_count != user_args) {
+                    print_log("Ошибка: функция %s ожидает %d аргумент(ов), передано %d\n",
+                              current->value, user_args, current->arg_count);
+                    return eval_fail(stack_top);
+                }
+                Container** args = extract_args_safely(&stack_top, user_args, current->value);
+                if (!args && user_args > 0) return eval_fail(stack_top);
+
+                // Параметр без значения (несуществующая переменная) - ошибка уже выведена
+                int missing = 0;
+                for (int i = 0; i < user_args; i++) missing = missing || !args[i];
+
+                Container* result = missing ? NULL : user_call(user_def, args);
+                for (int i = 0; i < user_args; i++) free_container(args[i]);
+                free(args);
+                if (!result) return eval_fail(stack_top);
+
+                push_to_stack(&stack_top, create_token_with_container(TOK_NUMBER, NULL, result));
+                break;
+            }
             if (!func_def) {
-                print_log(" : %s\n", current->value);
-                return NULL;
+                print_log("Неизвестная функция: %s\n", current->value);
+                return eval_fail(stack_top);
             }
 
-            Container** args = extract_args_safely(&stack_top, func_def->arg_count, current->value);
-            if (!args) return NULL;
+            // Для функций с переменным числом параметров берется количество из вызова
+            int arg_count = func_def->arg_count;
+            if (arg_count == ARGS_VARIADIC) {
+                arg_count = current->arg_count;
+            } else if (current->type == TOK_FUNCTION && current->arg_count != arg_count) {
+                print_log("Ошибка: функция %s ожидает %d аргумент(ов), передано %d\n",
+                          current->value, arg_count, current->arg_count);
+                return eval_fail(stack_top);
+            }
+
+            Container** args = extract_args_safely(&stack_top, arg_count, current->value);
+            if (!args) return eval_fail(stack_top);
 
-            Container* result = func_def->func(args, func_def->arg_count);
+            // Срезы с шагами и float-матрицы приводятся к плотным матрицам double,
+            // если функция не работает с ними сама
+            args_materialize(args, arg_count, func_def->raw);
 
-            //    
-            for(int i(0); i<func_def->arg_count; i++)
+            // double(A) - явный запрос двойной точности, режим precision к нему не применяется
+            Container* result = memo_call(func_def, args, arg_count);
+            if (func_def->func != double_func) result = precision_apply(result);
+
+            // Освобождение аргументов после вычисления
+            for(int i(0); i<arg_count; i++)
             {
                 if(args[i]) free_container(args[i]);
             }
             free(args);
 
             if (!result) {
-                print_log("   %s\n", current->value);
-                return NULL;
+                print_log("Ошибка в функции %s\n", current->value);
+                return eval_fail(stack_top);
             }
 
-            //     
+            // Результат кладем обратно в стек
             push_to_stack(&stack_top, create_token_with_container(TOK_NUMBER, NULL, result));
             break;
             }
@@ -430,47 +666,51 @@ Container* countRPN(Token *head)
             case TOK_ASSIGN: {
 
                 if (!stack_top || !stack_top->next) {
-                    print_log(":    =\n");
-                    return NULL;
+                    print_log("Ошибка: недостаточно операндов для =\n");
+                    return eval_fail(stack_top);
                 }
                 Token* value = pop_from_stack(&stack_top);
                 Token* ident = pop_from_stack(&stack_top);
 
                 if (ident->type != TOK_IDENT) {
-                    print_log(":   =   \n");
+                    print_log("Ошибка: слева от = должен быть идентификатор\n");
                     free_token(ident);
                     free_token(value);
-                    return NULL;
+                    return eval_fail(stack_top);
                 }
-                //   ,   
+                // Если справа переменная, берем её значение
                 if(value->type == TOK_IDENT)
                 {
                     Ident* value_ident = find_ident(FirstIdent, value->value);
                     if(!value_ident)
                     {
-                        print_log(":  %s  \n", value->value);
+                        print_log("Ошибка: переменная %s не существует\n", value->value);
                         free_token(ident);
                         free_token(value);
-                        return NULL;
+                        return eval_fail(stack_top);
                     }
                     free_token(value);
                     value = copy_token(value_ident->value);
 
                 }
 
-                 //      
-                Ident* existing = find_ident(FirstIdent, ident->value);
+                // Отложенные выражения, читающие старое значение, вычисляются до записи
+                lazy_invalidate(ident->value);
+
+                 // Поиск существующей переменной или создание новой
+                Ident* existing = find_ident_slot(FirstIdent, ident->value);
                 if (existing) {
-                    //    
+                    // Обновление значения существующей переменной
+                    lazy_drop(existing);
                     free_token(existing->value);
                     existing->value = copy_token(value);
                 } else {
-                    //     
+                    // Создание новой переменной в списке
                     Ident* new_ident = create_ident(ident->value, copy_token(value));
                     add_ident(&FirstIdent, new_ident);
                 }
 
-                //   ()   
+                // Результат присваивания (значение) возвращается в стек
                 push_to_stack(&stack_top, value);
                 free_token(ident);
 
@@ -478,22 +718,22 @@ Container* countRPN(Token *head)
             }
 
             default:
-                printf("   RPN: %d\n", current->type);
+                printf("Неизвестный токен в RPN: %d\n", current->type);
                 break;
         }
         current = current->next;
     }
 
-    //          
+    // В конце вычисления в стеке должен остаться ровно один элемент
     if (!stack_top) {
-        printf(":  \n");
+        printf("Ошибка: пустой стек\n");
         return NULL;
     }
 
 
     if (stack_top->next) {
-        printf(":     \n");
-        //    
+        printf("Ошибка: в стеке осталось несколько элементов\n");
+        // Очистка мусора при ошибке
         while (stack_top) {
             Token* temp = pop_from_stack(&stack_top);
             free_token(temp);
@@ -503,7 +743,7 @@ Container* countRPN(Token *head)
 
 
     Token* result_token = pop_from_stack(&stack_top);
-    //    -
+    // Извлечение контейнера из токена-результата
     Container* result = NULL;
     if (result_token) {
         result = get_container(result_token);
@@ -522,7 +762,7 @@ void print_tokens(Token *head) {
     };
 
     Token *current = head;
-    printf(":\n");
+    printf("Токены:\n");
     while (current != nullptr) {
         printf("  [%s: %s]\n", type_names[current->type], current->value);
         current = current->next;
@@ -531,7 +771,7 @@ void print_tokens(Token *head) {
 
 
 void print_rpn(Token* head) {
-    printf("  : ");
+    printf("Выражение в ОПЗ: ");
     Token* current = head;
     while (current != nullptr) {
         printf("%s ", current->value);
@@ -540,39 +780,143 @@ void print_rpn(Token* head) {
     printf("\n");
 }
 
-//   
+// Вывод справочной информации
 void print_help() {
     const char* help_text =
 
-        "________________    ________________\n"
+        "________________ СПРАВКА ПО КАЛЬКУЛЯТОРУ ________________\n"
+        "\n"
+        "КАК ПОЛЬЗОВАТЬСЯ:\n"
+        "  Просто введите выражение и нажмите Enter.\n"
+        "  Примеры: 2 + 2 * 2, sin(3.14), a = 10\n"
+        "\n"
+        "УПРАВЛЕНИЕ ПРОГРАММОЙ:\n"
+        "  save   - сохранить всю историю введенных команд в файл 'program.txt'\n"
+        "  screen - сохранить текущий вид консоли в файл 'screenshot.txt'\n"
+        "  open   - загрузить и выполнить команды из файла, введенного через пробел\n"
+        "  cls    - очистить экран\n"
+        "  spbench [n] - сравнить плотное и разреженное умножение n x n\n"
+        "  isa [sse2|avx2|avx512] - показать или выбрать набор инструкций\n"
+        "  precision [single|double] - точность новых матриц (single - float, вдвое меньше памяти)\n"
+        "  fusebench [n] - сравнить вычисление выражений над n x n со слиянием и без\n"
+        "  diskbench [n] - умножить матрицы n x n на диске (файлы в текущей папке)\n"
+        "  pipebench [n] - выполнить сценарий из n длинных выражений подряд и конвейером\n"
+        "  memo [on|off|clear] - кэш результатов inv, eig, sort, fft и др.: попадания по функциям\n"
+        "  lazy [on|off] - откладывать x = выражение; до первого чтения x\n"
+        "  mem [МБ|off] - память по подсистемам, пик и лимит (выражение сверх лимита - ошибка)\n"
+        "  timeit выражение - время вычисления (мин, медиана, p99) и выделения памяти, без memo\n"
+        "  bench файл [n] - выполнить сценарий n раз (по умолчанию 10) без вывода, строк в секунду\n"
+        "  exit   - закрыть калькулятор\n"
+        "  help   - показать справку по калькулятору\n"
+        "\n"
+        "МАТЕМАТИКА И ПЕРЕМЕННЫЕ:\n"
+        "  +, -, *, /  : Стандартные операции (сложение, вычитание, умножение, деление)\n"
+        "                Целые считаются точно в 64 битах; при переполнении и делении\n"
+        "                с остатком результат - дробное число\n"
+        "  =           : Запомнить число (пример: x = 5 + 2, теперь x равно 7)\n"
+        "  ans         : Хранит результат последнего вычисления (пример: ans + 10)\n"
+        "  ;           : В конце строки - не печатать результат (пример: x = inv(A);)\n"
+        "                В сценарии такое присваивание, перезаписанное до чтения, не считается\n"
+        "  [a, b, c]   : Создать вектор из трех чисел (пример: v = [1, 2, 3])\n"
+        "  [[1, 2], [3, 4]] : Матрица по строкам; [1, 2, 3, 4] - столбец\n"
+        "  A[i, j], A[i]  : Элемент и строка (индексы с нуля, -1 - последний)\n"
+        "  A[1:3, :], v[::2] : Срезы начало:конец:шаг, конец не включается\n"
+        "  transpose(A)   : Транспонирование; срезы и transpose не копируют элементы\n"
+        "  f(x, y) = x*x + y : Определить функцию (не больше 8 параметров), затем f(2, 1);\n"
+        "                   небольшие функции подставляются в выражение при вызове\n"
+        "\n"
+        "ФУНКЦИИ:\n"
+        "  sin(x), cos(x) : Синус и косинус (аргумент в радианах)\n"
+        "  log(x)         : Натуральный логарифм\n"
+        "  abs(x)         : Модуль числа (абсолютное значение)\n"
+        "  pow(x, y)      : Возведение x в степень y (вместо x^y)\n"
+        "  max(x, y), min(x, y) : Выбор большего и меньшего из двух чисел\n"
+        "  Функции применяются поэлементно к векторам и матрицам; число в pow, max и min\n"
+        "  размножается на все элементы, abs(v) для вектора - его длина\n"
+        "  cross(a, b)    : Векторное произведение двух векторов a и b\n"
+        "  zeros(m, n), eye(n), rand(m, n) : Нулевая, единичная и случайная матрицы\n"
+        "\n"
+        "КВАТЕРНИОНЫ И ПРЕОБРАЗОВАНИЯ:\n"
+        "  quat(w, x, y, z) : Кватернион w + xi + yj + zk\n"
+        "  quat(v, a)     : Поворот вокруг оси v на угол a (в радианах)\n"
+        "  quat(R), rotm(q) : Из матрицы поворота 3x3 и обратно\n"
+        "  q1 * q2, q * v : Композиция поворотов (сначала q2) и поворот вектора\n"
+        "  inv(q), abs(q) : Обратный кватернион и норма\n"
+        "  M * v для матрицы 4x4 - однородное преобразование точки (x, y, z, 1)\n"
+        "\n"
+        "ПОЛЯ ВЕКТОРОВ (много 3-векторов, координаты хранятся тремя массивами):\n"
+        "  field(A)       : Поле из матрицы n x 3, по вектору в строке\n"
+        "  field(x, y, z) : Поле из трех столбцов координат одной длины\n"
+        "  F + G, F - G, F * 2, F / 2 : Поэлементно; вместо поля можно взять один вектор\n"
+        "  F * G, cross(F, G), abs(F) : Скалярные произведения, векторные произведения, длины\n"
+        "  dense(F)       : Обратно в матрицу n x 3\n"
+        "\n"
+        "СВЕРТКИ (результат не зависит от числа потоков):\n"
+        "  sum(A), mean(A) : Сумма и среднее всех элементов\n"
+        "  norm(A)         : Евклидова норма вектора, норма Фробениуса матрицы\n"
+        "  min(A), max(A)  : Наименьший и наибольший элемент\n"
+        "  dot(a, b)       : Скалярное произведение массивов одного размера\n"
+        "  Ось \"rows\" дает значение для каждой строки, \"cols\" - для каждого столбца:\n"
+        "  sum(A, \"cols\"), max(A, \"rows\"). Режим суммирования в sum, mean, norm, dot:\n"
+        "  \"pairwise\" (попарно) или \"kahan\" (с компенсацией), например sum(v, \"kahan\")\n"
+        "\n"
+        "СОРТИРОВКА И КВАНТИЛИ:\n"
+        "  sort(v), argsort(v) : Значения по возрастанию и их номера (с нуля); у матрицы -\n"
+        "                        каждый столбец, sort(A, \"rows\") - каждая строка\n"
+        "  median(A)           : Медиана всех элементов (без полной сортировки)\n"
+        "  quantile(A, p)      : Квантиль p от 0 до 1, p может быть вектором: quantile(v, [0.25, 0.5, 0.75])\n"
+        "  Оси \"rows\" и \"cols\" в median и quantile - как у сверток\n"
         "\n"
-        " :\n"
-        "       Enter.\n"
-        "  : 2 + 2 * 2, sin(3.14), a = 10\n"
+        "РАЗРЕЖЕННЫЕ МАТРИЦЫ (индексы с нуля):\n"
+        "  sparse(A)            : Сжать плотную матрицу в CSR\n"
+        "  sparse(i, j, v, m, n): Матрица m x n из троек (строка, столбец, значение)\n"
+        "  mmread(\"файл.mtx\")  : Загрузить матрицу в формате Matrix Market\n"
+        "  sprand(m, n, p)      : Случайная матрица с долей ненулевых p\n"
+        "  dense(S), csr(S), csc(S), nnz(S) : Смена формата и число элементов\n"
         "\n"
-        " :\n"
-        "  save   -        'program.txt'\n"
-        "  screen -       'screenshot.txt'\n"
-        "  open   -      ,   \n"
-        "  cls    -  \n"
-        "  exit   -  \n"
-        "  help   -    \n"
+        "МАТРИЦЫ НА ДИСКЕ (больше оперативной памяти, хранятся по тайлам):\n"
+        "  disk(\"файл\")       : Открыть матрицу, записанную ранее\n"
+        "  disk(\"файл\", A)    : Записать матрицу A в файл\n"
+        "  diskrand(\"файл\", m, n) : Случайная матрица m x n прямо в файле\n"
+        "  diskmul(A, B, \"файл\") : Произведение A*B с записью результата в файл\n"
+        "  dense(D)            : Загрузить матрицу с диска в память\n"
         "\n"
-        "  :\n"
-        "  +, -, *, /  :   (, , , )\n"
-        "  =           :   (: x = 5 + 2,  x  7)\n"
-        "  ans         :     (: ans + 10)\n"
-        "  [a, b, c]   :      (: v = [1, 2, 3])\n"
+        "ЛИНЕЙНЫЕ СИСТЕМЫ (разложение запоминается, повторный solve с той же A быстрее):\n"
+        "  solve(A, b)    : Решение системы A*x = b (b - вектор или матрица)\n"
+        "  det(A), inv(A) : Определитель и обратная матрица\n"
+        "  lu(A)          : Разложение (L, U, P), где P*A = L*U\n"
+        "  chol(A)        : Разложение Холецкого A = L*L^T (A симметричная положительно определенная)\n"
+        "  qr(A)          : Разложение (Q, R), A = Q*R\n"
+        "  lstsq(A, b)    : Наименьшие квадраты для переопределенной системы\n"
+        "  spd(A)         : Отметить A как SPD, тогда solve использует Холецкого\n"
+        "  eig(A)         : Собственные значения (по возрастанию) и векторы симметричной A\n"
+        "  svd(A)         : Сингулярное разложение (U, s, V), A = U*diag(s)*V^T\n"
+        "  svds(A, k)     : k старших сингулярных троек, быстрый рандомизированный метод\n"
+        "  solve(A, b, \"mixed\") : Разложение в одинарной точности и уточнение до двойной\n"
+        "  single(A), double(A) : Перевод матрицы в float и обратно; solve с float-матрицей\n"
+        "                   уточняет решение до двойной точности\n"
+        "  get(t, i)      : Элемент i (с нуля) из набора значений, например get(lu(A), 0)\n"
         "\n"
-        ":\n"
-        "  sin(x), cos(x) :    (  )\n"
-        "  log(x)         :  \n"
-        "  abs(x)         :   ( )\n"
-        "  pow(x, y)      :  x   y ( x^y)\n"
-        "  max(x, y)      :     \n"
-        "  cross(a, b)    :     a  b\n"
+        "КОМПЛЕКСНЫЕ ЧИСЛА И ПРЕОБРАЗОВАНИЕ ФУРЬЕ:\n"
+        "  complex(re, im) : Комплексный массив из вещественной и мнимой частей\n"
+        "  real(z), imag(z), conj(z), angle(z), abs(z) : Части, сопряжение, аргумент, модуль\n"
+        "  fft(x), ifft(X)  : БПФ вектора или каждого столбца матрицы, любая длина\n"
+        "  fft2(A), ifft2(F): Двумерное БПФ\n"
+        "  rfft(x)          : БПФ вещественных данных, n/2+1 коэффициентов\n"
+        "  conv(a, b)       : Полная свертка векторов или матриц (напрямую или через БПФ)\n"
         "\n"
-        " :\n"
+        "ПРОИЗВОДНЫЕ:\n"
+        "  grad(\"x*y + sin(x)\", \"x, y\") : Градиент в текущих значениях x и y (число для одной\n"
+        "                   переменной). Третий аргумент \"forward\" (дуальные числа, проход на\n"
+        "                   переменную) или \"reverse\" (лента, один проход на весь градиент)\n"
+        "\n"
+        "ИТЕРАЦИОННЫЕ МЕТОДЫ (возвращают (x, число итераций, история невязок)):\n"
+        "  cg(A, b, tol, maxit, \"jacobi\")  : Сопряженные градиенты (A симметричная положительно определенная)\n"
+        "  bicgstab(A, b, tol, maxit, \"ilu\"): Стабилизированные бисопряженные градиенты\n"
+        "  gmres(A, b, tol, maxit)          : GMRES с перезапуском через 30 итераций\n"
+        "  Необязательны tol (0.00000001), maxit (1000) и предобусловливатель: \"none\", \"jacobi\", \"ilu\"\n"
+        "\n"
+        "ПРИМЕРЫ ВЫРАЖЕНИЙ:\n"
         "  >> 5 * (2 + 3)\n"
         "  >> pi = 3.14159\n"
         "  >> sin(pi / 2)\n"
@@ -584,7 +928,7 @@ void print_help() {
 }
 
 
-//    
+// Вывод приветствия при запуске
 void print_welcome_message()
 {
     const char* welcome_msg =
@@ -595,20 +939,20 @@ void print_welcome_message()
         "        | /    /___) /   ' /        /   ) /   /   '      \n"
         "________|/____(___ _(___ _(____/___(___(_/___(___ _______\n"
         "                                                         \n"
-        "     (, , )   \n"
+        "   Консольный Калькулятор (Числа, Векторы, Переменные)   \n"
         "_________________________________________________________\n"
-        "     Enter.\n"
-        ":  2 + 2 * 2  |  x = sin(0.5)  |  v = [1, 2, 3]\n"
+        "Введите математическое выражение и нажмите Enter.\n"
+        "Примеры:  2 + 2 * 2  |  x = sin(0.5)  |  v = [1, 2, 3]\n"
         "\n"
-        " help      .\n"
-        " exit  .\n"
+        "Введите help для полного списка команд и примеров.\n"
+        "Введите exit для выхода.\n"
         "----------------------------------------------------------\n";
 
     print_log("%s", welcome_msg);
 }
 
 
-//   ans
+// Обновление переменной ans
 void update_ans(Container* result) {
     if (!result) return;
 
@@ -617,49 +961,84 @@ void update_ans(Container* result) {
 
     Token* token_val = create_token_with_container(TOK_NUMBER, NULL, copy);
 
-    //  ans
-    Ident* ans_ident = find_ident(FirstIdent, "ans");
+    //Ищем переменную ans
+    Ident* ans_ident = find_ident_slot(FirstIdent, "ans");
 
     if (ans_ident) {
-        //        
+        lazy_drop(ans_ident);
+        // Если переменная уже есть — обновляем её значение
         if (ans_ident->value) {
-            free_token(ans_ident->value); //   
+            free_token(ans_ident->value); // Освобождаем старый токен
         }
         ans_ident->value = token_val;
     } else {
-        //      
+        // Если переменной нет — создаем новую
         Ident* new_ident = create_ident("ans", token_val);
         add_ident(&FirstIdent, new_ident);
     }
 }
 
 
-//     
-void process_expression(char* input) {
-    // 
-    Token *tokens = lex(input);
-    if (tokens == NULL) {
-        print_log("  \n\n");
-        return;
-    }
+// "x = выражение;" - результат не печатается. Строка без ';' копируется в expr
+int expression_quiet(const char* input, char* expr, size_t size) {
+    size_t len = strlen(input);
+    while (len > 0 && isspace((unsigned char)input[len - 1])) len--;
+    int quiet = len > 0 && input[len - 1] == ';';
+    if (quiet) len--;
+    if (len >= size) len = size - 1;
+    memcpy(expr, input, len);
+    expr[len] = 0;
+    return quiet;
+}
 
-    // 
-    Token* rpn = shuntingYard(tokens);
-    if (rpn != NULL) {
-        // 
-        Container* result = countRPN(rpn);
+// Вычисление разобранного выражения и печать результата; ОПЗ освобождается
+void evaluate_rpn(Token* rpn, int quiet, int defer) {
+    // Небольшие функции пользователя подставляются в выражение
+    rpn = user_inline(rpn);
 
-        print_log("<< ");
+    // Присваивание без вывода можно отложить до чтения переменной
+    if (quiet && (defer || lazy_enabled) && lazy_defer(rpn)) return;
 
-        update_ans(result);
-        print_container(result);
+    // Вычисление; память, занятая сверх исходной, видна в команде mem
+    mem_mark_begin();
+    Container* result = countRPN(rpn);
+    mem_mark_end();
 
+    update_ans(result);
+    if (!quiet) {
+        print_log("<< ");
+        print_container(result);
         print_log("\n");
+    }
+
+    free_container(result);
+    free_tokens(rpn);
+}
+
+// Полный цикл обработки одного выражения
+void process_expression(char* input, int defer) {
+    char expr[256];
+    int quiet = expression_quiet(input, expr, sizeof(expr));
+
+    //Лексический анализ
+    Token *tokens = lex(expr);
+    if (tokens == NULL) {
+        print_log("Ошибка лексического анализа\n\n");
+        return;
+    }
 
-        free_container(result);
-        free_tokens(rpn);
+    // Определение функции пользователя f(x) = ...
+    if (user_define(tokens)) {
+        free_tokens(tokens);
+        return;
+    }
+
+    //Сортировочная станция
+    Token* rpn = shuntingYard(tokens);
+    if (rpn != NULL) {
+        evaluate_rpn(rpn, quiet, defer);
     } else {
-        print_log("  \n\n");
+        print_log("Ошибка синтаксического анализа\n\n");
     }
 
     free_tokens(tokens);
@@ -670,7 +1049,10 @@ int main() {
     SetConsoleCP(1251);
     SetConsoleOutputCP(1251);
 
-    //    
+    // Выбор вычислительных ядер под процессор
+    dispatch_init();
+
+    // Очистка временных файлов сессии
     clear_file("session.tmp");
     clear_file("history.tmp");
 
@@ -678,32 +1060,32 @@ int main() {
 
     char input[256];
 
-     //    
+     // Основной цикл работы программы
     while (1) {
         print_log(">> ");
 
         if (fgets(input, sizeof(input), stdin) == NULL) break;
 
-        //   
+        // Логирование ввода пользователя
         append_to_file("session.tmp", input);
 
         input[strcspn(input, "\n")] = 0;
         if (strlen(input) == 0) continue;
 
-        //   
+        // Обработка системных команд
         if (strcmp(input, "exit") == 0)
         {
-            printf(" ,   ? (y/n): ");
+            printf("Вы уверены, что хотите выйти? (y/n): ");
             char confirm;
             scanf(" %c", &confirm);
-            while (getchar() != '\n'); //  
+            while (getchar() != '\n'); // Очистка буфера
 
-            //    y  Y
+            // Выходим ТОЛЬКО если y или Y
             if (confirm == 'y' || confirm == 'Y') {
                 break;
             } else {
 
-                printf(" .\n");
+                printf("Выход отменен.\n");
                 continue;
             }
         }
@@ -725,16 +1107,102 @@ int main() {
         }
 
         if (strcmp(input, "help") == 0) {
-            print_help(); // print_help   print_log
+            print_help(); // print_help должна использовать print_log
+            continue;
+        }
+
+        // Тест производительности "spbench [n]"
+        if (strncmp(input, "spbench", 7) == 0) {
+            int n = 2000;
+            char* space = strchr(input, ' ');
+            if (space != NULL && atoi(space + 1) > 0) {
+                n = atoi(space + 1);
+            }
+            sparse_benchmark(n);
+            continue;
+        }
+
+        // Тест слияния поэлементных операций "fusebench [n]"
+        if (strncmp(input, "fusebench", 9) == 0) {
+            int n = 2000;
+            char* space = strchr(input, ' ');
+            if (space != NULL && atoi(space + 1) > 0) {
+                n = atoi(space + 1);
+            }
+            fuse_benchmark(n);
+            continue;
+        }
+
+        // Тест конвейера разбора сценария "pipebench [n]"
+        if (strncmp(input, "pipebench", 9) == 0) {
+            int n = 20000;
+            char* space = strchr(input, ' ');
+            if (space != NULL && atoi(space + 1) > 0) {
+                n = atoi(space + 1);
+            }
+            pipeline_benchmark(n);
+            continue;
+        }
+
+        // Тест умножения матриц на диске "diskbench [n]"
+        if (strncmp(input, "diskbench", 9) == 0) {
+            int n = 4096;
+            char* space = strchr(input, ' ');
+            if (space != NULL && atoi(space + 1) > 0) {
+                n = atoi(space + 1);
+            }
+            disk_benchmark(n);
+            continue;
+        }
+
+        // Точность новых матриц "precision [single|double]"
+        if (strcmp(input, "precision") == 0 || strncmp(input, "precision ", 10) == 0) {
+            precision_command(input + 9);
+            continue;
+        }
+
+        // Кэш результатов чистых функций "memo [on|off|clear]"
+        if (strcmp(input, "memo") == 0 || strncmp(input, "memo ", 5) == 0) {
+            memo_command(input + 4);
+            continue;
+        }
+
+        // Память по подсистемам и лимит "mem [МБ|off]"
+        if (strcmp(input, "mem") == 0 || strncmp(input, "mem ", 4) == 0) {
+            mem_command(input + 3);
+            continue;
+        }
+
+        // Отложенные вычисления "lazy [on|off]"
+        if (strcmp(input, "lazy") == 0 || strncmp(input, "lazy ", 5) == 0) {
+            lazy_command(input + 4);
+            continue;
+        }
+
+        // Время вычисления выражения "timeit выражение"
+        if (strcmp(input, "timeit") == 0 || strncmp(input, "timeit ", 7) == 0) {
+            timeit_command(input + 6);
+            continue;
+        }
+
+        // Скорость выполнения сценария "bench файл [n]"
+        if (strcmp(input, "bench") == 0 || strncmp(input, "bench ", 6) == 0) {
+            bench_command(input + 5);
+            continue;
+        }
+
+        // Выбор набора инструкций "isa [уровень]"
+        if (strcmp(input, "isa") == 0 || strncmp(input, "isa ", 4) == 0) {
+            isa_command(input + 3);
             continue;
         }
 
-        //  "open _"
+        // Обработка "open имя_файла"
         if (strncmp(input, "open", 4) == 0) {
 
-            char filename[256] = "program.txt"; //  
+            char filename[256] = "program.txt"; // Дефолтное имя
 
-            //  :   ,  ,   
+            // Простая логика: если есть пробел, берем то, что после него
             char* space = strchr(input, ' ');
             if (space != NULL && strlen(space + 1) > 0) {
                 strcpy(filename, space + 1);
@@ -742,8 +1210,8 @@ int main() {
             }
             else
             {
-                print_log(":     \n");
-                print_log(": open program.txt\n");
+                print_log("Ошибка: введите название файла через пробел\n");
+                print_log("Пример: open program.txt\n");
             }
 
             continue;
@@ -754,13 +1222,15 @@ int main() {
         sprintf(cmd_to_save, "%s\n", input);
         append_to_file("history.tmp", cmd_to_save);
 
-        process_expression(input);
+        process_expression(input, 0);
     }
 
-    //    
+    // Очистка ресурсов перед выходом
     remove("session.tmp");
     remove("history.tmp");
     cleanup_global_data(FirstIdent);
+    user_cleanup();
+    memo_clear();
 
     return 0;
 }
@@ -0,0 +1,722 @@
+#include "lib.h"
+
+// Размеры блоков для умножения матриц (блок B помещается в кэш L2)
+#define GEMM_BLOCK_M 32
+#define GEMM_BLOCK_K 128
+#define GEMM_BLOCK_N 256
+
+// Количество элементов по каждому измерению, выводимых без сокращения
+#define MATRIX_PRINT_LIMIT 10
+#define MATRIX_PRINT_EDGE  4
+
+
+// Кэш разложений значения (создается при первом обращении)
+MatrixCache* matrix_cache_get(MatrixCache **slot) {
+    if (!*slot) {
+        *slot = (MatrixCache*)calloc(1, sizeof(MatrixCache));
+        (*slot)->refs = 1;
+    }
+    return *slot;
+}
+
+// Подключение копии значения к кэшу разложений оригинала
+MatrixCache* matrix_cache_share(MatrixCache **slot) {
+    MatrixCache *cache = matrix_cache_get(slot);
+    cache->refs++;
+    return cache;
+}
+
+// Отключение от кэша; последний владелец освобождает разложения
+void matrix_cache_release(MatrixCache *cache) {
+    if (!cache) return;
+    if (--cache->refs > 0) return;
+
+    lu_free(cache->lu);
+    chol_free(cache->chol);
+    qr_free(cache->qr);
+    slu_free(cache->slu);
+    free(cache);
+}
+
+// Место хранения кэша разложений для плотной (в том числе float) или разреженной матрицы
+MatrixCache** container_cache_slot(Container *container) {
+    if (!container) return NULL;
+    if (container->type == CT_MATRIX) return &((MatrixContainer*)container->data)->cache;
+    if (container->type == CT_SPARSE) return &((SparseContainer*)container->data)->cache;
+    if (container->type == CT_SINGLE) return &((SingleContainer*)container->data)->cache;
+    return NULL;
+}
+
+// Освобождение плотной матрицы
+void free_matrix_container(void *data) {
+    MatrixContainer *mc = (MatrixContainer*)data;
+    if (mc) {
+        matrix_cache_release(mc->cache);
+        if (mc->buffer) matrix_buffer_release(mc->buffer);
+        else mem_free(MEM_CONTAINERS, mc->data);
+        free(mc);
+    }
+}
+
+// Вывод одной строки матрицы с сокращением длинных строк
+static void print_matrix_row(const double *row, int cols) {
+    print_log("[");
+    for (int j = 0; j < cols; j++) {
+        if (cols > MATRIX_PRINT_LIMIT && j == MATRIX_PRINT_EDGE) {
+            print_log("..., ");
+            j = cols - MATRIX_PRINT_EDGE;
+        }
+        print_smart_double(row[j]);
+        if (j + 1 < cols) print_log(", ");
+    }
+    print_log("]");
+}
+
+// Вывод матрицы; столбец n x 1 выводится как обычный список
+void print_matrix_container(void *data) {
+    if (!data) return;
+    MatrixContainer *mc = (MatrixContainer*)data;
+
+    if (mc->cols == 1) {
+        print_matrix_row(mc->data, mc->rows);
+        return;
+    }
+
+    print_log("[");
+    for (int i = 0; i < mc->rows; i++) {
+        if (mc->rows > MATRIX_PRINT_LIMIT && i == MATRIX_PRINT_EDGE) {
+            print_log("..., ");
+            i = mc->rows - MATRIX_PRINT_EDGE;
+        }
+        print_matrix_row(mc->data + (size_t)i * mc->cols, mc->cols);
+        if (i + 1 < mc->rows) print_log(", ");
+    }
+    print_log("]");
+
+    if (mc->rows > MATRIX_PRINT_LIMIT || mc->cols > MATRIX_PRINT_LIMIT) {
+        print_log(" (%dx%d)", mc->rows, mc->cols);
+    }
+}
+
+// Инициализация матричного контейнера, заполненного нулями
+Container* create_matrix_container(int rows, int cols) {
+    double *values = (double*)mem_calloc(MEM_CONTAINERS, (size_t)rows * cols, sizeof(double));
+    if (!values) {
+        print_log("Ошибка: недостаточно памяти для матрицы %dx%d\n", rows, cols);
+        return NULL;
+    }
+
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
+    MatrixContainer *data = (MatrixContainer*)malloc(sizeof(MatrixContainer));
+
+    data->rows = rows;
+    data->cols = cols;
+    data->data = values;
+    data->cache = NULL;
+    data->buffer = NULL;
+    container->type = CT_MATRIX;
+    container->data = data;
+    container->free_func = free_matrix_container;
+    container->print_func = print_matrix_container;
+
+    return container;
+}
+
+// Копия элементов без кэша: результат можно изменять на месте
+static Container* matrix_duplicate(MatrixContainer *m) {
+    Container *copy = create_matrix_container(m->rows, m->cols);
+    if (!copy) return NULL;
+
+    MatrixContainer *mc = (MatrixContainer*)copy->data;
+    memcpy(mc->data, m->data, (size_t)m->rows * m->cols * sizeof(double));
+    return copy;
+}
+
+// Клонирование плотной матрицы; копия того же значения разделяет буфер элементов и кэш разложений
+Container* matrix_copy(MatrixContainer *m) {
+    Container *copy = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
+    MatrixContainer *data = (MatrixContainer*)malloc(sizeof(MatrixContainer));
+
+    data->rows = m->rows;
+    data->cols = m->cols;
+    data->data = m->data;
+    data->buffer = matrix_share_buffer(m);
+    data->cache = matrix_cache_share(&m->cache);
+    copy->type = CT_MATRIX;
+    copy->data = data;
+    copy->free_func = free_matrix_container;
+    copy->print_func = print_matrix_container;
+    return copy;
+}
+
+// Поэлементное сравнение двух матриц
+int matrix_compare(MatrixContainer *a, MatrixContainer *b) {
+    if (a->rows != b->rows || a->cols != b->cols) return 0;
+
+    size_t count = (size_t)a->rows * a->cols;
+    for (size_t i = 0; i < count; i++) {
+        if (fabs(a->data[i] - b->data[i]) >= 1e-10) return 0;
+    }
+    return 1;
+}
+
+// Приведение числа, вектора, матрицы, среза, поля или матрицы на диске к новой плотной матрице
+Container* container_to_matrix(Container *container) {
+    if (!container) return NULL;
+
+    switch (container->type) {
+        case CT_INT:
+        case CT_FLOAT: {
+            Container *result = create_matrix_container(1, 1);
+            if (result) ((MatrixContainer*)result->data)->data[0] = container_to_double(container);
+            return result;
+        }
+        case CT_VECTOR: {
+            VectorContainer *vc = (VectorContainer*)container->data;
+            Container *result = create_matrix_container(3, 1);
+            if (result) {
+                double *d = ((MatrixContainer*)result->data)->data;
+                d[0] = vc->x;
+                d[1] = vc->y;
+                d[2] = vc->z;
+            }
+            return result;
+        }
+        case CT_MATRIX:
+            return matrix_duplicate((MatrixContainer*)container->data);
+        case CT_SPARSE:
+            return sparse_to_dense((SparseContainer*)container->data);
+        case CT_FIELD:
+            return field_to_matrix((FieldContainer*)container->data);
+        case CT_VIEW:
+            return view_to_matrix((ViewContainer*)container->data);
+        case CT_DISK:
+            return disk_to_matrix((DiskContainer*)container->data);
+        case CT_SINGLE:
+            return single_to_matrix((SingleContainer*)container->data);
+        default:
+            return NULL;
+    }
+}
+
+// Копия всех элементов числа, вектора или матрицы (по строкам) в новый массив
+double* container_values(Container *container, int *count) {
+    if (!container) return NULL;
+
+    Container *dense = container_to_matrix(container);
+    if (!dense) return NULL;
+
+    MatrixContainer *mc = (MatrixContainer*)dense->data;
+    double *values = mc->data;
+    *count = mc->rows * mc->cols;
+
+    // Массив забирается у временного контейнера без копирования и дальше
+    // освобождается обычным free
+    mem_untrack(MEM_CONTAINERS, values);
+    mc->data = NULL;
+    free_container(dense);
+    return values;
+}
+
+// Длина контейнера, который может служить строкой матрицы (вектор, строка или столбец)
+static int row_length(Container *c) {
+    if (c->type == CT_VECTOR) return 3;
+    if (c->type == CT_MATRIX) {
+        MatrixContainer *mc = (MatrixContainer*)c->data;
+        if (mc->rows == 1) return mc->cols;
+        if (mc->cols == 1) return mc->rows;
+    }
+    return -1;
+}
+
+// Сборка матрицы из литерала [...]: числа дают столбец, векторы-строки дают матрицу
+Container* matrix_literal(Container** items, int count) {
+    if (count <= 0) return NULL;
+    for (int i = 0; i < count; i++) {
+        if (!items[i]) return NULL;
+    }
+
+    if (container_is_scalar(items[0])) {
+        Container *result = create_matrix_container(count, 1);
+        if (!result) return NULL;
+        double *d = ((MatrixContainer*)result->data)->data;
+
+        for (int i = 0; i < count; i++) {
+            if (!container_is_scalar(items[i])) {
+                print_log("Ошибка: в литерале нельзя смешивать числа и строки\n");
+                free_container(result);
+                return NULL;
+            }
+            d[i] = container_to_double(items[i]);
+        }
+        return result;
+    }
+
+    int cols = row_length(items[0]);
+    if (cols < 0) {
+        print_log("Ошибка: элементом матрицы может быть только число или строка\n");
+        return NULL;
+    }
+
+    for (int i = 1; i < count; i++) {
+        if (row_length(items[i]) != cols) {
+            print_log("Ошибка: строки матрицы имеют разную длину\n");
+            return NULL;
+        }
+    }
+
+    Container *result = create_matrix_container(count, cols);
+    if (!result) return NULL;
+    double *d = ((MatrixContainer*)result->data)->data;
+
+    for (int i = 0; i < count; i++) {
+        double *row = d + (size_t)i * cols;
+        if (items[i]->type == CT_VECTOR) {
+            VectorContainer *vc = (VectorContainer*)items[i]->data;
+            row[0] = vc->x;
+            row[1] = vc->y;
+            row[2] = vc->z;
+        } else {
+            MatrixContainer *mc = (MatrixContainer*)items[i]->data;
+            memcpy(row, mc->data, (size_t)cols * sizeof(double));
+        }
+    }
+    return result;
+}
+
+
+// Умножение матриц C = alpha*A*B + beta*C (хранение по строкам, A: m x k, B: k x n)
+void gemm(int m, int n, int k, double alpha, const double *A, int lda,
+          const double *B, int ldb, double beta, double *C, int ldc) {
+
+    double work = (double)m * n * k;
+
+    // Произведение на вектор: скалярное произведение для каждой строки
+    if (n == 1) {
+        #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < m; i++) {
+            const double *a = A + (size_t)i * lda;
+            double sum = 0.0;
+            if (ldb == 1) {
+                sum = kernels->dot(a, B, k);
+            } else {
+                for (int p = 0; p < k; p++) {
+                    sum += a[p] * B[(size_t)p * ldb];
+                }
+            }
+            double *c = C + (size_t)i * ldc;
+            *c = alpha * sum + (beta == 0.0 ? 0.0 : beta * *c);
+        }
+        return;
+    }
+
+    // Каждый поток обрабатывает свою полосу строк C, поэтому записи не пересекаются
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+    for (int i0 = 0; i0 < m; i0 += GEMM_BLOCK_M) {
+        int i1 = i0 + GEMM_BLOCK_M < m ? i0 + GEMM_BLOCK_M : m;
+
+        for (int i = i0; i < i1; i++) {
+            double *c = C + (size_t)i * ldc;
+            if (beta == 0.0) {
+                for (int j = 0; j < n; j++) c[j] = 0.0;
+            } else if (beta != 1.0) {
+                for (int j = 0; j < n; j++) c[j] *= beta;
+            }
+        }
+
+        for (int p0 = 0; p0 < k; p0 += GEMM_BLOCK_K) {
+            int p1 = p0 + GEMM_BLOCK_K < k ? p0 + GEMM_BLOCK_K : k;
+
+            for (int j0 = 0; j0 < n; j0 += GEMM_BLOCK_N) {
+                int j1 = j0 + GEMM_BLOCK_N < n ? j0 + GEMM_BLOCK_N : n;
+
+                for (int i = i0; i < i1; i++) {
+                    const double *a = A + (size_t)i * lda;
+                    double *c = C + (size_t)i * ldc;
+
+                    for (int p = p0; p < p1; p++) {
+                        double ap = alpha * a[p];
+                        if (ap == 0.0) continue;
+                        kernels->axpy(ap, B + (size_t)p * ldb + j0, c + j0, j1 - j0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// C = A*B для срезов и транспонированных матриц без их копирования (C: m x n подряд).
+// Элемент A(i, p) лежит в A[i*a_rs + p*a_cs], B(p, j) - в B[p*b_rs + j*b_cs].
+// Как в GEMM, но блоки A и B перед накоплением собираются в небольшие непрерывные панели
+int gemm_strided(int m, int n, int k, const double *A, int a_rs, int a_cs,
+                 const double *B, int b_rs, int b_cs, double *C) {
+
+    double work = (double)m * n * k;
+
+    if (a_cs == 1 && (b_cs == 1 || n == 1)) {
+        gemm(m, n, k, 1.0, A, a_rs, B, b_rs, 0.0, C, n);
+        return 1;
+    }
+
+    // A транспонирована, B - столбец: C накапливается по столбцам A, лежащим подряд
+    if (a_rs == 1 && n == 1) {
+        int chunks = (m + KERNEL_CHUNK - 1) / KERNEL_CHUNK;
+        #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+        for (int c = 0; c < chunks; c++) {
+            int i0 = c * KERNEL_CHUNK;
+            int len = m - i0 < KERNEL_CHUNK ? m - i0 : KERNEL_CHUNK;
+            for (int i = i0; i < i0 + len; i++) C[i] = 0.0;
+            for (int p = 0; p < k; p++) {
+                kernels->axpy(B[(ptrdiff_t)p * b_rs], A + (ptrdiff_t)p * a_cs + i0, C + i0, len);
+            }
+        }
+        return 1;
+    }
+
+    double *panel = (double*)malloc((size_t)GEMM_BLOCK_K * GEMM_BLOCK_N * sizeof(double));
+    if (!panel) {
+        print_log("Ошибка: недостаточно памяти для умножения %dx%d на %dx%d\n", m, k, k, n);
+        return 0;
+    }
+    memset(C, 0, (size_t)m * n * sizeof(double));
+
+    for (int p0 = 0; p0 < k; p0 += GEMM_BLOCK_K) {
+        int kb = p0 + GEMM_BLOCK_K < k ? GEMM_BLOCK_K : k - p0;
+
+        for (int j0 = 0; j0 < n; j0 += GEMM_BLOCK_N) {
+            int nb = j0 + GEMM_BLOCK_N < n ? GEMM_BLOCK_N : n - j0;
+
+            // Панель B; для транспонированной B внутренний цикл идет подряд по памяти
+            for (int j = 0; j < nb; j++) {
+                const double *src = B + (ptrdiff_t)p0 * b_rs + (ptrdiff_t)(j0 + j) * b_cs;
+                for (int p = 0; p < kb; p++) panel[(size_t)p * nb + j] = src[(ptrdiff_t)p * b_rs];
+            }
+
+            #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+            for (int i0 = 0; i0 < m; i0 += GEMM_BLOCK_M) {
+                int mb = i0 + GEMM_BLOCK_M < m ? GEMM_BLOCK_M : m - i0;
+
+                // Блок A по строкам
+                double a_block[GEMM_BLOCK_M * GEMM_BLOCK_K];
+                for (int p = 0; p < kb; p++) {
+                    const double *src = A + (ptrdiff_t)i0 * a_rs + (ptrdiff_t)(p0 + p) * a_cs;
+                    for (int i = 0; i < mb; i++) a_block[i * kb + p] = src[(ptrdiff_t)i * a_rs];
+                }
+
+                for (int i = 0; i < mb; i++) {
+                    double *c = C + (size_t)(i0 + i) * n + j0;
+                    for (int p = 0; p < kb; p++) {
+                        double ap = a_block[i * kb + p];
+                        if (ap == 0.0) continue;
+                        kernels->axpy(ap, panel + (size_t)p * nb, c, nb);
+                    }
+                }
+            }
+        }
+    }
+
+    free(panel);
+    return 1;
+}
+
+
+// Матрица 1 x 1 заменяется числом, столбец 3 x 1 при векторном операнде - вектором
+static Container* simplify_result(Container *result, int vector_operand) {
+    if (!result || result->type != CT_MATRIX) return result;
+    MatrixContainer *mc = (MatrixContainer*)result->data;
+
+    if (mc->rows == 1 && mc->cols == 1) {
+        Container *scalar = create_float_container(mc->data[0]);
+        free_container(result);
+        return scalar;
+    }
+    if (vector_operand && mc->rows == 3 && mc->cols == 1) {
+        Container *vec = create_vector_container(mc->data[0], mc->data[1], mc->data[2]);
+        free_container(result);
+        return vec;
+    }
+    return result;
+}
+
+// Умножение матрицы на число или деление (divide) на него
+static Container* matrix_scale_op(Container *a, double scalar, int divide) {
+    if (a->type == CT_SPARSE) {
+        SparseContainer *sp = sparse_convert((SparseContainer*)a->data, ((SparseContainer*)a->data)->format);
+        if (!sp) return NULL;
+        Container *result = create_sparse_container(sp);
+        if (divide) {
+            for (int p = 0; p < sp->nnz; p++) sp->val[p] /= scalar;
+        } else {
+            for (int p = 0; p < sp->nnz; p++) sp->val[p] *= scalar;
+        }
+        return result;
+    }
+
+    Container *result = container_to_matrix(a);
+    if (!result) return NULL;
+    MatrixContainer *mc = (MatrixContainer*)result->data;
+    size_t count = (size_t)mc->rows * mc->cols;
+
+    int chunks = (int)((count + KERNEL_CHUNK - 1) / KERNEL_CHUNK);
+    #pragma omp parallel for if(count > PARALLEL_MIN_WORK) schedule(static)
+    for (int c = 0; c < chunks; c++) {
+        size_t i0 = (size_t)c * KERNEL_CHUNK;
+        int len = (int)(count - i0 < KERNEL_CHUNK ? count - i0 : KERNEL_CHUNK);
+        if (divide) kernels->scal_div(scalar, mc->data + i0, len);
+        else kernels->scal(scalar, mc->data + i0, len);
+    }
+    return result;
+}
+
+Container* matrix_scale(Container *a, double scalar) {
+    return matrix_scale_op(a, scalar, 0);
+}
+
+// Деление на число: умножение на 1/d, только если оно дает тот же результат
+Container* matrix_divide(Container *a, double divisor) {
+    if (reciprocal_exact(divisor)) return matrix_scale_op(a, 1.0 / divisor, 0);
+    return matrix_scale_op(a, divisor, 1);
+}
+
+// Матричное умножение с выбором ядра по форматам операндов
+Container* matrix_mul(Container *a, Container *b) {
+    if (container_is_scalar(a)) return matrix_scale(b, container_to_double(a));
+    if (container_is_scalar(b)) return matrix_scale(a, container_to_double(b));
+
+    // Повороты и однородные преобразования до 4x4 - развернутыми ядрами без временных матриц
+    Container *small = small_matrix_mul(a, b);
+    if (small) return small;
+
+    int vector_operand = (b->type == CT_VECTOR);
+    if (a->type == CT_VECTOR || b->type == CT_VECTOR) {
+        Container *left = a->type == CT_VECTOR ? container_to_matrix(a) : a;
+        Container *right = b->type == CT_VECTOR ? container_to_matrix(b) : b;
+        Container *result = (left && right) ? matrix_mul(left, right) : NULL;
+        if (left != a) free_container(left);
+        if (right != b) free_container(right);
+        return simplify_result(result, vector_operand);
+    }
+
+    // Срезы и транспонированные матрицы читаются GEMM по шагам, без копирования
+    if (a->type == CT_VIEW || b->type == CT_VIEW) {
+        ViewContainer va, vb;
+        if (!strided_operand(a, &va) || !strided_operand(b, &vb)) {
+            Container *left = a->type == CT_VIEW ? container_to_matrix(a) : a;
+            Container *right = b->type == CT_VIEW ? container_to_matrix(b) : b;
+            Container *result = (left && right) ? matrix_mul(left, right) : NULL;
+            if (left != a) free_container(left);
+            if (right != b) free_container(right);
+            return result;
+        }
+        if (va.cols != vb.rows) {
+            print_log("Ошибка: несогласованные размеры %dx%d и %dx%d\n", va.rows, va.cols, vb.rows, vb.cols);
+            return NULL;
+        }
+        Container *result = create_matrix_container(va.rows, vb.cols);
+        if (!result) return NULL;
+        if (!gemm_strided(va.rows, vb.cols, va.cols, va.data, va.row_stride, va.col_stride,
+                          vb.data, vb.row_stride, vb.col_stride, ((MatrixContainer*)result->data)->data)) {
+            free_container(result);
+            return NULL;
+        }
+        return simplify_result(result, 0);
+    }
+
+    if ((a->type != CT_MATRIX && a->type != CT_SPARSE) ||
+        (b->type != CT_MATRIX && b->type != CT_SPARSE)) {
+        print_log("Ошибка: несовместимые типы для матричного умножения\n");
+        return NULL;
+    }
+
+    int a_rows, a_cols, b_rows, b_cols;
+    if (a->type == CT_SPARSE) {
+        a_rows = ((SparseContainer*)a->data)->rows;
+        a_cols = ((SparseContainer*)a->data)->cols;
+    } else {
+        a_rows = ((MatrixContainer*)a->data)->rows;
+        a_cols = ((MatrixContainer*)a->data)->cols;
+    }
+    if (b->type == CT_SPARSE) {
+        b_rows = ((SparseContainer*)b->data)->rows;
+        b_cols = ((SparseContainer*)b->data)->cols;
+    } else {
+        b_rows = ((MatrixContainer*)b->data)->rows;
+        b_cols = ((MatrixContainer*)b->data)->cols;
+    }
+
+    if (a_cols != b_rows) {
+        print_log("Ошибка: несогласованные размеры %dx%d и %dx%d\n", a_rows, a_cols, b_rows, b_cols);
+        return NULL;
+    }
+
+    if (a->type == CT_SPARSE && b->type == CT_SPARSE) {
+        print_log("Ошибка: произведение двух разреженных матриц не поддерживается, используйте dense()\n");
+        return NULL;
+    }
+
+    Container *result = create_matrix_container(a_rows, b_cols);
+    if (!result) return NULL;
+    double *c = ((MatrixContainer*)result->data)->data;
+
+    if (a->type == CT_SPARSE) {
+        sparse_spmm((SparseContainer*)a->data, ((MatrixContainer*)b->data)->data, b_cols, c);
+    } else if (b->type == CT_SPARSE) {
+        dense_sparse_mm(((MatrixContainer*)a->data)->data, a_rows, (SparseContainer*)b->data, c);
+    } else {
+        gemm(a_rows, b_cols, a_cols, 1.0, ((MatrixContainer*)a->data)->data, a_cols,
+             ((MatrixContainer*)b->data)->data, b_cols, 0.0, c, b_cols);
+    }
+
+    return simplify_result(result, 0);
+}
+
+// Поэлементная сумма (sign = 1) или разность (sign = -1) матриц
+Container* matrix_add(Container *a, Container *b, double sign) {
+    if (container_is_scalar(a) || container_is_scalar(b) || a->type == CT_STRING || b->type == CT_STRING) {
+        print_log("Ошибка: несовместимые типы для сложения матриц\n");
+        return NULL;
+    }
+
+    // Сумма двух разреженных матриц остаётся разреженной
+    if (a->type == CT_SPARSE && b->type == CT_SPARSE) {
+        SparseContainer *sa = (SparseContainer*)a->data;
+        SparseContainer *sb = (SparseContainer*)b->data;
+        if (sa->rows != sb->rows || sa->cols != sb->cols) {
+            print_log("Ошибка: несогласованные размеры %dx%d и %dx%d\n", sa->rows, sa->cols, sb->rows, sb->cols);
+            return NULL;
+        }
+
+        SparseContainer *ca = sparse_convert(sa, SP_CSR);
+        SparseContainer *cb = sparse_convert(sb, SP_CSR);
+        if (!ca || !cb) {
+            sparse_free(ca);
+            sparse_free(cb);
+            return NULL;
+        }
+        int nnz = ca->nnz + cb->nnz;
+        int *ri = (int*)malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(int));
+        int *ci = (int*)malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(int));
+        double *v = (double*)malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(double));
+        if (!ri || !ci || !v) {
+            print_log("Ошибка: недостаточно памяти для разреженной матрицы (nnz = %d)\n", nnz);
+            free(ri);
+            free(ci);
+            free(v);
+            sparse_free(ca);
+            sparse_free(cb);
+            return NULL;
+        }
+
+        int pos = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            SparseContainer *s = pass == 0 ? ca : cb;
+            double factor = pass == 0 ? 1.0 : sign;
+            for (int i = 0; i < s->rows; i++) {
+                for (int p = s->ptr[i]; p < s->ptr[i + 1]; p++) {
+                    ri[pos] = i;
+                    ci[pos] = s->idx[p];
+                    v[pos] = factor * s->val[p];
+                    pos++;
+                }
+            }
+        }
+
+        SparseContainer *sum = sparse_from_coo(sa->rows, sa->cols, nnz, ri, ci, v, sa->format);
+        free(ri);
+        free(ci);
+        free(v);
+        sparse_free(ca);
+        sparse_free(cb);
+        return sum ? create_sparse_container(sum) : NULL;
+    }
+
+    Container *result = container_to_matrix(a);
+    Container *other = container_to_matrix(b);
+    if (!result || !other) {
+        free_container(result);
+        free_container(other);
+        return NULL;
+    }
+
+    MatrixContainer *ma = (MatrixContainer*)result->data;
+    MatrixContainer *mb = (MatrixContainer*)other->data;
+    if (ma->rows != mb->rows || ma->cols != mb->cols) {
+        print_log("Ошибка: несогласованные размеры %dx%d и %dx%d\n", ma->rows, ma->cols, mb->rows, mb->cols);
+        free_container(result);
+        free_container(other);
+        return NULL;
+    }
+
+    size_t count = (size_t)ma->rows * ma->cols;
+    int chunks = (int)((count + KERNEL_CHUNK - 1) / KERNEL_CHUNK);
+    #pragma omp parallel for if(count > PARALLEL_MIN_WORK) schedule(static)
+    for (int c = 0; c < chunks; c++) {
+        size_t i0 = (size_t)c * KERNEL_CHUNK;
+        int len = (int)(count - i0 < KERNEL_CHUNK ? count - i0 : KERNEL_CHUNK);
+        kernels->axpy(sign, mb->data + i0, ma->data + i0, len);
+    }
+
+    free_container(other);
+    return simplify_result(result, a->type == CT_VECTOR || b->type == CT_VECTOR);
+}
+
+
+// Чтение неотрицательного целого аргумента (размера)
+int arg_to_size(Container *arg, const char *func_name, int *out) {
+    if (!arg || !container_is_scalar(arg)) {
+        print_log("%s: размер должен быть числом\n", func_name);
+        return 0;
+    }
+    double value = container_to_double(arg);
+    if (value < 1 || value != floor(value) || value > 2147483647.0) {
+        print_log("%s: размер должен быть натуральным числом\n", func_name);
+        return 0;
+    }
+    *out = (int)value;
+    return 1;
+}
+
+// Нулевая матрица заданного размера
+Container* zeros_func(Container** args, int arg_count) {
+    if (arg_count != 2) {
+        print_log("zeros: ожидается 2 аргумента\n");
+        return NULL;
+    }
+    int rows, cols;
+    if (!arg_to_size(args[0], "zeros", &rows) || !arg_to_size(args[1], "zeros", &cols)) return NULL;
+
+    return create_matrix_container(rows, cols);
+}
+
+// Единичная матрица
+Container* eye_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("eye: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    int n;
+    if (!arg_to_size(args[0], "eye", &n)) return NULL;
+
+    Container *result = create_matrix_container(n, n);
+    if (!result) return NULL;
+    double *d = ((MatrixContainer*)result->data)->data;
+    for (int i = 0; i < n; i++) d[(size_t)i * n + i] = 1.0;
+    return result;
+}
+
+// Матрица со случайными элементами из [0, 1)
+Container* rand_func(Container** args, int arg_count) {
+    if (arg_count != 2) {
+        print_log("rand: ожидается 2 аргумента\n");
+        return NULL;
+    }
+    int rows, cols;
+    if (!arg_to_size(args[0], "rand", &rows) || !arg_to_size(args[1], "rand", &cols)) return NULL;
+
+    Container *result = create_matrix_container(rows, cols);
+    if (!result) return NULL;
+    double *d = ((MatrixContainer*)result->data)->data;
+    size_t count = (size_t)rows * cols;
+    for (size_t i = 0; i < count; i++) d[i] = rand_uniform();
+    return result;
+}
@@ -0,0 +1,207 @@
+#include "lib.h"
+#include <atomic>
+#include <malloc.h>
+
+// Учет памяти по подсистемам: токены, значения (контейнеры и их элементы),
+// переменные, кэши (разложения и записи memo) и крупные рабочие буферы функций.
+// Размер блока при освобождении берется у самой
+// кучи (_msize), поэтому блок можно отдать коду, который освобождает его
+// обычным free (container_values) - для этого он снимается с учета mem_untrack.
+//
+// Лимит проверяется только для крупных блоков (элементы матриц, разложения):
+// их создатели уже умеют возвращать NULL, и выражение завершается ошибкой
+// вместо аварии процесса. Мелкие блоки (токены, заголовки) лимит не проверяют.
+// Перед отказом вытесняются записи кэша memo, начиная с самых старых.
+// Счетчики атомарные: токены выделяют и потоки разбора сценария.
+
+#define MEM_LIMIT_BLOCK ((size_t)64 << 10)     // Блоки от 64 КБ проверяются по лимиту
+
+static const char *mem_kind_names[MEM_KINDS] = {"токены", "значения", "переменные", "кэши", "рабочие буферы"};
+
+static std::atomic<long long> mem_bytes[MEM_KINDS];
+static std::atomic<long long> mem_total{0};
+static std::atomic<long long> mem_peak{0};
+static std::atomic<long long> mem_mark_peak{0};    // Пик с начала текущего выражения
+static long long mem_mark_base = 0;
+static long long mem_last_eval = -1;                // Прирост пика в последнем выражении
+static size_t mem_limit = 0;                        // 0 - без лимита
+static std::atomic<unsigned long> mem_refused{0};
+static std::atomic<unsigned long long> mem_allocations{0};   // Всего выделений с начала работы
+static std::atomic<unsigned long long> mem_allocated{0};     // и байт в них
+
+static size_t block_size(void *p) {
+#ifdef _WIN32
+    return _msize(p);
+#else
+    return malloc_usable_size(p);
+#endif
+}
+
+static void raise_peak(std::atomic<long long> *peak, long long value) {
+    long long seen = peak->load(std::memory_order_relaxed);
+    while (value > seen && !peak->compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+static void account(MemKind kind, long long delta) {
+    mem_bytes[kind].fetch_add(delta, std::memory_order_relaxed);
+    long long total = mem_total.fetch_add(delta, std::memory_order_relaxed) + delta;
+    if (delta > 0) {
+        mem_allocations.fetch_add(1, std::memory_order_relaxed);
+        mem_allocated.fetch_add((unsigned long long)delta, std::memory_order_relaxed);
+        raise_peak(&mem_peak, total);
+        raise_peak(&mem_mark_peak, total);
+    }
+}
+
+// Крупный блок не помещается в лимит
+static int over_limit(size_t bytes) {
+    if (!mem_limit || bytes < MEM_LIMIT_BLOCK) return 0;
+    long long total = mem_total.load(std::memory_order_relaxed);
+    if (total + (long long)bytes <= (long long)mem_limit) return 0;
+
+    // Кэш memo не защищен от потоков, его трогает только основной поток вне параллельных областей
+    while (!omp_in_parallel() && memo_evict_oldest()) {
+        total = mem_total.load(std::memory_order_relaxed);
+        if (total + (long long)bytes <= (long long)mem_limit) return 0;
+    }
+
+    mem_refused++;
+    print_log("Ошибка: лимит памяти %.0f МБ, занято %.1f МБ, нужно еще %.1f МБ\n",
+              mem_limit / 1048576.0, total / 1048576.0, bytes / 1048576.0);
+    return 1;
+}
+
+void* mem_alloc(MemKind kind, size_t bytes) {
+    if (over_limit(bytes)) return NULL;
+    void *p = malloc(bytes);
+    if (p) account(kind, (long long)block_size(p));
+    return p;
+}
+
+void* mem_calloc(MemKind kind, size_t count, size_t size) {
+    if (size && count > (size_t)-1 / size) return NULL;
+    if (over_limit(count * size)) return NULL;
+    void *p = calloc(count, size);
+    if (p) account(kind, (long long)block_size(p));
+    return p;
+}
+
+char* mem_strdup(MemKind kind, const char *s) {
+    size_t len = strlen(s) + 1;
+    char *copy = (char*)mem_alloc(kind, len);
+    if (copy) memcpy(copy, s, len);
+    return copy;
+}
+
+void mem_free(MemKind kind, void *p) {
+    if (!p) return;
+    account(kind, -(long long)block_size(p));
+    free(p);
+}
+
+// Блок уходит из-под учета: дальше его освобождают обычным free
+void mem_untrack(MemKind kind, void *p) {
+    if (p) account(kind, -(long long)block_size(p));
+}
+
+// Учтенные байты переходят к другой подсистеме: буфер, который теперь держит кэш memo
+void mem_transfer(MemKind from, MemKind to, size_t bytes) {
+    mem_bytes[from].fetch_sub((long long)bytes, std::memory_order_relaxed);
+    mem_bytes[to].fetch_add((long long)bytes, std::memory_order_relaxed);
+}
+
+// Начало и конец вычисления выражения: сколько памяти оно заняло сверх исходной
+void mem_mark_begin() {
+    mem_mark_base = mem_total.load(std::memory_order_relaxed);
+    mem_mark_peak.store(mem_mark_base, std::memory_order_relaxed);
+}
+
+void mem_mark_end() {
+    mem_last_eval = mem_mark_peak.load(std::memory_order_relaxed) - mem_mark_base;
+}
+
+// Сколько блоков и байт выделено с начала работы (освобождения не вычитаются)
+void mem_counters(unsigned long long *allocations, unsigned long long *bytes) {
+    *allocations = mem_allocations.load(std::memory_order_relaxed);
+    *bytes = mem_allocated.load(std::memory_order_relaxed);
+}
+
+// Лимит задан: крупное выделение может завершиться сообщением об отказе
+int mem_limited() {
+    return mem_limit != 0;
+}
+
+// Примерный объем памяти значения
+size_t container_bytes(Container *c) {
+    if (!c) return 0;
+    size_t base = sizeof(Container) + 32;
+    switch (c->type) {
+        case CT_MATRIX: {
+            MatrixContainer *m = (MatrixContainer*)c->data;
+            return base + (size_t)m->rows * m->cols * sizeof(double);
+        }
+        case CT_SINGLE: {
+            SingleContainer *m = (SingleContainer*)c->data;
+            return base + (size_t)m->rows * m->cols * sizeof(float);
+        }
+        case CT_COMPLEX: {
+            ComplexContainer *m = (ComplexContainer*)c->data;
+            return base + (size_t)m->rows * m->cols * sizeof(Complex);
+        }
+        case CT_SPARSE: {
+            SparseContainer *sp = (SparseContainer*)c->data;
+            return base + (size_t)sp->nnz * (sizeof(int) + sizeof(double)) +
+                   (size_t)((sp->rows > sp->cols ? sp->rows : sp->cols) + 1) * sizeof(int);
+        }
+        case CT_FIELD:
+            return base + (size_t)((FieldContainer*)c->data)->count * 3 * sizeof(double);
+        case CT_LIST: {
+            ListContainer *l = (ListContainer*)c->data;
+            size_t total = base;
+            for (int i = 0; i < l->count; i++) total += container_bytes(l->items[i]);
+            return total;
+        }
+        default:
+            return base;
+    }
+}
+
+static double megabytes(long long bytes) {
+    return bytes / 1048576.0;
+}
+
+// Команда "mem [лимит в МБ|off]": счетчики, пик, переменные и лимит
+void mem_command(const char *arg) {
+    while (arg != NULL && *arg == ' ') arg++;
+    if (arg != NULL && *arg != 0) {
+        if (strcmp(arg, "off") == 0) {
+            lazy_force_all();
+            mem_limit = 0;
+        } else if (atof(arg) > 0) {
+            lazy_force_all();
+            mem_limit = (size_t)(atof(arg) * 1048576.0);
+        } else {
+            print_log("mem: ожидается лимит в МБ или off\n");
+            return;
+        }
+    }
+
+    print_log("Память: занято %.1f МБ, пик %.1f МБ, ", megabytes(mem_total.load()), megabytes(mem_peak.load()));
+    if (mem_limit) print_log("лимит %.0f МБ, отказов %lu\n", megabytes((long long)mem_limit), mem_refused.load());
+    else print_log("без лимита\n");
+    for (int k = 0; k < MEM_KINDS; k++) {
+        print_log("  %-16s %10.2f МБ\n", mem_kind_names[k], megabytes(mem_bytes[k].load()));
+    }
+
+    // Значения переменных; матрицы с общим буфером считаются у каждой переменной
+    int count = 0, pending = 0;
+    size_t values = 0;
+    for (Ident *ident = FirstIdent; ident; ident = ident->next) {
+        count++;
+        if (ident->lazy) pending++;
+        else if (ident->value) values += container_bytes(ident->value->container);
+    }
+    print_log("Переменные: %d (отложено %d), значения %.2f МБ\n", count, pending, megabytes((long long)values));
+    if (mem_last_eval >= 0) print_log("Последнее выражение: пик +%.2f МБ\n", megabytes(mem_last_eval));
+}
@@ -0,0 +1,305 @@
+#include "lib.h"
+
+// Кэш результатов чистых функций (MEMO_PURE в таблице функций).
+//
+// Ключ - функция и 64-битный хэш содержимого аргументов (тип, размеры и все
+// элементы), поэтому одинаковые значения в разных переменных дают попадание, а
+// новое присваивание - промах. Хэш считается одним проходом по памяти: для
+// матрицы 1000x1000 около миллисекунды, что мало рядом с inv, eig или sort.
+// Совпадение хэшей разных аргументов имеет вероятность порядка 2^-64.
+//
+// Результат хранится копией: плотные матрицы при этом делят буфер элементов и
+// кэш разложений, так что попадание не копирует данные. Память ограничена
+// MEMO_MAX_BYTES и числом записей; вытесняется давно не использованная запись.
+// Байты записей учитываются в mem как кэши, а не значения; при нехватке памяти
+// под лимитом mem вытесняет записи сам (memo_evict_oldest).
+// Функции со случайностью, файлами или сообщениями о ходе вычисления не кэшируются.
+
+#define MEMO_ENTRIES    64
+#define MEMO_MAX_BYTES  ((size_t)256 << 20)
+#define MEMO_STATS      32          // Функций в статистике попаданий
+
+// Хэш больших массивов считается порциями параллельно; порции фиксированы,
+// поэтому хэш не зависит от числа потоков
+#define HASH_CHUNK      (1 << 16)   // Байт в порции
+
+typedef struct {
+    const FunctionDef *func;
+    unsigned long long key;
+    Container *result;
+    size_t bytes;
+    unsigned long used;
+} MemoEntry;
+
+typedef struct {
+    const FunctionDef *func;
+    unsigned long hits;
+    unsigned long misses;
+} MemoStats;
+
+static MemoEntry memo_entries[MEMO_ENTRIES];
+static MemoStats memo_stats[MEMO_STATS];
+static size_t memo_bytes = 0;
+static unsigned long memo_clock = 0;
+static unsigned long memo_evictions = 0;
+int memo_enabled = 1;
+
+
+// Хэш
+
+static const unsigned long long PRIME1 = 0x9E3779B185EBCA87ULL;
+static const unsigned long long PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const unsigned long long PRIME3 = 0x165667B19E3779F9ULL;
+
+static inline unsigned long long rotl64(unsigned long long x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline unsigned long long hash_mix(unsigned long long h, unsigned long long w) {
+    return rotl64(h ^ (rotl64(w * PRIME2, 31) * PRIME1), 27) * PRIME1 + PRIME3;
+}
+
+// Четыре независимые цепочки, чтобы умножения шли параллельно
+static unsigned long long hash_block(const unsigned char *p, size_t bytes) {
+    unsigned long long h[4] = { PRIME1, PRIME2, PRIME3, PRIME1 ^ PRIME2 };
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        unsigned long long w[4];
+        memcpy(w, p + i, sizeof(w));
+        for (int l = 0; l < 4; l++) h[l] = hash_mix(h[l], w[l]);
+    }
+    unsigned long long r = hash_mix(hash_mix(hash_mix(h[0], h[1]), h[2]), h[3]);
+    for (; i + 8 <= bytes; i += 8) {
+        unsigned long long w;
+        memcpy(&w, p + i, sizeof(w));
+        r = hash_mix(r, w);
+    }
+    if (i < bytes) {
+        unsigned long long w = 0;
+        memcpy(&w, p + i, bytes - i);
+        r = hash_mix(r, w);
+    }
+    return hash_mix(r, bytes);
+}
+
+static unsigned long long hash_bytes(unsigned long long h, const void *data, size_t bytes) {
+    const unsigned char *p = (const unsigned char*)data;
+    if (bytes <= HASH_CHUNK) return hash_mix(h, hash_block(p, bytes));
+
+    int chunks = (int)((bytes + HASH_CHUNK - 1) / HASH_CHUNK);
+    unsigned long long *parts = (unsigned long long*)malloc((size_t)chunks * sizeof(unsigned long long));
+    if (!parts) return hash_mix(h, hash_block(p, bytes));
+
+    #pragma omp parallel for if(bytes > (size_t)PARALLEL_MIN_WORK * 8) schedule(static)
+    for (int c = 0; c < chunks; c++) {
+        size_t start = (size_t)c * HASH_CHUNK;
+        size_t len = bytes - start < HASH_CHUNK ? bytes - start : HASH_CHUNK;
+        parts[c] = hash_block(p + start, len);
+    }
+    for (int c = 0; c < chunks; c++) h = hash_mix(h, parts[c]);
+    free(parts);
+    return h;
+}
+
+// Хэш значения аргумента; 0 - тип не кэшируется (список, срез, диапазон, файл)
+static int hash_container(Container *c, unsigned long long *h) {
+    if (!c) return 0;
+    *h = hash_mix(*h, (unsigned long long)c->type + 1);
+
+    switch (c->type) {
+        case CT_INT:
+            *h = hash_mix(*h, (unsigned long long)((IntContainer*)c->data)->value);
+            return 1;
+        case CT_FLOAT:
+            *h = hash_bytes(*h, &((FloatContainer*)c->data)->value, sizeof(double));
+            return 1;
+        case CT_VECTOR:
+            *h = hash_bytes(*h, c->data, sizeof(VectorContainer));
+            return 1;
+        case CT_QUAT:
+            *h = hash_bytes(*h, c->data, sizeof(QuatContainer));
+            return 1;
+        case CT_STRING: {
+            StringContainer *s = (StringContainer*)c->data;
+            *h = hash_bytes(*h, s->value, strlen(s->value));
+            return 1;
+        }
+        case CT_MATRIX: {
+            MatrixContainer *m = (MatrixContainer*)c->data;
+            *h = hash_mix(hash_mix(*h, m->rows), m->cols);
+            *h = hash_bytes(*h, m->data, (size_t)m->rows * m->cols * sizeof(double));
+            return 1;
+        }
+        case CT_SINGLE: {
+            SingleContainer *m = (SingleContainer*)c->data;
+            *h = hash_mix(hash_mix(*h, m->rows), m->cols);
+            *h = hash_bytes(*h, m->data, (size_t)m->rows * m->cols * sizeof(float));
+            return 1;
+        }
+        case CT_COMPLEX: {
+            ComplexContainer *m = (ComplexContainer*)c->data;
+            *h = hash_mix(hash_mix(*h, m->rows), m->cols);
+            *h = hash_bytes(*h, m->data, (size_t)m->rows * m->cols * sizeof(Complex));
+            return 1;
+        }
+        case CT_SPARSE: {
+            SparseContainer *sp = (SparseContainer*)c->data;
+            int lines = sp->format == SP_CSR ? sp->rows : sp->cols;
+            *h = hash_mix(hash_mix(hash_mix(*h, sp->format), sp->rows), sp->cols);
+            *h = hash_bytes(*h, sp->ptr, (size_t)(lines + 1) * sizeof(int));
+            *h = hash_bytes(*h, sp->idx, (size_t)sp->nnz * sizeof(int));
+            *h = hash_bytes(*h, sp->val, (size_t)sp->nnz * sizeof(double));
+            return 1;
+        }
+        case CT_FIELD: {
+            FieldContainer *f = (FieldContainer*)c->data;
+            *h = hash_mix(*h, f->count);
+            *h = hash_bytes(*h, f->x, (size_t)f->count * sizeof(double));
+            *h = hash_bytes(*h, f->y, (size_t)f->count * sizeof(double));
+            *h = hash_bytes(*h, f->z, (size_t)f->count * sizeof(double));
+            return 1;
+        }
+        default:
+            return 0;
+    }
+}
+
+// Записи
+
+static MemoStats* stats_for(const FunctionDef *f) {
+    for (int i = 0; i < MEMO_STATS; i++) {
+        if (memo_stats[i].func == f) return &memo_stats[i];
+        if (!memo_stats[i].func) {
+            memo_stats[i].func = f;
+            return &memo_stats[i];
+        }
+    }
+    return NULL;
+}
+
+static void entry_free(MemoEntry *e) {
+    mem_transfer(MEM_CACHES, MEM_CONTAINERS, e->bytes);
+    free_container(e->result);
+    memo_bytes -= e->bytes;
+    memset(e, 0, sizeof(*e));
+}
+
+static MemoEntry* memo_find(const FunctionDef *f, unsigned long long key) {
+    for (int i = 0; i < MEMO_ENTRIES; i++) {
+        if (memo_entries[i].result && memo_entries[i].key == key && memo_entries[i].func == f) {
+            return &memo_entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Свободная запись; давно не использованные вытесняются, пока результат не поместится
+static MemoEntry* memo_slot(size_t bytes) {
+    while (1) {
+        MemoEntry *oldest = NULL;
+        for (int i = 0; i < MEMO_ENTRIES; i++) {
+            MemoEntry *e = &memo_entries[i];
+            if (!e->result) {
+                if (memo_bytes + bytes <= MEMO_MAX_BYTES) return e;
+                continue;
+            }
+            if (!oldest || e->used < oldest->used) oldest = e;
+        }
+        if (!oldest) return NULL;
+        entry_free(oldest);
+        memo_evictions++;
+    }
+}
+
+// Вытеснить самую старую запись; 0 - кэш пуст
+int memo_evict_oldest() {
+    MemoEntry *oldest = NULL;
+    for (int i = 0; i < MEMO_ENTRIES; i++) {
+        MemoEntry *e = &memo_entries[i];
+        if (e->result && (!oldest || e->used < oldest->used)) oldest = e;
+    }
+    if (!oldest) return 0;
+    entry_free(oldest);
+    memo_evictions++;
+    return 1;
+}
+
+Container* memo_call(const FunctionDef *f, Container **args, int count) {
+    if (!memo_enabled || !(f->memo & MEMO_PURE)) return f->func(args, count);
+
+    unsigned long long key = hash_mix(PRIME3, (unsigned long long)count);
+    for (int i = 0; i < count; i++) {
+        if (!hash_container(args[i], &key)) return f->func(args, count);
+    }
+
+    MemoStats *stats = stats_for(f);
+    MemoEntry *e = memo_find(f, key);
+    if (e) {
+        e->used = ++memo_clock;
+        if (stats) stats->hits++;
+        return container_deep_copy(e->result);
+    }
+    if (stats) stats->misses++;
+
+    Container *result = f->func(args, count);
+    if (!result) return NULL;
+
+    // Результат больше четверти кэша вытеснил бы почти все остальное
+    size_t bytes = container_bytes(result);
+    if (bytes > MEMO_MAX_BYTES / 4) return result;
+
+    e = memo_slot(bytes);
+    if (!e) return result;
+    e->func = f;
+    e->key = key;
+    e->result = container_deep_copy(result);
+    if (!e->result) return result;
+    e->bytes = bytes;
+    mem_transfer(MEM_CONTAINERS, MEM_CACHES, bytes);
+    e->used = ++memo_clock;
+    memo_bytes += bytes;
+    return result;
+}
+
+void memo_clear() {
+    for (int i = 0; i < MEMO_ENTRIES; i++) {
+        if (memo_entries[i].result) entry_free(&memo_entries[i]);
+    }
+}
+
+// Команда "memo [on|off|clear]": режим и доля попаданий по функциям
+void memo_command(const char *arg) {
+    while (arg != NULL && *arg == ' ') arg++;
+    if (arg != NULL && *arg != 0) {
+        if (strcmp(arg, "on") == 0) {
+            memo_enabled = 1;
+        } else if (strcmp(arg, "off") == 0) {
+            memo_enabled = 0;
+            memo_clear();
+        } else if (strcmp(arg, "clear") == 0) {
+            memo_clear();
+            memset(memo_stats, 0, sizeof(memo_stats));
+            memo_evictions = 0;
+        } else {
+            print_log("memo: неизвестный режим %s (on, off или clear)\n", arg);
+            return;
+        }
+    }
+
+    int entries = 0;
+    for (int i = 0; i < MEMO_ENTRIES; i++) entries += memo_entries[i].result != NULL;
+    print_log("Кэш результатов: %s, записей %d из %d, %.1f МБ из %d МБ, вытеснено %lu\n",
+              memo_enabled ? "включен" : "выключен", entries, MEMO_ENTRIES,
+              memo_bytes / 1048576.0, (int)(MEMO_MAX_BYTES >> 20), memo_evictions);
+
+    unsigned long hits = 0, calls = 0;
+    for (int i = 0; i < MEMO_STATS && memo_stats[i].func; i++) {
+        const MemoStats *s = &memo_stats[i];
+        unsigned long n = s->hits + s->misses;
+        print_log("  %-10s попаданий %lu из %lu (%.1f%%)\n", s->func->name, s->hits, n,
+                  n ? 100.0 * s->hits / n : 0.0);
+        hits += s->hits;
+        calls += n;
+    }
+    print_log("Всего попаданий %lu из %lu (%.1f%%)\n", hits, calls, calls ? 100.0 * hits / calls : 0.0);
+}
@@ -0,0 +1,347 @@
+#include "lib.h"
+#include <float.h>
+
+// Свертки массивов: sum, mean, norm, dot, min, max по всем элементам или по осям.
+//
+// Массив делится на порции по KERNEL_CHUNK элементов. Порции сворачиваются
+// параллельно ядрами из таблицы kernels, а частичные результаты складываются
+// попарным деревом в фиксированном порядке. Поэтому результат не зависит ни
+// от числа потоков, ни от расписания OpenMP. Режимы суммирования:
+//   по умолчанию - векторная сумма в порции, дерево над порциями;
+//   "pairwise"   - попарное суммирование и внутри порции, до PAIRWISE_BASE элементов;
+//   "kahan"      - суммирование Кэхэна в порции и Ноймайера над порциями.
+// По столбцам матрица обходится полосами по COL_STRIP столбцов, строки
+// прибавляются к полосе по порядку (в режиме "pairwise" - попарно).
+
+#define PAIRWISE_BASE 128
+#define COL_STRIP 256
+
+typedef enum {
+    RK_SUM,
+    RK_DOT,         // Сумма x[i]*y[i]; для нормы y = x
+    RK_MIN,
+    RK_MAX
+} ReduceKind;
+
+typedef enum {
+    RM_PLAIN,
+    RM_PAIRWISE,
+    RM_KAHAN
+} ReduceMode;
+
+typedef enum {
+    AXIS_ALL,
+    AXIS_ROWS,      // Одно значение на строку
+    AXIS_COLS       // Одно значение на столбец
+} ReduceAxis;
+
+
+static double pairwise_sum(const double *x, int n) {
+    if (n <= PAIRWISE_BASE) return kernels->sum(x, n);
+    int h = n / 2;
+    return pairwise_sum(x, h) + pairwise_sum(x + h, n - h);
+}
+
+static double pairwise_dot(const double *x, const double *y, int n) {
+    if (n <= PAIRWISE_BASE) return kernels->dot(x, y, n);
+    int h = n / 2;
+    return pairwise_dot(x, y, h) + pairwise_dot(x + h, y + h, n - h);
+}
+
+// Свертка одной порции
+static double chunk_reduce(const double *x, const double *y, int n, ReduceKind kind, ReduceMode mode) {
+    switch (kind) {
+        case RK_MIN:
+            return kernels->minval(x, n);
+        case RK_MAX:
+            return kernels->maxval(x, n);
+        case RK_SUM:
+            if (mode == RM_KAHAN) return kernels->sum_kahan(x, n);
+            return mode == RM_PAIRWISE ? pairwise_sum(x, n) : kernels->sum(x, n);
+        default:
+            if (mode == RM_KAHAN) return kernels->dot_kahan(x, y, n);
+            return mode == RM_PAIRWISE ? pairwise_dot(x, y, n) : kernels->dot(x, y, n);
+    }
+}
+
+// Объединение частичных результатов порций в фиксированном порядке
+static double combine(const double *part, int n, ReduceKind kind, ReduceMode mode) {
+    if (kind == RK_MIN || kind == RK_MAX) {
+        double m = part[0];
+        for (int i = 1; i < n; i++) {
+            if (kind == RK_MIN ? part[i] < m : part[i] > m) m = part[i];
+        }
+        return m;
+    }
+    if (mode == RM_KAHAN) {
+        double sum = 0.0, comp = 0.0;
+        for (int i = 0; i < n; i++) neumaier_add(&sum, &comp, part[i]);
+        return sum + comp;
+    }
+    if (n == 1) return part[0];
+    int h = n / 2;
+    return combine(part, h, kind, mode) + combine(part + h, n - h, kind, mode);
+}
+
+// Свертка n подряд идущих элементов; parallel = 0 внутри уже параллельного цикла
+static double reduce_array(const double *x, const double *y, size_t n,
+                           ReduceKind kind, ReduceMode mode, int parallel) {
+    int chunks = (int)((n + KERNEL_CHUNK - 1) / KERNEL_CHUNK);
+    if (chunks == 1) return chunk_reduce(x, y, (int)n, kind, mode);
+
+    double *part = (double*)malloc((size_t)chunks * sizeof(double));
+    if (!part) return NAN;
+
+    #pragma omp parallel for if(parallel && n > PARALLEL_MIN_WORK) schedule(static)
+    for (int c = 0; c < chunks; c++) {
+        size_t i0 = (size_t)c * KERNEL_CHUNK;
+        int len = (int)(n - i0 < KERNEL_CHUNK ? n - i0 : KERNEL_CHUNK);
+        part[c] = chunk_reduce(x + i0, y ? y + i0 : NULL, len, kind, mode);
+    }
+
+    double result = combine(part, chunks, kind, mode);
+    free(part);
+    return result;
+}
+
+// Норма по сумме квадратов; при переполнении или потере порядка
+// пересчитывается с масштабированием на наибольший по модулю элемент
+static double finish_norm(double ss, const double *x, size_t n, size_t stride) {
+    if (ss != ss || (ss >= DBL_MIN && ss <= DBL_MAX)) return sqrt(ss);
+
+    double amax = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double v = fabs(x[i * stride]);
+        if (v > amax) amax = v;
+    }
+    if (amax == 0.0 || amax > DBL_MAX) return amax;
+
+    double scaled = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double t = x[i * stride] / amax;
+        scaled += t * t;
+    }
+    return amax * sqrt(scaled);
+}
+
+
+// Свертка строк [r0, r1) полосы шириной w по столбцам
+static void strip_reduce(const double *a, int ld, int r0, int r1, int w,
+                         ReduceKind kind, ReduceMode mode, double *out) {
+    if (mode == RM_PAIRWISE && r1 - r0 > PAIRWISE_BASE) {
+        double tmp[COL_STRIP];
+        int h = r0 + (r1 - r0) / 2;
+        strip_reduce(a, ld, r0, h, w, kind, mode, out);
+        strip_reduce(a, ld, h, r1, w, kind, mode, tmp);
+        for (int j = 0; j < w; j++) out[j] += tmp[j];
+        return;
+    }
+
+    const double *row = a + (size_t)r0 * ld;
+    if (kind == RK_DOT) {
+        for (int j = 0; j < w; j++) out[j] = row[j] * row[j];
+    } else {
+        memcpy(out, row, (size_t)w * sizeof(double));
+    }
+
+    double comp[COL_STRIP];
+    if (mode == RM_KAHAN) memset(comp, 0, (size_t)w * sizeof(double));
+
+    for (int r = r0 + 1; r < r1; r++) {
+        row = a + (size_t)r * ld;
+        switch (kind) {
+            case RK_MIN:
+                #pragma omp simd
+                for (int j = 0; j < w; j++) out[j] = row[j] < out[j] ? row[j] : out[j];
+                break;
+            case RK_MAX:
+                #pragma omp simd
+                for (int j = 0; j < w; j++) out[j] = row[j] > out[j] ? row[j] : out[j];
+                break;
+            default:
+                if (mode == RM_KAHAN) {
+                    for (int j = 0; j < w; j++) {
+                        double v = (kind == RK_DOT ? row[j] * row[j] : row[j]) - comp[j];
+                        double t = out[j] + v;
+                        comp[j] = (t - out[j]) - v;
+                        out[j] = t;
+                    }
+                } else if (kind == RK_DOT) {
+                    #pragma omp simd
+                    for (int j = 0; j < w; j++) out[j] += row[j] * row[j];
+                } else {
+                    #pragma omp simd
+                    for (int j = 0; j < w; j++) out[j] += row[j];
+                }
+                break;
+        }
+    }
+
+    if (mode == RM_KAHAN && kind != RK_MIN && kind != RK_MAX) {
+        for (int j = 0; j < w; j++) out[j] -= comp[j];
+    }
+}
+
+// Свертка матрицы по выбранной оси в out (rows или cols значений)
+static void reduce_axis(const MatrixContainer *m, ReduceAxis axis, ReduceKind kind,
+                        ReduceMode mode, double *out) {
+    size_t work = (size_t)m->rows * m->cols;
+
+    if (axis == AXIS_ROWS) {
+        #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < m->rows; i++) {
+            const double *row = m->data + (size_t)i * m->cols;
+            out[i] = reduce_array(row, row, (size_t)m->cols, kind, mode, 0);
+        }
+        return;
+    }
+
+    int strips = (m->cols + COL_STRIP - 1) / COL_STRIP;
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+    for (int s = 0; s < strips; s++) {
+        int j0 = s * COL_STRIP;
+        int w = m->cols - j0 < COL_STRIP ? m->cols - j0 : COL_STRIP;
+        strip_reduce(m->data + j0, m->cols, 0, m->rows, w, kind, mode, out + j0);
+    }
+}
+
+
+// Разбор необязательных строковых параметров: ось и режим суммирования
+static int parse_options(Container** args, int first, int arg_count, const char *name,
+                         ReduceAxis *axis, ReduceMode *mode, int allow_mode) {
+    *axis = AXIS_ALL;
+    *mode = RM_PLAIN;
+    for (int i = first; i < arg_count; i++) {
+        const char *opt = args[i] && args[i]->type == CT_STRING ?
+                          ((StringContainer*)args[i]->data)->value : NULL;
+        if (opt && strcmp(opt, "rows") == 0) *axis = AXIS_ROWS;
+        else if (opt && strcmp(opt, "cols") == 0) *axis = AXIS_COLS;
+        else if (opt && allow_mode && strcmp(opt, "pairwise") == 0) *mode = RM_PAIRWISE;
+        else if (opt && allow_mode && strcmp(opt, "kahan") == 0) *mode = RM_KAHAN;
+        else {
+            print_log("%s: параметр должен быть %s\n", name, allow_mode ?
+                      "\"rows\", \"cols\", \"pairwise\" или \"kahan\"" : "\"rows\" или \"cols\"");
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Значения аргумента в виде плотной матрицы; число и вектор копируются,
+// разреженная матрица раскрывается во временную плотную
+static MatrixContainer* reduce_operand(Container *a, Container **temp, const char *name) {
+    *temp = NULL;
+    if (a && (container_is_scalar(a) || a->type == CT_VECTOR)) {
+        *temp = container_to_matrix(a);
+        return *temp ? (MatrixContainer*)(*temp)->data : NULL;
+    }
+    MatrixContainer *m = a ? dense_view(a, temp) : NULL;
+    if (!m) print_log("%s: аргумент должен быть числом, вектором или матрицей\n", name);
+    return m;
+}
+
+static Container* reduce_call(Container** args, int arg_count, ReduceKind kind,
+                              int mean, int norm, const char *name) {
+    if (arg_count < 1) {
+        print_log("%s: ожидается хотя бы 1 аргумент\n", name);
+        return NULL;
+    }
+    ReduceAxis axis;
+    ReduceMode mode;
+    int sums = kind == RK_SUM || kind == RK_DOT;
+    if (!parse_options(args, 1, arg_count, name, &axis, &mode, sums)) return NULL;
+
+    Container *temp;
+    MatrixContainer *m = reduce_operand(args[0], &temp, name);
+    if (!m) return NULL;
+
+    // Строка по строкам или столбец по столбцам - свертка всех элементов
+    if ((axis == AXIS_ROWS && m->rows == 1) || (axis == AXIS_COLS && m->cols == 1)) axis = AXIS_ALL;
+
+    Container *result;
+    if (axis == AXIS_ALL) {
+        size_t n = (size_t)m->rows * m->cols;
+        double r = reduce_array(m->data, m->data, n, kind, mode, 1);
+        if (mean) r /= (double)n;
+        if (norm) r = finish_norm(r, m->data, n, 1);
+        result = create_float_container(r);
+    } else {
+        int count = axis == AXIS_ROWS ? m->rows : m->cols;
+        // По строкам - столбец значений, по столбцам - строка
+        result = axis == AXIS_ROWS ? create_matrix_container(m->rows, 1) : create_matrix_container(1, m->cols);
+        if (result) {
+            double *out = ((MatrixContainer*)result->data)->data;
+            reduce_axis(m, axis, kind, mode, out);
+            size_t length = axis == AXIS_ROWS ? m->cols : m->rows;
+            for (int i = 0; i < count; i++) {
+                if (mean) out[i] /= (double)length;
+                if (norm) {
+                    const double *x = axis == AXIS_ROWS ? m->data + (size_t)i * m->cols : m->data + i;
+                    out[i] = finish_norm(out[i], x, length, axis == AXIS_ROWS ? 1 : m->cols);
+                }
+            }
+        }
+    }
+
+    free_container(temp);
+    return result;
+}
+
+
+// sum(x[, "rows"|"cols"][, "pairwise"|"kahan"])
+Container* sum_func(Container** args, int arg_count) {
+    return reduce_call(args, arg_count, RK_SUM, 0, 0, "sum");
+}
+
+// mean(x[, "rows"|"cols"][, "pairwise"|"kahan"])
+Container* mean_func(Container** args, int arg_count) {
+    return reduce_call(args, arg_count, RK_SUM, 1, 0, "mean");
+}
+
+// Евклидова норма вектора, норма Фробениуса матрицы или нормы строк и столбцов
+Container* norm_func(Container** args, int arg_count) {
+    return reduce_call(args, arg_count, RK_DOT, 0, 1, "norm");
+}
+
+// min и max с одним аргументом или с осью (при двух числовых аргументах
+// min_func и max_func выбирают поэлементно)
+Container* extremum_reduce(Container** args, int arg_count, int is_max, const char *name) {
+    return reduce_call(args, arg_count, is_max ? RK_MAX : RK_MIN, 0, 0, name);
+}
+
+// Скалярное произведение массивов одинакового размера: dot(a, b[, "pairwise"|"kahan"])
+Container* dot_func(Container** args, int arg_count) {
+    if (arg_count < 2 || arg_count > 3) {
+        print_log("dot: ожидается 2 или 3 аргумента\n");
+        return NULL;
+    }
+    ReduceAxis axis;
+    ReduceMode mode;
+    if (!parse_options(args, 2, arg_count, "dot", &axis, &mode, 1)) return NULL;
+    if (axis != AXIS_ALL) {
+        print_log("dot: ось не поддерживается\n");
+        return NULL;
+    }
+
+    Container *ta, *tb;
+    MatrixContainer *a = reduce_operand(args[0], &ta, "dot");
+    MatrixContainer *b = a ? reduce_operand(args[1], &tb, "dot") : NULL;
+    if (!b) {
+        free_container(ta);
+        return NULL;
+    }
+
+    // Векторы сравниваются по длине, строка и столбец совместимы
+    size_t n = (size_t)a->rows * a->cols;
+    int vectors = (a->rows == 1 || a->cols == 1) && (b->rows == 1 || b->cols == 1);
+    Container *result = NULL;
+    if (vectors ? n != (size_t)b->rows * b->cols : a->rows != b->rows || a->cols != b->cols) {
+        print_log("dot: размеры %dx%d и %dx%d не совпадают\n", a->rows, a->cols, b->rows, b->cols);
+    } else {
+        result = create_float_container(reduce_array(a->data, b->data, n, RK_DOT, mode, 1));
+    }
+
+    free_container(ta);
+    free_container(tb);
+    return result;
+}
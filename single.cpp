@@ -0,0 +1,557 @@
+#include "lib.h"
+#include <float.h>
+
+// Матрицы одинарной точности (float): вдвое меньше памяти, и в векторный регистр
+// помещается вдвое больше элементов. single(A) и double(A) переводят значение между
+// точностями, команда "precision single" делает одинарную точность основной для всех
+// новых матриц. Функции без ядер для float получают копию в двойной точности
+// (args_materialize). solve для такой матрицы раскладывает ее в float и уточняет
+// решение до двойной точности по невязке, вычисленной в double.
+
+// Блоки SGEMM по байтам совпадают с блоками GEMM
+#define SGEMM_BLOCK_M 32
+#define SGEMM_BLOCK_K 256
+#define SGEMM_BLOCK_N 512
+
+#define SLU_BLOCK 64
+#define STRSM_BLOCK 512
+
+// Наибольшее число шагов уточнения; обычно хватает 2-4
+#define REFINE_MAX_ITER 10
+
+static int single_mode = 0;
+
+
+// Контейнер
+
+Container* create_single_container(int rows, int cols) {
+    size_t count = (size_t)rows * cols;
+    float *values = (float*)mem_calloc(MEM_CONTAINERS, count > 0 ? count : 1, sizeof(float));
+    if (!values) {
+        print_log("Ошибка: недостаточно памяти для матрицы %dx%d\n", rows, cols);
+        return NULL;
+    }
+
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
+    SingleContainer *data = (SingleContainer*)malloc(sizeof(SingleContainer));
+    data->rows = rows;
+    data->cols = cols;
+    data->data = values;
+    data->cache = NULL;
+    container->type = CT_SINGLE;
+    container->data = data;
+    container->free_func = free_single_container;
+    container->print_func = print_single_container;
+
+    return container;
+}
+
+void free_single_container(void *data) {
+    SingleContainer *s = (SingleContainer*)data;
+    if (s) {
+        matrix_cache_release(s->cache);
+        mem_free(MEM_CONTAINERS, s->data);
+        free(s);
+    }
+}
+
+void print_single_container(void *data) {
+    if (!data) return;
+    Container *dense = single_to_matrix((SingleContainer*)data);
+    if (!dense) return;
+    print_container(dense);
+    print_log(" (single)");
+    free_container(dense);
+}
+
+// Копия значения с общим кэшем разложений
+Container* single_copy(SingleContainer *s) {
+    Container *copy = create_single_container(s->rows, s->cols);
+    if (!copy) return NULL;
+    SingleContainer *data = (SingleContainer*)copy->data;
+    memcpy(data->data, s->data, (size_t)s->rows * s->cols * sizeof(float));
+    data->cache = matrix_cache_share(&s->cache);
+    return copy;
+}
+
+int single_compare(SingleContainer *a, SingleContainer *b) {
+    if (a->rows != b->rows || a->cols != b->cols) return 0;
+
+    size_t count = (size_t)a->rows * a->cols;
+    for (size_t i = 0; i < count; i++) {
+        if (fabsf(a->data[i] - b->data[i]) > 1e-6f * (1.0f + fabsf(a->data[i]))) return 0;
+    }
+    return 1;
+}
+
+// Расширение до double
+Container* single_to_matrix(SingleContainer *s) {
+    Container *result = create_matrix_container(s->rows, s->cols);
+    if (!result) return NULL;
+    double *d = ((MatrixContainer*)result->data)->data;
+    size_t count = (size_t)s->rows * s->cols;
+
+    #pragma omp parallel for if(count > PARALLEL_MIN_WORK) schedule(static)
+    for (size_t i = 0; i < count; i++) d[i] = s->data[i];
+    return result;
+}
+
+// Округление матрицы, среза, поля и т.п. до float
+Container* matrix_to_single(Container *c) {
+    if (!c) return NULL;
+    if (c->type == CT_SINGLE) return single_copy((SingleContainer*)c->data);
+
+    Container *dense = c->type == CT_MATRIX ? c : container_to_matrix(c);
+    if (!dense) return NULL;
+    MatrixContainer *m = (MatrixContainer*)dense->data;
+
+    Container *result = create_single_container(m->rows, m->cols);
+    if (result) {
+        float *f = ((SingleContainer*)result->data)->data;
+        size_t count = (size_t)m->rows * m->cols;
+
+        #pragma omp parallel for if(count > PARALLEL_MIN_WORK) schedule(static)
+        for (size_t i = 0; i < count; i++) f[i] = (float)m->data[i];
+    }
+    if (dense != c) free_container(dense);
+    return result;
+}
+
+
+// Ядра
+
+// C = alpha*A*B + beta*C, то же разбиение на блоки, что и в gemm
+void sgemm(int m, int n, int k, float alpha, const float *A, int lda,
+           const float *B, int ldb, float beta, float *C, int ldc) {
+
+    double work = (double)m * n * k;
+
+    if (n == 1 && ldb == 1) {
+        #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = 0; i < m; i++) {
+            float *c = C + (size_t)i * ldc;
+            *c = alpha * kernels->sdot(A + (size_t)i * lda, B, k) + (beta == 0.0f ? 0.0f : beta * *c);
+        }
+        return;
+    }
+
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+    for (int i0 = 0; i0 < m; i0 += SGEMM_BLOCK_M) {
+        int i1 = i0 + SGEMM_BLOCK_M < m ? i0 + SGEMM_BLOCK_M : m;
+
+        for (int i = i0; i < i1; i++) {
+            float *c = C + (size_t)i * ldc;
+            if (beta == 0.0f) {
+                for (int j = 0; j < n; j++) c[j] = 0.0f;
+            } else if (beta != 1.0f) {
+                for (int j = 0; j < n; j++) c[j] *= beta;
+            }
+        }
+
+        for (int p0 = 0; p0 < k; p0 += SGEMM_BLOCK_K) {
+            int p1 = p0 + SGEMM_BLOCK_K < k ? p0 + SGEMM_BLOCK_K : k;
+
+            for (int j0 = 0; j0 < n; j0 += SGEMM_BLOCK_N) {
+                int j1 = j0 + SGEMM_BLOCK_N < n ? j0 + SGEMM_BLOCK_N : n;
+
+                for (int i = i0; i < i1; i++) {
+                    const float *a = A + (size_t)i * lda;
+                    float *c = C + (size_t)i * ldc;
+
+                    for (int p = p0; p < p1; p++) {
+                        float ap = alpha * a[p];
+                        if (ap == 0.0f) continue;
+                        kernels->saxpy(ap, B + (size_t)p * ldb + j0, c + j0, j1 - j0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+// LU-разложение в одинарной точности
+
+void slu_free(SingleLU *f) {
+    if (f) {
+        mem_free(MEM_CACHES, f->lu);
+        mem_free(MEM_CACHES, f->piv);
+        free(f);
+    }
+}
+
+// Панель столбцов [k, k+nb) с выбором ведущего элемента, как lu_panel
+static void slu_panel(SingleLU *f, int k, int nb) {
+    int n = f->n;
+    float *a = f->lu;
+
+    for (int j = k; j < k + nb; j++) {
+        int p = j;
+        float best = fabsf(a[(size_t)j * n + j]);
+        for (int i = j + 1; i < n; i++) {
+            float value = fabsf(a[(size_t)i * n + j]);
+            if (value > best) {
+                best = value;
+                p = i;
+            }
+        }
+
+        f->piv[j] = p;
+        if (best == 0.0f) {
+            f->singular = 1;
+            continue;
+        }
+
+        if (p != j) {
+            float *rj = a + (size_t)j * n;
+            float *rp = a + (size_t)p * n;
+            for (int c = 0; c < n; c++) {
+                float t = rj[c];
+                rj[c] = rp[c];
+                rp[c] = t;
+            }
+        }
+
+        const float *urow = a + (size_t)j * n;
+        float inv = 1.0f / urow[j];
+        double work = (double)(n - j) * (k + nb - j);
+
+        #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+        for (int i = j + 1; i < n; i++) {
+            float *row = a + (size_t)i * n;
+            float l = row[j] * inv;
+            row[j] = l;
+            for (int c = j + 1; c < k + nb; c++) {
+                row[c] -= l * urow[c];
+            }
+        }
+    }
+}
+
+// U12 = L11^-1 * A12; полосы столбцов независимы
+static void slu_trsm(SingleLU *f, int k, int nb) {
+    int n = f->n;
+    float *a = f->lu;
+    int first = k + nb;
+    double work = (double)nb * nb * (n - first);
+
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+    for (int c0 = first; c0 < n; c0 += STRSM_BLOCK) {
+        int len = c0 + STRSM_BLOCK < n ? STRSM_BLOCK : n - c0;
+        for (int i = k + 1; i < k + nb; i++) {
+            float *row = a + (size_t)i * n;
+            for (int p = k; p < i; p++) {
+                float l = row[p];
+                if (l == 0.0f) continue;
+                kernels->saxpy(-l, a + (size_t)p * n + c0, row + c0, len);
+            }
+        }
+    }
+}
+
+SingleLU* slu_factor(const float *a, int n) {
+    SingleLU *f = (SingleLU*)malloc(sizeof(SingleLU));
+    if (!f) return NULL;
+
+    f->n = n;
+    f->singular = 0;
+    f->lu = (float*)mem_alloc(MEM_CACHES, (size_t)n * n * sizeof(float));
+    f->piv = (int*)mem_alloc(MEM_CACHES, (size_t)n * sizeof(int));
+    if (!f->lu || !f->piv) {
+        print_log("Ошибка: недостаточно памяти для разложения %dx%d\n", n, n);
+        slu_free(f);
+        return NULL;
+    }
+    memcpy(f->lu, a, (size_t)n * n * sizeof(float));
+
+    for (int k = 0; k < n; k += SLU_BLOCK) {
+        int nb = k + SLU_BLOCK < n ? SLU_BLOCK : n - k;
+
+        slu_panel(f, k, nb);
+
+        int rest = n - k - nb;
+        if (rest > 0) {
+            slu_trsm(f, k, nb);
+
+            float *a21 = f->lu + (size_t)(k + nb) * n + k;
+            float *u12 = f->lu + (size_t)k * n + k + nb;
+            float *a22 = f->lu + (size_t)(k + nb) * n + k + nb;
+            sgemm(rest, rest, nb, -1.0f, a21, n, u12, n, 1.0f, a22, n);
+        }
+    }
+    return f;
+}
+
+// B (n x k) заменяется на A^-1 * B
+static void slu_solve(const SingleLU *f, float *B, int k) {
+    int n = f->n;
+    const float *a = f->lu;
+
+    for (int i = 0; i < n; i++) {
+        int p = f->piv[i];
+        if (p != i) {
+            float *bi = B + (size_t)i * k;
+            float *bp = B + (size_t)p * k;
+            for (int c = 0; c < k; c++) {
+                float t = bi[c];
+                bi[c] = bp[c];
+                bp[c] = t;
+            }
+        }
+    }
+
+    for (int i = 1; i < n; i++) {
+        const float *row = a + (size_t)i * n;
+        float *bi = B + (size_t)i * k;
+        for (int p = 0; p < i; p++) {
+            float l = row[p];
+            if (l == 0.0f) continue;
+            const float *bp = B + (size_t)p * k;
+            for (int c = 0; c < k; c++) bi[c] -= l * bp[c];
+        }
+    }
+
+    for (int i = n - 1; i >= 0; i--) {
+        const float *row = a + (size_t)i * n;
+        float *bi = B + (size_t)i * k;
+        for (int p = i + 1; p < n; p++) {
+            float u = row[p];
+            if (u == 0.0f) continue;
+            const float *bp = B + (size_t)p * k;
+            for (int c = 0; c < k; c++) bi[c] -= u * bp[c];
+        }
+        float inv = 1.0f / row[i];
+        for (int c = 0; c < k; c++) bi[c] *= inv;
+    }
+}
+
+// Разложение float из кэша значения (вычисляется при первом обращении)
+static SingleLU* matrix_slu(Container *a, const MatrixContainer *am) {
+    MatrixCache **slot = container_cache_slot(a);
+    if (slot && *slot && (*slot)->slu) return (*slot)->slu;
+
+    size_t count = (size_t)am->rows * am->cols;
+    const float *values = a->type == CT_SINGLE ? ((SingleContainer*)a->data)->data : NULL;
+    float *rounded = NULL;
+    if (!values) {
+        rounded = (float*)malloc(count * sizeof(float));
+        if (!rounded) {
+            print_log("Ошибка: недостаточно памяти для матрицы %dx%d\n", am->rows, am->cols);
+            return NULL;
+        }
+        for (size_t i = 0; i < count; i++) rounded[i] = (float)am->data[i];
+        values = rounded;
+    }
+
+    SingleLU *f = slu_factor(values, am->rows);
+    free(rounded);
+    if (f && slot) matrix_cache_get(slot)->slu = f;
+    return f;
+}
+
+// Решение A*X = B (X: n x k, на входе B) итерационным уточнением: поправка ищется по
+// LU-разложению в float, невязка B - A*X считается в double. 1 - решение найдено
+// с точностью double, 0 - уточнение не сходится (матрица плохо обусловлена для float)
+int solve_refined(Container *a, double *X, int k) {
+    Container *temp;
+    MatrixContainer *am = dense_view(a, &temp);
+    if (!am) return 0;
+
+    int n = am->rows;
+    SingleLU *f = am->rows == am->cols ? matrix_slu(a, am) : NULL;
+    size_t count = (size_t)n * k;
+    double *B = (double*)malloc(count * sizeof(double));
+    double *R = (double*)malloc(count * sizeof(double));
+    float *D = (float*)malloc(count * sizeof(float));
+
+    int converged = 0;
+    if (f && !f->singular && B && R && D) {
+        // Критерий остановки как в LAPACK dsgesv: |R| <= |X| * |A| * eps * sqrt(n) (нормы max)
+        double anorm = 0.0;
+        for (int i = 0; i < n; i++) {
+            double row = 0.0;
+            for (int j = 0; j < n; j++) row += fabs(am->data[(size_t)i * n + j]);
+            if (row > anorm) anorm = row;
+        }
+        double tol = anorm * DBL_EPSILON * sqrt((double)n);
+
+        memcpy(B, X, count * sizeof(double));
+        memcpy(R, X, count * sizeof(double));
+        memset(X, 0, count * sizeof(double));
+
+        for (int it = 0; it < REFINE_MAX_ITER && !converged; it++) {
+            for (size_t i = 0; i < count; i++) D[i] = (float)R[i];
+            slu_solve(f, D, k);
+            for (size_t i = 0; i < count; i++) X[i] += D[i];
+
+            // R = B - A*X
+            memcpy(R, B, count * sizeof(double));
+            gemm(n, k, n, -1.0, am->data, n, X, k, 1.0, R, k);
+
+            double rnorm = 0.0, xnorm = 0.0;
+            for (size_t i = 0; i < count; i++) {
+                if (fabs(R[i]) > rnorm) rnorm = fabs(R[i]);
+                if (fabs(X[i]) > xnorm) xnorm = fabs(X[i]);
+            }
+            if (isnan(rnorm)) break;
+            converged = rnorm <= xnorm * tol;
+        }
+    }
+
+    free(B);
+    free(R);
+    free(D);
+    free_container(temp);
+    return converged;
+}
+
+
+// Операции
+
+static int is_scalar_type(Container *c) {
+    return c->type == CT_INT || c->type == CT_FLOAT;
+}
+
+// Умножение float-матрицы на число
+Container* single_scale(Container *a, double scalar) {
+    SingleContainer *s = (SingleContainer*)a->data;
+    Container *result = create_single_container(s->rows, s->cols);
+    if (!result) return NULL;
+    float *out = ((SingleContainer*)result->data)->data;
+    size_t count = (size_t)s->rows * s->cols;
+    float f = (float)scalar;
+
+    #pragma omp parallel for if(count > PARALLEL_MIN_WORK) schedule(static)
+    for (size_t i = 0; i < count; i++) out[i] = s->data[i] * f;
+    return result;
+}
+
+// Деление float-матрицы на число, при неточном 1/d - честным делением
+Container* single_divide(Container *a, double divisor) {
+    if (reciprocal_exact(divisor)) return single_scale(a, 1.0 / divisor);
+    SingleContainer *s = (SingleContainer*)a->data;
+    Container *result = create_single_container(s->rows, s->cols);
+    if (!result) return NULL;
+    float *out = ((SingleContainer*)result->data)->data;
+    size_t count = (size_t)s->rows * s->cols;
+    float f = (float)divisor;
+
+    #pragma omp parallel for if(count > PARALLEL_MIN_WORK) schedule(static)
+    for (size_t i = 0; i < count; i++) out[i] = s->data[i] / f;
+    return result;
+}
+
+// Сумма и разность; с матрицей двойной точности результат в double
+Container* single_add(Container *a, Container *b, double sign) {
+    if (a->type != CT_SINGLE || b->type != CT_SINGLE) {
+        Container *wa = a->type == CT_SINGLE ? single_to_matrix((SingleContainer*)a->data) : a;
+        Container *wb = b->type == CT_SINGLE ? single_to_matrix((SingleContainer*)b->data) : b;
+        Container *result = wa && wb ? matrix_add(wa, wb, sign) : NULL;
+        if (wa != a) free_container(wa);
+        if (wb != b) free_container(wb);
+        return result;
+    }
+
+    SingleContainer *sa = (SingleContainer*)a->data;
+    SingleContainer *sb = (SingleContainer*)b->data;
+    if (sa->rows != sb->rows || sa->cols != sb->cols) {
+        print_log("Ошибка: несогласованные размеры %dx%d и %dx%d\n", sa->rows, sa->cols, sb->rows, sb->cols);
+        return NULL;
+    }
+
+    Container *result = create_single_container(sa->rows, sa->cols);
+    if (!result) return NULL;
+    float *out = ((SingleContainer*)result->data)->data;
+    size_t count = (size_t)sa->rows * sa->cols;
+    memcpy(out, sa->data, count * sizeof(float));
+
+    int chunks = (int)((count + KERNEL_CHUNK - 1) / KERNEL_CHUNK);
+    #pragma omp parallel for if(count > PARALLEL_MIN_WORK) schedule(static)
+    for (int c = 0; c < chunks; c++) {
+        size_t i0 = (size_t)c * KERNEL_CHUNK;
+        int len = count - i0 < KERNEL_CHUNK ? (int)(count - i0) : KERNEL_CHUNK;
+        kernels->saxpy((float)sign, sb->data + i0, out + i0, len);
+    }
+    return result;
+}
+
+// Произведение: две float-матрицы - SGEMM, с числом - масштаб, иначе в double
+Container* single_mul(Container *a, Container *b) {
+    if (a->type == CT_SINGLE && is_scalar_type(b)) return single_scale(a, container_to_double(b));
+    if (b->type == CT_SINGLE && is_scalar_type(a)) return single_scale(b, container_to_double(a));
+
+    if (a->type != CT_SINGLE || b->type != CT_SINGLE) {
+        Container *wa = a->type == CT_SINGLE ? single_to_matrix((SingleContainer*)a->data) : a;
+        Container *wb = b->type == CT_SINGLE ? single_to_matrix((SingleContainer*)b->data) : b;
+        Container *result = wa && wb ? matrix_mul(wa, wb) : NULL;
+        if (wa != a) free_container(wa);
+        if (wb != b) free_container(wb);
+        return result;
+    }
+
+    SingleContainer *sa = (SingleContainer*)a->data;
+    SingleContainer *sb = (SingleContainer*)b->data;
+    if (sa->cols != sb->rows) {
+        print_log("Ошибка: несогласованные размеры %dx%d и %dx%d\n", sa->rows, sa->cols, sb->rows, sb->cols);
+        return NULL;
+    }
+
+    Container *result = create_single_container(sa->rows, sb->cols);
+    if (!result) return NULL;
+    sgemm(sa->rows, sb->cols, sa->cols, 1.0f, sa->data, sa->cols, sb->data, sb->cols,
+          0.0f, ((SingleContainer*)result->data)->data, sb->cols);
+    return result;
+}
+
+
+// Функции калькулятора
+
+Container* single_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("single: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (!args[0] || is_scalar_type(args[0]) || args[0]->type == CT_STRING) {
+        print_log("single: аргумент должен быть матрицей или вектором\n");
+        return NULL;
+    }
+    return matrix_to_single(args[0]);
+}
+
+Container* double_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("double: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (!args[0]) return NULL;
+    if (args[0]->type == CT_SINGLE) return single_to_matrix((SingleContainer*)args[0]->data);
+    return container_deep_copy(args[0]);
+}
+
+// В режиме single новые плотные матрицы сразу округляются до float
+Container* precision_apply(Container *result) {
+    if (!single_mode || !result || result->type != CT_MATRIX) return result;
+
+    Container *rounded = matrix_to_single(result);
+    if (!rounded) return result;
+    free_container(result);
+    return rounded;
+}
+
+// Команда "precision [single|double]": без аргумента показывает текущий режим
+void precision_command(const char *arg) {
+    while (arg != NULL && *arg == ' ') arg++;
+    if (arg != NULL && *arg != 0) {
+        if (strcmp(arg, "single") == 0) {
+            lazy_force_all();
+            single_mode = 1;
+        } else if (strcmp(arg, "double") == 0) {
+            lazy_force_all();
+            single_mode = 0;
+        } else {
+            print_log("precision: неизвестный режим %s (single или double)\n", arg);
+            return;
+        }
+    }
+    print_log("Точность матриц: %s\n", single_mode ? "single (float)" : "double");
+}
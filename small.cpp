@@ -0,0 +1,456 @@
+#include "lib.h"
+
+// Матрицы 2x2 - 4x4 (повороты 3x3 и однородные преобразования 4x4) обходят общий GEMM
+// и LU-разложение: размер задается параметром шаблона, циклы разворачиваются полностью,
+// промежуточные значения живут в регистрах, временных массивов нет.
+
+
+template<int N>
+static inline void mul_n(const double *a, const double *b, double *c) {
+    #pragma GCC unroll 4
+    for (int i = 0; i < N; i++) {
+        #pragma GCC unroll 4
+        for (int j = 0; j < N; j++) {
+            double s = 0.0;
+            #pragma GCC unroll 4
+            for (int k = 0; k < N; k++) s += a[i * N + k] * b[k * N + j];
+            c[i * N + j] = s;
+        }
+    }
+}
+
+template<int N>
+static inline void matvec_n(const double *a, const double *x, double *y) {
+    #pragma GCC unroll 4
+    for (int i = 0; i < N; i++) {
+        double s = 0.0;
+        #pragma GCC unroll 4
+        for (int k = 0; k < N; k++) s += a[i * N + k] * x[k];
+        y[i] = s;
+    }
+}
+
+// Определитель и обратная матрица по алгебраическим дополнениям
+template<int N> static inline double det_n(const double *a);
+template<int N> static inline int inv_n(const double *a, double *out);
+
+template<> inline double det_n<2>(const double *a) {
+    return a[0] * a[3] - a[1] * a[2];
+}
+
+template<> inline int inv_n<2>(const double *a, double *out) {
+    double det = det_n<2>(a);
+    if (det == 0.0) return 0;
+    double r = 1.0 / det;
+    double a0 = a[0], a1 = a[1], a2 = a[2], a3 = a[3];
+    out[0] =  a3 * r;
+    out[1] = -a1 * r;
+    out[2] = -a2 * r;
+    out[3] =  a0 * r;
+    return 1;
+}
+
+template<> inline double det_n<3>(const double *a) {
+    return a[0] * (a[4] * a[8] - a[5] * a[7]) +
+           a[1] * (a[5] * a[6] - a[3] * a[8]) +
+           a[2] * (a[3] * a[7] - a[4] * a[6]);
+}
+
+template<> inline int inv_n<3>(const double *a, double *out) {
+    double c00 = a[4] * a[8] - a[5] * a[7];
+    double c10 = a[5] * a[6] - a[3] * a[8];
+    double c20 = a[3] * a[7] - a[4] * a[6];
+    double det = a[0] * c00 + a[1] * c10 + a[2] * c20;
+    if (det == 0.0) return 0;
+    double r = 1.0 / det;
+
+    double t[9] = {
+        c00, a[2] * a[7] - a[1] * a[8], a[1] * a[5] - a[2] * a[4],
+        c10, a[0] * a[8] - a[2] * a[6], a[2] * a[3] - a[0] * a[5],
+        c20, a[1] * a[6] - a[0] * a[7], a[0] * a[4] - a[1] * a[3]
+    };
+    for (int i = 0; i < 9; i++) out[i] = t[i] * r;
+    return 1;
+}
+
+// Для 4x4 - разложение Лапласа по парам строк: миноры 2x2 верхней (s) и нижней (c) половин
+#define MINORS_4X4 \
+    double s0 = a[0] * a[5] - a[4] * a[1]; \
+    double s1 = a[0] * a[6] - a[4] * a[2]; \
+    double s2 = a[0] * a[7] - a[4] * a[3]; \
+    double s3 = a[1] * a[6] - a[5] * a[2]; \
+    double s4 = a[1] * a[7] - a[5] * a[3]; \
+    double s5 = a[2] * a[7] - a[6] * a[3]; \
+    double c5 = a[10] * a[15] - a[14] * a[11]; \
+    double c4 = a[9] * a[15] - a[13] * a[11]; \
+    double c3 = a[9] * a[14] - a[13] * a[10]; \
+    double c2 = a[8] * a[15] - a[12] * a[11]; \
+    double c1 = a[8] * a[14] - a[12] * a[10]; \
+    double c0 = a[8] * a[13] - a[12] * a[9];
+
+template<> inline double det_n<4>(const double *a) {
+    MINORS_4X4
+    return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+}
+
+template<> inline int inv_n<4>(const double *a, double *out) {
+    MINORS_4X4
+    double det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (det == 0.0) return 0;
+    double r = 1.0 / det;
+
+    double t[16] = {
+         a[5] * c5 - a[6] * c4 + a[7] * c3,
+        -a[1] * c5 + a[2] * c4 - a[3] * c3,
+         a[13] * s5 - a[14] * s4 + a[15] * s3,
+        -a[9] * s5 + a[10] * s4 - a[11] * s3,
+
+        -a[4] * c5 + a[6] * c2 - a[7] * c1,
+         a[0] * c5 - a[2] * c2 + a[3] * c1,
+        -a[12] * s5 + a[14] * s2 - a[15] * s1,
+         a[8] * s5 - a[10] * s2 + a[11] * s1,
+
+         a[4] * c4 - a[5] * c2 + a[7] * c0,
+        -a[0] * c4 + a[1] * c2 - a[3] * c0,
+         a[12] * s4 - a[13] * s2 + a[15] * s0,
+        -a[8] * s4 + a[9] * s2 - a[11] * s0,
+
+        -a[4] * c3 + a[5] * c1 - a[6] * c0,
+         a[0] * c3 - a[1] * c1 + a[2] * c0,
+        -a[12] * s3 + a[13] * s1 - a[14] * s0,
+         a[8] * s3 - a[9] * s1 + a[10] * s0
+    };
+    for (int i = 0; i < 16; i++) out[i] = t[i] * r;
+    return 1;
+}
+
+
+// Выбор ядра по размеру; n от SMALL_MIN до SMALL_MAX
+void small_matmul(int n, const double *a, const double *b, double *c) {
+    switch (n) {
+        case 2: mul_n<2>(a, b, c); break;
+        case 3: mul_n<3>(a, b, c); break;
+        case 4: mul_n<4>(a, b, c); break;
+    }
+}
+
+void small_matvec(int n, const double *a, const double *x, double *y) {
+    switch (n) {
+        case 2: matvec_n<2>(a, x, y); break;
+        case 3: matvec_n<3>(a, x, y); break;
+        case 4: matvec_n<4>(a, x, y); break;
+    }
+}
+
+double small_det(int n, const double *a) {
+    switch (n) {
+        case 2: return det_n<2>(a);
+        case 3: return det_n<3>(a);
+        case 4: return det_n<4>(a);
+    }
+    return 0.0;
+}
+
+// 0 - матрица вырождена
+int small_inv(int n, const double *a, double *out) {
+    switch (n) {
+        case 2: return inv_n<2>(a, out);
+        case 3: return inv_n<3>(a, out);
+        case 4: return inv_n<4>(a, out);
+    }
+    return 0;
+}
+
+
+// Произведение малой квадратной матрицы на матрицу того же размера, столбец или вектор.
+// Матрица 4x4 применяется к вектору как однородное преобразование точки (x, y, z, 1).
+// NULL - размеры не подходят, умножение выполняет общий путь
+Container* small_matrix_mul(Container *a, Container *b) {
+    if (a->type != CT_MATRIX) return NULL;
+    MatrixContainer *ma = (MatrixContainer*)a->data;
+    int n = ma->rows;
+    if (n != ma->cols || n < SMALL_MIN || n > SMALL_MAX) return NULL;
+
+    if (b->type == CT_VECTOR) {
+        VectorContainer *v = (VectorContainer*)b->data;
+        double x[4] = {v->x, v->y, v->z, 1.0}, y[4];
+        if (n == 3) {
+            matvec_n<3>(ma->data, x, y);
+            return create_vector_container(y[0], y[1], y[2]);
+        }
+        if (n == 4) {
+            matvec_n<4>(ma->data, x, y);
+            // w = 0 - точка на бесконечности, возвращается направление
+            double r = (y[3] != 0.0 && y[3] != 1.0) ? 1.0 / y[3] : 1.0;
+            return create_vector_container(y[0] * r, y[1] * r, y[2] * r);
+        }
+        return NULL;
+    }
+
+    if (b->type != CT_MATRIX) return NULL;
+    MatrixContainer *mb = (MatrixContainer*)b->data;
+    if (mb->rows != n || (mb->cols != n && mb->cols != 1)) return NULL;
+
+    Container *result = create_matrix_container(n, mb->cols);
+    if (!result) return NULL;
+    double *c = ((MatrixContainer*)result->data)->data;
+    if (mb->cols == 1) small_matvec(n, ma->data, mb->data, c);
+    else small_matmul(n, ma->data, mb->data, c);
+    return result;
+}
+
+
+// Кватернионы
+
+Container* create_quat_container(double w, double x, double y, double z) {
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
+    QuatContainer *data = (QuatContainer*)malloc(sizeof(QuatContainer));
+
+    data->w = w;
+    data->x = x;
+    data->y = y;
+    data->z = z;
+    container->type = CT_QUAT;
+    container->data = data;
+    container->free_func = free_quat_container;
+    container->print_func = print_quat_container;
+
+    return container;
+}
+
+void free_quat_container(void *data) {
+    if (data) free(data);
+}
+
+void print_quat_container(void *data) {
+    if (data) {
+        QuatContainer *q = (QuatContainer*)data;
+        print_log("quat(");
+        print_smart_double(q->w);
+        print_log(", ");
+        print_smart_double(q->x);
+        print_log(", ");
+        print_smart_double(q->y);
+        print_log(", ");
+        print_smart_double(q->z);
+        print_log(")");
+    }
+}
+
+int quat_compare(QuatContainer *a, QuatContainer *b) {
+    return fabs(a->w - b->w) < 1e-10 &&
+           fabs(a->x - b->x) < 1e-10 &&
+           fabs(a->y - b->y) < 1e-10 &&
+           fabs(a->z - b->z) < 1e-10;
+}
+
+static Container* quat_scale(const QuatContainer *q, double s) {
+    return create_quat_container(q->w * s, q->x * s, q->y * s, q->z * s);
+}
+
+static double quat_norm2(const QuatContainer *q) {
+    return q->w * q->w + q->x * q->x + q->y * q->y + q->z * q->z;
+}
+
+// Произведение Гамильтона: поворот b, затем a
+static Container* quat_product(const QuatContainer *a, const QuatContainer *b) {
+    return create_quat_container(
+        a->w * b->w - a->x * b->x - a->y * b->y - a->z * b->z,
+        a->w * b->x + a->x * b->w + a->y * b->z - a->z * b->y,
+        a->w * b->y - a->x * b->z + a->y * b->w + a->z * b->x,
+        a->w * b->z + a->x * b->y - a->y * b->x + a->z * b->w);
+}
+
+// Поворот вектора q*v*q^-1; для ненормированного q делится на |q|^2, масштаба нет
+static Container* quat_rotate(const QuatContainer *q, const VectorContainer *v) {
+    double n2 = quat_norm2(q);
+    if (n2 == 0.0) {
+        print_log("Ошибка: поворот нулевым кватернионом\n");
+        return NULL;
+    }
+    double s = 2.0 / n2;
+
+    // t = u x v + w*v, v' = v + s * (u x t)
+    double tx = q->y * v->z - q->z * v->y + q->w * v->x;
+    double ty = q->z * v->x - q->x * v->z + q->w * v->y;
+    double tz = q->x * v->y - q->y * v->x + q->w * v->z;
+    return create_vector_container(v->x + s * (q->y * tz - q->z * ty),
+                                   v->y + s * (q->z * tx - q->x * tz),
+                                   v->z + s * (q->x * ty - q->y * tx));
+}
+
+Container* quat_inverse(Container *a) {
+    QuatContainer *q = (QuatContainer*)a->data;
+    double n2 = quat_norm2(q);
+    if (n2 == 0.0) {
+        print_log("inv: нулевой кватернион необратим\n");
+        return NULL;
+    }
+    return create_quat_container(q->w / n2, -q->x / n2, -q->y / n2, -q->z / n2);
+}
+
+Container* quat_norm(Container *a) {
+    return create_float_container(sqrt(quat_norm2((QuatContainer*)a->data)));
+}
+
+// Сумма (sign = 1) или разность (sign = -1) кватернионов
+Container* quat_add(Container *a, Container *b, double sign) {
+    if (a->type != CT_QUAT || b->type != CT_QUAT) {
+        print_log("Ошибка: кватернион складывается только с кватернионом\n");
+        return NULL;
+    }
+    QuatContainer *qa = (QuatContainer*)a->data;
+    QuatContainer *qb = (QuatContainer*)b->data;
+    return create_quat_container(qa->w + sign * qb->w, qa->x + sign * qb->x,
+                                 qa->y + sign * qb->y, qa->z + sign * qb->z);
+}
+
+// q * q - композиция поворотов, q * v - поворот вектора, умножение на число
+Container* quat_mul(Container *a, Container *b) {
+    if (container_is_scalar(a)) return quat_scale((QuatContainer*)b->data, container_to_double(a));
+    if (container_is_scalar(b)) return quat_scale((QuatContainer*)a->data, container_to_double(b));
+
+    if (a->type == CT_QUAT && b->type == CT_QUAT) {
+        return quat_product((QuatContainer*)a->data, (QuatContainer*)b->data);
+    }
+    if (a->type == CT_QUAT && b->type == CT_VECTOR) {
+        return quat_rotate((QuatContainer*)a->data, (VectorContainer*)b->data);
+    }
+
+    print_log("Ошибка: кватернион умножается на число, кватернион или вектор (q * v)\n");
+    return NULL;
+}
+
+// q / s и q1 / q2 = q1 * q2^-1
+Container* quat_div(Container *a, Container *b) {
+    if (a->type == CT_QUAT && container_is_scalar(b)) {
+        double divisor = container_to_double(b);
+        if (divisor == 0.0) {
+            print_log("Ошибка: деление на ноль\n");
+            return NULL;
+        }
+        return quat_scale((QuatContainer*)a->data, 1.0 / divisor);
+    }
+    if (a->type == CT_QUAT && b->type == CT_QUAT) {
+        Container *inverse = quat_inverse(b);
+        if (!inverse) return NULL;
+        Container *result = quat_product((QuatContainer*)a->data, (QuatContainer*)inverse->data);
+        free_container(inverse);
+        return result;
+    }
+
+    print_log("Ошибка: кватернион делится только на число или кватернион\n");
+    return NULL;
+}
+
+// Кватернион поворота по ортогональной матрице 3x3 (метод Шеппарда)
+static Container* quat_from_rotation(const double *r) {
+    double trace = r[0] + r[4] + r[8];
+    double w, x, y, z;
+
+    if (trace > 0.0) {
+        double s = 2.0 * sqrt(trace + 1.0);
+        w = 0.25 * s;
+        x = (r[7] - r[5]) / s;
+        y = (r[2] - r[6]) / s;
+        z = (r[3] - r[1]) / s;
+    } else if (r[0] > r[4] && r[0] > r[8]) {
+        double s = 2.0 * sqrt(1.0 + r[0] - r[4] - r[8]);
+        w = (r[7] - r[5]) / s;
+        x = 0.25 * s;
+        y = (r[1] + r[3]) / s;
+        z = (r[2] + r[6]) / s;
+    } else if (r[4] > r[8]) {
+        double s = 2.0 * sqrt(1.0 + r[4] - r[0] - r[8]);
+        w = (r[2] - r[6]) / s;
+        x = (r[1] + r[3]) / s;
+        y = 0.25 * s;
+        z = (r[5] + r[7]) / s;
+    } else {
+        double s = 2.0 * sqrt(1.0 + r[8] - r[0] - r[4]);
+        w = (r[3] - r[1]) / s;
+        x = (r[2] + r[6]) / s;
+        y = (r[5] + r[7]) / s;
+        z = 0.25 * s;
+    }
+    return create_quat_container(w, x, y, z);
+}
+
+// quat(w, x, y, z), quat(ось, угол) или quat(R) из матрицы поворота 3x3
+Container* quat_func(Container** args, int arg_count) {
+    for (int i = 0; i < arg_count; i++) {
+        if (!args[i]) return NULL;
+    }
+
+    if (arg_count == 4) {
+        for (int i = 0; i < 4; i++) {
+            if (!container_is_scalar(args[i])) {
+                print_log("quat: компоненты w, x, y, z должны быть числами\n");
+                return NULL;
+            }
+        }
+        return create_quat_container(container_to_double(args[0]), container_to_double(args[1]),
+                                     container_to_double(args[2]), container_to_double(args[3]));
+    }
+
+    if (arg_count == 2 && args[0]->type == CT_VECTOR && container_is_scalar(args[1])) {
+        VectorContainer *axis = (VectorContainer*)args[0]->data;
+        double length = sqrt(axis->x * axis->x + axis->y * axis->y + axis->z * axis->z);
+        if (length == 0.0) {
+            print_log("quat: ось поворота не может быть нулевой\n");
+            return NULL;
+        }
+        double half = 0.5 * container_to_double(args[1]);
+        double s = sin(half) / length;
+        return create_quat_container(cos(half), axis->x * s, axis->y * s, axis->z * s);
+    }
+
+    if (arg_count == 1 && args[0]->type == CT_QUAT) {
+        QuatContainer *q = (QuatContainer*)args[0]->data;
+        return create_quat_container(q->w, q->x, q->y, q->z);
+    }
+
+    if (arg_count == 1 && args[0]->type == CT_MATRIX) {
+        MatrixContainer *m = (MatrixContainer*)args[0]->data;
+        if (m->rows == 3 && m->cols == 3) return quat_from_rotation(m->data);
+    }
+
+    print_log("quat: ожидается quat(w, x, y, z), quat(ось, угол) или quat(R) с матрицей 3x3\n");
+    return NULL;
+}
+
+// Матрица поворота 3x3 по кватерниону (нормируется)
+Container* rotm_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("rotm: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (!args[0]) return NULL;
+    if (args[0]->type != CT_QUAT) {
+        print_log("rotm: аргумент должен быть кватернионом\n");
+        return NULL;
+    }
+
+    QuatContainer *q = (QuatContainer*)args[0]->data;
+    double n2 = quat_norm2(q);
+    if (n2 == 0.0) {
+        print_log("rotm: нулевой кватернион\n");
+        return NULL;
+    }
+    double s = 2.0 / n2;
+    double w = q->w, x = q->x, y = q->y, z = q->z;
+
+    Container *result = create_matrix_container(3, 3);
+    if (!result) return NULL;
+    double *r = ((MatrixContainer*)result->data)->data;
+    r[0] = 1.0 - s * (y * y + z * z);
+    r[1] = s * (x * y - z * w);
+    r[2] = s * (x * z + y * w);
+    r[3] = s * (x * y + z * w);
+    r[4] = 1.0 - s * (x * x + z * z);
+    r[5] = s * (y * z - x * w);
+    r[6] = s * (x * z - y * w);
+    r[7] = s * (y * z + x * w);
+    r[8] = 1.0 - s * (x * x + y * y);
+    return result;
+}
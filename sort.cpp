@@ -0,0 +1,521 @@
+#include "lib.h"
+
+// Сортировка и порядковые статистики: sort, argsort, median, quantile.
+//
+// Числа double переводятся в 64-битные ключи с тем же порядком (у положительных
+// инвертируется знаковый бит, у отрицательных - все биты; NaN больше всех чисел).
+// sort и argsort - поразрядная сортировка LSD по RADIX_BITS бит за проход: каждый
+// поток считает гистограмму своего участка, по гистограммам всех потоков находит
+// место своих элементов и раскладывает их без синхронизации. Проходы по разрядам,
+// одинаковым у всех ключей, пропускаются. Сортировка устойчива, поэтому argsort
+// сохраняет порядок равных элементов.
+//
+// median и quantile не сортируют: поразрядный выбор сужает кандидатов по
+// SELECT_BITS следующих старших бит за проход, пока не останется искомый элемент.
+//
+// Вектор обрабатывается целиком и параллельно внутри, у матрицы sort/argsort по
+// умолчанию обрабатывают каждый столбец, median/quantile - все элементы (как sum);
+// "rows" и "cols" задают обработку каждой строки или столбца, строки и столбцы
+// раздаются потокам.
+
+#define RADIX_BITS   11
+#define RADIX_SIZE   (1 << RADIX_BITS)
+#define RADIX_PASSES ((64 + RADIX_BITS - 1) / RADIX_BITS)
+#define SELECT_BITS  11
+#define SELECT_SIZE  (1 << SELECT_BITS)
+#define SORT_SMALL   64         // Меньшие массивы сортируются вставками
+
+typedef unsigned long long SortKey;
+
+typedef enum {
+    SORT_ALL,
+    SORT_ROWS,
+    SORT_COLS
+} SortAxis;
+
+static inline SortKey key_of(double x) {
+    SortKey bits;
+    if (x != x) return ~0ULL;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits >> 63 ? ~bits : bits ^ (1ULL << 63);
+}
+
+static inline double value_of(SortKey key) {
+    SortKey bits = key >> 63 ? key ^ (1ULL << 63) : ~key;
+    double x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+static int sort_threads(size_t n) {
+    int threads = 1;
+#ifdef _OPENMP
+    if ((double)n * RADIX_PASSES > PARALLEL_MIN_WORK) threads = omp_get_max_threads();
+#endif
+    return threads;
+}
+
+
+// Сортировка
+
+// Устойчивая сортировка вставками ключей и (если idx != NULL) индексов
+static void insertion_sort(SortKey *key, int *idx, size_t n) {
+    for (size_t i = 1; i < n; i++) {
+        SortKey k = key[i];
+        int v = idx ? idx[i] : 0;
+        size_t j = i;
+        while (j > 0 && key[j - 1] > k) {
+            key[j] = key[j - 1];
+            if (idx) idx[j] = idx[j - 1];
+            j--;
+        }
+        key[j] = k;
+        if (idx) idx[j] = v;
+    }
+}
+
+// Поразрядная сортировка key (и idx вместе с ней); key_tmp и idx_tmp - буферы той же
+// длины. threads > 1 - проходы выполняются параллельно, иначе в текущем потоке.
+// 0 - нет памяти, key не изменен
+static int radix_sort(SortKey *key, int *idx, size_t n, SortKey *key_tmp, int *idx_tmp, int threads) {
+    if (n <= SORT_SMALL) {
+        insertion_sort(key, idx, n);
+        return 1;
+    }
+
+    // Разряды, в которых ключи различаются
+    SortKey all_or = 0, all_and = ~0ULL;
+    #pragma omp parallel for num_threads(threads) if(threads > 1) reduction(|:all_or) reduction(&:all_and) schedule(static)
+    for (long long i = 0; i < (long long)n; i++) {
+        all_or |= key[i];
+        all_and &= key[i];
+    }
+    SortKey varying = all_or ^ all_and;
+
+    size_t *count = (size_t*)malloc((size_t)threads * RADIX_SIZE * sizeof(size_t));
+    if (!count) return 0;
+    int swapped = 0;
+
+    #pragma omp parallel num_threads(threads) if(threads > 1)
+    {
+        int part = 0, parts = 1;
+#ifdef _OPENMP
+        part = omp_get_thread_num();
+        parts = omp_get_num_threads();
+#endif
+        size_t begin = n * part / parts;
+        size_t end = n * (part + 1) / parts;
+        SortKey *src = key, *dst = key_tmp;
+        int *isrc = idx, *idst = idx_tmp;
+        size_t *my = count + (size_t)part * RADIX_SIZE;
+        size_t pos[RADIX_SIZE];
+
+        for (int pass = 0; pass < RADIX_PASSES; pass++) {
+            int shift = pass * RADIX_BITS;
+            if (((varying >> shift) & (RADIX_SIZE - 1)) == 0) continue;
+
+            memset(my, 0, RADIX_SIZE * sizeof(size_t));
+            for (size_t i = begin; i < end; i++) my[(src[i] >> shift) & (RADIX_SIZE - 1)]++;
+            #pragma omp barrier
+
+            // Начало участка потока в корзине d: все меньшие корзины плюс
+            // элементы корзины d у потоков с меньшим номером
+            size_t offset = 0;
+            for (int d = 0; d < RADIX_SIZE; d++) {
+                size_t start = offset;
+                for (int t = 0; t < parts; t++) {
+                    size_t c = count[(size_t)t * RADIX_SIZE + d];
+                    if (t < part) start += c;
+                    offset += c;
+                }
+                pos[d] = start;
+            }
+
+            for (size_t i = begin; i < end; i++) {
+                size_t p = pos[(src[i] >> shift) & (RADIX_SIZE - 1)]++;
+                dst[p] = src[i];
+                if (idx) idst[p] = isrc[i];
+            }
+            #pragma omp barrier
+
+            SortKey *t = src; src = dst; dst = t;
+            int *it = isrc; isrc = idst; idst = it;
+            if (part == 0) swapped = !swapped;
+        }
+    }
+
+    if (swapped) {
+        memcpy(key, key_tmp, n * sizeof(SortKey));
+        if (idx) memcpy(idx, idx_tmp, n * sizeof(int));
+    }
+    free(count);
+    return 1;
+}
+
+
+// Выбор
+
+// Ключ с номером k (с нуля) в порядке возрастания в *found; key не меняется,
+// buf - буфер той же длины для отобранных кандидатов. 0 - нет памяти
+static int radix_select(const SortKey *key, size_t n, size_t k, SortKey *buf, int threads, SortKey *found) {
+    const SortKey *cand = key;
+    size_t *count = (size_t*)malloc((size_t)threads * SELECT_SIZE * sizeof(size_t));
+    if (!count) return 0;
+
+    for (int top = 64; top > 0 && n > SORT_SMALL; top -= SELECT_BITS) {
+        int shift = top > SELECT_BITS ? top - SELECT_BITS : 0;
+        SortKey mask = ((SortKey)1 << (top - shift)) - 1;
+        int parts = n > PARALLEL_MIN_WORK ? threads : 1;
+        int bucket = 0;
+        size_t below = 0;
+
+        // Гистограмма разряда по участкам
+        #pragma omp parallel for num_threads(threads) if(parts > 1) schedule(static)
+        for (int t = 0; t < parts; t++) {
+            size_t *my = count + (size_t)t * SELECT_SIZE;
+            memset(my, 0, SELECT_SIZE * sizeof(size_t));
+            for (size_t i = n * t / parts; i < n * (t + 1) / parts; i++) my[(cand[i] >> shift) & mask]++;
+        }
+
+        size_t total[SELECT_SIZE] = {0};
+        for (int t = 0; t < parts; t++) {
+            for (int d = 0; d < SELECT_SIZE; d++) total[d] += count[(size_t)t * SELECT_SIZE + d];
+        }
+        while (below + total[bucket] <= k) below += total[bucket++];
+        if (total[bucket] == n) continue;
+
+        // Остаются только ключи из нужной корзины; каждый участок пишет на свое место.
+        // Первый отбор идет в buf, следующие - в новый буфер меньшего размера
+        SortKey *dst = cand == key ? buf : (SortKey*)malloc(total[bucket] * sizeof(SortKey));
+        size_t *start = (size_t*)malloc((size_t)parts * sizeof(size_t));
+        if (!dst || !start) {
+            if (dst != buf) free(dst);
+            free(start);
+            if (cand != key && cand != buf) free((void*)cand);
+            free(count);
+            return 0;
+        }
+        size_t offset = 0;
+        for (int t = 0; t < parts; t++) {
+            start[t] = offset;
+            offset += count[(size_t)t * SELECT_SIZE + bucket];
+        }
+        #pragma omp parallel for num_threads(threads) if(parts > 1) schedule(static)
+        for (int t = 0; t < parts; t++) {
+            size_t pos = start[t];
+            for (size_t i = n * t / parts; i < n * (t + 1) / parts; i++) {
+                if ((int)((cand[i] >> shift) & mask) == bucket) dst[pos++] = cand[i];
+            }
+        }
+        free(start);
+
+        if (cand != key && cand != buf) free((void*)cand);
+        cand = dst;
+        n = total[bucket];
+        k -= below;
+    }
+    free(count);
+
+    if (cand != buf) {
+        memcpy(buf, cand, n * sizeof(SortKey));
+        if (cand != key) free((void*)cand);
+    }
+    insertion_sort(buf, NULL, n);
+    *found = buf[k];
+    return 1;
+}
+
+// Квантиль p с линейной интерполяцией между соседними порядковыми статистиками
+// в *out; 0 - нет памяти
+static int quantile_keys(const SortKey *key, size_t n, double p, SortKey *buf, int threads, double *out) {
+    double h = (n - 1) * p;
+    size_t k = (size_t)floor(h);
+    SortKey lo;
+    if (!radix_select(key, n, k, buf, threads, &lo)) return 0;
+    if (k + 1 >= n || h == (double)k) {
+        *out = value_of(lo);
+        return 1;
+    }
+
+    // Следующий по порядку: тот же ключ, если он повторяется, иначе наименьший больший
+    size_t not_greater = 0;
+    SortKey next = ~0ULL;
+    #pragma omp parallel for num_threads(threads) if(threads > 1) reduction(+:not_greater) reduction(min:next) schedule(static)
+    for (long long i = 0; i < (long long)n; i++) {
+        if (key[i] <= lo) not_greater++;
+        else if (key[i] < next) next = key[i];
+    }
+    if (not_greater > k + 1) next = lo;
+
+    double a = value_of(lo), b = value_of(next);
+    *out = a + (h - k) * (b - a);
+    return 1;
+}
+
+
+// Функции калькулятора
+
+// Значения аргумента в виде плотной матрицы (как у сверток в reduce.cpp)
+static MatrixContainer* sort_operand(Container *a, Container **temp, const char *name) {
+    *temp = NULL;
+    if (a && (container_is_scalar(a) || a->type == CT_VECTOR)) {
+        *temp = container_to_matrix(a);
+        return *temp ? (MatrixContainer*)(*temp)->data : NULL;
+    }
+    MatrixContainer *m = a && a->type != CT_COMPLEX ? dense_view(a, temp) : NULL;
+    if (!m) print_log("%s: аргумент должен быть числом, вектором или матрицей\n", name);
+    return m;
+}
+
+static int parse_axis(Container** args, int first, int arg_count, const char *name, SortAxis *axis) {
+    for (int i = first; i < arg_count; i++) {
+        const char *opt = args[i] && args[i]->type == CT_STRING ?
+                          ((StringContainer*)args[i]->data)->value : NULL;
+        if (opt && strcmp(opt, "rows") == 0) *axis = SORT_ROWS;
+        else if (opt && strcmp(opt, "cols") == 0) *axis = SORT_COLS;
+        else {
+            print_log("%s: параметр должен быть \"rows\" или \"cols\"\n", name);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Разбиение матрицы на обрабатываемые отрезки: lines отрезков длины len,
+// элемент i отрезка l лежит в data[l*line_step + i*step]
+static void axis_layout(const MatrixContainer *m, SortAxis axis, int *lines, size_t *len, size_t *line_step, size_t *step) {
+    if (axis == SORT_ALL || (axis == SORT_ROWS && m->rows == 1) || (axis == SORT_COLS && m->cols == 1)) {
+        *lines = 1;
+        *len = (size_t)m->rows * m->cols;
+        *line_step = 0;
+        *step = 1;
+    } else if (axis == SORT_ROWS) {
+        *lines = m->rows;
+        *len = m->cols;
+        *line_step = m->cols;
+        *step = 1;
+    } else {
+        *lines = m->cols;
+        *len = m->rows;
+        *line_step = 1;
+        *step = m->cols;
+    }
+}
+
+// Сортировка отрезка src[i*step] в dst[i*step] (значения или номера); 0 - нет памяти
+static int sort_line(const double *src, size_t step, double *dst, size_t len, int want_index, int threads) {
+    SortKey *key = (SortKey*)mem_alloc(MEM_SCRATCH, 2 * len * sizeof(SortKey));
+    int *idx = want_index ? (int*)mem_alloc(MEM_SCRATCH, 2 * len * sizeof(int)) : NULL;
+    if (!key || (want_index && !idx)) {
+        mem_free(MEM_SCRATCH, key);
+        mem_free(MEM_SCRATCH, idx);
+        return 0;
+    }
+
+    #pragma omp parallel for num_threads(threads) if(threads > 1) schedule(static)
+    for (long long i = 0; i < (long long)len; i++) {
+        key[i] = key_of(src[i * step]);
+        if (idx) idx[i] = (int)i;
+    }
+    if (!radix_sort(key, idx, len, key + len, idx ? idx + len : NULL, threads)) {
+        mem_free(MEM_SCRATCH, key);
+        mem_free(MEM_SCRATCH, idx);
+        return 0;
+    }
+    #pragma omp parallel for num_threads(threads) if(threads > 1) schedule(static)
+    for (long long i = 0; i < (long long)len; i++) {
+        dst[i * step] = idx ? (double)idx[i] : value_of(key[i]);
+    }
+
+    mem_free(MEM_SCRATCH, key);
+    mem_free(MEM_SCRATCH, idx);
+    return 1;
+}
+
+// sort и argsort: результат того же размера, что и аргумент
+static Container* sort_call(Container** args, int arg_count, int want_index, const char *name) {
+    if (arg_count < 1 || arg_count > 2) {
+        print_log("%s: ожидается 1 или 2 аргумента\n", name);
+        return NULL;
+    }
+    SortAxis axis = SORT_COLS;
+    if (!parse_axis(args, 1, arg_count, name, &axis)) return NULL;
+
+    Container *temp;
+    MatrixContainer *m = sort_operand(args[0], &temp, name);
+    if (!m) return NULL;
+    if (m->rows == 1 || m->cols == 1) axis = SORT_ALL;
+
+    int lines;
+    size_t len, line_step, step;
+    axis_layout(m, axis, &lines, &len, &line_step, &step);
+    if (len > INT_MAX) {
+        print_log("%s: слишком длинный массив\n", name);
+        free_container(temp);
+        return NULL;
+    }
+
+    Container *result = create_matrix_container(m->rows, m->cols);
+    if (!result) {
+        free_container(temp);
+        return NULL;
+    }
+    double *out = ((MatrixContainer*)result->data)->data;
+
+    // Один отрезок сортируется всеми потоками, несколько - раздаются потокам
+    int ok = 1;
+    if (lines == 1) {
+        ok = sort_line(m->data, step, out, len, want_index, sort_threads(len));
+    } else {
+        double work = (double)lines * len * RADIX_PASSES;
+        #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(dynamic)
+        for (int l = 0; l < lines; l++) {
+            if (!sort_line(m->data + (size_t)l * line_step, step, out + (size_t)l * line_step, len, want_index, 1)) ok = 0;
+        }
+    }
+    if (!ok) {
+        print_log("%s: недостаточно памяти\n", name);
+        free_container(result);
+        free_container(temp);
+        return NULL;
+    }
+
+    free_container(temp);
+
+    // Вектор остается вектором
+    if (args[0]->type == CT_VECTOR) {
+        Container *vec = create_vector_container(out[0], out[1], out[2]);
+        free_container(result);
+        return vec;
+    }
+    return result;
+}
+
+// sort(x[, "rows"|"cols"]): значения по возрастанию (NaN в конце)
+Container* sort_func(Container** args, int arg_count) {
+    return sort_call(args, arg_count, 0, "sort");
+}
+
+// argsort(x[, "rows"|"cols"]): номера (с нуля) элементов в порядке возрастания
+Container* argsort_func(Container** args, int arg_count) {
+    return sort_call(args, arg_count, 1, "argsort");
+}
+
+// Квантили prob (count штук) отрезка src[i*step]; 0 - нет памяти
+static int quantile_line(const double *src, size_t step, size_t len, const double *prob, int count,
+                         double *out, int threads) {
+    SortKey *key = (SortKey*)mem_alloc(MEM_SCRATCH, 2 * len * sizeof(SortKey));
+    if (!key) return 0;
+
+    #pragma omp parallel for num_threads(threads) if(threads > 1) schedule(static)
+    for (long long i = 0; i < (long long)len; i++) key[i] = key_of(src[i * step]);
+    int ok = 1;
+    for (int j = 0; j < count && ok; j++) ok = quantile_keys(key, len, prob[j], key + len, threads, &out[j]);
+
+    mem_free(MEM_SCRATCH, key);
+    return ok;
+}
+
+// Квантили prob (count штук) для каждого отрезка; out[l*count + j]
+static int quantile_lines(const MatrixContainer *m, SortAxis axis, const double *prob, int count, double *out) {
+    int lines;
+    size_t len, line_step, step;
+    axis_layout(m, axis, &lines, &len, &line_step, &step);
+    if (lines == 1) {
+        return quantile_line(m->data, step, len, prob, count, out, sort_threads(len));
+    }
+
+    int ok = 1;
+    double work = (double)lines * len * count;
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(dynamic)
+    for (int l = 0; l < lines; l++) {
+        if (!quantile_line(m->data + (size_t)l * line_step, step, len, prob, count, out + (size_t)l * count, 1)) ok = 0;
+    }
+    return ok;
+}
+
+// quantile с вероятностями из prob; результат: для всех элементов - форма prob,
+// по строкам - строка квантилей на каждую строку, по столбцам - столбец на каждый столбец
+static Container* quantile_call(Container** args, int arg_count, int first_option, Container *prob, const char *name) {
+    SortAxis axis = SORT_ALL;
+    if (!parse_axis(args, first_option, arg_count, name, &axis)) return NULL;
+
+    Container *ptemp = container_to_matrix(prob);
+    if (!ptemp || prob->type == CT_STRING) {
+        print_log("%s: вероятность должна быть числом или вектором\n", name);
+        free_container(ptemp);
+        return NULL;
+    }
+    MatrixContainer *pm = (MatrixContainer*)ptemp->data;
+    int count = pm->rows * pm->cols;
+    for (int j = 0; j < count; j++) {
+        if (!(pm->data[j] >= 0.0 && pm->data[j] <= 1.0)) {
+            print_log("%s: вероятность должна быть от 0 до 1\n", name);
+            free_container(ptemp);
+            return NULL;
+        }
+    }
+
+    Container *temp;
+    MatrixContainer *m = sort_operand(args[0], &temp, name);
+    if (!m || (size_t)m->rows * m->cols == 0) {
+        if (m) print_log("%s: пустой массив\n", name);
+        free_container(temp);
+        free_container(ptemp);
+        return NULL;
+    }
+    if ((axis == SORT_ROWS && m->rows == 1) || (axis == SORT_COLS && m->cols == 1)) axis = SORT_ALL;
+
+    int lines = axis == SORT_ROWS ? m->rows : axis == SORT_COLS ? m->cols : 1;
+    double *values = (double*)mem_alloc(MEM_SCRATCH, (size_t)lines * count * sizeof(double));
+    Container *result = NULL;
+
+    if (values && quantile_lines(m, axis, pm->data, count, values)) {
+        if (axis == SORT_ALL && count == 1 && container_is_scalar(prob)) {
+            result = create_float_container(values[0]);
+        } else if (axis == SORT_ALL) {
+            result = create_matrix_container(pm->rows, pm->cols);
+            if (result) memcpy(((MatrixContainer*)result->data)->data, values, count * sizeof(double));
+        } else if (axis == SORT_ROWS) {
+            result = create_matrix_container(lines, count);
+            if (result) memcpy(((MatrixContainer*)result->data)->data, values, (size_t)lines * count * sizeof(double));
+        } else {
+            result = create_matrix_container(count, lines);
+            if (result) {
+                double *out = ((MatrixContainer*)result->data)->data;
+                for (int l = 0; l < lines; l++) {
+                    for (int j = 0; j < count; j++) out[(size_t)j * lines + l] = values[(size_t)l * count + j];
+                }
+            }
+        }
+    } else {
+        print_log("%s: недостаточно памяти\n", name);
+    }
+
+    mem_free(MEM_SCRATCH, values);
+    free_container(temp);
+    free_container(ptemp);
+    return result;
+}
+
+// median(x[, "rows"|"cols"])
+Container* median_func(Container** args, int arg_count) {
+    if (arg_count < 1 || arg_count > 2) {
+        print_log("median: ожидается 1 или 2 аргумента\n");
+        return NULL;
+    }
+    Container *half = create_float_container(0.5);
+    Container *result = quantile_call(args, arg_count, 1, half, "median");
+    free_container(half);
+    return result;
+}
+
+// quantile(x, p[, "rows"|"cols"]): p - число или вектор вероятностей от 0 до 1
+Container* quantile_func(Container** args, int arg_count) {
+    if (arg_count < 2 || arg_count > 3) {
+        print_log("quantile: ожидается 2 или 3 аргумента\n");
+        return NULL;
+    }
+    if (!args[1]) return NULL;
+    return quantile_call(args, arg_count, 2, args[1], "quantile");
+}
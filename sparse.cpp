@@ -0,0 +1,807 @@
+#include "lib.h"
+
+// Во сколько раз объём умножения должен превышать стоимость перевода CSC -> CSR
+#define SPARSE_CONVERT_FACTOR 3
+
+// Количество элементов разреженной матрицы, выводимых целиком
+#define SPARSE_PRINT_LIMIT 20
+
+
+// Выделение памяти под разреженную матрицу с nnz элементами
+SparseContainer* sparse_alloc(SparseFormat format, int rows, int cols, int nnz) {
+    SparseContainer *sp = (SparseContainer*)malloc(sizeof(SparseContainer));
+    if (!sp) return NULL;
+
+    int major = format == SP_CSR ? rows : cols;
+    sp->format = format;
+    sp->rows = rows;
+    sp->cols = cols;
+    sp->nnz = nnz;
+    sp->cache = NULL;
+    sp->ptr = (int*)mem_calloc(MEM_CONTAINERS, (size_t)major + 1, sizeof(int));
+    sp->idx = (int*)mem_alloc(MEM_CONTAINERS, (size_t)(nnz > 0 ? nnz : 1) * sizeof(int));
+    sp->val = (double*)mem_alloc(MEM_CONTAINERS, (size_t)(nnz > 0 ? nnz : 1) * sizeof(double));
+
+    if (!sp->ptr || !sp->idx || !sp->val) {
+        print_log("Ошибка: недостаточно памяти для разреженной матрицы (nnz = %d)\n", nnz);
+        sparse_free(sp);
+        return NULL;
+    }
+    return sp;
+}
+
+void sparse_free(SparseContainer *sp) {
+    if (sp) {
+        matrix_cache_release(sp->cache);
+        mem_free(MEM_CONTAINERS, sp->ptr);
+        mem_free(MEM_CONTAINERS, sp->idx);
+        mem_free(MEM_CONTAINERS, sp->val);
+        free(sp);
+    }
+}
+
+void free_sparse_container(void *data) {
+    sparse_free((SparseContainer*)data);
+}
+
+// Вывод размеров, формата и первых ненулевых элементов
+void print_sparse_container(void *data) {
+    if (!data) return;
+    SparseContainer *sp = (SparseContainer*)data;
+
+    print_log("разреженная %dx%d (%s), nnz = %d", sp->rows, sp->cols,
+              sp->format == SP_CSR ? "CSR" : "CSC", sp->nnz);
+    if (sp->nnz == 0) return;
+
+    print_log(": [");
+    int major = sp->format == SP_CSR ? sp->rows : sp->cols;
+    int printed = 0;
+    for (int i = 0; i < major && printed < SPARSE_PRINT_LIMIT; i++) {
+        for (int p = sp->ptr[i]; p < sp->ptr[i + 1] && printed < SPARSE_PRINT_LIMIT; p++) {
+            int row = sp->format == SP_CSR ? i : sp->idx[p];
+            int col = sp->format == SP_CSR ? sp->idx[p] : i;
+            if (printed > 0) print_log(", ");
+            print_log("(%d, %d) = ", row, col);
+            print_smart_double(sp->val[p]);
+            printed++;
+        }
+    }
+    if (sp->nnz > SPARSE_PRINT_LIMIT) print_log(", ...");
+    print_log("]");
+}
+
+// Инициализация контейнера разреженной матрицы (контейнер становится владельцем)
+Container* create_sparse_container(SparseContainer *sparse) {
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
+
+    container->type = CT_SPARSE;
+    container->data = sparse;
+    container->free_func = free_sparse_container;
+    container->print_func = print_sparse_container;
+
+    return container;
+}
+
+// Клонирование разреженной матрицы; копия разделяет кэш разложений
+Container* sparse_copy(SparseContainer *sp) {
+    SparseContainer *copy = sparse_alloc(sp->format, sp->rows, sp->cols, sp->nnz);
+    if (!copy) return NULL;
+
+    int major = sp->format == SP_CSR ? sp->rows : sp->cols;
+    memcpy(copy->ptr, sp->ptr, ((size_t)major + 1) * sizeof(int));
+    memcpy(copy->idx, sp->idx, (size_t)sp->nnz * sizeof(int));
+    memcpy(copy->val, sp->val, (size_t)sp->nnz * sizeof(double));
+    copy->cache = matrix_cache_share(&sp->cache);
+    return create_sparse_container(copy);
+}
+
+
+// Построение матрицы из координатных троек (COO); повторяющиеся позиции суммируются
+SparseContainer* sparse_from_coo(int rows, int cols, int nnz, const int *ri, const int *ci,
+                                 const double *v, SparseFormat format) {
+    for (int e = 0; e < nnz; e++) {
+        if (ri[e] < 0 || ri[e] >= rows || ci[e] < 0 || ci[e] >= cols) {
+            print_log("Ошибка: индекс (%d, %d) вне матрицы %dx%d\n", ri[e], ci[e], rows, cols);
+            return NULL;
+        }
+    }
+
+    const int *maj = format == SP_CSR ? ri : ci;
+    const int *min = format == SP_CSR ? ci : ri;
+    int major = format == SP_CSR ? rows : cols;
+    int minor = format == SP_CSR ? cols : rows;
+
+    // Две устойчивые сортировки подсчётом: по младшему индексу, затем по старшему
+    int *count = (int*)calloc((size_t)(major > minor ? major : minor) + 1, sizeof(int));
+    int *by_minor = (int*)malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(int));
+    int *order = (int*)malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(int));
+    if (!count || !by_minor || !order) {
+        print_log("Ошибка: недостаточно памяти для разреженной матрицы (nnz = %d)\n", nnz);
+        free(count);
+        free(by_minor);
+        free(order);
+        return NULL;
+    }
+
+    for (int e = 0; e < nnz; e++) count[min[e] + 1]++;
+    for (int i = 0; i < minor; i++) count[i + 1] += count[i];
+    for (int e = 0; e < nnz; e++) by_minor[count[min[e]]++] = e;
+
+    memset(count, 0, ((size_t)major + 1) * sizeof(int));
+    for (int e = 0; e < nnz; e++) count[maj[e] + 1]++;
+    for (int i = 0; i < major; i++) count[i + 1] += count[i];
+    for (int q = 0; q < nnz; q++) {
+        int e = by_minor[q];
+        order[count[maj[e]]++] = e;
+    }
+
+    // Подсчёт уникальных позиций
+    int unique = 0;
+    for (int q = 0; q < nnz; q++) {
+        int e = order[q];
+        if (q == 0 || maj[e] != maj[order[q - 1]] || min[e] != min[order[q - 1]]) unique++;
+    }
+
+    SparseContainer *sp = sparse_alloc(format, rows, cols, unique);
+    if (sp) {
+        int out = -1;
+        for (int q = 0; q < nnz; q++) {
+            int e = order[q];
+            if (q == 0 || maj[e] != maj[order[q - 1]] || min[e] != min[order[q - 1]]) {
+                out++;
+                sp->idx[out] = min[e];
+                sp->val[out] = v[e];
+                sp->ptr[maj[e] + 1]++;
+            } else {
+                sp->val[out] += v[e];
+            }
+        }
+        for (int i = 0; i < major; i++) sp->ptr[i + 1] += sp->ptr[i];
+    }
+
+    free(count);
+    free(by_minor);
+    free(order);
+    return sp;
+}
+
+// Перевод между CSR и CSC (транспонирование структуры за O(nnz))
+SparseContainer* sparse_convert(const SparseContainer *sp, SparseFormat format) {
+    SparseContainer *result = sparse_alloc(format, sp->rows, sp->cols, sp->nnz);
+    if (!result) return NULL;
+
+    int major = sp->format == SP_CSR ? sp->rows : sp->cols;
+    if (format == sp->format) {
+        memcpy(result->ptr, sp->ptr, ((size_t)major + 1) * sizeof(int));
+        memcpy(result->idx, sp->idx, (size_t)sp->nnz * sizeof(int));
+        memcpy(result->val, sp->val, (size_t)sp->nnz * sizeof(double));
+        return result;
+    }
+
+    int new_major = format == SP_CSR ? sp->rows : sp->cols;
+    for (int p = 0; p < sp->nnz; p++) result->ptr[sp->idx[p] + 1]++;
+    for (int i = 0; i < new_major; i++) result->ptr[i + 1] += result->ptr[i];
+
+    // Обход старых строк по возрастанию сразу даёт упорядоченные индексы в новых
+    int *next = (int*)malloc(((size_t)new_major + 1) * sizeof(int));
+    if (!next) {
+        print_log("Ошибка: недостаточно памяти для разреженной матрицы (nnz = %d)\n", sp->nnz);
+        sparse_free(result);
+        return NULL;
+    }
+    memcpy(next, result->ptr, ((size_t)new_major + 1) * sizeof(int));
+    for (int i = 0; i < major; i++) {
+        for (int p = sp->ptr[i]; p < sp->ptr[i + 1]; p++) {
+            int q = next[sp->idx[p]]++;
+            result->idx[q] = i;
+            result->val[q] = sp->val[p];
+        }
+    }
+    free(next);
+    return result;
+}
+
+// Сжатие плотной матрицы в CSR
+SparseContainer* sparse_from_dense(const MatrixContainer *m) {
+    int nnz = 0;
+    size_t count = (size_t)m->rows * m->cols;
+    for (size_t i = 0; i < count; i++) {
+        if (m->data[i] != 0.0) nnz++;
+    }
+
+    SparseContainer *sp = sparse_alloc(SP_CSR, m->rows, m->cols, nnz);
+    if (!sp) return NULL;
+
+    int pos = 0;
+    for (int i = 0; i < m->rows; i++) {
+        const double *row = m->data + (size_t)i * m->cols;
+        for (int j = 0; j < m->cols; j++) {
+            if (row[j] != 0.0) {
+                sp->idx[pos] = j;
+                sp->val[pos] = row[j];
+                pos++;
+            }
+        }
+        sp->ptr[i + 1] = pos;
+    }
+    return sp;
+}
+
+// Развёртывание разреженной матрицы в плотную
+Container* sparse_to_dense(const SparseContainer *sp) {
+    Container *result = create_matrix_container(sp->rows, sp->cols);
+    if (!result) return NULL;
+    double *d = ((MatrixContainer*)result->data)->data;
+
+    int major = sp->format == SP_CSR ? sp->rows : sp->cols;
+    for (int i = 0; i < major; i++) {
+        for (int p = sp->ptr[i]; p < sp->ptr[i + 1]; p++) {
+            if (sp->format == SP_CSR) {
+                d[(size_t)i * sp->cols + sp->idx[p]] += sp->val[p];
+            } else {
+                d[(size_t)sp->idx[p] * sp->cols + i] += sp->val[p];
+            }
+        }
+    }
+    return result;
+}
+
+// Сравнение разреженных матриц (форматы могут различаться)
+int sparse_compare(const SparseContainer *a, const SparseContainer *b) {
+    if (a->rows != b->rows || a->cols != b->cols || a->nnz != b->nnz) return 0;
+
+    SparseContainer *other = sparse_convert(b, a->format);
+    if (!other) return 0;
+
+    int major = a->format == SP_CSR ? a->rows : a->cols;
+    int equal = memcmp(a->ptr, other->ptr, ((size_t)major + 1) * sizeof(int)) == 0 &&
+                memcmp(a->idx, other->idx, (size_t)a->nnz * sizeof(int)) == 0;
+    for (int p = 0; equal && p < a->nnz; p++) {
+        if (fabs(a->val[p] - other->val[p]) >= 1e-10) equal = 0;
+    }
+
+    sparse_free(other);
+    return equal;
+}
+
+
+// Граница участка строк для потока: строки делятся так, чтобы у потоков было поровну nnz
+static int csr_partition_bound(const SparseContainer *sp, int part, int parts) {
+    if (part >= parts) return sp->rows;
+
+    long long target = (long long)sp->nnz * part / parts;
+    int lo = 0, hi = sp->rows;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (sp->ptr[mid] < target) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// C = A*B для A в CSR: каждый поток вычисляет свой непрерывный участок строк C
+static void csr_spmm(const SparseContainer *sp, const double *B, int k, double *C) {
+    double work = (double)sp->nnz * k + (double)sp->rows * k;
+
+    #pragma omp parallel if(work > PARALLEL_MIN_WORK)
+    {
+        int part = 0, parts = 1;
+#ifdef _OPENMP
+        part = omp_get_thread_num();
+        parts = omp_get_num_threads();
+#endif
+        int begin = csr_partition_bound(sp, part, parts);
+        int end = csr_partition_bound(sp, part + 1, parts);
+
+        for (int i = begin; i < end; i++) {
+            double *c = C + (size_t)i * k;
+
+            if (k == 1) {
+                double sum = 0.0;
+                for (int p = sp->ptr[i]; p < sp->ptr[i + 1]; p++) {
+                    sum += sp->val[p] * B[sp->idx[p]];
+                }
+                *c = sum;
+                continue;
+            }
+
+            for (int j = 0; j < k; j++) c[j] = 0.0;
+            for (int p = sp->ptr[i]; p < sp->ptr[i + 1]; p++) {
+                double v = sp->val[p];
+                const double *b = B + (size_t)sp->idx[p] * k;
+                for (int j = 0; j < k; j++) c[j] += v * b[j];
+            }
+        }
+    }
+}
+
+// C = A*B для A в CSC: последовательная раздача столбцов в строки результата
+static void csc_spmm(const SparseContainer *sp, const double *B, int k, double *C) {
+    memset(C, 0, (size_t)sp->rows * k * sizeof(double));
+
+    for (int col = 0; col < sp->cols; col++) {
+        const double *b = B + (size_t)col * k;
+        for (int p = sp->ptr[col]; p < sp->ptr[col + 1]; p++) {
+            double v = sp->val[p];
+            double *c = C + (size_t)sp->idx[p] * k;
+            for (int j = 0; j < k; j++) c[j] += v * b[j];
+        }
+    }
+}
+
+// Умножение разреженной матрицы на плотную (B: cols x k, C: rows x k, хранение по строкам)
+void sparse_spmm(const SparseContainer *sp, const double *B, int k, double *C) {
+    if (sp->format == SP_CSR) {
+        csr_spmm(sp, B, k, C);
+        return;
+    }
+
+    // Столбцы CSC нельзя раздать потокам без конфликтов записи, поэтому матрица
+    // переводится в CSR, если перевод окупается числом столбцов правой части
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    double work = (double)sp->nnz * k;
+    if (threads > 1 && work > PARALLEL_MIN_WORK &&
+        (double)k * (threads - 1) > (double)SPARSE_CONVERT_FACTOR * threads) {
+        SparseContainer *csr = sparse_convert(sp, SP_CSR);
+        if (csr) {
+            csr_spmm(csr, B, k, C);
+            sparse_free(csr);
+            return;
+        }
+    }
+    csc_spmm(sp, B, k, C);
+}
+
+// Умножение плотной матрицы на разреженную: C (m x k) = A (m x n) * S (n x k)
+void dense_sparse_mm(const double *A, int m, const SparseContainer *sp, double *C) {
+    int n = sp->rows;
+    int k = sp->cols;
+    double work = (double)m * sp->nnz;
+
+    // Строки результата независимы при любом формате S
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+    for (int i = 0; i < m; i++) {
+        const double *a = A + (size_t)i * n;
+        double *c = C + (size_t)i * k;
+
+        if (sp->format == SP_CSR) {
+            for (int j = 0; j < k; j++) c[j] = 0.0;
+            for (int r = 0; r < n; r++) {
+                double ar = a[r];
+                if (ar == 0.0) continue;
+                for (int p = sp->ptr[r]; p < sp->ptr[r + 1]; p++) {
+                    c[sp->idx[p]] += ar * sp->val[p];
+                }
+            }
+        } else {
+            for (int j = 0; j < k; j++) {
+                double sum = 0.0;
+                for (int p = sp->ptr[j]; p < sp->ptr[j + 1]; p++) {
+                    sum += a[sp->idx[p]] * sp->val[p];
+                }
+                c[j] = sum;
+            }
+        }
+    }
+}
+
+
+// Перевод строки в нижний регистр
+static void to_lower(char *s) {
+    for (; *s; s++) *s = (char)tolower((unsigned char)*s);
+}
+
+// Загрузка матрицы из файла в формате Matrix Market (coordinate или array)
+Container* sparse_load_mm(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        print_log("Ошибка: не удалось открыть файл '%s'\n", filename);
+        return NULL;
+    }
+
+    char line[1024];
+    char object[64], format[64], field[64], symmetry[64];
+    if (!fgets(line, sizeof(line), f) ||
+        sscanf(line, "%%%%MatrixMarket %63s %63s %63s %63s", object, format, field, symmetry) != 4) {
+        print_log("Ошибка: '%s' не является файлом Matrix Market\n", filename);
+        fclose(f);
+        return NULL;
+    }
+    to_lower(object);
+    to_lower(format);
+    to_lower(field);
+    to_lower(symmetry);
+
+    int is_pattern = strcmp(field, "pattern") == 0;
+    int is_symmetric = strcmp(symmetry, "symmetric") == 0;
+    int is_skew = strcmp(symmetry, "skew-symmetric") == 0;
+    if (strcmp(object, "matrix") != 0 ||
+        (strcmp(field, "real") != 0 && strcmp(field, "double") != 0 &&
+         strcmp(field, "integer") != 0 && !is_pattern) ||
+        (!is_symmetric && !is_skew && strcmp(symmetry, "general") != 0)) {
+        print_log("Ошибка: неподдерживаемый вид Matrix Market: %s %s %s %s\n", object, format, field, symmetry);
+        fclose(f);
+        return NULL;
+    }
+
+    // Пропуск комментариев до строки с размерами
+    do {
+        if (!fgets(line, sizeof(line), f)) {
+            print_log("Ошибка: в файле '%s' нет строки размеров\n", filename);
+            fclose(f);
+            return NULL;
+        }
+    } while (line[0] == '%' || line[strspn(line, " \t\r\n")] == '\0');
+
+    int rows = 0, cols = 0, entries = 0;
+
+    if (strcmp(format, "array") == 0) {
+        if (sscanf(line, "%d %d", &rows, &cols) != 2 || rows <= 0 || cols <= 0 || is_pattern) {
+            print_log("Ошибка: некорректный заголовок array в '%s'\n", filename);
+            fclose(f);
+            return NULL;
+        }
+
+        // Плотный формат хранится по столбцам; для симметричных - только нижний треугольник
+        Container *result = create_matrix_container(rows, cols);
+        if (!result) {
+            fclose(f);
+            return NULL;
+        }
+        double *d = ((MatrixContainer*)result->data)->data;
+        for (int j = 0; j < cols; j++) {
+            for (int i = (is_symmetric || is_skew) ? j : 0; i < rows; i++) {
+                double value;
+                if (fscanf(f, "%lf", &value) != 1) {
+                    print_log("Ошибка: файл '%s' закончился раньше времени\n", filename);
+                    free_container(result);
+                    fclose(f);
+                    return NULL;
+                }
+                d[(size_t)i * cols + j] = value;
+                if (i != j && (is_symmetric || is_skew)) {
+                    d[(size_t)j * cols + i] = is_skew ? -value : value;
+                }
+            }
+        }
+        fclose(f);
+        return result;
+    }
+
+    if (strcmp(format, "coordinate") != 0 ||
+        sscanf(line, "%d %d %d", &rows, &cols, &entries) != 3 ||
+        rows <= 0 || cols <= 0 || entries < 0) {
+        print_log("Ошибка: некорректный заголовок coordinate в '%s'\n", filename);
+        fclose(f);
+        return NULL;
+    }
+
+    int capacity = (is_symmetric || is_skew) ? 2 * entries : entries;
+    int *ri = (int*)malloc((size_t)(capacity > 0 ? capacity : 1) * sizeof(int));
+    int *ci = (int*)malloc((size_t)(capacity > 0 ? capacity : 1) * sizeof(int));
+    double *v = (double*)malloc((size_t)(capacity > 0 ? capacity : 1) * sizeof(double));
+    if (!ri || !ci || !v) {
+        print_log("Ошибка: недостаточно памяти для %d элементов\n", entries);
+        free(ri);
+        free(ci);
+        free(v);
+        fclose(f);
+        return NULL;
+    }
+
+    int nnz = 0;
+    for (int e = 0; e < entries; e++) {
+        int i, j;
+        double value = 1.0;
+        if (fscanf(f, "%d %d", &i, &j) != 2 || (!is_pattern && fscanf(f, "%lf", &value) != 1)) {
+            print_log("Ошибка: файл '%s' закончился раньше времени\n", filename);
+            nnz = -1;
+            break;
+        }
+        // В файле индексы начинаются с единицы
+        ri[nnz] = i - 1;
+        ci[nnz] = j - 1;
+        v[nnz] = value;
+        nnz++;
+        if ((is_symmetric || is_skew) && i != j) {
+            ri[nnz] = j - 1;
+            ci[nnz] = i - 1;
+            v[nnz] = is_skew ? -value : value;
+            nnz++;
+        }
+    }
+    fclose(f);
+
+    SparseContainer *sp = nnz >= 0 ? sparse_from_coo(rows, cols, nnz, ri, ci, v, SP_CSR) : NULL;
+    free(ri);
+    free(ci);
+    free(v);
+    return sp ? create_sparse_container(sp) : NULL;
+}
+
+
+// Случайная разреженная матрица с долей ненулевых элементов density
+static SparseContainer* sparse_random(int rows, int cols, double density) {
+    double target = density * rows * cols;
+    if (target > 2147483647.0) {
+        print_log("sprand: слишком много ненулевых элементов\n");
+        return NULL;
+    }
+
+    int nnz = (int)(target + 0.5);
+    int *ri = (int*)malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(int));
+    int *ci = (int*)malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(int));
+    double *v = (double*)malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(double));
+    SparseContainer *sp = NULL;
+
+    if (ri && ci && v) {
+        for (int e = 0; e < nnz; e++) {
+            ri[e] = (int)(rand_next() % (unsigned long long)rows);
+            ci[e] = (int)(rand_next() % (unsigned long long)cols);
+            v[e] = rand_uniform();
+        }
+        sp = sparse_from_coo(rows, cols, nnz, ri, ci, v, SP_CSR);
+    } else {
+        print_log("Ошибка: недостаточно памяти для %d элементов\n", nnz);
+    }
+
+    free(ri);
+    free(ci);
+    free(v);
+    return sp;
+}
+
+// Разреженная матрица: sparse(A) из плотной или sparse(i, j, v, m, n) из троек (индексы с нуля)
+Container* sparse_func(Container** args, int arg_count) {
+    if (arg_count == 1) {
+        if (!args[0]) return NULL;
+        if (args[0]->type == CT_SPARSE) return sparse_copy((SparseContainer*)args[0]->data);
+
+        Container *dense = container_to_matrix(args[0]);
+        if (!dense) {
+            print_log("sparse: аргумент должен быть матрицей\n");
+            return NULL;
+        }
+        SparseContainer *sp = sparse_from_dense((MatrixContainer*)dense->data);
+        free_container(dense);
+        return sp ? create_sparse_container(sp) : NULL;
+    }
+
+    if (arg_count != 5) {
+        print_log("sparse: ожидается 1 или 5 аргументов\n");
+        return NULL;
+    }
+    int rows, cols;
+    if (!arg_to_size(args[3], "sparse", &rows) || !arg_to_size(args[4], "sparse", &cols)) return NULL;
+
+    int ni, nj, nv;
+    double *di = container_values(args[0], &ni);
+    double *dj = container_values(args[1], &nj);
+    double *dv = container_values(args[2], &nv);
+
+    SparseContainer *sp = NULL;
+    if (!di || !dj || !dv || ni != nj || ni != nv) {
+        print_log("sparse: i, j и v должны быть векторами одинаковой длины\n");
+    } else {
+        int *ri = (int*)malloc((size_t)(ni > 0 ? ni : 1) * sizeof(int));
+        int *ci = (int*)malloc((size_t)(ni > 0 ? ni : 1) * sizeof(int));
+        int ok = ri && ci;
+        if (!ok) print_log("Ошибка: недостаточно памяти для разреженной матрицы (nnz = %d)\n", ni);
+        for (int e = 0; ok && e < ni; e++) {
+            // Индексы - целые числа внутри матрицы; дробные не округляются молча
+            if (di[e] != floor(di[e]) || dj[e] != floor(dj[e])) {
+                print_log("sparse: индексы должны быть целыми, получено (%g, %g)\n", di[e], dj[e]);
+                ok = 0;
+            } else if (!(di[e] >= 0 && di[e] < rows && dj[e] >= 0 && dj[e] < cols)) {
+                print_log("sparse: индекс (%g, %g) вне матрицы %dx%d\n", di[e], dj[e], rows, cols);
+                ok = 0;
+            } else {
+                ri[e] = (int)di[e];
+                ci[e] = (int)dj[e];
+            }
+        }
+        if (ok) sp = sparse_from_coo(rows, cols, ni, ri, ci, dv, SP_CSR);
+        free(ri);
+        free(ci);
+    }
+
+    free(di);
+    free(dj);
+    free(dv);
+    return sp ? create_sparse_container(sp) : NULL;
+}
+
+// Плотное представление матрицы
+Container* dense_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("dense: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (!args[0]) return NULL;
+
+    Container *result = container_to_matrix(args[0]);
+    if (!result) print_log("dense: аргумент должен быть матрицей\n");
+    return result;
+}
+
+// Явный перевод разреженной матрицы в заданный формат
+static Container* convert_func(Container** args, int arg_count, SparseFormat format, const char *name) {
+    if (arg_count != 1) {
+        print_log("%s: ожидается 1 аргумент\n", name);
+        return NULL;
+    }
+    if (!args[0]) return NULL;
+
+    if (args[0]->type == CT_SPARSE) {
+        SparseContainer *sp = sparse_convert((SparseContainer*)args[0]->data, format);
+        return sp ? create_sparse_container(sp) : NULL;
+    }
+
+    Container *dense = container_to_matrix(args[0]);
+    if (!dense) {
+        print_log("%s: аргумент должен быть матрицей\n", name);
+        return NULL;
+    }
+    SparseContainer *csr = sparse_from_dense((MatrixContainer*)dense->data);
+    free_container(dense);
+    if (!csr || format == SP_CSR) return csr ? create_sparse_container(csr) : NULL;
+
+    SparseContainer *sp = sparse_convert(csr, format);
+    sparse_free(csr);
+    return sp ? create_sparse_container(sp) : NULL;
+}
+
+Container* csr_func(Container** args, int arg_count) {
+    return convert_func(args, arg_count, SP_CSR, "csr");
+}
+
+Container* csc_func(Container** args, int arg_count) {
+    return convert_func(args, arg_count, SP_CSC, "csc");
+}
+
+// Количество ненулевых (хранимых) элементов
+Container* nnz_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("nnz: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (!args[0]) return NULL;
+
+    if (args[0]->type == CT_SPARSE) {
+        return create_int_container(((SparseContainer*)args[0]->data)->nnz);
+    }
+
+    int count;
+    double *values = container_values(args[0], &count);
+    if (!values) {
+        print_log("nnz: аргумент должен быть матрицей\n");
+        return NULL;
+    }
+    int nnz = 0;
+    for (int i = 0; i < count; i++) {
+        if (values[i] != 0.0) nnz++;
+    }
+    free(values);
+    return create_int_container(nnz);
+}
+
+// Загрузка матрицы Matrix Market: mmread("файл.mtx")
+Container* mmread_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("mmread: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (!args[0] || args[0]->type != CT_STRING) {
+        print_log("mmread: аргумент должен быть строкой с именем файла\n");
+        return NULL;
+    }
+    return sparse_load_mm(((StringContainer*)args[0]->data)->value);
+}
+
+// Случайная разреженная матрица: sprand(m, n, плотность)
+Container* sprand_func(Container** args, int arg_count) {
+    if (arg_count != 3) {
+        print_log("sprand: ожидается 3 аргумента\n");
+        return NULL;
+    }
+    if (!container_is_scalar(args[0]) || !container_is_scalar(args[1]) || !container_is_scalar(args[2])) {
+        print_log("sprand: аргументы должны быть числами\n");
+        return NULL;
+    }
+
+    int rows = (int)container_to_double(args[0]);
+    int cols = (int)container_to_double(args[1]);
+    double density = container_to_double(args[2]);
+    if (rows <= 0 || cols <= 0 || density < 0.0 || density > 1.0) {
+        print_log("sprand: нужны положительные размеры и плотность из [0, 1]\n");
+        return NULL;
+    }
+
+    SparseContainer *sp = sparse_random(rows, cols, density);
+    return sp ? create_sparse_container(sp) : NULL;
+}
+
+
+// Среднее время одного умножения (разреженного, если sp задана, иначе плотного)
+static double time_product(const SparseContainer *sp, const MatrixContainer *dense,
+                           const double *X, int k, double *Y) {
+    int reps = 1;
+    double elapsed;
+    while (1) {
+        double start = wall_time();
+        for (int r = 0; r < reps; r++) {
+            if (sp) {
+                sparse_spmm(sp, X, k, Y);
+            } else {
+                gemm(dense->rows, k, dense->cols, 1.0, dense->data, dense->cols, X, k, 0.0, Y, k);
+            }
+        }
+        elapsed = wall_time() - start;
+        if (elapsed > 0.2 || reps >= (1 << 20)) break;
+        reps *= 2;
+    }
+    return elapsed / reps;
+}
+
+// Сравнение плотного и разреженного умножения на векторе и на блоке из 16 столбцов
+void sparse_benchmark(int n) {
+    static const double densities[] = {0.001, 0.01, 0.05, 0.2};
+    const int block = 16;
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    double *X = (double*)malloc((size_t)n * block * sizeof(double));
+    double *Y_dense = (double*)malloc((size_t)n * block * sizeof(double));
+    double *Y_sparse = (double*)malloc((size_t)n * block * sizeof(double));
+    if (!X || !Y_dense || !Y_sparse) {
+        print_log("Ошибка: недостаточно памяти для теста n = %d\n", n);
+        free(X);
+        free(Y_dense);
+        free(Y_sparse);
+        return;
+    }
+    for (size_t i = 0; i < (size_t)n * block; i++) X[i] = rand_uniform();
+
+    print_log("Умножение %dx%d, потоков: %d\n", n, n, threads);
+    print_log("плотность        nnz  плотн. Ax   разреж. Ax  ускор.  плотн. AX%d  разреж. AX%d  ускор.\n", block, block);
+
+    for (size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); d++) {
+        SparseContainer *sp = sparse_random(n, n, densities[d]);
+        Container *dense = sp ? sparse_to_dense(sp) : NULL;
+        if (!dense) {
+            sparse_free(sp);
+            break;
+        }
+        MatrixContainer *dm = (MatrixContainer*)dense->data;
+
+        double dense_mv = time_product(NULL, dm, X, 1, Y_dense);
+        double sparse_mv = time_product(sp, NULL, X, 1, Y_sparse);
+        double dense_mm = time_product(NULL, dm, X, block, Y_dense);
+        double sparse_mm = time_product(sp, NULL, X, block, Y_sparse);
+
+        // Контроль: результаты обоих ядер должны совпадать
+        double max_diff = 0.0;
+        for (size_t i = 0; i < (size_t)n * block; i++) {
+            double diff = fabs(Y_dense[i] - Y_sparse[i]);
+            if (diff > max_diff) max_diff = diff;
+        }
+
+        print_log("%8.3f%% %10d %9.3f мс %9.3f мс %6.1fx %10.3f мс %10.3f мс %6.1fx%s\n",
+                  densities[d] * 100.0, sp->nnz,
+                  dense_mv * 1e3, sparse_mv * 1e3, dense_mv / sparse_mv,
+                  dense_mm * 1e3, sparse_mm * 1e3, dense_mm / sparse_mm,
+                  max_diff > 1e-9 ? "  (РАСХОЖДЕНИЕ)" : "");
+
+        free_container(dense);
+        sparse_free(sp);
+    }
+
+    free(X);
+    free(Y_dense);
+    free(Y_sparse);
+}
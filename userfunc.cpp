@@ -0,0 +1,397 @@
+#include "lib.h"
+
+// Функции пользователя: f(x, y) = x*x + y.
+//
+// Тело переводится в ОПЗ один раз при определении, имена параметров заменяются
+// токенами TOK_PARAM с номером ячейки, поэтому при вызове параметры не ищутся по
+// имени. Функции вызываются по имени в момент вычисления (позднее связывание):
+// переопределение f сразу действует во всех выражениях и функциях, которые ее вызывают.
+//
+// Небольшие тела (до USER_INLINE_TOKENS токенов) подставляются прямо в ОПЗ
+// вызывающего выражения вместо вызова: отрезок каждого аргумента ставится на место
+// параметра. После подстановки цепочки поэлементных операций тела и окружения
+// сливаются в один проход (fuse.cpp). Аргумент из нескольких токенов подставляется,
+// только если параметр встречается в теле ровно один раз, иначе функция вызывается
+// обычно и аргумент считается один раз. Тела с присваиванием не подставляются, а
+// присваивать параметру нельзя. Тела с подставленными вызовами других
+// функций хранятся до следующего определения любой функции.
+//
+// grad подставляет все вызовы без этих ограничений (user_expand): его выражение
+// без присваиваний и побочных эффектов, поэтому повтор аргумента ничего не меняет.
+
+#define USER_FUNC_MAX      64
+#define USER_PARAM_MAX     8
+#define USER_INLINE_TOKENS 48   // Наибольшее тело для подстановки
+#define USER_CALL_DEPTH    64   // Наибольшая глубина вложенных вызовов
+#define USER_EXPAND_TOKENS 4096 // Наибольшее тело при полной подстановке (grad)
+
+struct UserFunction {
+    char *name;
+    int params;
+    Token *body;            // ОПЗ тела
+    int uses[USER_PARAM_MAX];   // Сколько раз параметр встречается в теле
+    int length;             // Число токенов тела
+    Token *expanded;        // Тело с подставленными функциями
+    int expanded_length;
+    unsigned expanded_version;
+    int expanding;          // Идет подстановка в тело (защита от циклов)
+};
+
+static UserFunction user_functions[USER_FUNC_MAX];
+static int user_count = 0;
+static unsigned user_version = 1;   // Меняется при каждом определении
+static int call_depth = 0;
+
+UserFunction* find_user_function(const char *name) {
+    for (int i = 0; i < user_count; i++) {
+        if (strcmp(user_functions[i].name, name) == 0) return &user_functions[i];
+    }
+    return NULL;
+}
+
+int user_param_count(const UserFunction *f) {
+    return f->params;
+}
+
+static int list_length(const Token *head) {
+    int n = 0;
+    for (const Token *t = head; t; t = t->next) n++;
+    return n;
+}
+
+// Копия отрезка списка [start, end]; хвост копии возвращается в *tail
+static Token* copy_segment(const Token *start, const Token *end, Token **tail) {
+    Token *front = NULL, *rear = NULL;
+    for (const Token *t = start; t; t = t->next) {
+        enqueue(&front, &rear, copy_token(t));
+        if (t == end) break;
+    }
+    if (tail) *tail = rear;
+    return front;
+}
+
+
+// Подстановка
+
+// Отрезок ОПЗ, вычисляющий одно значение
+typedef struct {
+    Token *start;
+    Token *end;
+    int length;
+} Segment;
+
+static int segment_is_operand(const Segment *s) {
+    return s->length == 1 && token_arity(s->start) < 0;
+}
+
+static int segment_has_assign(const Segment *s) {
+    for (const Token *t = s->start; t; t = t->next) {
+        if (t->type == TOK_ASSIGN) return 1;
+        if (t == s->end) break;
+    }
+    return 0;
+}
+
+static const Token* expanded_body(UserFunction *f, int *length);
+static Token* inline_calls(Token *head, int force);
+
+static int has_assign(const Token *head) {
+    for (const Token *t = head; t; t = t->next) {
+        if (t->type == TOK_ASSIGN) return 1;
+    }
+    return 0;
+}
+
+// Можно ли подставить вызов f с аргументами args
+static int can_inline(UserFunction *f, const Segment *args, int count) {
+    if (f->expanding || count != f->params) return 0;
+    int length;
+    const Token *body = expanded_body(f, &length);
+    if (!body || length > USER_INLINE_TOKENS) return 0;
+
+    // Присваивание в теле: подстановка отрезка аргумента изменила бы смысл вызова
+    if (has_assign(body)) return 0;
+    for (int i = 0; i < count; i++) {
+        // Переменную без использования нужно все же найти, иначе пропадет ошибка
+        if (segment_is_operand(&args[i]) && !(f->uses[i] == 0 && args[i].start->type == TOK_IDENT)) continue;
+        if (f->uses[i] != 1 || segment_has_assign(&args[i])) return 0;
+    }
+    return 1;
+}
+
+// Тело f со всеми подставленными вызовами; NULL - цикл, присваивание или слишком
+// длинное тело. Освобождает вызывающий
+static Token* forced_body(UserFunction *f) {
+    if (f->expanding) return NULL;
+    f->expanding = 1;
+    Token *body = inline_calls(copy_segment(f->body, NULL, NULL), 1);
+    f->expanding = 0;
+    if (has_assign(body) || list_length(body) > USER_EXPAND_TOKENS) {
+        free_tokens(body);
+        return NULL;
+    }
+    return body;
+}
+
+// Подстановка функций в список ОПЗ; возвращает новое начало списка. force -
+// подставлять все вызовы, а не только небольшие. Стек отрезков повторяет стек
+// вычислителя: для каждого значения хранится отрезок токенов, который его вычисляет
+static Token* inline_calls(Token *head, int force) {
+    int capacity = list_length(head) + 1;
+    Segment *stack = (Segment*)malloc((size_t)capacity * sizeof(Segment));
+    int top = 0;
+    Token *t = head;
+
+    while (t) {
+        Token *next = t->next;
+        int arity = token_arity(t);
+        if (arity < 0) {
+            stack[top].start = stack[top].end = t;
+            stack[top].length = 1;
+            top++;
+            t = next;
+            continue;
+        }
+        if (arity > top) break;         // Ошибку сообщит вычислитель
+
+        UserFunction *f = t->type == TOK_FUNCTION && !find_function(t->value) ?
+                          find_user_function(t->value) : NULL;
+        Segment *args = stack + top - arity;
+
+        const Token *body = NULL;
+        Token *forced = NULL;
+        if (f && force) {
+            if (arity == f->params) body = forced = forced_body(f);
+        } else if (f && can_inline(f, args, arity)) {
+            body = expanded_body(f, NULL);
+        }
+
+        if (body) {
+            // Копия тела, в которой параметры заменены отрезками аргументов
+            Token *front = NULL, *rear = NULL;
+            for (const Token *b = body; b; b = b->next) {
+                if (b->type == TOK_PARAM) {
+                    Token *seg_tail;
+                    Token *seg = copy_segment(args[b->arg_count].start, args[b->arg_count].end, &seg_tail);
+                    if (rear) rear->next = seg;
+                    else front = seg;
+                    seg->prev = rear;
+                    rear = seg_tail;
+                } else {
+                    enqueue(&front, &rear, copy_token(b));
+                }
+            }
+            free_tokens(forced);
+
+            // Замена отрезков аргументов и вызова на подставленное тело
+            Token *first = arity > 0 ? args[0].start : t;
+            Token *before = first->prev;
+            if (before) before->next = front;
+            else head = front;
+            front->prev = before;
+            rear->next = next;
+            if (next) next->prev = rear;
+
+            t->next = NULL;
+            free_tokens(first);
+
+            // Тело уже без подстановок внутри, его значение - один отрезок
+            int length = 0;
+            for (Token *c = front; ; c = c->next) {
+                length++;
+                if (c == rear) break;
+            }
+            top -= arity;
+            stack[top].start = front;
+            stack[top].end = rear;
+            stack[top].length = length;
+            top++;
+            t = next;
+            continue;
+        }
+
+        Token *start = arity > 0 ? args[0].start : t;
+        int length = 1;
+        for (int i = 0; i < arity; i++) length += args[i].length;
+        top -= arity;
+        stack[top].start = start;
+        stack[top].end = t;
+        stack[top].length = length;
+        top++;
+        t = next;
+    }
+
+    free(stack);
+    return head;
+}
+
+// Тело f с подставленными небольшими функциями; пересобирается после новых определений
+static const Token* expanded_body(UserFunction *f, int *length) {
+    if (!f->expanded || f->expanded_version != user_version) {
+        free_tokens(f->expanded);
+        f->expanding = 1;
+        f->expanded = inline_calls(copy_segment(f->body, NULL, NULL), 0);
+        f->expanding = 0;
+        f->expanded_length = list_length(f->expanded);
+        f->expanded_version = user_version;
+    }
+    if (length) *length = f->expanded_length;
+    return f->expanded;
+}
+
+Token* user_inline(Token *rpn) {
+    if (user_count == 0 || !rpn) return rpn;
+    return inline_calls(rpn, 0);
+}
+
+Token* user_expand(Token *rpn) {
+    if (user_count == 0 || !rpn) return rpn;
+    return inline_calls(rpn, 1);
+}
+
+
+// Вызов
+
+Container* user_call(UserFunction *f, Container **args) {
+    if (call_depth >= USER_CALL_DEPTH) {
+        print_log("Ошибка: слишком глубокая вложенность вызовов функции %s\n", f->name);
+        return NULL;
+    }
+    call_depth++;
+    Container *result = countRPN_frame((Token*)expanded_body(f, NULL), args);
+    call_depth--;
+
+    // О неудаче сообщает только внешний вызов, а не каждый уровень вложенности
+    if (!result && call_depth == 0) print_log("Ошибка в функции %s\n", f->name);
+    return result;
+}
+
+
+// Определение
+
+static void user_free(UserFunction *f) {
+    free(f->name);
+    free_tokens(f->body);
+    free_tokens(f->expanded);
+    memset(f, 0, sizeof(*f));
+}
+
+// Разбор заголовка "имя(п1, п2, ...) =": 1 - это определение, токен после '=' в *body
+static int parse_header(Token *tokens, char **params, int *count, Token **body) {
+    Token *t = tokens;
+    if (!t || t->type != TOK_FUNCTION) return 0;
+    t = t->next;
+    if (!t || t->type != TOK_LPAREN) return 0;
+    t = t->next;
+
+    *count = 0;
+    if (t && t->type == TOK_RPAREN) {
+        t = t->next;
+    } else {
+        while (1) {
+            if (!t || t->type != TOK_IDENT || *count >= USER_PARAM_MAX) return 0;
+            params[(*count)++] = t->value;
+            t = t->next;
+            if (t && t->type == TOK_COMMA) {
+                t = t->next;
+                continue;
+            }
+            if (!t || t->type != TOK_RPAREN) return 0;
+            t = t->next;
+            break;
+        }
+    }
+    if (!t || t->type != TOK_ASSIGN) return 0;
+    *body = t->next;
+    return 1;
+}
+
+// Определение "f(x, y) = выражение". Возвращает 0, если строка не определение функции;
+// иначе функция определена или выведена ошибка
+int user_define(Token *tokens) {
+    char *params[USER_PARAM_MAX];
+    int count;
+    Token *body_tokens;
+    if (!parse_header(tokens, params, &count, &body_tokens)) return 0;
+
+    const char *name = tokens->value;
+    if (find_function(name)) {
+        print_log("Ошибка: %s - встроенная функция, ее нельзя переопределить\n\n", name);
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < i; j++) {
+            if (strcmp(params[i], params[j]) == 0) {
+                print_log("Ошибка: параметр %s повторяется\n\n", params[i]);
+                return 1;
+            }
+        }
+    }
+    if (!body_tokens || body_tokens->type == TOK_EOF) {
+        print_log("Ошибка: пустое тело функции %s\n\n", name);
+        return 1;
+    }
+    for (Token *t = body_tokens; t && t->next; t = t->next) {
+        if (t->type != TOK_IDENT || t->next->type != TOK_ASSIGN) continue;
+        for (int i = 0; i < count; i++) {
+            if (strcmp(t->value, params[i]) == 0) {
+                print_log("Ошибка: параметру %s нельзя присвоить значение\n\n", params[i]);
+                return 1;
+            }
+        }
+    }
+
+    Token *rpn = shuntingYard(body_tokens);
+    if (!rpn) {
+        print_log("Ошибка синтаксического анализа тела функции %s\n\n", name);
+        return 1;
+    }
+
+    // Параметры - в ячейки по номеру; прямой вызов самой себя не закончится
+    int uses[USER_PARAM_MAX] = {0};
+    for (Token *t = rpn; t; t = t->next) {
+        if (t->type == TOK_FUNCTION && strcmp(t->value, name) == 0) {
+            print_log("Ошибка: функция %s вызывает саму себя\n\n", name);
+            free_tokens(rpn);
+            return 1;
+        }
+        if (t->type != TOK_IDENT) continue;
+        for (int i = 0; i < count; i++) {
+            if (strcmp(t->value, params[i]) == 0) {
+                t->type = TOK_PARAM;
+                t->arg_count = i;
+                uses[i]++;
+                break;
+            }
+        }
+    }
+
+    UserFunction *f = find_user_function(name);
+    if (f) {
+        user_free(f);
+    } else if (user_count < USER_FUNC_MAX) {
+        f = &user_functions[user_count++];
+    } else {
+        print_log("Ошибка: не больше %d функций пользователя\n\n", USER_FUNC_MAX);
+        free_tokens(rpn);
+        return 1;
+    }
+
+    f->name = (char*)malloc(strlen(name) + 1);
+    strcpy(f->name, name);
+    f->params = count;
+    f->body = rpn;
+    f->length = list_length(rpn);
+    memcpy(f->uses, uses, sizeof(uses));
+    user_version++;
+
+    print_log("<< %s(", name);
+    for (int i = 0; i < count; i++) print_log(i ? ", %s" : "%s", params[i]);
+    print_log(")\n");
+    return 1;
+}
+
+void user_cleanup() {
+    for (int i = 0; i < user_count; i++) user_free(&user_functions[i]);
+    user_count = 0;
+}
@@ -0,0 +1,384 @@
+#include "lib.h"
+
+// Срезы A[1:3, :], v[::2] и транспонирование не копируют элементы: результат ссылается
+// на буфер исходной матрицы со сдвигом и шагами. Срез из целых строк остается обычной
+// матрицей (элементы идут подряд), остальные срезы - ViewContainer. Функции, которые
+// не умеют работать с шагами, получают плотную копию при вызове (args_materialize).
+
+
+// Буфер матрицы становится общим (создается при первой копии или срезе), ссылок + 1
+MatrixBuffer* matrix_share_buffer(MatrixContainer *m) {
+    if (!m->buffer) {
+        m->buffer = (MatrixBuffer*)malloc(sizeof(MatrixBuffer));
+        m->buffer->refs = 1;
+        m->buffer->data = m->data;
+    }
+    m->buffer->refs++;
+    return m->buffer;
+}
+
+// Последний владелец освобождает элементы
+void matrix_buffer_release(MatrixBuffer *buffer) {
+    if (!buffer) return;
+    if (--buffer->refs > 0) return;
+
+    mem_free(MEM_CONTAINERS, buffer->data);
+    free(buffer);
+}
+
+
+// Срезы
+
+Container* create_view_container(int rows, int cols, double *data, int row_stride, int col_stride,
+                                 MatrixBuffer *buffer) {
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
+    ViewContainer *view = (ViewContainer*)malloc(sizeof(ViewContainer));
+
+    view->rows = rows;
+    view->cols = cols;
+    view->data = data;
+    view->row_stride = row_stride;
+    view->col_stride = col_stride;
+    view->buffer = buffer;
+    container->type = CT_VIEW;
+    container->data = view;
+    container->free_func = free_view_container;
+    container->print_func = print_view_container;
+
+    return container;
+}
+
+void free_view_container(void *data) {
+    ViewContainer *view = (ViewContainer*)data;
+    if (view) {
+        matrix_buffer_release(view->buffer);
+        free(view);
+    }
+}
+
+void print_view_container(void *data) {
+    if (!data) return;
+    Container *dense = view_to_matrix((ViewContainer*)data);
+    if (!dense) return;
+    print_container(dense);
+    free_container(dense);
+}
+
+// Копия значения - еще одна ссылка на тот же буфер
+Container* view_copy(ViewContainer *v) {
+    v->buffer->refs++;
+    return create_view_container(v->rows, v->cols, v->data, v->row_stride, v->col_stride, v->buffer);
+}
+
+// Плотная копия среза по строкам
+Container* view_to_matrix(ViewContainer *v) {
+    Container *result = create_matrix_container(v->rows, v->cols);
+    if (!result) return NULL;
+    double *d = ((MatrixContainer*)result->data)->data;
+    double work = (double)v->rows * v->cols;
+
+    #pragma omp parallel for if(work > PARALLEL_MIN_WORK) schedule(static)
+    for (int i = 0; i < v->rows; i++) {
+        const double *src = v->data + (ptrdiff_t)i * v->row_stride;
+        double *dst = d + (size_t)i * v->cols;
+        for (int j = 0; j < v->cols; j++) dst[j] = src[(ptrdiff_t)j * v->col_stride];
+    }
+    return result;
+}
+
+// Описание плотной матрицы или среза через шаги; 0 - операнд другого типа
+int strided_operand(Container *c, ViewContainer *out) {
+    if (c->type == CT_VIEW) {
+        *out = *(ViewContainer*)c->data;
+        return 1;
+    }
+    if (c->type == CT_MATRIX) {
+        MatrixContainer *m = (MatrixContainer*)c->data;
+        out->rows = m->rows;
+        out->cols = m->cols;
+        out->data = m->data;
+        out->row_stride = m->cols;
+        out->col_stride = 1;
+        out->buffer = m->buffer;
+        return 1;
+    }
+    return 0;
+}
+
+// Замена срезов и float-матриц среди аргументов плотными матрицами двойной точности,
+// кроме тех, что функция принимает как есть (raw)
+void args_materialize(Container **args, int count, int raw) {
+    for (int i = 0; i < count; i++) {
+        if (!args[i]) continue;
+        Container *dense = NULL;
+        if (args[i]->type == CT_VIEW && !(raw & RAW_VIEW)) {
+            dense = view_to_matrix((ViewContainer*)args[i]->data);
+        } else if (args[i]->type == CT_SINGLE && !(raw & RAW_SINGLE)) {
+            dense = single_to_matrix((SingleContainer*)args[i]->data);
+        } else {
+            continue;
+        }
+        free_container(args[i]);
+        args[i] = dense;
+    }
+}
+
+// Результат среза или транспонирования: элементы подряд по строкам - обычная матрица,
+// иначе срез с шагами. Ссылка на буфер передается результату
+static Container* make_view(int rows, int cols, double *data, int row_stride, int col_stride,
+                            MatrixBuffer *buffer) {
+    int contiguous = (cols == 1 || col_stride == 1) && (rows == 1 || row_stride == (cols == 1 ? 1 : cols));
+    if (!contiguous) return create_view_container(rows, cols, data, row_stride, col_stride, buffer);
+
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
+    MatrixContainer *m = (MatrixContainer*)malloc(sizeof(MatrixContainer));
+    m->rows = rows;
+    m->cols = cols;
+    m->data = data;
+    m->cache = NULL;
+    m->buffer = buffer;
+    container->type = CT_MATRIX;
+    container->data = m;
+    container->free_func = free_matrix_container;
+    container->print_func = print_matrix_container;
+    return container;
+}
+
+// Матрица или срез как описание с шагами и ссылкой на общий буфер; разреженная
+// матрица предварительно переводится в плотную
+static int shared_operand(Container *c, ViewContainer *out) {
+    if (c->type == CT_VIEW) {
+        *out = *(ViewContainer*)c->data;
+        out->buffer->refs++;
+        return 1;
+    }
+
+    Container *temp = NULL;
+    MatrixContainer *m = c->type == CT_MATRIX || c->type == CT_SPARSE ? dense_view(c, &temp) : NULL;
+    if (!m) return 0;
+    strided_operand(temp ? temp : c, out);
+    out->buffer = matrix_share_buffer(m);
+    free_container(temp);
+    return 1;
+}
+
+
+// Диапазоны
+
+Container* create_range_container(int has_start, int start, int has_stop, int stop, int step) {
+    Container *container = (Container*)mem_alloc(MEM_CONTAINERS, sizeof(Container));
+    RangeContainer *range = (RangeContainer*)malloc(sizeof(RangeContainer));
+
+    range->has_start = has_start;
+    range->start = start;
+    range->has_stop = has_stop;
+    range->stop = stop;
+    range->step = step;
+    container->type = CT_RANGE;
+    container->data = range;
+    container->free_func = free_range_container;
+    container->print_func = print_range_container;
+
+    return container;
+}
+
+void free_range_container(void *data) {
+    if (data) free(data);
+}
+
+void print_range_container(void *data) {
+    if (!data) return;
+    RangeContainer *r = (RangeContainer*)data;
+    if (r->has_start) print_log("%d", r->start);
+    print_log(":");
+    if (r->has_stop) print_log("%d", r->stop);
+    if (r->step != 1) print_log(":%d", r->step);
+}
+
+// Целое значение индекса; NULL допустим для пропущенной части среза
+static int index_value(Container *c, int *out) {
+    if (!container_is_scalar(c)) {
+        print_log("Ошибка: индекс должен быть целым числом\n");
+        return 0;
+    }
+    double value = container_to_double(c);
+    if (value != floor(value) || fabs(value) > INT_MAX) {
+        print_log("Ошибка: индекс должен быть целым числом\n");
+        return 0;
+    }
+    *out = (int)value;
+    return 1;
+}
+
+// Оператор ":" из индексов: начало:конец или начало:конец:шаг, части могут быть пропущены
+Container* range_func(Container** args, int arg_count) {
+    int value[3] = {0, 0, 1};
+    for (int i = 0; i < arg_count && i < 3; i++) {
+        if (args[i] && !index_value(args[i], &value[i])) return NULL;
+    }
+    if (value[2] == 0) {
+        print_log("Ошибка: шаг среза не может быть нулевым\n");
+        return NULL;
+    }
+    return create_range_container(args[0] != NULL, value[0], args[1] != NULL, value[1], value[2]);
+}
+
+
+// Индексы по одному измерению длины length: первый элемент, количество и шаг
+typedef struct {
+    int first;
+    int count;
+    int step;
+    int single;     // Одиночный индекс, а не срез
+} Selection;
+
+// Как в Python: отрицательные индексы отсчитываются от конца, границы среза обрезаются
+static int select_indices(Container *index, int length, Selection *sel) {
+    if (index && index->type == CT_RANGE) {
+        RangeContainer *r = (RangeContainer*)index->data;
+        int step = r->step;
+        int start, stop;
+
+        if (r->has_start) {
+            start = r->start < 0 ? r->start + length : r->start;
+            if (start < 0) start = step < 0 ? -1 : 0;
+            else if (start >= length) start = step < 0 ? length - 1 : length;
+        } else {
+            start = step < 0 ? length - 1 : 0;
+        }
+        if (r->has_stop) {
+            stop = r->stop < 0 ? r->stop + length : r->stop;
+            if (stop < 0) stop = step < 0 ? -1 : 0;
+            else if (stop >= length) stop = step < 0 ? length - 1 : length;
+        } else {
+            stop = step < 0 ? -1 : length;
+        }
+
+        sel->first = start;
+        sel->step = step;
+        sel->single = 0;
+        if (step > 0) sel->count = stop > start ? (stop - start + step - 1) / step : 0;
+        else sel->count = start > stop ? (start - stop - step - 1) / -step : 0;
+
+        if (sel->count == 0) {
+            print_log("Ошибка: срез не содержит элементов\n");
+            return 0;
+        }
+        return 1;
+    }
+
+    int i;
+    if (!index || !index_value(index, &i)) return 0;
+    if (i < 0) i += length;
+    if (i < 0 || i >= length) {
+        print_log("Ошибка: индекс вне диапазона 0..%d\n", length - 1);
+        return 0;
+    }
+    sel->first = i;
+    sel->count = 1;
+    sel->step = 1;
+    sel->single = 1;
+    return 1;
+}
+
+// Индексация A[i, j], A[1:3, :], v[::2]; индексы с нуля. Один индекс у матрицы
+// выбирает строки, у строки или столбца - элементы
+Container* index_func(Container** args, int arg_count) {
+    if (!args[0]) return NULL;
+    Container *base = args[0];
+    int dims = arg_count - 1;
+
+    if (base->type == CT_LIST) {
+        ListContainer *lc = (ListContainer*)base->data;
+        Selection sel;
+        if (dims != 1 || (args[1] && args[1]->type == CT_RANGE)) {
+            print_log("Ошибка: набор значений индексируется одним числом\n");
+            return NULL;
+        }
+        if (!select_indices(args[1], lc->count, &sel)) return NULL;
+        return container_deep_copy(lc->items[sel.first]);
+    }
+
+    if (dims < 1 || dims > 2) {
+        print_log("Ошибка: ожидается один или два индекса\n");
+        return NULL;
+    }
+
+    // Вектор индексируется как столбец 3 x 1 с копированием: элементов всего три
+    Container *vector_temp = base->type == CT_VECTOR ? container_to_matrix(base) : NULL;
+    ViewContainer v;
+    if (!shared_operand(vector_temp ? vector_temp : base, &v)) {
+        print_log("Ошибка: индексировать можно матрицу, вектор или набор значений\n");
+        return NULL;
+    }
+    free_container(vector_temp);
+
+    Selection rows, cols;
+    int ok;
+    if (dims == 2) {
+        ok = select_indices(args[1], v.rows, &rows) && select_indices(args[2], v.cols, &cols);
+    } else if (v.rows == 1) {
+        rows.first = 0;
+        rows.count = 1;
+        rows.step = 1;
+        rows.single = 0;
+        ok = select_indices(args[1], v.cols, &cols);
+    } else {
+        cols.first = 0;
+        cols.count = v.cols;
+        cols.step = 1;
+        cols.single = v.cols == 1;
+        ok = select_indices(args[1], v.rows, &rows);
+    }
+    if (!ok) {
+        matrix_buffer_release(v.buffer);
+        return NULL;
+    }
+
+    double *data = v.data + (ptrdiff_t)rows.first * v.row_stride + (ptrdiff_t)cols.first * v.col_stride;
+    if (rows.single && cols.single) {
+        Container *element = create_float_container(*data);
+        matrix_buffer_release(v.buffer);
+        return element;
+    }
+    return make_view(rows.count, cols.count, data, rows.step * v.row_stride, cols.step * v.col_stride, v.buffer);
+}
+
+// Транспонирование: у матрицы и среза меняются местами размеры и шаги
+Container* transpose_func(Container** args, int arg_count) {
+    if (arg_count != 1) {
+        print_log("transpose: ожидается 1 аргумент\n");
+        return NULL;
+    }
+    if (!args[0]) return NULL;
+    Container *a = args[0];
+
+    if (container_is_scalar(a)) return container_deep_copy(a);
+    if (a->type == CT_VECTOR) {
+        Container *result = container_to_matrix(a);
+        if (result) {
+            MatrixContainer *m = (MatrixContainer*)result->data;
+            m->rows = 1;
+            m->cols = 3;
+        }
+        return result;
+    }
+
+    // CSR матрицы совпадает с CSC транспонированной: меняются только формат и размеры
+    if (a->type == CT_SPARSE) {
+        SparseContainer *sp = (SparseContainer*)a->data;
+        SparseContainer *t = sparse_convert(sp, sp->format);
+        if (!t) return NULL;
+        t->format = sp->format == SP_CSR ? SP_CSC : SP_CSR;
+        t->rows = sp->cols;
+        t->cols = sp->rows;
+        return create_sparse_container(t);
+    }
+
+    ViewContainer v;
+    if (!shared_operand(a, &v)) {
+        print_log("transpose: аргумент должен быть числом, вектором или матрицей\n");
+        return NULL;
+    }
+    return make_view(v.cols, v.rows, v.data, v.col_stride, v.row_stride, v.buffer);
+}